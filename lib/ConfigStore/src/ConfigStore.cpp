@@ -0,0 +1,212 @@
+#include "ConfigStore.h"
+
+// Initialize static variables
+String ConfigStore::path;
+std::map<String, std::vector<uint8_t>> ConfigStore::sections;
+std::vector<String> ConfigStore::migrated;
+bool ConfigStore::dirty = false;
+SemaphoreHandle_t ConfigStore::lock = xSemaphoreCreateRecursiveMutex();
+
+/// @brief Loads the configuration store
+/// @param Path The path of the store file
+/// @return True on success
+bool ConfigStore::begin(String Path) {
+	path = Path;
+	sections.clear();
+	if (!Storage::fileExists("/settings")) {
+		Storage::createDir("/settings");
+	}
+	File file = Storage::getFileSystem(path)->open(path);
+	if (!file) {
+		return true;
+	}
+	// Read the whole store in one go
+	std::vector<uint8_t> data(file.size());
+	bool success = file.read(data.data(), data.size()) == data.size();
+	file.close();
+	uint32_t magic = 0;
+	if (success && data.size() >= sizeof(magic)) {
+		memcpy(&magic, data.data(), sizeof(magic));
+	}
+	if (magic != store_magic) {
+		// Fall back to any JSON files, or defaults
+		Serial.println("Config store is invalid, ignoring it");
+		return true;
+	}
+	size_t position = sizeof(magic);
+	while (position < data.size()) {
+		uint8_t key_length = data[position];
+		if (position + 1 + key_length + sizeof(uint16_t) > data.size()) {
+			break;
+		}
+		String key;
+		key.concat((const char*)&data[position + 1], key_length);
+		position += 1 + key_length;
+		uint16_t section_length;
+		memcpy(&section_length, &data[position], sizeof(section_length));
+		position += sizeof(section_length);
+		if (position + section_length > data.size()) {
+			break;
+		}
+		sections[key] = std::vector<uint8_t>(data.begin() + position, data.begin() + position + section_length);
+		position += section_length;
+	}
+	if (position != data.size()) {
+		// Keep the complete sections, the rest fall back to defaults
+		Serial.println("Config store is truncated");
+	}
+	Serial.println("Loaded " + String(sections.size()) + " config sections");
+	return true;
+}
+
+/// @brief Checks if a config section exists, moving it from its JSON file if needed
+/// @param key The key of the section
+/// @return True if the section exists
+bool ConfigStore::has(String key) {
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	bool found = sections.count(key) > 0 || migrate(key);
+	xSemaphoreGiveRecursive(lock);
+	return found;
+}
+
+/// @brief Gets a config section
+/// @param key The key of the section
+/// @return The section as a JSON string, empty string if it doesn't exist
+String ConfigStore::get(String key) {
+	String output = "";
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	if (has(key)) {
+		const std::vector<uint8_t>& section = sections[key];
+		// Allocate the JSON document
+		JsonDocument doc;
+		DeserializationError error = deserializeMsgPack(doc, section.data(), section.size());
+		if (error) {
+			Serial.print(F("Deserialization failed: "));
+			Serial.println(error.f_str());
+		} else {
+			serializeJson(doc, output);
+		}
+	}
+	xSemaphoreGiveRecursive(lock);
+	return output;
+}
+
+/// @brief Sets a config section. Changes are kept in memory until commit() is called
+/// @param key The key of the section, at most 255 characters
+/// @param json The section as a JSON string
+/// @return True on success
+bool ConfigStore::set(String key, String json) {
+	if (key.length() > 255) {
+		return false;
+	}
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Deserialize section contents
+	DeserializationError error = deserializeJson(doc, json);
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	std::vector<uint8_t> section(measureMsgPack(doc));
+	if (section.size() > UINT16_MAX) {
+		return false;
+	}
+	serializeMsgPack(doc, section.data(), section.size());
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	auto existing = sections.find(key);
+	if (existing == sections.end() || existing->second != section) {
+		sections[key] = std::move(section);
+		dirty = true;
+	}
+	xSemaphoreGiveRecursive(lock);
+	return true;
+}
+
+/// @brief Writes any changed sections to storage
+/// @return True on success
+bool ConfigStore::commit() {
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	bool success = true;
+	if (dirty) {
+		// The constant has no definition to take the address of, so copy it first
+		uint32_t magic = store_magic;
+		std::vector<uint8_t> data((const uint8_t*)&magic, (const uint8_t*)&magic + sizeof(magic));
+		for (const auto& s : sections) {
+			uint16_t section_length = s.second.size();
+			data.push_back(s.first.length());
+			data.insert(data.end(), s.first.c_str(), s.first.c_str() + s.first.length());
+			data.insert(data.end(), (const uint8_t*)&section_length, (const uint8_t*)&section_length + sizeof(section_length));
+			data.insert(data.end(), s.second.begin(), s.second.end());
+		}
+		success = Storage::writeFile(path, data.data(), data.size());
+		if (success) {
+			dirty = false;
+			// The JSON files are no longer needed once their sections are stored
+			for (const auto& m : migrated) {
+				Storage::deleteFile(m);
+			}
+			migrated.clear();
+		}
+	}
+	xSemaphoreGiveRecursive(lock);
+	return success;
+}
+
+/// @brief Gets all config sections as a JSON object
+/// @return A JSON string with each section under its key
+String ConfigStore::exportJSON() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// An empty document serializes as null, so start with an object
+	doc.to<JsonObject>();
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	for (const auto& s : sections) {
+		JsonDocument section;
+		if (!deserializeMsgPack(section, s.second.data(), s.second.size())) {
+			doc[s.first] = section;
+		}
+	}
+	xSemaphoreGiveRecursive(lock);
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Replaces config sections from a JSON object, like the one from exportJSON(), and commits them. Sections not in the object are kept
+/// @param json A JSON string with each section under its key
+/// @return True on success
+bool ConfigStore::importJSON(String json) {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Deserialize file contents
+	DeserializationError error = deserializeJson(doc, json);
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	bool success = true;
+	for (JsonPair s : doc.as<JsonObject>()) {
+		String section;
+		serializeJson(s.value(), section);
+		success &= set(s.key().c_str(), section);
+	}
+	return commit() && success;
+}
+
+/// @brief Moves a config section from its JSON file into the store
+/// @param key The key of the section, which is the path of its JSON file
+/// @return True if the section was moved
+bool ConfigStore::migrate(String key) {
+	if (!key.startsWith("/") || !Storage::fileExists(key) || !set(key, Storage::readFile(key))) {
+		return false;
+	}
+	Serial.println("Moved " + key + " into config store");
+	migrated.push_back(key);
+	return true;
+}
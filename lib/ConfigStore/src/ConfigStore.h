@@ -0,0 +1,55 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* ArduinoJSON: https://arduinojson.org/
+*
+* All configuration is kept in one file, read once at boot. Each section is stored as MessagePack under the path of
+* the JSON file it replaces (e.g. "/settings/sig/TimerSwitch.json"), and is only converted back to JSON when it's
+* requested. Existing JSON files are moved into the store the first time their section is requested.
+*
+* File format (little-endian): "SHC1", then for each section the key length (uint8), the key, the section length
+* (uint16), and the section.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Storage.h>
+#include <map>
+#include <vector>
+
+/// @brief Stores all configuration sections in a single binary file
+class ConfigStore {
+	public:
+		static bool begin(String Path = "/settings/config.bin");
+		static bool has(String key);
+		static String get(String key);
+		static bool set(String key, String json);
+		static bool commit();
+		static String exportJSON();
+		static bool importJSON(String json);
+
+	private:
+		/// @brief Path of the store file
+		static String path;
+
+		/// @brief MessagePack encoded sections, by key
+		static std::map<String, std::vector<uint8_t>> sections;
+
+		/// @brief Keys of sections moved from JSON files, which are removed once the store is committed
+		static std::vector<String> migrated;
+
+		/// @brief True if there are changes that haven't been committed
+		static bool dirty;
+
+		/// @brief Guards the sections, since they can be changed from the web server and the main loop
+		static SemaphoreHandle_t lock;
+
+		/// @brief Value of the magic number at the start of the file ("SHC1")
+		static const uint32_t store_magic = 0x31434853;
+
+		static bool migrate(String key);
+};
@@ -22,7 +22,7 @@ bool Configuration::begin(String File) {
 /// @brief Deserializes JSON from config file and applies it to current config
 /// @return True on success
 bool Configuration::loadConfig() {
-	String json_string = Storage::readFile(file);
+	String json_string = ConfigStore::get(file);
 	if (json_string == "") {
 		Serial.println("Could not load config file, or it doesn't exist. Defaults used.");
 		json_string = configToJSON();
@@ -54,6 +54,8 @@ bool Configuration::updateConfig(String config) {
 	currentConfig.WiFiClient = doc["WiFiClient"] | true;
 	currentConfig.configSSID = doc["configSSID"].as<String>();
 	currentConfig.configPW = doc["configPW"].as<String>();
+	currentConfig.apiUser = doc["apiUser"] | "";
+	currentConfig.apiPW = doc["apiPW"] | "";
 	return true;
 }
 
@@ -63,11 +65,12 @@ bool Configuration::saveConfig() {
 	return saveConfig(configToJSON());
 }
 
-/// @brief Saves a string of config settings to config file. Does not apply the settings without a call to loadSettings()
+/// @brief Saves a string of config settings to config file. Does not apply the settings without a call to loadSettings().
+/// Unchanged settings aren't rewritten, and changes are written shortly after (see DeviceConfig::writeConfig())
 /// @param config A complete and properly formatted JSON string of all the settings
 /// @return True on success
 bool Configuration::saveConfig(String config) {
-	if(!Storage::writeFile(file, config)) {
+	if(!DeviceConfig::writeConfig(file, config)) {
 		Serial.println("Could not write config file");
 		return false;
 	}
@@ -94,6 +97,8 @@ String Configuration::configToJSON() {
 	doc["WiFiClient"] = currentConfig.WiFiClient;
 	doc["configSSID"] = currentConfig.configSSID;
 	doc["configPW"] = currentConfig.configPW;
+	doc["apiUser"] = currentConfig.apiUser;
+	doc["apiPW"] = currentConfig.apiPW;
 
 	// Create string to hold output
 	String output;
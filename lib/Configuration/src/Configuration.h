@@ -10,6 +10,7 @@
 #pragma once
 #include <ArduinoJson.h>
 #include <Storage.h>
+#include <DeviceConfig.h>
 
 /// @brief Holds and manages the hub configuration
 class Configuration {
@@ -41,6 +42,12 @@ class Configuration {
 
 			/// @brief Password for configuration interface
 			String configPW = "ESP32Sensor";
+
+			/// @brief User name required to use the web API, empty to allow anyone
+			String apiUser = "";
+
+			/// @brief Password required to use the web API
+			String apiPW = "";
 		} config;
 
 		static String configToJSON();
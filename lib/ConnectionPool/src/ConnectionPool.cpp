@@ -0,0 +1,133 @@
+#include "ConnectionPool.h"
+
+// Initialize static variables
+std::vector<ConnectionPool::connection> ConnectionPool::connections;
+SemaphoreHandle_t ConnectionPool::lock = xSemaphoreCreateMutex();
+
+/// @brief Gets a client for a request, reusing an open connection to the same server if there is one
+/// @param url The URL the request will be sent to
+/// @return An HTTP client started on the URL, or nullptr if no socket became free in time. Must be returned with release()
+HTTPClient* ConnectionPool::acquire(String url) {
+	String key = keyFor(url);
+	ulong start = millis();
+	do {
+		HTTPClient* http = nullptr;
+		WiFiClient* client = nullptr;
+		xSemaphoreTake(lock, portMAX_DELAY);
+		// Reuse an idle connection to the same server that's still open
+		for (size_t i = 0; i < connections.size() && http == nullptr; i++) {
+			if (!connections[i].in_use && connections[i].key == key) {
+				if (connections[i].client->connected()) {
+					connections[i].in_use = true;
+					http = connections[i].http;
+					client = connections[i].client;
+				} else {
+					// Closed by the server
+					close(i--);
+				}
+			}
+		}
+		// Make room by closing the longest idle connection to another server
+		if (http == nullptr && connections.size() >= max_sockets) {
+			int oldest = -1;
+			for (size_t i = 0; i < connections.size(); i++) {
+				if (!connections[i].in_use && (oldest < 0 || connections[i].last_used < connections[oldest].last_used)) {
+					oldest = i;
+				}
+			}
+			if (oldest >= 0) {
+				close(oldest);
+			}
+		}
+		if (http == nullptr && connections.size() < max_sockets) {
+			if (key.startsWith("https")) {
+				// No CA is configured for webhooks, same as HTTPClient::begin(url)
+				WiFiClientSecure* secure = new WiFiClientSecure();
+				secure->setInsecure();
+				client = secure;
+			} else {
+				client = new WiFiClient();
+			}
+			http = new HTTPClient();
+			http->setReuse(true);
+			connections.push_back({ .key = key, .client = client, .http = http, .in_use = true, .last_used = millis() });
+		}
+		xSemaphoreGive(lock);
+		if (http != nullptr) {
+			// Credentials from a previous URL to the same server mustn't be sent with this one
+			http->setAuthorization("");
+			http->begin(*client, url);
+			return http;
+		}
+		// Every socket is busy, wait for one to be released
+		delay(50);
+	} while (millis() - start < acquire_timeout);
+	Serial.println("No free sockets for request to " + key);
+	return nullptr;
+}
+
+/// @brief Ends a request and returns its connection to the pool
+/// @param http The client from acquire()
+/// @param reusable True if the response was read completely and the connection can be used by the next request
+void ConnectionPool::release(HTTPClient* http, bool reusable) {
+	// Keeps the connection open unless the server asked to close it
+	http->end();
+	xSemaphoreTake(lock, portMAX_DELAY);
+	for (size_t i = 0; i < connections.size(); i++) {
+		if (connections[i].http == http) {
+			if (reusable && connections[i].client->connected()) {
+				connections[i].in_use = false;
+				connections[i].last_used = millis();
+			} else {
+				close(i);
+			}
+			break;
+		}
+	}
+	xSemaphoreGive(lock);
+}
+
+/// @brief Closes connections that have been idle too long or were closed by the server
+void ConnectionPool::prune() {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	for (size_t i = 0; i < connections.size(); i++) {
+		if (!connections[i].in_use && (millis() - connections[i].last_used >= idle_timeout || !connections[i].client->connected())) {
+			close(i--);
+		}
+	}
+	xSemaphoreGive(lock);
+}
+
+/// @brief Gets the key of the server a URL points to
+/// @param url The URL
+/// @return The scheme, host and port of the URL
+String ConnectionPool::keyFor(String url) {
+	int scheme_end = url.indexOf("://");
+	String scheme = scheme_end < 0 ? "http" : url.substring(0, scheme_end);
+	scheme.toLowerCase();
+	String host = scheme_end < 0 ? url : url.substring(scheme_end + 3);
+	// Remove path and credentials
+	int path = host.indexOf('/');
+	if (path >= 0) {
+		host = host.substring(0, path);
+	}
+	int credentials = host.lastIndexOf('@');
+	if (credentials >= 0) {
+		host = host.substring(credentials + 1);
+	}
+	host.toLowerCase();
+	if (host.indexOf(':') < 0) {
+		host += scheme == "https" ? ":443" : ":80";
+	}
+	return scheme + "://" + host;
+}
+
+/// @brief Closes a connection and removes it from the pool. Must be called with the lock held
+/// @param index The position of the connection in the pool
+void ConnectionPool::close(size_t index) {
+	connections[index].client->stop();
+	// The HTTP client refers to the connection until it's deleted
+	delete connections[index].http;
+	delete connections[index].client;
+	connections.erase(connections.begin() + index);
+}
@@ -0,0 +1,62 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Keeps connections to web servers open between requests so repeated requests to the same server don't pay for a new
+* TCP (and TLS) handshake every time. Connections are shared by every webhook that uses the same scheme, host and port,
+* are closed after sitting idle, and the total number of sockets is capped to leave room in lwIP for the web server.
+* Each connection is pooled with the HTTPClient that uses it, since destroying an HTTPClient stops its connection.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#include <vector>
+
+/// @brief Pool of keep-alive connections shared by outgoing requests
+class ConnectionPool {
+	public:
+		static HTTPClient* acquire(String url);
+		static void release(HTTPClient* http, bool reusable);
+		static void prune();
+		static String keyFor(String url);
+
+	private:
+		/// @brief Describes a pooled connection
+		typedef struct connection {
+			/// @brief The scheme, host and port the connection is to (e.g. "https://example.com:443")
+			String key;
+
+			/// @brief The client holding the connection
+			WiFiClient* client;
+
+			/// @brief The HTTP client sending requests on the connection
+			HTTPClient* http;
+
+			/// @brief True while a request is using the connection
+			bool in_use;
+
+			/// @brief The time the connection was last released, in milliseconds
+			ulong last_used;
+		} connection;
+
+		/// @brief All pooled connections
+		static std::vector<connection> connections;
+
+		/// @brief Locks the pool, since requests are sent from more than one task
+		static SemaphoreHandle_t lock;
+
+		/// @brief Maximum number of sockets the pool can hold open
+		static const size_t max_sockets = 4;
+
+		/// @brief Time in milliseconds an unused connection is kept open
+		static const ulong idle_timeout = 15000;
+
+		/// @brief Time in milliseconds to wait for a free socket
+		static const ulong acquire_timeout = 5000;
+
+		static void close(size_t index);
+};
@@ -0,0 +1,173 @@
+#include "DeltaPatch.h"
+
+/// @brief Starts applying a delta
+/// @param s The state of the delta
+void DeltaPatch::begin(state& s) {
+	memset(&s, 0, sizeof(state));
+	s.stage = Stage::Header;
+}
+
+/// @brief Applies the next chunk of a delta
+/// @param s The state of the delta
+/// @param data The chunk of the delta
+/// @param len The length of the chunk in bytes
+/// @param output Receives the bytes of the new firmware
+/// @return True on success, false if the delta failed (see state.error)
+bool DeltaPatch::apply(state& s, const uint8_t* data, size_t len, Output output) {
+	while (len > 0 && s.error == nullptr) {
+		switch (s.stage) {
+			case Stage::Header:
+				if (readField(s, data, len, header_size)) {
+					if (readUint32(s.field) != delta_magic) {
+						s.error = "Not a firmware delta";
+					} else if (checkSource(s, readUint32(s.field + 4), s.field + 8)) {
+						s.target_size = readUint32(s.field + 40);
+						s.stage = Stage::Operation;
+					}
+				}
+				break;
+			case Stage::Operation:
+				{
+					uint8_t operation = *data++;
+					len--;
+					if (operation == 1) {
+						s.stage = Stage::CopyArguments;
+					} else if (operation == 2) {
+						s.stage = Stage::InsertLength;
+					} else {
+						s.error = "Firmware delta is corrupt";
+					}
+				}
+				break;
+			case Stage::CopyArguments:
+				if (readField(s, data, len, 8) && copy(s, readUint32(s.field), readUint32(s.field + 4), output)) {
+					s.stage = s.produced >= s.target_size ? Stage::Done : Stage::Operation;
+				}
+				break;
+			case Stage::InsertLength:
+				if (readField(s, data, len, 4)) {
+					s.remaining = readUint32(s.field);
+					s.stage = Stage::InsertData;
+				}
+				break;
+			case Stage::InsertData:
+				{
+					size_t length = std::min((size_t)s.remaining, len);
+					if (s.produced + length > s.target_size) {
+						s.error = "Firmware delta is too long";
+						break;
+					}
+					if (!output(data, length)) {
+						s.error = "Could not write firmware";
+						break;
+					}
+					data += length;
+					len -= length;
+					s.remaining -= length;
+					s.produced += length;
+					if (s.remaining == 0) {
+						s.stage = s.produced >= s.target_size ? Stage::Done : Stage::Operation;
+					}
+				}
+				break;
+			case Stage::Done:
+				s.error = "Firmware delta is too long";
+				break;
+		}
+	}
+	return s.error == nullptr;
+}
+
+/// @brief Checks if all of the new firmware has been produced
+/// @param s The state of the delta
+/// @return True if the delta is complete
+bool DeltaPatch::finished(const state& s) {
+	return s.error == nullptr && s.stage == Stage::Done;
+}
+
+/// @brief Collects the bytes of a fixed size field, which may be split across chunks
+/// @param s The state of the delta
+/// @param data The chunk, moved past the bytes read
+/// @param len The length of the chunk, reduced by the bytes read
+/// @param size The size of the field in bytes
+/// @return True once the whole field has been read into state.field
+bool DeltaPatch::readField(state& s, const uint8_t*& data, size_t& len, size_t size) {
+	size_t length = std::min(size - s.field_length, len);
+	memcpy(s.field + s.field_length, data, length);
+	s.field_length += length;
+	data += length;
+	len -= length;
+	if (s.field_length < size) {
+		return false;
+	}
+	s.field_length = 0;
+	return true;
+}
+
+/// @brief Checks the running firmware is the one the delta was made against
+/// @param s The state of the delta
+/// @param size The size of the firmware the delta was made against
+/// @param hash The SHA-256 hash of the firmware the delta was made against
+/// @return True if the running firmware matches
+bool DeltaPatch::checkSource(state& s, uint32_t size, const uint8_t* hash) {
+	const esp_partition_t* running = esp_ota_get_running_partition();
+	if (running == nullptr || size > running->size) {
+		s.error = "Firmware delta doesn't match the running firmware";
+		return false;
+	}
+	mbedtls_sha256_context sha;
+	mbedtls_sha256_init(&sha);
+	mbedtls_sha256_starts(&sha, 0);
+	uint8_t buffer[512];
+	bool success = true;
+	for (uint32_t offset = 0; success && offset < size; offset += sizeof(buffer)) {
+		size_t length = std::min((size_t)(size - offset), sizeof(buffer));
+		success = esp_partition_read(running, offset, buffer, length) == ESP_OK;
+		mbedtls_sha256_update(&sha, buffer, length);
+	}
+	uint8_t running_hash[32];
+	mbedtls_sha256_finish(&sha, running_hash);
+	mbedtls_sha256_free(&sha);
+	if (!success || memcmp(running_hash, hash, sizeof(running_hash)) != 0) {
+		s.error = "Firmware delta doesn't match the running firmware";
+		return false;
+	}
+	return true;
+}
+
+/// @brief Copies part of the running firmware to the new firmware
+/// @param s The state of the delta
+/// @param offset The offset in the running firmware
+/// @param length The number of bytes to copy
+/// @param output Receives the bytes of the new firmware
+/// @return True on success
+bool DeltaPatch::copy(state& s, uint32_t offset, uint32_t length, Output& output) {
+	const esp_partition_t* running = esp_ota_get_running_partition();
+	if ((uint64_t)offset + length > running->size || s.produced + length > s.target_size) {
+		s.error = "Firmware delta is corrupt";
+		return false;
+	}
+	uint8_t buffer[512];
+	while (length > 0) {
+		size_t chunk = std::min((size_t)length, sizeof(buffer));
+		if (esp_partition_read(running, offset, buffer, chunk) != ESP_OK) {
+			s.error = "Could not read running firmware";
+			return false;
+		}
+		if (!output(buffer, chunk)) {
+			s.error = "Could not write firmware";
+			return false;
+		}
+		offset += chunk;
+		length -= chunk;
+		s.produced += chunk;
+	}
+	return true;
+}
+
+/// @brief Reads a little-endian 32-bit value
+/// @param bytes The bytes of the value
+/// @return The value
+uint32_t DeltaPatch::readUint32(const uint8_t* bytes) {
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
@@ -0,0 +1,77 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Rebuilds a firmware image from a delta against the running firmware, as the delta streams in. Deltas are made with
+* tools/make_delta.py, and only hold the parts of the new firmware that can't be copied from the running firmware.
+*
+* Delta format (little-endian): "SHD1", the size of the firmware it was made against (uint32), the SHA-256 hash of that
+* firmware, and the size of the new firmware (uint32). Then a list of operations, each a type (uint8) followed by:
+*  - Copy (1): the offset in the running firmware (uint32) and the number of bytes to copy (uint32)
+*  - Insert (2): the number of bytes (uint32) and the bytes themselves
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include <functional>
+
+/// @brief Applies deltas to the running firmware
+class DeltaPatch {
+	public:
+		/// @brief Stages of reading a delta
+		enum class Stage {
+			Header,
+			Operation,
+			CopyArguments,
+			InsertLength,
+			InsertData,
+			Done
+		};
+
+		/// @brief State of a delta being applied. Plain data so it can be kept in an upload's state
+		typedef struct state {
+			/// @brief The current stage of reading the delta
+			Stage stage;
+
+			/// @brief Bytes of the current field read so far
+			uint8_t field[44];
+
+			/// @brief Number of bytes of the current field read so far
+			size_t field_length;
+
+			/// @brief Size of the new firmware in bytes
+			uint32_t target_size;
+
+			/// @brief Number of bytes of the new firmware produced so far
+			uint32_t produced;
+
+			/// @brief Number of bytes left to insert
+			uint32_t remaining;
+
+			/// @brief Description of why the delta failed, nullptr if it hasn't
+			const char* error;
+		} state;
+
+		/// @brief Receives the bytes of the new firmware, returning true on success
+		typedef std::function<bool(const uint8_t*, size_t)> Output;
+
+		static void begin(state& s);
+		static bool apply(state& s, const uint8_t* data, size_t len, Output output);
+		static bool finished(const state& s);
+
+	private:
+		/// @brief Value of the magic number at the start of a delta ("SHD1")
+		static const uint32_t delta_magic = 0x31444853;
+
+		/// @brief Size of the delta header in bytes
+		static const size_t header_size = 44;
+
+		static bool readField(state& s, const uint8_t*& data, size_t& len, size_t size);
+		static bool checkSource(state& s, uint32_t size, const uint8_t* hash);
+		static bool copy(state& s, uint32_t offset, uint32_t length, Output& output);
+		static uint32_t readUint32(const uint8_t* bytes);
+};
@@ -0,0 +1,52 @@
+#include "DescriptionCache.h"
+
+/// @brief Creates a description cache
+/// @param builder Function that builds the description
+DescriptionCache::DescriptionCache(std::function<String()> builder) {
+	this->builder = builder;
+	lock = xSemaphoreCreateMutex();
+}
+
+/// @brief Marks the description as changed, so it's rebuilt when next requested
+void DescriptionCache::invalidate() {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	generation++;
+	xSemaphoreGive(lock);
+}
+
+/// @brief Gets the description, building it if it's changed
+/// @return The description
+String DescriptionCache::get() {
+	String tag;
+	return get(tag);
+}
+
+/// @brief Gets the description and its entity tag, building them if it's changed
+/// @param etag Receives the entity tag, including quotes
+/// @return The description
+String DescriptionCache::get(String& etag) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (built != generation) {
+		description = builder();
+		// FNV-1a hash of the contents, so the tag stays the same across reboots if the description does
+		uint32_t h = 2166136261;
+		for (const char c : description) {
+			h = (h ^ (uint8_t)c) * 16777619;
+		}
+		this->etag = "\"" + String(h, HEX) + "\"";
+		built = generation;
+	}
+	String output = description;
+	etag = this->etag;
+	xSemaphoreGive(lock);
+	return output;
+}
+
+/// @brief Gets the generation of the description, which changes each time it's invalidated
+/// @return The generation
+uint32_t DescriptionCache::getGeneration() {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	uint32_t current = generation;
+	xSemaphoreGive(lock);
+	return current;
+}
@@ -0,0 +1,42 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Holds a serialized description (e.g. the JSON describing every sensor) so it's only rebuilt after something it describes
+* changes. Changes are counted with a generation number by calling invalidate(), and the description is rebuilt the next
+* time it's requested. Each build also gets an entity tag, from a hash of its contents, so clients can revalidate it.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <functional>
+
+/// @brief Caches a serialized description until it's invalidated
+class DescriptionCache {
+	public:
+		DescriptionCache(std::function<String()> builder);
+		void invalidate();
+		String get();
+		String get(String& etag);
+		uint32_t getGeneration();
+
+	private:
+		/// @brief Builds the description
+		std::function<String()> builder;
+
+		/// @brief The last description built
+		String description;
+
+		/// @brief Entity tag of the last description built, including quotes
+		String etag;
+
+		/// @brief Incremented each time the description needs rebuilding
+		uint32_t generation = 1;
+
+		/// @brief The generation of the last description built, 0 if none has been
+		uint32_t built = 0;
+
+		/// @brief Guards the description, since it can be requested and invalidated from different tasks
+		SemaphoreHandle_t lock;
+};
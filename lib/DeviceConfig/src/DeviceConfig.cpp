@@ -1,5 +1,11 @@
 #include "DeviceConfig.h"
 
+// Initialize static variables
+std::map<String, uint32_t> DeviceConfig::saved_hashes;
+std::map<String, DeviceConfig::pending_write> DeviceConfig::pending;
+DeviceConfig::write_stats DeviceConfig::stats = { .written = 0, .skipped = 0, .coalesced = 0 };
+SemaphoreHandle_t DeviceConfig::lock = xSemaphoreCreateRecursiveMutex();
+
 /// @brief Gets any available config settings for the current device
 /// @return A JSON string of configurable settings
 String DeviceConfig::getConfig() {
@@ -18,28 +24,130 @@ bool DeviceConfig::setConfig(String config) {
 /// @param path The path to the config file to save
 /// @param contents The contents to save in the file
 bool DeviceConfig::saveConfig(String path, String contents) {
-	return Storage::writeFile(path, getConfig());
+	return writeConfig(path, contents);
 }
 
-/// @brief Checks for the existence of the config file. Creates necessary containing directories as needed during check
-/// @param path The path to the config file
-/// @return True if config file exists
+/// @brief Checks for the existence of the config section
+/// @param path The path of the config section (and of the JSON file it was stored in before the config store)
+/// @return True if config section exists
 bool DeviceConfig::checkConfig(String path) {
-	if (!Storage::fileExists(path)) {
-		// Check for, and create, directories
-		size_t pos = 0;
-		String path_builder = "";
-		// Remove starting '/'
-		path.remove(0,1);
-		while ((pos = path.indexOf('/')) != -1) {
-			path_builder += "/" + path.substring(0, pos);
-			if (!Storage::fileExists(path_builder)) {
-				Storage::createDir(path_builder);
-			}
-			path.remove(0, pos + 1);
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	bool exists = pending.count(path) > 0 || ConfigStore::has(path);
+	xSemaphoreGiveRecursive(lock);
+	return exists;
+}
+
+/// @brief Reads a config section, including changes that are waiting to be written
+/// @param path The path of the config section
+/// @return A JSON string of the config, empty string if it doesn't exist
+String DeviceConfig::readConfig(String path) {
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	auto waiting = pending.find(path);
+	String contents = waiting != pending.end() ? waiting->second.contents : ConfigStore::get(path);
+	xSemaphoreGiveRecursive(lock);
+	return contents;
+}
+
+/// @brief Writes a config section to the config store if its contents have changed. Changes are written after a short delay by flushConfigs(), so several changes in a row only cause one write
+/// @param path The path of the config section
+/// @param contents The contents to save in the section
+/// @param defer True to wait for flushConfigs(), false to write immediately
+/// @return True on success
+bool DeviceConfig::writeConfig(String path, String contents, bool defer) {
+	uint32_t new_hash = hash(contents);
+	bool success = true;
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	auto saved = saved_hashes.find(path);
+	if (saved == saved_hashes.end() && ConfigStore::has(path)) {
+		// Hash what's already stored the first time a section is saved
+		saved = saved_hashes.emplace(path, hash(ConfigStore::get(path))).first;
+	}
+	auto waiting = pending.find(path);
+	if (saved != saved_hashes.end() && saved->second == new_hash) {
+		// Contents are unchanged, or were changed back before being written
+		if (waiting != pending.end()) {
+			pending.erase(waiting);
+		}
+		stats.skipped++;
+	} else if (defer) {
+		if (waiting != pending.end()) {
+			waiting->second.contents = contents;
+			stats.coalesced++;
+		} else {
+			pending[path] = { .contents = contents, .due = millis() + flush_delay };
 		}
-		return false;
 	} else {
-		return true;
+		if (waiting != pending.end()) {
+			pending.erase(waiting);
+		}
+		success = ConfigStore::set(path, contents) && ConfigStore::commit();
+		if (success) {
+			saved_hashes[path] = new_hash;
+			stats.written++;
+		}
 	}
-}
\ No newline at end of file
+	xSemaphoreGiveRecursive(lock);
+	return success;
+}
+
+/// @brief Writes config changes that are waiting to be written. Call regularly, and with all set before rebooting
+/// @param all True to write all waiting changes, false to only write those that have waited long enough
+/// @return True on success
+bool DeviceConfig::flushConfigs(bool all) {
+	bool success = true;
+	std::vector<std::map<String, pending_write>::iterator> written;
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	for (auto p = pending.begin(); p != pending.end();) {
+		if (all || (long)(millis() - p->second.due) >= 0) {
+			if (ConfigStore::set(p->first, p->second.contents)) {
+				written.push_back(p);
+				p++;
+			} else {
+				Serial.println("Could not save config " + p->first);
+				success = false;
+				p = pending.erase(p);
+			}
+		} else {
+			p++;
+		}
+	}
+	// Everything that settled is written together, and only counts as saved once the store is committed
+	if (!written.empty()) {
+		if (ConfigStore::commit()) {
+			for (const auto& w : written) {
+				saved_hashes[w->first] = hash(w->second.contents);
+				pending.erase(w);
+			}
+			stats.written++;
+		} else {
+			// Keep the changes waiting so they're tried again after another delay
+			Serial.println("Could not commit config");
+			for (const auto& w : written) {
+				w->second.due = millis() + flush_delay;
+			}
+			success = false;
+		}
+	}
+	xSemaphoreGiveRecursive(lock);
+	return success;
+}
+
+/// @brief Gets the number of config writes made and avoided
+/// @return A JSON string of the counts
+String DeviceConfig::getWriteStats() {
+	xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+	String output = "{\"written\":" + String(stats.written) + ",\"skipped\":" + String(stats.skipped) + ",\"coalesced\":" + String(stats.coalesced) + ",\"pending\":" + String(pending.size()) + "}";
+	xSemaphoreGiveRecursive(lock);
+	return output;
+}
+
+/// @brief Hashes config contents (32 bit FNV-1a)
+/// @param contents The contents to hash
+/// @return The hash
+uint32_t DeviceConfig::hash(String contents) {
+	uint32_t h = 2166136261;
+	for (const char c : contents) {
+		h = (h ^ (uint8_t)c) * 16777619;
+	}
+	return h;
+}
@@ -7,13 +7,60 @@
 #pragma once
 #include <Arduino.h>
 #include <Storage.h>
+#include <ConfigStore.h>
+#include <map>
+#include <vector>
 
 /// @brief Used by device classes to inherit saving a local configuration
 class DeviceConfig {
 	public:
 		virtual String getConfig();
 		virtual bool setConfig(String config);
+		static bool writeConfig(String path, String contents, bool defer = true);
+		static bool flushConfigs(bool all = false);
+		static String getWriteStats();
+
 	protected:
 		bool saveConfig(String path, String contents);
 		bool checkConfig(String path);
+		String readConfig(String path);
+
+	private:
+		/// @brief Describes a config write waiting to be flushed
+		typedef struct pending_write {
+			/// @brief The contents to write
+			String contents;
+
+			/// @brief The time in ms after which the write should be flushed
+			ulong due;
+		} pending_write;
+
+		/// @brief Counts of config writes made and avoided
+		typedef struct write_stats {
+			/// @brief Number of config files written
+			uint32_t written;
+
+			/// @brief Number of saves skipped because the contents didn't change
+			uint32_t skipped;
+
+			/// @brief Number of saves merged into a write that was already waiting
+			uint32_t coalesced;
+		} write_stats;
+
+		/// @brief Time in ms to wait before writing changed config, so rapid changes are written once
+		static const ulong flush_delay = 2000;
+
+		/// @brief Hashes of the config last written to each file
+		static std::map<String, uint32_t> saved_hashes;
+
+		/// @brief Config writes waiting to be flushed, by path
+		static std::map<String, pending_write> pending;
+
+		/// @brief Counts of config writes made and avoided
+		static write_stats stats;
+
+		/// @brief Guards the pending writes, since config can be saved from the web server and the main loop
+		static SemaphoreHandle_t lock;
+
+		static uint32_t hash(String contents);
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "MeasurementStream.h"
+
+// Initialize static variables
+AsyncEventSource* MeasurementStream::events = nullptr;
+std::vector<double> MeasurementStream::sent_values;
+ulong MeasurementStream::min_period = 1000;
+ulong MeasurementStream::last_sent = 0;
+uint32_t MeasurementStream::event_id = 0;
+int MeasurementStream::deltas_sent = 0;
+bool MeasurementStream::resync = true;
+String MeasurementStream::frame = "{\"p\":[],\"u\":[],\"v\":[]}";
+SemaphoreHandle_t MeasurementStream::frame_lock = xSemaphoreCreateMutex();
+
+/// @brief Starts the measurement stream
+/// @param url The URL clients connect to
+/// @param minPeriod The minimum time in ms between events sent to clients
+/// @return A pointer to the event source handler to add to the web server
+AsyncEventSource* MeasurementStream::begin(String url, ulong minPeriod) {
+	bool first = events == nullptr;
+	min_period = minPeriod;
+	events = new AsyncEventSource(url);
+	resync = true;
+	// Give new clients the current state of all measurements, from the last frame built on the sensor side
+	events->onConnect([](AsyncEventSourceClient *client) {
+		xSemaphoreTake(frame_lock, portMAX_DELAY);
+		String current = frame;
+		xSemaphoreGive(frame_lock);
+		client->send(current.c_str(), "frame", event_id, 10000);
+		// The frame holds newer values than the other clients were last sent, so deltas against those would leave this client out of date
+		resync = true;
+	});
+	if (first) {
+		SensorManager::addMeasurementCallback(publish);
+	}
+	return events;
+}
+
+/// @brief Sends the latest measurements to connected clients
+void MeasurementStream::publish() {
+	// Keep the frame for clients that connect before the next measurement
+	String current = fullFrame();
+	xSemaphoreTake(frame_lock, portMAX_DELAY);
+	frame = current;
+	xSemaphoreGive(frame_lock);
+	if (events == nullptr || events->count() == 0) {
+		resync = true;
+		return;
+	}
+	// Rate limit events, values not sent are picked up by the next delta
+	ulong now = millis();
+	if (now - last_sent < min_period) {
+		return;
+	}
+	// Drop events when clients aren't keeping up, and have them resynchronize once they are
+	if (events->avgPacketsWaiting() > max_queued) {
+		resync = true;
+		return;
+	}
+	last_sent = now;
+	event_id++;
+	if (resync || deltas_sent >= keyframe_interval || sent_values.size() != SensorManager::measurements.size()) {
+		events->send(current.c_str(), "frame", event_id);
+		sent_values.clear();
+		for (const auto& m : SensorManager::measurements) {
+			sent_values.push_back(m.value);
+		}
+		deltas_sent = 0;
+		resync = false;
+	} else {
+		String delta = deltaFrame();
+		// Nothing changed, nothing to send
+		if (delta == "") {
+			event_id--;
+			return;
+		}
+		events->send(delta.c_str(), "delta", event_id);
+		deltas_sent++;
+	}
+}
+
+/// @brief Creates a frame with every measurement
+/// @return A JSON string with arrays of the parameters, units, and values
+String MeasurementStream::fullFrame() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	JsonArray parameters = doc["p"].to<JsonArray>();
+	JsonArray units = doc["u"].to<JsonArray>();
+	JsonArray values = doc["v"].to<JsonArray>();
+	for (const auto& m : SensorManager::measurements) {
+		parameters.add(m.parameter);
+		units.add(m.unit);
+		values.add(m.value);
+	}
+	String output;
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Creates a frame with only the measurements that changed since the last event
+/// @return A JSON string with an array of [index, value] pairs, or an empty string if nothing changed
+String MeasurementStream::deltaFrame() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	JsonArray changes = doc["d"].to<JsonArray>();
+	for (int i = 0; i < sent_values.size(); i++) {
+		double value = SensorManager::measurements[i].value;
+		if (value != sent_values[i]) {
+			JsonArray change = changes.add<JsonArray>();
+			change.add(i);
+			change.add(value);
+			sent_values[i] = value;
+		}
+	}
+	if (changes.size() == 0) {
+		return "";
+	}
+	String output;
+	serializeJson(doc, output);
+	return output;
+}
@@ -0,0 +1,63 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* ESPAsyncWebServer: https://github.com/esphome/ESPAsyncWebServer
+* ArduinoJSON: https://arduinojson.org/
+*
+* Pushes measurements to clients using Server-Sent Events. Clients receive a "frame" event with every parameter, unit
+* and value when they connect, then "delta" events containing only the values that changed, as [index, value] pairs.
+* Full frames are resent periodically, and whenever deltas had to be dropped, so clients can resynchronize.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <SensorManager.h>
+#include <vector>
+
+/// @brief Streams measurements to web clients as they are taken
+class MeasurementStream {
+	public:
+		static AsyncEventSource* begin(String url = "/events", ulong minPeriod = 1000);
+
+	private:
+		/// @brief The event source clients connect to
+		static AsyncEventSource* events;
+
+		/// @brief The values last sent to clients
+		static std::vector<double> sent_values;
+
+		/// @brief The minimum time in ms between events sent to clients
+		static ulong min_period;
+
+		/// @brief The time in ms when the last event was sent
+		static ulong last_sent;
+
+		/// @brief ID of the last event sent
+		static uint32_t event_id;
+
+		/// @brief Number of deltas sent since the last full frame
+		static int deltas_sent;
+
+		/// @brief Set when clients may have missed a delta and need a full frame
+		static bool resync;
+
+		/// @brief The full frame of the latest measurements, built on the sensor side for clients that connect
+		static String frame;
+
+		/// @brief Guards the frame, which is sent to new clients from the web server's task
+		static SemaphoreHandle_t frame_lock;
+
+		/// @brief Number of deltas to send between full frames
+		static const int keyframe_interval = 60;
+
+		/// @brief Average number of messages queued per client above which events are dropped
+		static const size_t max_queued = 8;
+
+		static void publish();
+		static String fullFrame();
+		static String deltaFrame();
+};
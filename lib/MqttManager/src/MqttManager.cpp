@@ -0,0 +1,314 @@
+#include "MqttManager.h"
+
+// Initialize static variables
+MqttManager::settings MqttManager::current_config = { .enabled = false, .host = "", .port = 1883, .client_id = "sensorhub", .username = "", .password = "", .base_topic = "sensorhub", .qos = 0, .retain = true, .frame = false };
+AsyncMqttClient MqttManager::client;
+String MqttManager::config;
+String MqttManager::status_topic;
+std::deque<MqttManager::message> MqttManager::outbound;
+String MqttManager::command;
+int MqttManager::in_flight = 0;
+ulong MqttManager::next_connect = 0;
+ulong MqttManager::backoff = MqttManager::min_backoff;
+uint32_t MqttManager::dropped = 0;
+SemaphoreHandle_t MqttManager::lock = xSemaphoreCreateMutex();
+
+/// @brief Starts the MQTT manager and loads its configuration
+/// @param configFile Name of config file
+/// @return True on success
+bool MqttManager::begin(String configFile) {
+	config = "/settings/" + configFile;
+	client.onConnect(onConnect);
+	client.onDisconnect(onDisconnect);
+	client.onMessage(onMessage);
+	client.onPublish(onPublish);
+	SensorManager::addMeasurementCallback(publishMeasurements);
+	return loadConfig();
+}
+
+/// @brief Loads the configuration from the config file
+/// @return True on success or if nothing has been configured yet
+bool MqttManager::loadConfig() {
+	if (ConfigStore::has(config)) {
+		// Attempt to load and read config
+		String json_string = ConfigStore::get(config);
+		if (json_string == "") {
+			Serial.println("Could not load MQTT config file");
+			return false;
+		}
+		return updateConfig(json_string);
+	}
+	return true;
+}
+
+/// @brief Applies a new configuration, reconnecting to the broker
+/// @param config A complete JSON string of the configuration
+/// @return True on success
+bool MqttManager::updateConfig(String config) {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Deserialize file contents
+	DeserializationError error = deserializeJson(doc, config);
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	// Held until the client has the new settings, so loop() can't connect with a mix of old and new ones
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (client.connected()) {
+		client.disconnect();
+	}
+	current_config.enabled = doc["enabled"].as<bool>();
+	current_config.host = doc["host"] | "";
+	current_config.port = doc["port"] | 1883;
+	current_config.client_id = doc["clientID"] | "sensorhub";
+	current_config.username = doc["username"] | "";
+	current_config.password = doc["password"] | "";
+	current_config.base_topic = doc["baseTopic"] | "sensorhub";
+	current_config.qos = std::min(doc["qos"] | 0, 2);
+	current_config.retain = doc["retain"] | true;
+	current_config.frame = doc["frame"] | false;
+	status_topic = current_config.base_topic + "/status";
+	// Messages queued for the old broker or topics aren't wanted any more
+	outbound.clear();
+	backoff = min_backoff;
+	next_connect = millis();
+	// The client keeps pointers to these, so they point into the configuration
+	client.setServer(current_config.host.c_str(), current_config.port);
+	client.setClientId(current_config.client_id.c_str());
+	// Always set, so credentials removed from the configuration aren't still sent
+	client.setCredentials(current_config.username.isEmpty() ? nullptr : current_config.username.c_str(), current_config.password.isEmpty() ? nullptr : current_config.password.c_str());
+	client.setWill(status_topic.c_str(), 1, true, "offline");
+	xSemaphoreGive(lock);
+	return true;
+}
+
+/// @brief Saves a configuration to the config file. Does not apply the configuration without a call to updateConfig()
+/// @param config A complete JSON string of the configuration
+/// @return True on success
+bool MqttManager::saveConfig(String config) {
+	if (!DeviceConfig::writeConfig(MqttManager::config, config)) {
+		Serial.println("Could not write MQTT config file");
+		return false;
+	}
+	return true;
+}
+
+/// @brief Gets the current configuration
+/// @return A JSON string of the configuration
+String MqttManager::getConfig() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	xSemaphoreTake(lock, portMAX_DELAY);
+	doc["enabled"] = current_config.enabled;
+	doc["host"] = current_config.host;
+	doc["port"] = current_config.port;
+	doc["clientID"] = current_config.client_id;
+	doc["username"] = current_config.username;
+	doc["password"] = current_config.password;
+	doc["baseTopic"] = current_config.base_topic;
+	doc["qos"] = current_config.qos;
+	doc["retain"] = current_config.retain;
+	doc["frame"] = current_config.frame;
+	doc["connected"] = client.connected();
+	doc["queued"] = outbound.size();
+	doc["dropped"] = dropped;
+	xSemaphoreGive(lock);
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Queues a message to be published
+/// @param topic The topic, relative to the base topic
+/// @param payload The payload of the message
+/// @param qos Quality of service level
+/// @param retain Retain the message on the broker
+/// @return True if the message was queued
+bool MqttManager::publish(String topic, String payload, uint8_t qos, bool retain) {
+	if (!current_config.enabled) {
+		return false;
+	}
+	enqueue({ .topic = current_config.base_topic + "/" + topic, .payload = payload, .qos = qos, .retain = retain });
+	return true;
+}
+
+/// @brief Connects to the broker when needed and publishes queued messages. Call regularly from the main loop
+void MqttManager::loop() {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (!current_config.enabled || current_config.host.isEmpty()) {
+		xSemaphoreGive(lock);
+		return;
+	}
+	if (!client.connected()) {
+		// A failed attempt is reported through onDisconnect(), the wait between attempts keeps growing until one succeeds
+		if (WiFi.isConnected() && (long)(millis() - next_connect) >= 0) {
+			next_connect = millis() + backoff;
+			backoff = std::min(backoff * 2, (ulong)max_backoff);
+			client.connect();
+		}
+		xSemaphoreGive(lock);
+		return;
+	}
+	// Write everything that's ready in one go, so messages share TCP segments
+	while (!outbound.empty()) {
+		message& m = outbound.front();
+		if (m.qos > 0 && in_flight >= max_in_flight) {
+			break;
+		}
+		if (client.publish(m.topic.c_str(), m.qos, m.retain, m.payload.c_str(), m.payload.length()) == 0) {
+			// The connection can't take any more yet
+			break;
+		}
+		if (m.qos > 0) {
+			in_flight++;
+		}
+		outbound.pop_front();
+	}
+	xSemaphoreGive(lock);
+}
+
+/// @brief Queues the latest measurements, called each time a set of measurements is taken
+void MqttManager::publishMeasurements() {
+	if (!current_config.enabled) {
+		return;
+	}
+	// Sensors can measure the same parameter, so repeated names are numbered
+	std::map<String, int> seen;
+	char value[24];
+	for (const auto& m : SensorManager::measurements) {
+		String topic = topicName(m.parameter);
+		int count = ++seen[topic];
+		if (count > 1) {
+			topic += "_" + String(count);
+		}
+		if (isnan(m.value)) {
+			continue;
+		}
+		snprintf(value, sizeof(value), "%.6g", m.value);
+		enqueue({ .topic = current_config.base_topic + "/" + topic, .payload = value, .qos = current_config.qos, .retain = current_config.retain });
+	}
+	if (current_config.frame) {
+		enqueue({ .topic = current_config.base_topic + "/frame", .payload = SensorManager::getLastMeasurement(), .qos = current_config.qos, .retain = false });
+	}
+}
+
+/// @brief Adds a message to the outbound queue, replacing an unsent retained value for the same topic, or the oldest message if the queue is full
+/// @param m The message
+void MqttManager::enqueue(message m) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (m.retain) {
+		// Only the latest retained value matters
+		for (auto& queued : outbound) {
+			if (queued.retain && queued.topic == m.topic) {
+				queued.payload = m.payload;
+				queued.qos = m.qos;
+				xSemaphoreGive(lock);
+				return;
+			}
+		}
+	}
+	if (outbound.size() >= max_outbound) {
+		outbound.pop_front();
+		dropped++;
+	}
+	outbound.push_back(m);
+	xSemaphoreGive(lock);
+}
+
+/// @brief Subscribes to commands and announces the hub is online once connected
+/// @param sessionPresent True if the broker kept the previous session
+void MqttManager::onConnect(bool sessionPresent) {
+	Serial.println("Connected to MQTT broker");
+	xSemaphoreTake(lock, portMAX_DELAY);
+	backoff = min_backoff;
+	in_flight = 0;
+	xSemaphoreGive(lock);
+	client.subscribe((current_config.base_topic + "/cmd/#").c_str(), 1);
+	client.publish(status_topic.c_str(), 1, true, "online");
+}
+
+/// @brief Logs why the connection to the broker was lost, it's retried from loop()
+/// @param reason The reason for the disconnection
+void MqttManager::onDisconnect(AsyncMqttClientDisconnectReason reason) {
+	Serial.print("Disconnected from MQTT broker: ");
+	Serial.println((int)reason);
+}
+
+/// @brief Collects commands, which may arrive in more than one part
+/// @param topic The topic of the message
+/// @param payload The part of the payload received
+/// @param properties Properties of the message
+/// @param len Length of the part
+/// @param index Position of the part in the payload
+/// @param total Length of the payload
+void MqttManager::onMessage(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total) {
+	if (total > max_command) {
+		if (index == 0) {
+			Serial.println("MQTT command too long");
+		}
+		return;
+	}
+	if (index == 0) {
+		command = "";
+		command.reserve(total);
+	}
+	command.concat(payload, len);
+	if (index + len >= total) {
+		runCommand(topic, command);
+		command = "";
+	}
+}
+
+/// @brief Counts acknowledged messages
+/// @param packetId The ID of the message
+void MqttManager::onPublish(uint16_t packetId) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (in_flight > 0) {
+		in_flight--;
+	}
+	xSemaphoreGive(lock);
+}
+
+/// @brief Sends a signal to a receiver from a command topic (<baseTopic>/cmd/<receiver position ID>/<signal name or ID>)
+/// @param topic The topic of the command
+/// @param payload The payload of the signal
+void MqttManager::runCommand(String topic, String payload) {
+	String prefix = current_config.base_topic + "/cmd/";
+	if (!topic.startsWith(prefix)) {
+		return;
+	}
+	topic = topic.substring(prefix.length());
+	int separator = topic.indexOf('/');
+	if (separator <= 0 || separator == topic.length() - 1) {
+		Serial.println("Bad MQTT command topic");
+		return;
+	}
+	int receiver = topic.substring(0, separator).toInt();
+	String signal = topic.substring(separator + 1);
+	// Signals can be given by ID or by name
+	bool numeric = true;
+	for (const char* c = signal.c_str(); *c != '\0'; c++) {
+		numeric = numeric && isdigit(*c);
+	}
+	if (numeric) {
+		SignalManager::addSignalToQueue(receiver, (int)signal.toInt(), payload);
+	} else {
+		SignalManager::addSignalToQueue(receiver, signal, payload);
+	}
+}
+
+/// @brief Makes a name safe to use as a topic level
+/// @param name The name
+/// @return The name with wildcards and separators replaced
+String MqttManager::topicName(String name) {
+	name.replace("/", "_");
+	name.replace("+", "_");
+	name.replace("#", "_");
+	name.replace(" ", "_");
+	return name;
+}
@@ -0,0 +1,145 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* ArduinoJSON: https://arduinojson.org/
+* AsyncMqttClient: https://github.com/marvinroger/async-mqtt-client (esphome fork, to share AsyncTCP with ESPAsyncWebServer)
+*
+* Keeps a connection to an MQTT broker. Each set of measurements is published with one topic per parameter
+* (<baseTopic>/<parameter>), and optionally as a whole frame (<baseTopic>/frame). Messages are queued and written together
+* from loop(), queued values that haven't been sent yet are replaced by newer ones, and the connection is retried with
+* exponential backoff. Signals are sent to receivers by publishing to <baseTopic>/cmd/<receiver position ID>/<signal name or ID>,
+* with the signal's payload as the message.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <AsyncMqttClient.h>
+#include <ArduinoJson.h>
+#include <ConfigStore.h>
+#include <DeviceConfig.h>
+#include <SensorManager.h>
+#include <SignalManager.h>
+#include <deque>
+#include <map>
+
+/// @brief Publishes measurements to, and receives signals from, an MQTT broker
+class MqttManager {
+	private:
+		/// @brief Describes the MQTT configuration
+		typedef struct settings {
+			/// @brief Enable MQTT
+			bool enabled;
+
+			/// @brief Host name or IP address of the broker
+			String host;
+
+			/// @brief Port of the broker
+			uint16_t port;
+
+			/// @brief Client ID to connect with
+			String client_id;
+
+			/// @brief User name to connect with, empty for none
+			String username;
+
+			/// @brief Password to connect with
+			String password;
+
+			/// @brief Topic all other topics are under
+			String base_topic;
+
+			/// @brief Quality of service level to publish measurements with
+			uint8_t qos;
+
+			/// @brief Publish measurements as retained values
+			bool retain;
+
+			/// @brief Publish each set of measurements as a single JSON message as well
+			bool frame;
+		} settings;
+
+		/// @brief The current MQTT configuration
+		static settings current_config;
+
+		/// @brief A message waiting to be published
+		typedef struct message {
+			/// @brief Topic to publish to
+			String topic;
+
+			/// @brief The payload of the message
+			String payload;
+
+			/// @brief Quality of service level
+			uint8_t qos;
+
+			/// @brief Retain the message on the broker
+			bool retain;
+		} message;
+
+		/// @brief The MQTT client
+		static AsyncMqttClient client;
+
+		/// @brief Full path to config file
+		static String config;
+
+		/// @brief Topic the connection status is published to, kept here since the client only keeps a pointer to it
+		static String status_topic;
+
+		/// @brief Messages waiting to be published, oldest first
+		static std::deque<message> outbound;
+
+		/// @brief Collects a command received in more than one part
+		static String command;
+
+		/// @brief Number of messages published with QoS above 0 that haven't been acknowledged
+		static int in_flight;
+
+		/// @brief The time in ms to try connecting next
+		static ulong next_connect;
+
+		/// @brief Time in ms to wait before reconnecting, doubled after each attempt
+		static ulong backoff;
+
+		/// @brief Number of messages dropped because the queue was full
+		static uint32_t dropped;
+
+		/// @brief Guards the outbound queue, since measurements, the client and loop() can be on different tasks
+		static SemaphoreHandle_t lock;
+
+		/// @brief Maximum number of messages waiting to be published
+		static const size_t max_outbound = 64;
+
+		/// @brief Maximum number of unacknowledged messages
+		static const int max_in_flight = 8;
+
+		/// @brief Time in ms to wait before the first reconnection attempt
+		static const ulong min_backoff = 1000;
+
+		/// @brief Longest time in ms to wait between reconnection attempts
+		static const ulong max_backoff = 60000;
+
+		/// @brief Maximum length of a command payload
+		static const size_t max_command = 1024;
+
+		static void publishMeasurements();
+		static void enqueue(message m);
+		static void onConnect(bool sessionPresent);
+		static void onDisconnect(AsyncMqttClientDisconnectReason reason);
+		static void onMessage(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total);
+		static void onPublish(uint16_t packetId);
+		static void runCommand(String topic, String payload);
+		static String topicName(String name);
+
+	public:
+		static bool begin(String configFile);
+		static bool loadConfig();
+		static bool updateConfig(String config);
+		static bool saveConfig(String config);
+		static String getConfig();
+		static bool publish(String topic, String payload, uint8_t qos = 0, bool retain = false);
+		static void loop();
+};
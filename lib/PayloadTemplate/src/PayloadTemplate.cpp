@@ -0,0 +1,153 @@
+#include "PayloadTemplate.h"
+
+// Initialize static variables
+std::vector<PayloadTemplate::snapshot_value> PayloadTemplate::snapshot;
+SemaphoreHandle_t PayloadTemplate::snapshot_lock = xSemaphoreCreateMutex();
+
+/// @brief Creates a template, splitting it into literal text and placeholders
+/// @param source The text of the template
+/// @param encoding How values are encoded when rendered
+PayloadTemplate::PayloadTemplate(String source, Encoding encoding) {
+	this->source = source;
+	this->encoding = encoding;
+	int start = 0;
+	while (start < source.length()) {
+		int open = source.indexOf("{{", start);
+		int close = open < 0 ? -1 : source.indexOf("}}", open + 2);
+		if (close < 0) {
+			segments.push_back({ .text = source.substring(start), .parameter = "", .index = -1 });
+			break;
+		}
+		if (open > start) {
+			segments.push_back({ .text = source.substring(start, open), .parameter = "", .index = -1 });
+		}
+		String parameter = source.substring(open + 2, close);
+		parameter.trim();
+		segments.push_back({ .text = "", .parameter = parameter, .index = -1 });
+		start = close + 2;
+	}
+}
+
+/// @brief Checks if the template has no text
+/// @return True if empty
+bool PayloadTemplate::isEmpty() const {
+	return segments.empty();
+}
+
+/// @brief Checks if the template has any placeholders
+/// @return True if there's at least one placeholder
+bool PayloadTemplate::hasPlaceholders() const {
+	for (const auto& s : segments) {
+		if (s.text.isEmpty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief Renders the template with the latest measurements
+/// @param output The buffer to write to, its contents are replaced but its memory is kept
+void PayloadTemplate::render(String& output) {
+	output.remove(0);
+	output.reserve(last_length);
+	char value[24];
+	xSemaphoreTake(snapshot_lock, portMAX_DELAY);
+	for (auto& s : segments) {
+		if (!s.text.isEmpty()) {
+			output += s.text;
+			continue;
+		}
+		if (s.parameter == "timestamp") {
+			snprintf(value, sizeof(value), "%lu", (ulong)time(nullptr));
+			output += value;
+			continue;
+		}
+		int index = findParameter(s);
+		if (index < 0 || isnan(snapshot[index].value)) {
+			// No value to output
+			if (encoding == Encoding::JSON) {
+				output += "null";
+			}
+			continue;
+		}
+		snprintf(value, sizeof(value), "%.6g", snapshot[index].value);
+		// Numbers are valid JSON as-is
+		encode(output, value, encoding == Encoding::JSON ? Encoding::None : encoding);
+	}
+	xSemaphoreGive(snapshot_lock);
+	last_length = output.length();
+}
+
+/// @brief Appends a value to a buffer, encoded for where it's used
+/// @param output The buffer to append to
+/// @param value The value to append
+/// @param encoding How to encode the value. JSON encoding escapes the value for use inside a JSON string
+void PayloadTemplate::encode(String& output, const char* value, Encoding encoding) {
+	const char* hex = "0123456789ABCDEF";
+	for (const char* c = value; *c != '\0'; c++) {
+		if (encoding == Encoding::URL) {
+			if (isalnum(*c) || *c == '-' || *c == '_' || *c == '.' || *c == '~') {
+				output += *c;
+			} else {
+				output += '%';
+				output += hex[(uint8_t)*c >> 4];
+				output += hex[(uint8_t)*c & 0xF];
+			}
+		} else if (encoding == Encoding::JSON) {
+			if (*c == '"' || *c == '\\') {
+				output += '\\';
+				output += *c;
+			} else if ((uint8_t)*c < 0x20) {
+				output += "\\u00";
+				output += hex[(uint8_t)*c >> 4];
+				output += hex[(uint8_t)*c & 0xF];
+			} else {
+				output += *c;
+			}
+		} else {
+			output += *c;
+		}
+	}
+}
+
+/// @brief Gets the encoding to use for a body of a content type
+/// @param contentType The content type of the body
+/// @return The encoding to use
+PayloadTemplate::Encoding PayloadTemplate::encodingFor(String contentType) {
+	contentType.toLowerCase();
+	if (contentType.indexOf("json") >= 0) {
+		return Encoding::JSON;
+	}
+	if (contentType.indexOf("x-www-form-urlencoded") >= 0) {
+		return Encoding::URL;
+	}
+	return Encoding::None;
+}
+
+/// @brief Copies the latest measurements for templates to be rendered from, called each time measurements are taken
+void PayloadTemplate::takeSnapshot() {
+	xSemaphoreTake(snapshot_lock, portMAX_DELAY);
+	snapshot.resize(SensorManager::measurements.size());
+	for (int i = 0; i < snapshot.size(); i++) {
+		snapshot[i].parameter = SensorManager::measurements[i].parameter;
+		snapshot[i].value = SensorManager::measurements[i].value;
+	}
+	xSemaphoreGive(snapshot_lock);
+}
+
+/// @brief Finds a placeholder's parameter in the snapshot, checking where it was last found first
+/// @param s The placeholder
+/// @return The position of the parameter, or -1 if it isn't being measured
+int PayloadTemplate::findParameter(segment& s) {
+	int index = s.index;
+	if (index >= 0 && index < snapshot.size() && snapshot[index].parameter == s.parameter) {
+		return index;
+	}
+	for (index = 0; index < snapshot.size(); index++) {
+		if (snapshot[index].parameter == s.parameter) {
+			s.index = index;
+			return index;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,83 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Templates for building request payloads from the latest measurements. "{{Temperature}}" is replaced by the latest value
+* of the "Temperature" parameter and "{{timestamp}}" by the current time in seconds since the epoch. Templates are split
+* into literal text and placeholders once, when created, and rendered by appending straight into an output buffer, encoding
+* values for where they're used (URL query, JSON or form body). Placeholders for parameters that aren't being measured
+* render as nothing (null in JSON). Values come from a copy of the latest measurements that takeSnapshot() makes on the
+* sensor side, as a measurement callback, so templates can be rendered from the web server's task.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <SensorManager.h>
+#include <vector>
+
+/// @brief A template with placeholders for measurement values
+class PayloadTemplate {
+	public:
+		/// @brief How values are encoded when rendered
+		enum class Encoding {
+			/// @brief As-is
+			None,
+
+			/// @brief Percent-encoded for a URL or form body
+			URL,
+
+			/// @brief As JSON values
+			JSON
+		};
+
+		PayloadTemplate(String source = "", Encoding encoding = Encoding::None);
+		bool isEmpty() const;
+		bool hasPlaceholders() const;
+		void render(String& output);
+		static void encode(String& output, const char* value, Encoding encoding);
+		static Encoding encodingFor(String contentType);
+		static void takeSnapshot();
+
+		/// @brief The text the template was created from
+		String source;
+
+	private:
+		/// @brief A measured value, copied from the latest measurements
+		typedef struct snapshot_value {
+			/// @brief The parameter measured
+			String parameter;
+
+			/// @brief The value of the measurement
+			double value;
+		} snapshot_value;
+
+		/// @brief The latest measurements, as of the last call to takeSnapshot()
+		static std::vector<snapshot_value> snapshot;
+
+		/// @brief Guards the snapshot, which is taken on the sensor side and read when rendering
+		static SemaphoreHandle_t snapshot_lock;
+
+		/// @brief A part of a template
+		typedef struct segment {
+			/// @brief Literal text to output, empty for a placeholder
+			String text;
+
+			/// @brief The name of the parameter whose value is output
+			String parameter;
+
+			/// @brief The position of the parameter in the snapshot, last time it was found
+			int index;
+		} segment;
+
+		/// @brief The parts of the template, in order
+		std::vector<segment> segments;
+
+		/// @brief How values are encoded
+		Encoding encoding;
+
+		/// @brief Length of the last rendered output, used to size the output buffer
+		size_t last_length = 0;
+
+		int findParameter(segment& s);
+};
@@ -0,0 +1,285 @@
+#include "Router.h"
+
+/// @brief Adds a route
+/// @param path The exact path to match, without a query string
+/// @param method The method to match
+/// @param handler The function that responds to requests
+/// @param middleware Checks to run in order before the handler
+/// @param upload The function that receives uploaded files, if the route accepts them
+/// @return True on success, false if the route can't be added
+bool Router::on(const char* path, WebRequestMethod method, Handler handler, std::vector<Middleware> middleware, UploadHandler upload) {
+	uint32_t k = key(path, method);
+	auto existing = routes.find(k);
+	if (existing != routes.end()) {
+		if (existing->second.path == path && existing->second.method == method) {
+			Serial.printf("Route %s is already registered\n", path);
+		} else {
+			// Two routes share a hash, rename one of them
+			Serial.printf("Route %s collides with %s\n", path, existing->second.path.c_str());
+		}
+		refused++;
+		return false;
+	}
+	routes[k] = { .path = path, .method = method, .handler = handler, .middleware = middleware, .upload = upload, .count = 0, .rejected = 0, .total_us = 0, .max_us = 0 };
+	return true;
+}
+
+/// @brief Checks if a request matches a route
+/// @param request The request
+/// @return True if it does
+bool Router::canHandle(AsyncWebServerRequest *request) {
+	if (find(request) == nullptr) {
+		return false;
+	}
+	// The server drops headers no handler asked for, and routes and their middleware read headers such as Accept, If-None-Match and Authorization
+	request->addInterestingHeader("ANY");
+	return true;
+}
+
+/// @brief Runs a route's middleware and then its handler, timing the handler
+/// @param request The request
+void Router::handleRequest(AsyncWebServerRequest *request) {
+	route* r = find(request);
+	if (r == nullptr) {
+		request->send(HTTP_CODE_NOT_FOUND);
+		return;
+	}
+	r->count++;
+	// Uploads have already been received by now, and UploadStream needs their disconnect callback
+	bool counted = !r->upload;
+	if (counted && max_in_flight > 0 && in_flight >= max_in_flight) {
+		r->rejected++;
+		shed++;
+		AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_SERVICE_UNAVAILABLE, "text/plain", "Too many requests in progress");
+		response->addHeader("Retry-After", "1");
+		request->send(response);
+		return;
+	}
+	if (!passes(r, request, true)) {
+		r->rejected++;
+		return;
+	}
+	if (counted) {
+		// A request is in flight until its response has been sent and the connection closed
+		in_flight++;
+		request->onDisconnect([this]() {
+			in_flight--;
+		});
+	}
+	ulong start = micros();
+	r->handler(request);
+	uint32_t elapsed = micros() - start;
+	r->total_us += elapsed;
+	r->max_us = std::max(r->max_us, elapsed);
+}
+
+/// @brief Passes part of an uploaded file to a route, as long as its middleware passes
+/// @param request The request
+/// @param filename The name of the file
+/// @param index The position of the part in the file
+/// @param data The part of the file
+/// @param len The length of the part
+/// @param final True if this is the last part
+void Router::handleUpload(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final) {
+	route* r = find(request);
+	// The response is left to handleRequest(), once the upload is done
+	if (r != nullptr && r->upload && passes(r, request, false)) {
+		r->upload(request, filename, index, data, len, final);
+	}
+}
+
+/// @brief Indicates the router needs the request body
+/// @return False
+bool Router::isRequestHandlerTrivial() {
+	return false;
+}
+
+/// @brief Checks that every route given to on() was registered
+/// @return True if none were refused as duplicates or hash collisions
+bool Router::allRegistered() {
+	return refused == 0;
+}
+
+/// @brief Sets the maximum number of requests to respond to at once, others get a 503 response until one finishes
+/// @param limit The maximum number of requests, 0 for no limit
+void Router::setInFlightLimit(uint16_t limit) {
+	max_in_flight = limit;
+}
+
+/// @brief Gets how often each route was used and how long its handler took
+/// @return A JSON string of the metrics
+String Router::getMetrics() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	doc["inFlight"] = in_flight;
+	doc["inFlightLimit"] = max_in_flight;
+	doc["shed"] = shed;
+	JsonArray route_array = doc["routes"].to<JsonArray>();
+	for (const auto& r : routes) {
+		JsonObject entry = route_array.add<JsonObject>();
+		switch (r.second.method) {
+			case HTTP_GET:
+				entry["method"] = "GET";
+				break;
+			case HTTP_POST:
+				entry["method"] = "POST";
+				break;
+			case HTTP_PUT:
+				entry["method"] = "PUT";
+				break;
+			case HTTP_DELETE:
+				entry["method"] = "DELETE";
+				break;
+			default:
+				entry["method"] = (int)r.second.method;
+				break;
+		}
+		entry["path"] = r.second.path;
+		entry["count"] = r.second.count;
+		entry["rejected"] = r.second.rejected;
+		uint32_t handled = r.second.count - r.second.rejected;
+		entry["averageMicros"] = handled > 0 ? (uint32_t)(r.second.total_us / handled) : 0;
+		entry["maxMicros"] = r.second.max_us;
+	}
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Creates middleware that stops requests until the hub has started successfully
+/// @param flag The flag that's set once the hub is ready, read on each request
+/// @return The middleware
+Router::Middleware Router::ready(const bool& flag) {
+	return [&flag](AsyncWebServerRequest* request, bool respond) {
+		if (!flag && respond) {
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain");
+		}
+		return flag;
+	};
+}
+
+/// @brief Creates middleware that stops requests missing any of a set of parameters
+/// @param names The names of the parameters
+/// @param post True to check the body parameters, false for the query parameters
+/// @return The middleware
+Router::Middleware Router::params(std::vector<String> names, bool post) {
+	return [names, post](AsyncWebServerRequest* request, bool respond) {
+		for (const auto& name : names) {
+			if (!request->hasParam(name, post)) {
+				if (respond) {
+					request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+				}
+				return false;
+			}
+		}
+		return true;
+	};
+}
+
+/// @brief Creates middleware that stops requests that have none of a set of parameters
+/// @param names The names of the parameters
+/// @param post True to check the body parameters, false for the query parameters
+/// @return The middleware
+Router::Middleware Router::anyParam(std::vector<String> names, bool post) {
+	return [names, post](AsyncWebServerRequest* request, bool respond) {
+		for (const auto& name : names) {
+			if (request->hasParam(name, post)) {
+				return true;
+			}
+		}
+		if (respond) {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+		}
+		return false;
+	};
+}
+
+/// @brief Creates middleware that asks for a user name and password, if a user name is set
+/// @param username The user name, read on each request so changes apply straight away. Empty to allow all requests
+/// @param password The password
+/// @return The middleware
+Router::Middleware Router::authenticated(const String& username, const String& password) {
+	return [&username, &password](AsyncWebServerRequest* request, bool respond) {
+		if (username.isEmpty() || request->authenticate(username.c_str(), password.c_str())) {
+			return true;
+		}
+		if (respond) {
+			request->requestAuthentication();
+		}
+		return false;
+	};
+}
+
+/// @brief Creates middleware that limits how often a route can be used, with a token bucket shared by all clients
+/// @param rate The number of requests allowed per second over time
+/// @param burst The number of requests allowed at once after the route has been idle
+/// @return The middleware
+Router::Middleware Router::rateLimit(float rate, uint16_t burst) {
+	std::shared_ptr<bucket> b = std::make_shared<bucket>();
+	b->tokens = burst;
+	b->last = millis();
+	return [b, rate, burst](AsyncWebServerRequest* request, bool respond) {
+		ulong now = millis();
+		b->tokens = std::min((float)burst, b->tokens + (now - b->last) * rate / 1000.0f);
+		b->last = now;
+		if (b->tokens >= 1) {
+			// Checks made while a file is uploaded don't use up a token, the request does once it's complete
+			if (respond) {
+				b->tokens -= 1;
+			}
+			return true;
+		}
+		if (respond) {
+			AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_TOO_MANY_REQUESTS, "text/plain", "Too many requests");
+			response->addHeader("Retry-After", String((uint32_t)ceilf((1 - b->tokens) / rate)));
+			request->send(response);
+		}
+		return false;
+	};
+}
+
+/// @brief Creates middleware that turns requests away while memory is low, for routes that need a lot of it
+/// @param minBlock The size in bytes of the largest free block of memory needed to start the handler
+/// @return The middleware
+Router::Middleware Router::memory(uint32_t minBlock) {
+	return [minBlock](AsyncWebServerRequest* request, bool respond) {
+		// The largest block is what limits allocations, and is cheap to read
+		if (ESP.getMaxAllocHeap() >= minBlock) {
+			return true;
+		}
+		if (respond) {
+			AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_SERVICE_UNAVAILABLE, "text/plain", "Not enough memory, try again later");
+			response->addHeader("Retry-After", "2");
+			request->send(response);
+		}
+		return false;
+	};
+}
+
+/// @brief Finds the route matching a request
+/// @param request The request
+/// @return A pointer to the route, or nullptr if there isn't one
+Router::route* Router::find(AsyncWebServerRequest *request) {
+	auto r = routes.find(key(request->url().c_str(), request->method()));
+	// Different paths can share a hash, so the path is checked as well
+	if (r == routes.end() || r->second.method != request->method() || r->second.path != request->url()) {
+		return nullptr;
+	}
+	return &r->second;
+}
+
+/// @brief Runs a route's middleware in order, stopping at the first that fails
+/// @param r The route
+/// @param request The request
+/// @param respond True to let failing middleware send its error response
+/// @return True if all the middleware passed
+bool Router::passes(route* r, AsyncWebServerRequest *request, bool respond) {
+	for (const auto& m : r->middleware) {
+		if (!m(request, respond)) {
+			return false;
+		}
+	}
+	return true;
+}
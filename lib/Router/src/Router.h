@@ -0,0 +1,127 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* ESPAsyncWebServer: https://github.com/esphome/ESPAsyncWebServer
+* ArduinoJSON: https://arduinojson.org/
+*
+* A single request handler holding a table of API routes. Routes are found by a hash of their method and exact path,
+* instead of asking each registered handler in turn. Each route has a list of middleware (readiness, parameter and
+* authentication checks) that run before its handler, and the router counts how often each route is used and how long
+* its handler takes. The number of requests being responded to at once can be capped, and middleware is provided to
+* rate limit routes and to turn requests away while memory is low, so load spikes slow clients down instead of exhausting
+* the heap or sockets.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <ESPAsyncWebServer.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Dispatches API requests to routes through a hash table
+class Router : public AsyncWebHandler {
+	public:
+		/// @brief Handles a request
+		typedef std::function<void(AsyncWebServerRequest*)> Handler;
+
+		/// @brief Handles part of an uploaded file
+		typedef std::function<void(AsyncWebServerRequest*, String, size_t, uint8_t*, size_t, bool)> UploadHandler;
+
+		/// @brief Checks a request before its handler runs. Returns true to continue, or false to stop, sending an error response if respond is true
+		typedef std::function<bool(AsyncWebServerRequest* request, bool respond)> Middleware;
+
+		bool on(const char* path, WebRequestMethod method, Handler handler, std::vector<Middleware> middleware = {}, UploadHandler upload = nullptr);
+		bool canHandle(AsyncWebServerRequest *request);
+		void handleRequest(AsyncWebServerRequest *request);
+		void handleUpload(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final);
+		bool isRequestHandlerTrivial();
+		bool allRegistered();
+		void setInFlightLimit(uint16_t limit);
+		String getMetrics();
+		static Middleware ready(const bool& flag);
+		static Middleware params(std::vector<String> names, bool post = false);
+		static Middleware anyParam(std::vector<String> names, bool post = false);
+		static Middleware authenticated(const String& username, const String& password);
+		static Middleware rateLimit(float rate, uint16_t burst);
+		static Middleware memory(uint32_t minBlock);
+
+		/// @brief Hashes a method and path (FNV-1a), can be evaluated at compile time
+		/// @param path The path
+		/// @param method The method
+		/// @return The hash
+		static constexpr uint32_t key(const char* path, uint32_t method) {
+			return hash(path, (2166136261u ^ method) * 16777619u);
+		}
+
+	private:
+		/// @brief Describes a route
+		typedef struct route {
+			/// @brief The exact path of the route
+			String path;
+
+			/// @brief The method of the route
+			WebRequestMethod method;
+
+			/// @brief The function that responds to requests
+			Handler handler;
+
+			/// @brief Checks run in order before the handler
+			std::vector<Middleware> middleware;
+
+			/// @brief The function that receives uploaded files, if any
+			UploadHandler upload;
+
+			/// @brief Number of requests handled
+			uint32_t count;
+
+			/// @brief Number of requests stopped by middleware
+			uint32_t rejected;
+
+			/// @brief Total time in µs spent in the handler
+			uint64_t total_us;
+
+			/// @brief Longest time in µs spent in the handler
+			uint32_t max_us;
+		} route;
+
+		/// @brief Holds the tokens of a rate limit
+		typedef struct bucket {
+			/// @brief Number of requests that can be made now
+			float tokens;
+
+			/// @brief The time in ms the tokens were last topped up
+			ulong last;
+		} bucket;
+
+		/// @brief The routes, by hash of their method and path
+		std::unordered_map<uint32_t, route> routes;
+
+		/// @brief Number of requests whose responses haven't finished
+		uint16_t in_flight = 0;
+
+		/// @brief Maximum number of requests to respond to at once, 0 for no limit
+		uint16_t max_in_flight = 0;
+
+		/// @brief Number of requests turned away because too many were in flight
+		uint32_t shed = 0;
+
+		/// @brief Number of routes that couldn't be registered, as duplicates or hash collisions
+		uint16_t refused = 0;
+
+		/// @brief Continues a hash over the characters of a string
+		/// @param s The string
+		/// @param h The hash so far
+		/// @return The hash
+		static constexpr uint32_t hash(const char* s, uint32_t h) {
+			return *s == '\0' ? h : hash(s + 1, (h ^ (uint8_t)*s) * 16777619u);
+		}
+
+		route* find(AsyncWebServerRequest *request);
+		bool passes(route* r, AsyncWebServerRequest *request, bool respond);
+};
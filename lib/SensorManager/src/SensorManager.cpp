@@ -3,12 +3,16 @@
 // Initialize static variables
 std::vector<Sensor*> SensorManager::sensors;
 std::vector<SensorManager::measurement> SensorManager::measurements;
+std::vector<std::function<void()>> SensorManager::measurement_callbacks;
+SemaphoreHandle_t SensorManager::callbacks_lock = xSemaphoreCreateRecursiveMutex();
+DescriptionCache SensorManager::sensor_info(SensorManager::buildSensorInfo);
 
 /// @brief Adds a sensor to the in-use sensors collection
 /// @param sensor A pointer to the sensor to add
 /// @return True on success
 bool SensorManager::addSensor(Sensor* sensor) {
 	sensors.push_back(sensor);
+	sensor_info.invalidate();
 	return true; // Currently no way to fail this
 }
 
@@ -23,6 +27,8 @@ bool SensorManager::beginSensors() {
 			Serial.println("Started " + s->Description.name);
 		}
 	}
+	// Sensors fill in their descriptions when they start
+	sensor_info.invalidate();
 	return true;
 }
 
@@ -47,30 +53,68 @@ bool SensorManager::takeMeasurement() {
 			});
 		}
 	}
+	// Notify anything waiting on new measurements
+	xSemaphoreTakeRecursive(callbacks_lock, portMAX_DELAY);
+	for (const auto& c : measurement_callbacks) {
+		c();
+	}
+	xSemaphoreGiveRecursive(callbacks_lock);
 	return true;
 }
 
+/// @brief Adds a function to be called each time a complete set of measurements is taken
+/// @param callback The function to call
+void SensorManager::addMeasurementCallback(std::function<void()> callback) {
+	xSemaphoreTakeRecursive(callbacks_lock, portMAX_DELAY);
+	measurement_callbacks.push_back(callback);
+	xSemaphoreGiveRecursive(callbacks_lock);
+}
+
 /// @brief Gets a complete collection of the last measurements recorded by the sensors
 /// @return A JSON string with all the measurements
 String SensorManager::getLastMeasurement() {
 	// Allocate the JSON document
 	JsonDocument doc;
+	getLastMeasurement(doc);
+	String output;
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Adds a complete collection of the last measurements recorded by the sensors to a document
+/// @param doc The document to add the measurements to
+/// @param singlePrecision True to store values as 32-bit floats, which is all any sensor needs and half the size in MessagePack
+void SensorManager::getLastMeasurement(JsonDocument& doc, bool singlePrecision) {
 	// Create array of measurements
 	JsonArray measurement_array = doc["measurements"].to<JsonArray>();
 	// Add measurements to array
 	for (int i = 0; i < measurements.size(); i++) {
 		measurement_array[i]["parameter"] = measurements[i].parameter;
-		measurement_array[i]["value"] = measurements[i].value;
+		if (singlePrecision) {
+			measurement_array[i]["value"] = (float)measurements[i].value;
+		} else {
+			measurement_array[i]["value"] = measurements[i].value;
+		}
 		measurement_array[i]["unit"] = measurements[i].unit;
 	}
-	String output;
-	serializeJson(doc, output);
-	return output;
 }
 
 /// @brief Retrieves the information on all available sensors and their parameters
 /// @return A JSON string of the information
 String SensorManager::getSensorInfo() {
+	return sensor_info.get();
+}
+
+/// @brief Retrieves the information on all available sensors and their parameters
+/// @param etag Receives the entity tag of the information
+/// @return A JSON string of the information
+String SensorManager::getSensorInfo(String& etag) {
+	return sensor_info.get(etag);
+}
+
+/// @brief Builds the information on all available sensors and their parameters
+/// @return A JSON string of the information
+String SensorManager::buildSensorInfo() {
 	// Allocate the JSON document
 	JsonDocument doc;
 	// Create array of senors
@@ -111,7 +155,10 @@ String SensorManager::getSensorConfig(int sensorPosID) {
 /// @return True on success
 bool SensorManager::setSensorConfig(int sensorPosID, String config) {
 	if (sensorPosID >= 0 && sensorPosID < sensors.size()) {
-		return sensors[sensorPosID]->setConfig(config);
+		// The config can change the sensor's description
+		bool result = sensors[sensorPosID]->setConfig(config);
+		sensor_info.invalidate();
+		return result;
 	} else {
 		return false;
 	}
@@ -126,5 +173,7 @@ std::tuple<Sensor::calibration_response, String> SensorManager::calibrateSensor(
 		Serial.println("sensorPosID out of range");
 		return { Sensor::calibration_response::error, "sensorPosID out of range" };
 	}
-	return sensors[sensorPosID]->calibrate(step);
+	std::tuple<Sensor::calibration_response, String> result = sensors[sensorPosID]->calibrate(step);
+	sensor_info.invalidate();
+	return result;
 }
\ No newline at end of file
@@ -10,7 +10,9 @@
 #pragma once
 #include <Sensor.h>
 #include <vector>
+#include <functional>
 #include <ArduinoJson.h>
+#include <DescriptionCache.h>
 
 class SensorManager {
 	private:
@@ -29,6 +31,17 @@ class SensorManager {
 			String unit;
 		};
 
+		/// @brief Functions to call each time a complete set of measurements is taken
+		static std::vector<std::function<void()>> measurement_callbacks;
+
+		/// @brief Guards the measurement callbacks, since startup stages on either core can add them while measurements are taken
+		static SemaphoreHandle_t callbacks_lock;
+
+		/// @brief Holds the serialized sensor info until a sensor changes
+		static DescriptionCache sensor_info;
+
+		static String buildSensorInfo();
+
 	public:
 		/// @brief Contains the most recently requested measurements
 		static std::vector<measurement> measurements;
@@ -36,8 +49,11 @@ class SensorManager {
 		static bool addSensor(Sensor* sensor);
 		static bool beginSensors();
 		static bool takeMeasurement();
+		static void addMeasurementCallback(std::function<void()> callback);
 		static String getLastMeasurement();
+		static void getLastMeasurement(JsonDocument& doc, bool singlePrecision = false);
 		static String getSensorInfo();
+		static String getSensorInfo(String& etag);
 		static String getSensorConfig(int sensorPosID);
 		static bool setSensorConfig(int sensorPosID, String config);
 		static std::tuple<Sensor::calibration_response, String> calibrateSensor(int sensorPosID, int step);
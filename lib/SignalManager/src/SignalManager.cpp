@@ -4,6 +4,7 @@
 std::vector<SignalReceiver*> SignalManager::receivers;
 QueueHandle_t SignalManager::signalQueue = xQueueCreate(15, sizeof(int[2]));
 std::queue<String> SignalManager::payloads;
+DescriptionCache SignalManager::receiver_info(SignalManager::buildReceiverInfo);
 
 /// @brief Adds a signal receiver to the in-use list
 /// @param receiver A pointer to the receiver to add
@@ -11,6 +12,7 @@ std::queue<String> SignalManager::payloads;
 bool SignalManager::addReceiver(SignalReceiver* receiver) {
 	// Add receiver to in-use list
 	receivers.push_back(receiver);
+	receiver_info.invalidate();
 	return true; // Currently no way to fail this
 }
 
@@ -25,6 +27,8 @@ bool SignalManager::beginReceivers() {
 			Serial.println("Started " + r->Description.name);
 		}
 	}
+	// Receivers fill in their descriptions when they start
+	receiver_info.invalidate();
 	return true;
 }
 
@@ -43,7 +47,7 @@ bool SignalManager::addSignalToQueue(int receiverPosID, String signal, String pa
 	// Attempt to convert signal name to ID
 	int signal_id;
 	try {
-		signal_id = receivers[receiverPosID]->Description.signals.at("signal");
+		signal_id = receivers[receiverPosID]->Description.signals.at(signal);
 	} catch (const std::out_of_range& e) {
 		Serial.println("Receiver cannot process signal");
 		return false;
@@ -81,6 +85,19 @@ bool SignalManager::addSignalToQueue(int receiverPosID, int signal, String paylo
 /// @brief Retrieves the information on all available receivers and their signals
 /// @return A JSON string of the information
 String SignalManager::getReceiverInfo() {
+	return receiver_info.get();
+}
+
+/// @brief Retrieves the information on all available receivers and their signals
+/// @param etag Receives the entity tag of the information
+/// @return A JSON string of the information
+String SignalManager::getReceiverInfo(String& etag) {
+	return receiver_info.get(etag);
+}
+
+/// @brief Builds the information on all available receivers and their signals
+/// @return A JSON string of the information
+String SignalManager::buildReceiverInfo() {
 	// Allocate the JSON document
 	JsonDocument doc;
 	// Create array of receivers
@@ -123,7 +140,10 @@ String SignalManager::getReceiverConfig(int receiverPosID) {
 /// @return True on success
 bool SignalManager::setReceiverConfig(int receiverPosID, String config) {
 	if (receiverPosID >= 0 && receiverPosID < receivers.size()) {
-		return receivers[receiverPosID]->setConfig(config);
+		// The config can change the receiver's description
+		bool result = receivers[receiverPosID]->setConfig(config);
+		receiver_info.invalidate();
+		return result;
 	} else {
 		return false;
 	}
@@ -144,7 +164,7 @@ std::tuple<bool, String> SignalManager::processSignalImmediately(int receiverPos
 	// Attempt to convert signal name to ID
 	int signal_id;
 	try {
-		signal_id = receivers[receiverPosID]->Description.signals.at("signal");
+		signal_id = receivers[receiverPosID]->Description.signals.at(signal);
 	} catch (const std::out_of_range& e) {
 		Serial.println("Receiver cannot process signal");
 		return{ true, R"({"success": false})" };
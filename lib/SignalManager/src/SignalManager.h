@@ -10,6 +10,7 @@
 #pragma once
 #include <ArduinoJson.h>
 #include <SignalReceiver.h>
+#include <DescriptionCache.h>
 #include <vector>
 #include <queue>
 
@@ -25,6 +26,11 @@ class SignalManager {
 		/// @brief Holds all payloads delivered with a signal
 		static std::queue<String> payloads;
 
+		/// @brief Holds the serialized receiver info until a receiver changes
+		static DescriptionCache receiver_info;
+
+		static String buildReceiverInfo();
+
 	public:
 		static bool addReceiver(SignalReceiver* receiver);
 		static bool beginReceivers();
@@ -33,6 +39,7 @@ class SignalManager {
 		static std::tuple<bool, String> processSignalImmediately(int receiverPosID, String signal, String payload = "");
 		static std::tuple<bool, String> processSignalImmediately(int receiverPosID, int signal, String payload = "");
 		static String getReceiverInfo();
+		static String getReceiverInfo(String& etag);
 		static String getReceiverConfig(int receiverPosID);
 		static bool setReceiverConfig(int receiverPosID, String config);
 		static void signalProcessor(void* arg);
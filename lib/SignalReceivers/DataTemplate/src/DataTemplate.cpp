@@ -23,7 +23,7 @@ bool DataTemplate::begin() {
 		result = saveConfig(config_path, getConfig());
 	} else {
 		// Load settings
-		result = setConfig(Storage::readFile(config_path));
+		result = setConfig(readConfig(config_path));
 	}
 	return result;
 }
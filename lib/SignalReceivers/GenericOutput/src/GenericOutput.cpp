@@ -24,7 +24,7 @@ bool GenericOutput::begin() {
 		return setConfig(R"({ "pin":)" + String(current_config.pin) + R"(, "name": "Generic Output" })");
 	} else {
 		// Load settings
-		return setConfig(Storage::readFile(config_path));
+		return setConfig(readConfig(config_path));
 	}
 }
 
@@ -13,15 +13,15 @@ bool LocalDataLogger::begin() {
 	Description.name = "Local Data Logger";
 	Description.id = 1;
 	bool result = false;
-	if (!Storage::fileExists(config_path)) {
+	if (!checkConfig(config_path)) {
 		// Set defaults
-		current_config = { .name = "LocalData.csv", .enabled = false };
+		current_config = { .name = "LocalData.csv", .enabled = false, .rotation = "None", .maxSize = 0, .keepSegments = 0, .reserve = 64 };
 		TaskDescription = { .taskName = "LocalDataLogger", .taskPeriod = 10000 };
 		path = "/data/" + current_config.name;
 		result = saveConfig(config_path, getConfig());
 	} else {
 		// Load settings
-		result = setConfig(Storage::readFile(config_path));
+		result = setConfig(readConfig(config_path));
 	}
 	return result;
 }
@@ -55,14 +55,144 @@ bool LocalDataLogger::enableLogging(bool enable) {
 			if (!Storage::fileExists("/data")) {
 				Storage::createDir("/data");
 			}
-			if (!Storage::writeFile(path, header)) {
+			if (!createLog()) {
 				return false;
 			}
+		} else {
+			// Read the header of the existing file so it can be reused when the file is rotated
+			File file = Storage::getFileSystem(path)->open(path);
+			header = file.readStringUntil('\n') + '\n';
+			file.close();
+			// Continue the time index of the existing file, or start one if it's missing
+			log_size = Storage::fileSize(path);
+			uint32_t started;
+			if (!TimeIndex::getHeader(path, generation, started)) {
+				// File was created before its generation and start time were kept in its index
+				generation = lastGeneration() + 1;
+				started = rtc->getLocalEpoch();
+				if (!TimeIndex::createIndex(path, generation, started)) {
+					return false;
+				}
+			}
+			segment = segmentName(started);
+			TimeIndex::entry last;
+			next_index = TimeIndex::lastEntry(path, last) ? last.offset + index_stride : 0;
 		}
 	}
 	return enableTask(enable);
 }
 
+/// @brief Creates a new data file with the column header, and starts a new time index for it
+/// @return True on success
+bool LocalDataLogger::createLog() {
+	// Start a new generation so sync cursors into the old file are recognized as stale. The indexes are checked as well, in case the old data file was lost before its replacement was created
+	generation = std::max(generation, lastGeneration()) + 1;
+	uint32_t started = rtc->getLocalEpoch();
+	if (!TimeIndex::createIndex(path, generation, started) || !Storage::writeFile(path, header)) {
+		return false;
+	}
+	segment = segmentName(started);
+	log_size = header.length();
+	next_index = 0;
+	return true;
+}
+
+/// @brief Checks if the data file should be rotated before adding a row
+/// @param length The length of the row to add
+/// @return True if the data file is full or its time period has ended
+bool LocalDataLogger::needsRotation(size_t length) {
+	// Never rotate an empty file
+	if (log_size <= header.length()) {
+		return false;
+	}
+	if (current_config.maxSize > 0 && log_size + length > current_config.maxSize * 1024) {
+		return true;
+	}
+	// Compare the hour or day the file was started with the current one
+	int period = current_config.rotation == "Hourly" ? 11 : (current_config.rotation == "Daily" ? 8 : 0);
+	return period > 0 && rtc->getTime("%Y%m%d-%H").substring(0, period) != segment.substring(0, period);
+}
+
+/// @brief Moves the data file and its time index to a segment named for the time it was started, then starts a new data file
+/// @return True on success
+bool LocalDataLogger::rotateLog() {
+	String destination = segmentPath(segment);
+	if (!Storage::renameFile(path, destination)) {
+		return false;
+	}
+	Storage::renameFile(TimeIndex::indexPath(path), TimeIndex::indexPath(destination));
+	// Correct any drift in the tracked free space once per segment
+	Storage::refreshFreeSpace(path);
+	return createLog() && removeSegments(0);
+}
+
+/// @brief Removes the oldest segments until the retention policy is met and there's enough free space
+/// @param needed The number of bytes about to be written
+/// @return True if there's enough free space to write the bytes and keep the reserve
+bool LocalDataLogger::removeSegments(size_t needed) {
+	size_t required = needed + current_config.reserve * 1024;
+	std::vector<String> segments = listSegments();
+	auto s = segments.begin();
+	while (s != segments.end() && ((current_config.keepSegments > 0 && segments.end() - s > current_config.keepSegments) || Storage::freeSpace(path) < required)) {
+		Storage::deleteFile(TimeIndex::indexPath(*s));
+		if (!Storage::deleteFile(*s)) {
+			break;
+		}
+		s++;
+	}
+	return Storage::freeSpace(path) >= required;
+}
+
+/// @brief Lists the segments of the data file
+/// @return The paths of the segments, oldest first
+std::vector<String> LocalDataLogger::listSegments() {
+	String prefix = segmentPath("");
+	String extension = prefix.substring(prefix.lastIndexOf('-') + 1);
+	prefix = prefix.substring(0, prefix.lastIndexOf('-') + 1);
+	std::vector<String> segments;
+	for (const auto& f : Storage::listFiles("/data", 0)) {
+		if (f.startsWith(prefix) && f.endsWith(extension) && !f.endsWith(".idx")) {
+			segments.push_back(f);
+		}
+	}
+	// Segment names start with the time they were started, so they sort oldest first
+	std::sort(segments.begin(), segments.end());
+	return segments;
+}
+
+/// @brief Gets the path of a segment of the data file
+/// @param segment The time the segment was started
+/// @return The path of the segment (e.g. /data/LocalData-20240101-120000.csv)
+String LocalDataLogger::segmentPath(String segment) {
+	int extension = path.lastIndexOf('.');
+	if (extension <= path.lastIndexOf('/')) {
+		return path + "-" + segment;
+	}
+	return path.substring(0, extension) + "-" + segment + path.substring(extension);
+}
+
+/// @brief Formats the time a data file was started as the name of its segment
+/// @param started The time the data file was started, in local time as seconds since the epoch
+/// @return The name of the segment (e.g. 20240101-120000)
+String LocalDataLogger::segmentName(uint32_t started) {
+	time_t t = started;
+	struct tm time;
+	localtime_r(&t, &time);
+	char buffer[16];
+	strftime(buffer, sizeof(buffer), "%Y%m%d-%H%M%S", &time);
+	return String(buffer);
+}
+
+/// @brief Finds the highest generation in the indexes of the data file and its segments
+/// @return The generation, 0 if there are no indexes
+uint32_t LocalDataLogger::lastGeneration() {
+	uint32_t last = TimeIndex::getGeneration(path);
+	for (const auto& s : listSegments()) {
+		last = std::max(last, TimeIndex::getGeneration(s));
+	}
+	return last;
+}
+
 /// @brief Sets the configuration for this device
 /// @param config The JSON config to use
 /// @return True on success
@@ -80,6 +210,10 @@ bool LocalDataLogger::setConfig(String config) {
 	// Assign loaded values
 	current_config.name = doc["name"].as<String>();
 	current_config.enabled = doc["enabled"].as<bool>();
+	current_config.rotation = doc["rotation"]["current"] | "None";
+	current_config.maxSize = doc["maxSize"] | 0;
+	current_config.keepSegments = doc["keepSegments"] | 0;
+	current_config.reserve = doc["reserve"] | 64;
 	TaskDescription.taskPeriod = doc["samplingPeriod"].as<long>();
 	TaskDescription.taskName = doc["taskName"].as<std::string>();
 	path = "/data/" + current_config.name;
@@ -94,7 +228,7 @@ void LocalDataLogger::runTask(long elapsed) {
 	if (current_config.enabled && totalElapsed >= TaskDescription.taskPeriod) {
 		totalElapsed = 0;
 		if (!Storage::fileExists(path)) {
-			if (!Storage::writeFile(path, header)) {
+			if (!createLog()) {
 				return;
 			}
 		}
@@ -116,8 +250,24 @@ void LocalDataLogger::runTask(long elapsed) {
 			data += "," + m["value"].as<String>();
 		}
 		data += '\n';
-		if (Storage::freeSpace() > data.length()) {
-			Storage::appendToFile(path, data);
+		// Start a new data file when the current one is full or its time period has ended
+		if (needsRotation(data.length()) && !rotateLog()) {
+			return;
+		}
+		// Make room by removing the oldest segments, then by retiring the current data file if that isn't enough
+		if (Storage::freeSpace(path) < data.length() + current_config.reserve * 1024 && !removeSegments(data.length()) && log_size > header.length()) {
+			if (rotateLog()) {
+				removeSegments(data.length());
+			}
+		}
+		if (Storage::freeSpace(path) > data.length()) {
+			// Index the row if enough data has been logged since the last index entry
+			if (log_size >= next_index && TimeIndex::addEntry(path, rtc->getEpoch(), log_size)) {
+				next_index = log_size + index_stride;
+			}
+			if (Storage::appendToFile(path, data)) {
+				log_size += data.length();
+			}
 		}
 	}
 }
@@ -130,6 +280,13 @@ String LocalDataLogger::getConfig() {
 	// Assign current values
 	doc["name"] = current_config.name;
 	doc["enabled"] = current_config.enabled;
+	doc["rotation"]["current"] = current_config.rotation;
+	doc["rotation"]["options"][0] = "None";
+	doc["rotation"]["options"][1] = "Hourly";
+	doc["rotation"]["options"][2] = "Daily";
+	doc["maxSize"] = current_config.maxSize;
+	doc["keepSegments"] = current_config.keepSegments;
+	doc["reserve"] = current_config.reserve;
 	doc["samplingPeriod"] = TaskDescription.taskPeriod;
 	doc["taskName"] = TaskDescription.taskName;
 
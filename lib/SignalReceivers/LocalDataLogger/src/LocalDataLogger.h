@@ -14,7 +14,9 @@
 #include <SensorManager.h>
 #include <ESP32Time.h>
 #include <Storage.h>
+#include <TimeIndex.h>
 #include <ArduinoJson.h>
+#include <algorithm>
 
 /// @brief Logs sensor data locally
 class LocalDataLogger : public SignalReceiver, public PeriodicTask {
@@ -26,14 +28,41 @@ class LocalDataLogger : public SignalReceiver, public PeriodicTask {
 
 			/// @brief Enable data logging
 			bool enabled;
+
+			/// @brief Time period after which a new data file is started ("None", "Hourly", or "Daily")
+			String rotation;
+
+			/// @brief Size in KB after which a new data file is started, 0 for no limit
+			size_t maxSize;
+
+			/// @brief Number of old data files to keep, 0 to keep them until space is needed
+			int keepSegments;
+
+			/// @brief Free space in KB to keep available on the storage, old data files are removed to maintain it
+			size_t reserve;
 		} current_config;
 
+		/// @brief Incremented each time the data file is recreated, used for sync cursors. Kept in the time index instead of the config so it can't be set back
+		uint32_t generation = 0;
+
+		/// @brief The time the current data file was started (e.g. 20240101-120000), used to name it when it's rotated
+		String segment;
+
 		/// @brief CSV column header
 		String header;
 
 		/// @brief Full path to data file
 		String path;
 
+		/// @brief Current size of the data file in bytes
+		size_t log_size = 0;
+
+		/// @brief Size the data file needs to reach before the next row is added to the time index
+		size_t next_index = 0;
+
+		/// @brief Approximate number of bytes of data between time index entries
+		const size_t index_stride = 4096;
+
 		/// @brief Path to configuration file
 		const String config_path = "/settings/sig/LocalLogger.json";
 
@@ -41,6 +70,14 @@ class LocalDataLogger : public SignalReceiver, public PeriodicTask {
 		ESP32Time* rtc;
 
 		bool enableLogging(bool enable);
+		bool createLog();
+		bool needsRotation(size_t length);
+		bool rotateLog();
+		bool removeSegments(size_t needed);
+		std::vector<String> listSegments();
+		String segmentPath(String segment);
+		String segmentName(uint32_t started);
+		uint32_t lastGeneration();
 
 	public:
 		LocalDataLogger(ESP32Time* RTC);
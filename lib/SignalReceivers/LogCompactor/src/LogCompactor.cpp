@@ -0,0 +1,241 @@
+#include "LogCompactor.h"
+
+/// @brief Creates a log compactor
+/// @param RTC Pointer to RTC to use for time
+LogCompactor::LogCompactor(ESP32Time* RTC) {
+	rtc = RTC;
+}
+
+/// @brief Starts the log compactor
+/// @return True on success
+bool LogCompactor::begin() {
+	// Set description
+	Description.signalQuantity = 0;
+	Description.type = "datalogger";
+	Description.name = "Log Compactor";
+	Description.id = 2;
+	if (!checkConfig(config_path)) {
+		// Set defaults
+		current_config = { .dataFile = "LocalData.csv", .enabled = false, .minAge = 3, .resolution = 900 };
+		TaskDescription = { .taskName = "LogCompactor", .taskPeriod = 5000 };
+		return saveConfig(config_path, getConfig());
+	} else {
+		// Load settings
+		return setConfig(readConfig(config_path));
+	}
+}
+
+/// @brief Gets the current config
+/// @return A JSON string of the config
+String LogCompactor::getConfig() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Assign current values
+	doc["dataFile"] = current_config.dataFile;
+	doc["enabled"] = current_config.enabled;
+	doc["minAge"] = current_config.minAge;
+	doc["resolution"] = current_config.resolution;
+	doc["samplingPeriod"] = TaskDescription.taskPeriod;
+	doc["taskName"] = TaskDescription.taskName;
+
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Sets the configuration for this device
+/// @param config The JSON config to use
+/// @return True on success
+bool LogCompactor::setConfig(String config) {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Deserialize file contents
+	DeserializationError error = deserializeJson(doc, config);
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	// Disable task in case name changed
+	if (!enableTask(false)) {
+		return false;
+	}
+	// Assign loaded values
+	current_config.dataFile = doc["dataFile"].as<String>();
+	current_config.enabled = doc["enabled"].as<bool>();
+	current_config.minAge = doc["minAge"].as<int>();
+	current_config.resolution = std::max(doc["resolution"].as<int>(), 1);
+	TaskDescription.taskPeriod = doc["samplingPeriod"].as<long>();
+	TaskDescription.taskName = doc["taskName"].as<std::string>();
+	// Start over with the new settings
+	source = "";
+	if (!saveConfig(config_path, getConfig())) {
+		return false;
+	}
+	return enableTask(current_config.enabled);
+}
+
+/// @brief Compacts a few rows of the current segment, or looks for a segment to compact
+/// @param elapsed The time in ms since this task was last called
+void LogCompactor::runTask(long elapsed) {
+	totalElapsed += elapsed;
+	if (current_config.enabled && totalElapsed >= TaskDescription.taskPeriod) {
+		totalElapsed = 0;
+		if (source.isEmpty() && !findSegment()) {
+			return;
+		}
+		if (!compactRows()) {
+			Serial.println("Could not compact " + source);
+			Storage::deleteFile(outputPath(source) + ".tmp");
+			source = "";
+		}
+	}
+}
+
+/// @brief Looks for a raw segment old enough to compact, and starts its output file
+/// @return True if a segment was found
+bool LogCompactor::findSegment() {
+	String name = "/data/" + current_config.dataFile;
+	int extension = name.lastIndexOf('.');
+	String prefix = (extension > name.lastIndexOf('/') ? name.substring(0, extension) : name) + "-";
+	for (const auto& f : Storage::listFiles("/data", 0)) {
+		if (!f.startsWith(prefix) || f.endsWith(".idx") || f.endsWith(".tmp") || f.indexOf(".agg") != -1) {
+			continue;
+		}
+		// Find the age of the segment from the last row in its index, or from when it was last written
+		TimeIndex::entry last;
+		uint32_t last_time = 0;
+		if (TimeIndex::lastEntry(f, last)) {
+			last_time = last.time;
+		} else {
+			File file = Storage::getFileSystem(f)->open(f);
+			last_time = file.getLastWrite();
+			file.close();
+		}
+		if (rtc->getEpoch() - last_time < (uint32_t)current_config.minAge * 86400) {
+			continue;
+		}
+		// Build the header of the output from the column names
+		File file = Storage::getFileSystem(f)->open(f);
+		String header = file.readStringUntil('\n');
+		position = file.position();
+		file.close();
+		String output = "time,samples";
+		int columns = 0;
+		int start = header.indexOf(',');
+		while (start != -1) {
+			int end = header.indexOf(',', start + 1);
+			String column = header.substring(start + 1, end == -1 ? header.length() : end);
+			output += "," + column + " min," + column + " max," + column + " mean";
+			columns++;
+			start = end;
+		}
+		if (!Storage::writeFile(outputPath(f) + ".tmp", output + '\n')) {
+			return false;
+		}
+		Serial.println("Compacting " + f);
+		source = f;
+		interval_rows = 0;
+		aggregates.assign(columns, { NAN, NAN, 0, 0 });
+		return true;
+	}
+	return false;
+}
+
+/// @brief Adds the next rows of the segment to the aggregates, and replaces the segment with the output when it's finished
+/// @return True on success
+bool LogCompactor::compactRows() {
+	File file = Storage::getFileSystem(source)->open(source);
+	if (!file || !file.seek(position)) {
+		return false;
+	}
+	String output;
+	for (int i = 0; i < rows_per_run && file.available(); i++) {
+		String row = file.readStringUntil('\n');
+		uint32_t seconds;
+		if (!TimeIndex::parseTime(row.c_str(), seconds)) {
+			continue;
+		}
+		uint32_t interval = seconds - seconds % current_config.resolution;
+		if (interval_rows > 0 && interval != interval_start) {
+			output += closeInterval();
+		}
+		interval_start = interval;
+		interval_rows++;
+		const char* field = strchr(row.c_str(), ',');
+		for (auto& a : aggregates) {
+			if (field == nullptr) {
+				break;
+			}
+			// Skip cells that aren't numbers (e.g. "null" for a failed reading) instead of counting them as 0
+			char* end;
+			float value = strtof(field + 1, &end);
+			bool parsed = end != field + 1;
+			field = strchr(field + 1, ',');
+			if (!parsed || isnan(value)) {
+				continue;
+			}
+			if (a.count == 0) {
+				a.min = value;
+				a.max = value;
+			} else {
+				a.min = std::min(a.min, value);
+				a.max = std::max(a.max, value);
+			}
+			a.sum += value;
+			a.count++;
+		}
+	}
+	position = file.position();
+	bool finished = !file.available();
+	file.close();
+	if (finished && interval_rows > 0) {
+		output += closeInterval();
+	}
+	String temp = outputPath(source) + ".tmp";
+	if (!output.isEmpty() && !Storage::appendToFile(temp, output)) {
+		return false;
+	}
+	if (finished) {
+		// Swap the segment for the aggregates
+		if (!Storage::renameFile(temp, outputPath(source))) {
+			return false;
+		}
+		Storage::deleteFile(TimeIndex::indexPath(source));
+		Storage::deleteFile(source);
+		Serial.println("Finished compacting " + source);
+		source = "";
+	}
+	return true;
+}
+
+/// @brief Formats the aggregates of the current interval as a row and resets them
+/// @return The row for the output file
+String LogCompactor::closeInterval() {
+	String row = TimeIndex::formatTime(interval_start) + "," + String(interval_rows);
+	for (auto& a : aggregates) {
+		if (a.count > 0) {
+			// String(float) rounds to 2 decimals, which loses small readings
+			row += "," + String(a.min, 6) + "," + String(a.max, 6) + "," + String(a.sum / a.count, 6);
+		} else {
+			row += ",nan,nan,nan";
+		}
+		a = { NAN, NAN, 0, 0 };
+	}
+	interval_rows = 0;
+	return row + '\n';
+}
+
+/// @brief Gets the path of the compacted version of a segment
+/// @param segment The path of the segment
+/// @return The path of the output file (e.g. /data/LocalData-20240101-120000.agg.csv)
+String LogCompactor::outputPath(String segment) {
+	int extension = segment.lastIndexOf('.');
+	if (extension <= segment.lastIndexOf('/')) {
+		return segment + ".agg";
+	}
+	return segment.substring(0, extension) + ".agg" + segment.substring(extension);
+}
@@ -0,0 +1,93 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries used:
+* ArduinoJSON: https://arduinojson.org/
+* ESP32Time: https://github.com/fbiego/ESP32Time
+*
+* Rewrites old segments of a LocalDataLogger data file as the minimum, maximum, and mean of each column over fixed
+* intervals. A few rows are processed each time the task runs, so a segment is never held in memory and other tasks
+* aren't held up.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <SignalReceiver.h>
+#include <PeriodicTask.h>
+#include <ESP32Time.h>
+#include <Storage.h>
+#include <TimeIndex.h>
+#include <ArduinoJson.h>
+#include <vector>
+
+/// @brief Compacts old data logger segments into downsampled aggregates
+class LogCompactor : public SignalReceiver, public PeriodicTask {
+	private:
+		/// @brief Holds log compactor configuration
+		struct {
+			/// @brief The name of the data file whose segments are compacted
+			String dataFile;
+
+			/// @brief Enable compaction
+			bool enabled;
+
+			/// @brief Age in days a segment must reach before it's compacted
+			int minAge;
+
+			/// @brief Length in seconds of each aggregate interval
+			int resolution;
+		} current_config;
+
+		/// @brief Running aggregate of one column over an interval
+		typedef struct aggregate {
+			/// @brief The smallest value
+			float min;
+
+			/// @brief The largest value
+			float max;
+
+			/// @brief The sum of the values
+			double sum;
+
+			/// @brief The number of values
+			uint32_t count;
+		} aggregate;
+
+		/// @brief Path to configuration file
+		const String config_path = "/settings/sig/LogCompactor.json";
+
+		/// @brief Maximum number of rows to process each time the task runs
+		const int rows_per_run = 200;
+
+		/// @brief Pointer to the clock object in use
+		ESP32Time* rtc;
+
+		/// @brief Path of the segment being compacted, empty if none
+		String source;
+
+		/// @brief Byte offset of the next row to read from the segment
+		size_t position = 0;
+
+		/// @brief Start of the current interval, in local time as seconds since the epoch
+		uint32_t interval_start = 0;
+
+		/// @brief Number of rows in the current interval
+		uint32_t interval_rows = 0;
+
+		/// @brief Aggregates of each column over the current interval
+		std::vector<aggregate> aggregates;
+
+		bool findSegment();
+		bool compactRows();
+		String closeInterval();
+		String outputPath(String segment);
+
+	public:
+		LogCompactor(ESP32Time* RTC);
+		bool begin();
+		String getConfig();
+		bool setConfig(String config);
+		void runTask(long elapsed);
+};
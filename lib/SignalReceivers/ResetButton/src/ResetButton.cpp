@@ -27,7 +27,7 @@ bool ResetButton::begin() {
 		return false;
 	} else {
 		// Load settings
-		return setConfig(Storage::readFile("/settings/sig/ResetButton.json"));
+		return setConfig(readConfig(config_path));
 	}
 }
 
@@ -0,0 +1,293 @@
+#include "TelemetryExporter.h"
+
+/// @brief Creates a telemetry exporter
+/// @param RTC Pointer to RTC to use for time
+TelemetryExporter::TelemetryExporter(ESP32Time* RTC) {
+	rtc = RTC;
+}
+
+/// @brief Starts the telemetry exporter
+/// @return True on success
+bool TelemetryExporter::begin() {
+	// Set description
+	Description.signalQuantity = 0;
+	Description.type = "exporter";
+	Description.name = "Telemetry Exporter";
+	Description.id = 4;
+	bool result = false;
+	if (!checkConfig(config_path)) {
+		// Set defaults
+		current_config = { .enabled = false, .webhook = 0, .measurement = "sensorhub", .tags = "", .batchSize = 30, .flushPeriod = 60000, .maxSpill = 512 };
+		TaskDescription = { .taskName = "TelemetryExporter", .taskPeriod = 10000 };
+		result = saveConfig(config_path, getConfig());
+	} else {
+		// Load settings
+		result = setConfig(readConfig(config_path));
+	}
+	return result;
+}
+
+/// @brief Sets the configuration for this device
+/// @param config The JSON config to use
+/// @return True on success
+bool TelemetryExporter::setConfig(String config) {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Deserialize file contents
+	DeserializationError error = deserializeJson(doc, config);
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	// Assign loaded values
+	current_config.enabled = doc["enabled"].as<bool>();
+	current_config.webhook = doc["webhook"] | 0;
+	current_config.measurement = doc["measurement"] | "sensorhub";
+	current_config.tags = doc["tags"] | "";
+	current_config.batchSize = std::max(doc["batchSize"] | 30, 1);
+	current_config.flushPeriod = doc["flushPeriod"] | 60000;
+	current_config.maxSpill = doc["maxSpill"] | 512;
+	TaskDescription.taskPeriod = doc["samplingPeriod"].as<long>();
+	TaskDescription.taskName = doc["taskName"].as<std::string>();
+	enableTask(current_config.enabled);
+	return saveConfig(config_path, getConfig());
+}
+
+/// @brief Gets the current config
+/// @return A JSON string of the config
+String TelemetryExporter::getConfig() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Assign current values
+	doc["enabled"] = current_config.enabled;
+	doc["webhook"] = current_config.webhook;
+	doc["measurement"] = current_config.measurement;
+	doc["tags"] = current_config.tags;
+	doc["batchSize"] = current_config.batchSize;
+	doc["flushPeriod"] = current_config.flushPeriod;
+	doc["maxSpill"] = current_config.maxSpill;
+	doc["samplingPeriod"] = TaskDescription.taskPeriod;
+	doc["taskName"] = TaskDescription.taskName;
+
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Collects measurements and sends them when a batch is ready
+/// @param elapsed The time in ms since this task was last called
+void TelemetryExporter::runTask(long elapsed) {
+	totalElapsed += elapsed;
+	if (!current_config.enabled) {
+		return;
+	}
+	if (totalElapsed >= TaskDescription.taskPeriod) {
+		totalElapsed = 0;
+		if (SensorManager::takeMeasurement()) {
+			addLine();
+		}
+	}
+	if (pending != 0) {
+		checkPending();
+	}
+	if (pending == 0) {
+		bool due = buffered_lines >= current_config.batchSize || buffer.length() >= max_batch || (buffered_lines > 0 && millis() - first_line >= current_config.flushPeriod);
+		bool spilled = Storage::fileSize(spill_path) > spill_offset;
+		// After a failure, wait a flush period before trying again
+		bool backoff = failing && millis() - last_failure < current_config.flushPeriod;
+		if ((due || spilled) && !backoff && WiFi.isConnected()) {
+			sendBatch();
+		}
+	}
+	// Don't hold more than one batch in memory while the collector can't be reached
+	if (buffer.length() >= max_buffer) {
+		spill(buffer);
+		buffer = "";
+		buffered_lines = 0;
+	}
+}
+
+/// @brief Adds the latest measurements to the buffer as a line
+void TelemetryExporter::addLine() {
+	String line = current_config.measurement;
+	line.replace(",", "\\,");
+	line.replace(" ", "\\ ");
+	if (!current_config.tags.isEmpty()) {
+		line += "," + current_config.tags;
+	}
+	// Sensors can measure the same parameter, so repeated names are numbered
+	std::map<String, int> seen;
+	char separator = ' ';
+	for (const auto& m : SensorManager::measurements) {
+		// Line protocol has no way to represent a missing value
+		if (isnan(m.value)) {
+			continue;
+		}
+		String key = escapeKey(m.parameter);
+		int count = ++seen[key];
+		if (count > 1) {
+			key += "_" + String(count);
+		}
+		line += separator;
+		line += key + "=" + String(m.value, 6);
+		separator = ',';
+	}
+	if (separator == ' ') {
+		return;
+	}
+	line += " " + String(rtc->getEpoch()) + "\n";
+	if (buffered_lines == 0) {
+		first_line = millis();
+	}
+	buffer += line;
+	buffered_lines++;
+}
+
+/// @brief Sends the next batch, spilled lines first so they arrive in order
+/// @return True if the batch was queued
+bool TelemetryExporter::sendBatch() {
+	String batch;
+	bool from_spill = Storage::fileSize(spill_path) > spill_offset;
+	if (from_spill) {
+		if (!readSpill(batch)) {
+			return false;
+		}
+	} else {
+		batch = buffer;
+	}
+	int64_t id = WebhookManager::queueRequest(current_config.webhook, Webhook::Method::POST, batch, true, "text/plain; charset=utf-8");
+	if (id < 0) {
+		if (id == -1) {
+			Serial.println("Telemetry webhook doesn't exist");
+			failing = true;
+			last_failure = millis();
+		}
+		return false;
+	}
+	pending = id;
+	sending = batch;
+	sending_spill = from_spill;
+	if (!from_spill) {
+		buffer = "";
+		buffered_lines = 0;
+	}
+	return true;
+}
+
+/// @brief Checks if the batch being sent has finished, and spills it if it failed
+void TelemetryExporter::checkPending() {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Results are forgotten if enough other requests finish first, treat that as a failure
+	if (deserializeJson(doc, WebhookManager::getResult(pending))) {
+		doc["status"] = "failed";
+	}
+	String status = doc["status"].as<String>();
+	if (status == "queued" || status == "sending" || status == "retrying") {
+		return;
+	}
+	if (status == "done") {
+		failing = false;
+		if (sending_spill) {
+			spill_offset += sending.length();
+			// Everything spilled has been sent
+			if (spill_offset >= Storage::fileSize(spill_path)) {
+				Storage::deleteFile(spill_path);
+				spill_offset = 0;
+			}
+		}
+	} else {
+		Serial.print("Could not send telemetry. Response code: ");
+		Serial.println(doc["code"].as<int>());
+		failing = true;
+		last_failure = millis();
+		// Spilled batches are still in the spill file, others are added to it
+		if (!sending_spill) {
+			spill(sending);
+		}
+	}
+	pending = 0;
+	sending = "";
+}
+
+/// @brief Reads the oldest unsent lines from the spill file
+/// @param batch Receives the lines
+/// @return True on success
+bool TelemetryExporter::readSpill(String& batch) {
+	File file = Storage::getFileSystem(spill_path)->open(spill_path, FILE_READ);
+	if (!file || !file.seek(spill_offset)) {
+		Serial.println("Could not read telemetry spill file");
+		return false;
+	}
+	size_t remaining = file.size() - spill_offset;
+	size_t length = std::min(max_batch, remaining);
+	batch = "";
+	batch.reserve(length);
+	char chunk[256];
+	while (length > 0) {
+		size_t read = file.read((uint8_t*)chunk, std::min(length, sizeof(chunk)));
+		if (read == 0) {
+			break;
+		}
+		batch.concat(chunk, read);
+		length -= read;
+	}
+	// Only send whole lines
+	int end = batch.lastIndexOf('\n');
+	if (end < 0 && batch.length() < remaining) {
+		// A single line longer than a batch, read on to its end so it's sent by itself
+		size_t read;
+		while (end < 0 && (read = file.read((uint8_t*)chunk, sizeof(chunk))) > 0) {
+			const char* newline = (const char*)memchr(chunk, '\n', read);
+			if (newline != nullptr) {
+				end = batch.length() + (newline - chunk);
+			}
+			batch.concat(chunk, read);
+		}
+	}
+	file.close();
+	if (end < 0) {
+		// A partial line at the end of the file left by a failed write, skip it
+		spill_offset += batch.length();
+		if (spill_offset >= Storage::fileSize(spill_path)) {
+			Storage::deleteFile(spill_path);
+			spill_offset = 0;
+		}
+		return false;
+	}
+	batch = batch.substring(0, end + 1);
+	return true;
+}
+
+/// @brief Adds lines to the spill file to be sent later
+/// @param lines The lines to add
+void TelemetryExporter::spill(String lines) {
+	if (lines.isEmpty()) {
+		return;
+	}
+	if (Storage::fileSize(spill_path) + lines.length() > current_config.maxSpill * 1024) {
+		Serial.println("Telemetry spill file is full, dropping " + String(lines.length()) + " bytes");
+		return;
+	}
+	if (!Storage::fileExists("/data")) {
+		Storage::createDir("/data");
+	}
+	if (!Storage::appendToFile(spill_path, lines)) {
+		Serial.println("Could not spill telemetry");
+	}
+}
+
+/// @brief Escapes a field key for the line protocol
+/// @param key The key
+/// @return The escaped key
+String TelemetryExporter::escapeKey(String key) {
+	key.replace("\\", "\\\\");
+	key.replace(",", "\\,");
+	key.replace("=", "\\=");
+	key.replace(" ", "\\ ");
+	return key;
+}
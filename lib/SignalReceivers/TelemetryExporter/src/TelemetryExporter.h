@@ -0,0 +1,109 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries used:
+* ArduinoJSON: https://arduinojson.org/
+*
+* Pushes measurements to a remote collector in batches, using the InfluxDB line protocol, through a webhook. Each set of
+* measurements becomes one line, and lines are sent together once enough have been collected or the oldest one has waited
+* long enough. Timestamps are in seconds, so for InfluxDB the webhook URL should include "precision=s".
+* Batches that can't be sent (no network, collector down) are spilled to a file in the data directory and sent, oldest
+* first, once the collector can be reached again.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <SignalReceiver.h>
+#include <PeriodicTask.h>
+#include <SensorManager.h>
+#include <WebhookManager.h>
+#include <ESP32Time.h>
+#include <Storage.h>
+#include <ArduinoJson.h>
+
+/// @brief Exports sensor data to a remote collector
+class TelemetryExporter : public SignalReceiver, public PeriodicTask {
+	private:
+		/// @brief Holds exporter configuration
+		struct {
+			/// @brief Enable exporting
+			bool enabled;
+
+			/// @brief The position ID of the webhook to send batches to
+			int webhook;
+
+			/// @brief The measurement name of each line
+			String measurement;
+
+			/// @brief Tags added to each line, comma separated (e.g. "host=hub1,room=lab")
+			String tags;
+
+			/// @brief Number of sets of measurements to collect before sending a batch
+			int batchSize;
+
+			/// @brief Time in ms after which collected measurements are sent, even if the batch isn't full
+			ulong flushPeriod;
+
+			/// @brief Size in KB of the spill file, batches that don't fit are dropped
+			size_t maxSpill;
+		} current_config;
+
+		/// @brief Lines waiting to be sent
+		String buffer;
+
+		/// @brief Number of lines in the buffer
+		int buffered_lines = 0;
+
+		/// @brief The time in ms the oldest line in the buffer was added
+		ulong first_line = 0;
+
+		/// @brief The batch being sent
+		String sending;
+
+		/// @brief True if the batch being sent was read from the spill file
+		bool sending_spill = false;
+
+		/// @brief ID of the webhook request sending the batch, 0 if none
+		uint32_t pending = 0;
+
+		/// @brief Number of bytes at the start of the spill file that have already been sent
+		size_t spill_offset = 0;
+
+		/// @brief The time in ms a batch last failed to send, used to wait before trying again
+		ulong last_failure = 0;
+
+		/// @brief True if a batch has failed since the last one that was sent
+		bool failing = false;
+
+		/// @brief Maximum size of a batch in bytes
+		const size_t max_batch = 8192;
+
+		/// @brief Size of the buffer in bytes above which it's spilled instead of waiting to be sent
+		const size_t max_buffer = 8192;
+
+		/// @brief Path to the spill file
+		const String spill_path = "/data/telemetry.lp";
+
+		/// @brief Path to configuration file
+		const String config_path = "/settings/sig/TelemetryExporter.json";
+
+		/// @brief Pointer to the clock object in use
+		ESP32Time* rtc;
+
+		void addLine();
+		bool sendBatch();
+		void checkPending();
+		bool readSpill(String& batch);
+		void spill(String lines);
+		static String escapeKey(String key);
+
+	public:
+		TelemetryExporter(ESP32Time* RTC);
+		bool begin();
+		String getConfig();
+		bool setConfig(String config);
+		void runTask(long elapsed);
+};
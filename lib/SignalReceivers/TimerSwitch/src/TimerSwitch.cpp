@@ -25,7 +25,7 @@ bool TimerSwitch::begin() {
 		return setConfig(R"({"pin":)" + String(current_config.pin) + R"(, "name": "Timer Switch", "onTime": "9:30", "offTime": "22:15", "enabled": false, "active": "Active high"})");
 	} else {
 		// Load settings
-		return setConfig(Storage::readFile(config_path));
+		return setConfig(readConfig(config_path));
 	}
 }
 
@@ -0,0 +1,149 @@
+#include "Startup.h"
+
+// Initialize static variables
+std::vector<Startup::stage> Startup::stages;
+QueueHandle_t Startup::finished = NULL;
+ulong Startup::ready_time = 0;
+
+/// @brief Adds a stage to boot. All stages must be added before run() is called
+/// @param name The name of the stage
+/// @param stage The function that performs the stage, returning true on success
+/// @param after The names of the stages that must finish before this one starts
+/// @param deferred True to run the stage in the background after boot, in which case it can only depend on other stages that run before it
+void Startup::addStage(String name, std::function<bool()> stage, std::vector<String> after, bool deferred) {
+	stages.push_back({ .name = name, .run = stage, .after = after, .deferred = deferred, .status = Status::Waiting, .started = 0, .duration = 0 });
+}
+
+/// @brief Runs all non-deferred stages, each as soon as the stages it depends on have finished
+/// @return True if all stages succeeded
+bool Startup::run() {
+	finished = xQueueCreate(stages.size(), sizeof(int));
+	int running = 0;
+	int core = 0;
+	bool success = true;
+	while (success) {
+		// Start every stage that's ready
+		for (int i = 0; i < stages.size(); i++) {
+			if (!stages[i].deferred && stages[i].status == Status::Waiting && canStart(stages[i])) {
+				stages[i].status = Status::Running;
+				running++;
+				// 8K of stack since stages may start WiFi or parse JSON configs
+				xTaskCreatePinnedToCore(stageTask, stages[i].name.c_str(), 8192, (void*)(intptr_t)i, 1, NULL, core);
+				core = 1 - core;
+			}
+		}
+		if (running == 0) {
+			break;
+		}
+		int index;
+		xQueueReceive(finished, &index, portMAX_DELAY);
+		running--;
+		if (stages[index].status == Status::Failed) {
+			Serial.println("Startup stage " + stages[index].name + " failed");
+			success = false;
+		}
+	}
+	// Anything still waiting depends on a stage that doesn't exist, or on itself
+	for (const auto& s : stages) {
+		if (success && !s.deferred && s.status == Status::Waiting) {
+			Serial.println("Startup stage " + s.name + " can't run, check its dependencies");
+			success = false;
+		}
+	}
+	// Wait for any stages still running so nothing is left half started
+	while (running > 0) {
+		int index;
+		xQueueReceive(finished, &index, portMAX_DELAY);
+		running--;
+	}
+	ready_time = millis();
+	Serial.println("Startup took " + String(ready_time) + "ms");
+	return success;
+}
+
+/// @brief Starts running the deferred stages in the background
+void Startup::runDeferred() {
+	xTaskCreate(deferredTask, "Deferred Startup", 8192, NULL, 1, NULL);
+}
+
+/// @brief Gets the timing of each stage of boot
+/// @return A JSON string of the timings, in ms since boot
+String Startup::getTimings() {
+	const char* status_names[] = { "waiting", "running", "done", "failed" };
+	// Allocate the JSON document
+	JsonDocument doc;
+	doc["ready"] = ready_time;
+	JsonArray stage_array = doc["stages"].to<JsonArray>();
+	for (const auto& s : stages) {
+		JsonObject stage = stage_array.add<JsonObject>();
+		stage["name"] = s.name;
+		stage["deferred"] = s.deferred;
+		stage["status"] = status_names[(int)s.status];
+		stage["start"] = s.started;
+		stage["duration"] = s.duration;
+	}
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Checks if all the stages a stage depends on have finished
+/// @param s The stage to check
+/// @return True if the stage can start
+bool Startup::canStart(const stage& s) {
+	for (const auto& name : s.after) {
+		bool done = false;
+		for (const auto& other : stages) {
+			if (other.name == name) {
+				done = other.status == Status::Done;
+				break;
+			}
+		}
+		if (!done) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// @brief Runs a stage and records its timing
+/// @param s The stage to run
+void Startup::runStage(stage& s) {
+	Serial.println("Starting " + s.name);
+	s.started = millis();
+	bool success = s.run();
+	s.duration = millis() - s.started;
+	s.status = success ? Status::Done : Status::Failed;
+	Serial.println("Finished " + s.name + " in " + String(s.duration) + "ms");
+}
+
+/// @brief Task that runs a single stage and reports when it's finished
+/// @param arg The index of the stage
+void Startup::stageTask(void* arg) {
+	int index = (intptr_t)arg;
+	runStage(stages[index]);
+	xQueueSend(finished, &index, portMAX_DELAY);
+	vTaskDelete(NULL);
+}
+
+/// @brief Task that runs the deferred stages one after another
+/// @param arg Unused
+void Startup::deferredTask(void* arg) {
+	for (auto& s : stages) {
+		if (!s.deferred) {
+			continue;
+		}
+		if (canStart(s)) {
+			runStage(s);
+			if (s.status == Status::Failed) {
+				Serial.println("Deferred startup stage " + s.name + " failed");
+			}
+		} else {
+			// Leave it waiting, so the failure shows in the timings
+			Serial.println("Deferred startup stage " + s.name + " skipped, its dependencies didn't finish");
+		}
+	}
+	vTaskDelete(NULL);
+}
@@ -0,0 +1,71 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Boot is described as stages that list the stages they depend on. Each stage runs in its own task as soon as its
+* dependencies finish, alternating between cores, so independent stages (e.g. connecting to WiFi and starting sensors)
+* run at the same time. Deferred stages run one after another in the background once everything else is ready.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include <vector>
+
+/// @brief Runs the stages of boot, concurrently where possible, and records how long each took
+class Startup {
+	public:
+		static void addStage(String name, std::function<bool()> stage, std::vector<String> after = {}, bool deferred = false);
+		static bool run();
+		static void runDeferred();
+		static String getTimings();
+
+	private:
+		/// @brief States a stage can be in
+		enum class Status {
+			Waiting,
+			Running,
+			Done,
+			Failed
+		};
+
+		/// @brief Describes a stage of boot
+		typedef struct stage {
+			/// @brief The name of the stage
+			String name;
+
+			/// @brief The function that performs the stage, returning true on success
+			std::function<bool()> run;
+
+			/// @brief The names of the stages that must finish before this one starts
+			std::vector<String> after;
+
+			/// @brief True to run the stage in the background after boot
+			bool deferred;
+
+			/// @brief The current state of the stage
+			Status status;
+
+			/// @brief The time in ms since boot that the stage started
+			ulong started;
+
+			/// @brief The time in ms the stage took
+			ulong duration;
+		} stage;
+
+		/// @brief All stages, in the order they were added
+		static std::vector<stage> stages;
+
+		/// @brief Receives the index of each stage as it finishes
+		static QueueHandle_t finished;
+
+		/// @brief The time in ms since boot that all non-deferred stages finished
+		static ulong ready_time;
+
+		static bool canStart(const stage& s);
+		static void runStage(stage& s);
+		static void stageTask(void* arg);
+		static void deferredTask(void* arg);
+};
@@ -1,16 +1,21 @@
 #include "Storage.h"
 
 // Initialize static variables
-Storage::Media Storage::storageMedia = Storage::Media::LittleFS;
-FS* Storage::storageSystem = &LittleFS;
+std::vector<Storage::mount> Storage::mounts;
+std::map<String, Storage::staged_append> Storage::staged;
+size_t Storage::staged_bytes = 0;
+SemaphoreHandle_t Storage::write_lock = xSemaphoreCreateRecursiveMutex();
+std::map<String, std::map<String, Storage::file_info>> Storage::directories;
+std::list<String> Storage::recent_dirs;
+std::set<String> Storage::uncacheable;
+size_t Storage::cached_entries = 0;
 
 /// @brief Mount LittleFS and format if necessary
+/// @param prefix The paths to store on LittleFS, "/" for all paths not stored on another medium
 /// @return True on successful mount of LittleFS
-bool Storage::begin() {
-	storageSystem = &LittleFS;
-	storageMedia = Storage::Media::LittleFS;
+bool Storage::begin(String prefix) {
 	Serial.println("Mounting  LittleFS, this could take a while, please wait...");
-	return LittleFS.begin(true, "/sd");
+	return LittleFS.begin(true, "/littlefs") && addMount(prefix, Storage::Media::LittleFS, &LittleFS);
 }
 
 /// @brief Mount and initiate the storage for an SD card using SPI. Must be formatted as FAT32
@@ -18,10 +23,9 @@ bool Storage::begin() {
 /// @param mo The microcontroller out pin
 /// @param sck The serial clock pin
 /// @param cs The chip-select pin
+/// @param prefix The paths to store on the SD card, "/" for all paths not stored on another medium
 /// @return True on success
-bool Storage::begin(int mi, int mo, int sck, int cs) {
-	storageSystem = &SD;
-	storageMedia = Storage::Media::SD_SPI;
+bool Storage::begin(int mi, int mo, int sck, int cs, String prefix) {
 	// Start SPI bus
 	SPI.begin(sck, mi, mo);
 	bool success = true;
@@ -45,11 +49,11 @@ bool Storage::begin(int mi, int mo, int sck, int cs) {
 			} else {
 				Serial.println("UNKNOWN");
 			}
-			uint64_t cardSize = SD_MMC.cardSize() / 1048576; // 1024 * 1024
-			Serial.printf("SD_MMC card size: %lluMB\n", cardSize);
+			uint64_t cardSize = SD.cardSize() / 1048576; // 1024 * 1024
+			Serial.printf("SD card size: %lluMB\n", cardSize);
 		}
 	}
-	return success;
+	return success && addMount(prefix, Storage::Media::SD_SPI, &SD);
 }
 
 /// @brief Mount and initiate the storage for an SD card using SDIO (e.g. https://www.adafruit.com/product/4682). Will format if necessary
@@ -59,14 +63,13 @@ bool Storage::begin(int mi, int mo, int sck, int cs) {
 /// @param d1 D1 pin number
 /// @param d2 D2 pin number
 /// @param d3 D3 pin number
+/// @param prefix The paths to store on the SD card, "/" for all paths not stored on another medium
 /// @return True on success
-bool Storage::begin(int clk, int cmd, int d0, int d1, int d2, int d3) {
-	storageSystem = &SD_MMC;
-	storageMedia = Storage::Media::SD_MMC;
+bool Storage::begin(int clk, int cmd, int d0, int d1, int d2, int d3, String prefix) {
 	bool success = SD_MMC.setPins(clk, cmd, d0, d1, d2, d3);
 	if (success) {
 		Serial.println("Mounting storage...");
-		if (!SD_MMC.begin("/sd", false, true, 40000)) {
+		if (!SD_MMC.begin("/sdcard", false, true, 40000)) {
 			Serial.println("Card mount failed, might need to reduce sd_mmc frequency to 10000");
 			success = false;
 		} else {
@@ -91,19 +94,36 @@ bool Storage::begin(int clk, int cmd, int d0, int d1, int d2, int d3) {
 			}
 		}
 	}
-	return success;
+	return success && addMount(prefix, Storage::Media::SD_MMC, &SD_MMC);
 }
 
-/// @brief Gets the currently used file system
+/// @brief Gets the file system storing paths not stored on another medium
 /// @return A pointer to storage media/file system being used
 fs::FS* Storage::getFileSystem() {
-	return storageSystem; 
+	return mountFor("/").system;
+}
+
+/// @brief Gets the file system storing a path. Any appends to the path waiting to be written are written first, so the file is up to date
+/// @param path The path of a file or directory
+/// @return A pointer to the file system storing the path
+fs::FS* Storage::getFileSystem(String path) {
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	writeStagedUnder(path);
+	xSemaphoreGiveRecursive(write_lock);
+	return mountFor(path).system;
 }
 
-/// @brief Gets the currently used media type
+/// @brief Gets the media type storing paths not stored on another medium
 /// @return The type of media in use
 Storage::Media Storage::getMediaType() {
-	return storageMedia;
+	return mountFor("/").media;
+}
+
+/// @brief Gets the media type storing a path
+/// @param path The path of a file or directory
+/// @return The type of media storing the path
+Storage::Media Storage::getMediaType(String path) {
+	return mountFor(path).media;
 }
 
 /// @brief List the files in a directory
@@ -111,32 +131,11 @@ Storage::Media Storage::getMediaType() {
 /// @param levels How many levels to recurse into the directory for listing
 /// @return A collection of strings of full paths of the files found
 std::vector<String> Storage::listFiles(String dirname, uint8_t levels) {
-	Serial.println("Listing directory: " + dirname);
+	std::vector<entry> entries;
+	listEntries(dirname, levels, entries);
 	std::vector<String> folderContents;
-	File root = storageSystem->open(dirname);
-	if(!root){
-		Serial.println("Failed to open directory");
-		return folderContents;
-	}
-	if (!root.isDirectory()) {
-		Serial.println("Not a directory");
-		return folderContents;
-	}
-	File file = root.openNextFile();
-	while(file) {
-		if(file.isDirectory()) {
-			Serial.print("  DIR : ");
-			Serial.println(file.name());
-			if(levels) {
-				// Recurse and add subdir contents to file list
-				for (const auto& f : listFiles(file.path(), levels - 1)) {
-					folderContents.push_back(f);
-				}
-			}
-		} else {
-			folderContents.push_back(String(file.path()));
-		}
-		file = root.openNextFile();
+	for (const auto& e : entries) {
+		folderContents.push_back(e.path);
 	}
 	return folderContents;
 }
@@ -148,38 +147,80 @@ std::vector<String> Storage::listFiles(String dirname, uint8_t levels) {
 std::vector<String> Storage::listDirs(String dirname, uint8_t levels) {
 	Serial.println("Listing directory: " + dirname);
 	std::vector<String> folderContents;
-	File root = storageSystem->open(dirname);
-	if(!root){
-		Serial.println("Failed to open directory");
-		return folderContents;
-	}
-	if (!root.isDirectory()) {
-		Serial.println("Not a directory");
-		return folderContents;
-	}
-	File file = root.openNextFile();
-	while(file) {
-		if(file.isDirectory()) {
-			folderContents.push_back(String(file.path()));
-			Serial.println(file.name());
-			if(levels) {
-				// Recurse and add subdir contents to file list
-				for (const auto& d : listDirs(file.path(), levels - 1)) {
-					folderContents.push_back(d);
-				}
+	std::vector<String> subdirs;
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	forEachEntry(dirname, [&](const String& name, const file_info& info) {
+		if (info.directory) {
+			subdirs.push_back(joinPath(dirname, name));
+		}
+	});
+	xSemaphoreGiveRecursive(write_lock);
+	for (const auto& d : subdirs) {
+		folderContents.push_back(d);
+		if (levels) {
+			// Recurse and add subdir contents to directory list
+			for (const auto& sub : listDirs(d, levels - 1)) {
+				folderContents.push_back(sub);
 			}
 		}
-		file = root.openNextFile();
 	}
 	return folderContents;
 }
 
+/// @brief Lists the files in a directory with their size and modification time, a page at a time.
+/// Directories are cached after they are first read, so listing them again doesn't touch the file system
+/// @param dirname The directory path to list
+/// @param levels How many levels to recurse into the directory for listing
+/// @param entries Receives the files on the requested page
+/// @param offset The number of matching files to skip
+/// @param limit The maximum number of files to return
+/// @param glob Only list files with names matching this pattern ('*' matches any characters, '?' matches one)
+/// @return The total number of matching files
+size_t Storage::listEntries(String dirname, uint8_t levels, std::vector<entry>& entries, size_t offset, size_t limit, String glob) {
+	Serial.println("Listing directory: " + dirname);
+	size_t matched = 0;
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	collectEntries(dirname, levels, entries, offset, limit, glob, matched);
+	xSemaphoreGiveRecursive(write_lock);
+	return matched;
+}
+
+/// @brief Updates the cached information about a file or directory that was changed without using this class
+/// @param path The path of the file or directory
+void Storage::refreshEntry(String path) {
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	if (directories.count(parentDir(path)) > 0) {
+		File file = mountFor(path).system->open(path);
+		if (!file) {
+			uncacheEntry(path);
+		} else {
+			cacheEntry(path, { .directory = file.isDirectory(), .size = file.size() + stagedSize(path), .modified = file.getLastWrite() });
+			file.close();
+			// Directories may have been created along the way
+			String dir = parentDir(path);
+			while (dir != "/" && directories.count(parentDir(dir)) > 0 && !cachedInfo(dir)) {
+				cacheEntry(dir, { .directory = true, .size = 0, .modified = time(nullptr) });
+				dir = parentDir(dir);
+			}
+		}
+	}
+	xSemaphoreGiveRecursive(write_lock);
+}
+
 /// @brief Checks if a file or directory exists on the storage
 /// @param path The path of the file or directory
 /// @return True if it exists
 bool Storage::fileExists(String path) {
 	Serial.println("Checking for file: " + path);
-	return storageSystem->exists(path);
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	bool exists;
+	if (path == "/" || directories.count(parentDir(path)) == 0) {
+		exists = stagedSize(path) > 0 || mountFor(path).system->exists(path);
+	} else {
+		exists = cachedInfo(path) != nullptr;
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return exists;
 }
 
 /// @brief Creates a directory on the storage
@@ -187,7 +228,17 @@ bool Storage::fileExists(String path) {
 /// @return True on success
 bool Storage::createDir(String path) {
 	Serial.println("Creating Dir: " + path);
-	return storageSystem->mkdir(path);;
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	// Some file systems report success for a directory that's already there, which keeps its contents
+	bool existed = mountFor(path).system->exists(path);
+	bool success = mountFor(path).system->mkdir(path);
+	if (success && !existed) {
+		cacheEntry(path, { .directory = true, .size = 0, .modified = time(nullptr) });
+		// A new directory is empty, so it can be cached straight away
+		storeDir(normalizePath(path), {});
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
 }
 
 /// @brief Removes a directory from the storage
@@ -195,7 +246,16 @@ bool Storage::createDir(String path) {
 /// @return True on success
 bool Storage::removeDir(String path) {
 	Serial.println("Removing Dir:" + path);
-	return storageSystem->rmdir(path);
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	writeStagedUnder(path);
+	mount& m = mountFor(path);
+	m.free_space = -1;
+	bool success = m.system->rmdir(path);
+	if (success) {
+		uncacheEntry(path);
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
 }
 
 /// @brief Reads the contents of a file from the storage
@@ -203,7 +263,7 @@ bool Storage::removeDir(String path) {
 /// @return A String of the file contents, empty string on failure
 String Storage::readFile(String path) {
 	Serial.println("Reading file: " + path);
-	File file = storageSystem->open(path);
+	File file = getFileSystem(path)->open(path);
 	if (!file) {
 		Serial.println("Failed to open file for reading");
 		return "";
@@ -216,41 +276,112 @@ String Storage::readFile(String path) {
 	return output;
 }
 
-/// @brief Writes data to a file, creates or overwrites a file if necessary
+/// @brief Writes data to a file, creates or overwrites a file if necessary. The contents are written to a temporary file
+/// that replaces the original once complete, so an interrupted write leaves either the old or the new contents
 /// @param path The path of the file to write
 /// @param content The content of the file to write
 /// @return True on success
 bool Storage::writeFile(String path, String content) {
+	return writeFile(path, (const uint8_t*)content.c_str(), content.length());
+}
+
+/// @brief Writes binary data to a file, creates or overwrites a file if necessary. Written the same way as writeFile(String, String)
+/// @param path The path of the file to write
+/// @param data The data to write
+/// @param length The length of the data in bytes
+/// @return True on success
+bool Storage::writeFile(String path, const uint8_t* data, size_t length) {
 	Serial.println("Writing file: " + path);
-	File file = storageSystem->open(path, FILE_WRITE);
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	// The file is being replaced, so any appends waiting don't matter
+	discardStaged(path);
+	mount& m = mountFor(path);
+	File file = m.system->open(path + ".tmp", FILE_WRITE);
+	bool success = false;
 	if (!file) {
 		Serial.println("Failed to open file for writing");
-		return false;
+	} else {
+		success = file.write(data, length) == length;
+		file.flush();
+		file.close();
+		// Record the write as committed once the new contents are safely stored
+		success = success && journal(path, "W " + path) && replaceFile(path) && clearJournal(path);
+		if (success) {
+			cacheEntry(path, { .directory = false, .size = length, .modified = time(nullptr) });
+		}
 	}
-	return file.print(content) > 0;
+	// The old contents are freed too, so count again on next use
+	m.free_space = -1;
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
 }
 
-/// @brief Appends data to a file
+/// @brief Appends data to a file. On SD cards appends are staged in RAM and written in chunks by flush(), so up to a few seconds of appends
+/// can be lost on power loss. Appends to LittleFS are written immediately
 /// @param path The path of the file to append
 /// @param content The content to append
 /// @return True on success
 bool Storage::appendToFile(String path, String content) {
 	Serial.println("Appending to file: " + path);
-	File file = storageSystem->open(path, FILE_APPEND);
-	if (!file) {
-		Serial.println("Failed to open file for appending");
+	if (content.isEmpty()) {
 		return false;
 	}
-	return file.print(content) > 0;
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	mount& m = mountFor(path);
+	bool success = true;
+	if (m.media == Storage::Media::LittleFS) {
+		// LittleFS is copy-on-write, so an append only becomes visible when it completes
+		File file = m.system->open(path, FILE_APPEND);
+		if (!file) {
+			Serial.println("Failed to open file for appending");
+			success = false;
+		} else {
+			success = file.print(content) == content.length();
+			file.flush();
+			cacheEntry(path, { .directory = false, .size = file.size(), .modified = time(nullptr) });
+			file.close();
+		}
+	} else {
+		size_t size = fileSize(path) + content.length();
+		staged_append& s = staged[path];
+		if (s.data.isEmpty()) {
+			s.since = millis();
+		}
+		s.data += content;
+		staged_bytes += content.length();
+		cacheEntry(path, { .directory = false, .size = size, .modified = time(nullptr) });
+		if (s.data.length() >= stage_chunk || staged_bytes >= max_staged) {
+			success = writeStaged(path);
+		}
+	}
+	if (success && m.free_space != -1) {
+		m.free_space = std::max(m.free_space - (int64_t)content.length(), (int64_t)0);
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
 }
 
-/// @brief Renames/moves a file on the storage
+/// @brief Renames/moves a file on the storage. Both paths must be stored on the same medium
 /// @param path1 The original path/name of the file
 /// @param path2 The new path/name of the file
 /// @return True on success
 bool Storage::renameFile(String path1, String path2) {
 	Serial.println("Renaming file" + path1 + " to " + path2);
-	return storageSystem->rename(path1, path2);
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	bool success = false;
+	mount& m = mountFor(path1);
+	if (&m != &mountFor(path2)) {
+		Serial.println("Can't rename between storage media");
+	} else {
+		writeStagedUnder(path1);
+		success = m.system->rename(path1, path2);
+		if (success) {
+			uncacheEntry(path1);
+			refreshEntry(path2);
+		}
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
 }
 
 /// @brief Deletes a file from the storage
@@ -258,23 +389,555 @@ bool Storage::renameFile(String path1, String path2) {
 /// @return True on success
 bool Storage::deleteFile(String path) {
 	Serial.println("Deleting file: " + path);
-	return storageSystem->remove(path);
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	size_t size = fileSize(path);
+	discardStaged(path);
+	mount& m = mountFor(path);
+	bool success = m.system->remove(path);
+	if (success) {
+		uncacheEntry(path);
+		if (m.free_space != -1) {
+			m.free_space += size;
+		}
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
 }
 
-/// @brief Get free space on filesystem
+/// @brief Gets the size of a file on the storage, including any appends waiting to be written
+/// @param path The path of the file
+/// @return The size of the file in bytes, 0 if it doesn't exist
+size_t Storage::fileSize(String path) {
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	const file_info* info = cachedInfo(path);
+	size_t size = info != nullptr ? info->size : stagedSize(path);
+	if (info == nullptr) {
+		File file = mountFor(path).system->open(path);
+		if (file) {
+			size += file.size();
+			file.close();
+		}
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return size;
+}
+
+/// @brief Get free space on the medium storing a path. The file system is only queried when needed, after that the value is kept up to date from writes and deletes
+/// @param path The path to check the medium of
 /// @return The number of free bytes
-size_t Storage::freeSpace() {
-	switch (storageMedia)
+size_t Storage::freeSpace(String path) {
+	if (mountFor(path).free_space == -1) {
+		return refreshFreeSpace(path);
+	}
+	return mountFor(path).free_space;
+}
+
+/// @brief Queries the file system for the free space, correcting any drift in the tracked value (e.g. from block rounding)
+/// @param path The path to check the medium of
+/// @return The number of free bytes
+size_t Storage::refreshFreeSpace(String path) {
+	mount& m = mountFor(path);
+	switch (m.media)
 	{
 		case Storage::Media::LittleFS:
-			return LittleFS.totalBytes() - LittleFS.usedBytes();
+			m.free_space = LittleFS.totalBytes() - LittleFS.usedBytes();
 			break;
 		case Storage::Media::SD_SPI:
-			return SD.totalBytes() - SD.usedBytes();
+			m.free_space = SD.totalBytes() - SD.usedBytes();
 			break;
 		case Storage::Media::SD_MMC:
-			return SD_MMC.totalBytes() - SD_MMC.usedBytes();
+			m.free_space = SD_MMC.totalBytes() - SD_MMC.usedBytes();
+			break;
+		default:
+			m.free_space = 0;
+			break;
+	}
+	return m.free_space;
+}
+
+/// @brief Writes staged appends that are large or old enough. Should be called regularly, e.g. from the main loop
+/// @param all True to write all staged appends, e.g. before rebooting
+/// @return True on success
+bool Storage::flush(bool all) {
+	bool success = true;
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	std::vector<String> ready;
+	for (const auto& s : staged) {
+		if (all || millis() - s.second.since >= stage_delay) {
+			ready.push_back(s.first);
+		}
+	}
+	for (const auto& path : ready) {
+		success &= writeStaged(path);
+	}
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
+}
+
+/// @brief Adds a mounted medium, replacing any medium with the same prefix. Completes any writes to it that were interrupted
+/// @param prefix The paths to store on the medium
+/// @param media The storage media type
+/// @param system The file system of the medium
+/// @return True on success
+bool Storage::addMount(String prefix, Media media, FS* system) {
+	prefix = normalizePath(prefix);
+	xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+	for (auto m = mounts.begin(); m != mounts.end(); m++) {
+		if (m->prefix == prefix) {
+			mounts.erase(m);
 			break;
+		}
 	}
-	return 0;
-}
\ No newline at end of file
+	// Keep the longest prefixes first so the most specific medium is found first
+	auto position = mounts.begin();
+	while (position != mounts.end() && position->prefix.length() >= prefix.length()) {
+		position++;
+	}
+	position = mounts.insert(position, { .prefix = prefix, .media = media, .system = system, .free_space = -1 });
+	clearCache();
+	bool success = recover(*position);
+	xSemaphoreGiveRecursive(write_lock);
+	return success;
+}
+
+/// @brief Finds the medium storing a path
+/// @param path The path of a file or directory
+/// @return The mount of the medium
+Storage::mount& Storage::mountFor(String path) {
+	for (auto& m : mounts) {
+		if (m.prefix == "/" || path == m.prefix || path.startsWith(m.prefix + "/")) {
+			return m;
+		}
+	}
+	// Nothing is mounted yet, fall back to the internal storage
+	static mount internal = { .prefix = "/", .media = Storage::Media::LittleFS, .system = &LittleFS, .free_space = -1 };
+	return internal;
+}
+
+/// @brief Completes or rolls back any writes to a medium interrupted by a reset or power loss
+/// @param m The mount of the medium
+/// @return True on success
+bool Storage::recover(mount& m) {
+	if (!m.system->exists(journal_path)) {
+		return true;
+	}
+	Serial.println("Recovering interrupted writes");
+	File file = m.system->open(journal_path);
+	String records = file.readString();
+	file.close();
+	bool success = true;
+	int start = 0;
+	int end;
+	// Ignore anything after the last newline, that record was never completed so its write never started
+	while ((end = records.indexOf('\n', start)) != -1) {
+		String record = records.substring(start, end);
+		start = end + 1;
+		if (record.startsWith("W ")) {
+			String path = record.substring(2);
+			if (m.system->exists(path + ".tmp")) {
+				success &= replaceFile(path);
+			} else if (!m.system->exists(path) && m.system->exists(path + ".bak")) {
+				success &= m.system->rename(path + ".bak", path);
+			}
+			m.system->remove(path + ".bak");
+		} else if (record.startsWith("A ")) {
+			int separator = record.indexOf(' ', 2);
+			success &= truncateFile(record.substring(separator + 1), record.substring(2, separator).toInt());
+		}
+	}
+	return (!m.system->exists(journal_path) || m.system->remove(journal_path)) && success;
+}
+
+/// @brief Adds a record to the write journal of the medium storing a path
+/// @param path The path being written
+/// @param record The record to add
+/// @return True on success
+bool Storage::journal(String path, String record) {
+	File file = mountFor(path).system->open(journal_path, FILE_APPEND);
+	if (!file) {
+		Serial.println("Failed to open journal");
+		return false;
+	}
+	record += '\n';
+	bool success = file.print(record) == record.length();
+	file.close();
+	return success;
+}
+
+/// @brief Removes all records from the write journal of the medium storing a path
+/// @param path The path that was written
+/// @return True on success
+bool Storage::clearJournal(String path) {
+	FS* system = mountFor(path).system;
+	return !system->exists(journal_path) || system->remove(journal_path);
+}
+
+/// @brief Replaces a file with its temporary file (path + ".tmp")
+/// @param path The path of the file to replace
+/// @return True on success
+bool Storage::replaceFile(String path) {
+	String temp = path + ".tmp";
+	mount& m = mountFor(path);
+	// LittleFS replaces the destination of a rename atomically
+	if (m.media == Storage::Media::LittleFS || !m.system->exists(path)) {
+		return m.system->rename(temp, path);
+	}
+	// FAT can't rename over an existing file, so keep a backup until the new file is in place
+	String backup = path + ".bak";
+	m.system->remove(backup);
+	return m.system->rename(path, backup) && m.system->rename(temp, path) && m.system->remove(backup);
+}
+
+/// @brief Shortens a file by copying the start of it to a temporary file that replaces it
+/// @param path The path of the file
+/// @param size The size to shorten the file to
+/// @return True on success
+bool Storage::truncateFile(String path, size_t size) {
+	FS* system = mountFor(path).system;
+	File file = system->open(path);
+	if (!file) {
+		return false;
+	}
+	if (file.size() <= size) {
+		file.close();
+		return true;
+	}
+	File temp = system->open(path + ".tmp", FILE_WRITE);
+	uint8_t buffer[512];
+	size_t remaining = size;
+	bool success = (bool)temp;
+	while (success && remaining > 0) {
+		size_t length = file.read(buffer, std::min(sizeof(buffer), remaining));
+		success = length > 0 && temp.write(buffer, length) == length;
+		remaining -= length;
+	}
+	file.close();
+	temp.close();
+	return success && replaceFile(path);
+}
+
+/// @brief Writes the staged appends to a file in one go. The original size is journaled first, so an interrupted append can be undone
+/// @param path The path of the file
+/// @return True on success
+bool Storage::writeStaged(String path) {
+	auto s = staged.find(path);
+	if (s == staged.end()) {
+		return true;
+	}
+	File file = mountFor(path).system->open(path, FILE_APPEND);
+	bool success = false;
+	if (!file) {
+		Serial.println("Failed to open file for appending");
+	} else {
+		if (journal(path, "A " + String(file.size()) + " " + path)) {
+			success = file.write((const uint8_t*)s->second.data.c_str(), s->second.data.length()) == s->second.data.length();
+			file.flush();
+			clearJournal(path);
+		}
+		file.close();
+	}
+	// Drop the appends even on failure, so a bad card can't use up all the RAM
+	staged_bytes -= s->second.data.length();
+	staged.erase(s);
+	refreshEntry(path);
+	return success;
+}
+
+/// @brief Writes the staged appends to a file, or to all files in a directory
+/// @param path The path of the file or directory
+/// @return True on success
+bool Storage::writeStagedUnder(String path) {
+	path = normalizePath(path);
+	std::vector<String> ready;
+	for (const auto& s : staged) {
+		if (s.first == path || path == "/" || s.first.startsWith(path + "/")) {
+			ready.push_back(s.first);
+		}
+	}
+	bool success = true;
+	for (const auto& p : ready) {
+		success &= writeStaged(p);
+	}
+	return success;
+}
+
+/// @brief Drops any staged appends to a file
+/// @param path The path of the file
+void Storage::discardStaged(String path) {
+	auto s = staged.find(path);
+	if (s != staged.end()) {
+		staged_bytes -= s->second.data.length();
+		staged.erase(s);
+	}
+}
+
+/// @brief Gets the number of bytes of staged appends to a file
+/// @param path The path of the file
+/// @return The number of bytes waiting to be written
+size_t Storage::stagedSize(String path) {
+	auto s = staged.find(path);
+	return s != staged.end() ? s->second.data.length() : 0;
+}
+
+/// @brief Adds the files in a directory to a page of a listing, recursing into subdirectories
+/// @param dirname The directory path to list
+/// @param levels How many levels to recurse into the directory for listing
+/// @param entries Receives the files on the requested page
+/// @param offset The number of matching files to skip
+/// @param limit The maximum number of files to return
+/// @param glob Only list files with names matching this pattern
+/// @param matched The number of matching files found so far
+void Storage::collectEntries(String dirname, uint8_t levels, std::vector<entry>& entries, size_t offset, size_t limit, String glob, size_t& matched) {
+	std::vector<String> subdirs;
+	forEachEntry(dirname, [&](const String& name, const file_info& info) {
+		if (info.directory) {
+			if (levels) {
+				subdirs.push_back(joinPath(dirname, name));
+			}
+		} else if (matchGlob(glob.c_str(), name.c_str())) {
+			if (matched >= offset && entries.size() < limit) {
+				entries.push_back({ .path = joinPath(dirname, name), .directory = false, .size = info.size, .modified = info.modified });
+			}
+			matched++;
+		}
+	});
+	for (const auto& d : subdirs) {
+		collectEntries(d, levels - 1, entries, offset, limit, glob, matched);
+	}
+}
+
+/// @brief Calls a function for each file and directory in a directory, reading it from the cache if possible
+/// @param dirname The directory path
+/// @param visit The function to call with the name and information of each entry
+void Storage::forEachEntry(String dirname, std::function<void(const String&, const file_info&)> visit) {
+	dirname = normalizePath(dirname);
+	std::map<String, file_info>* cached = cachedDir(dirname);
+	if (cached != nullptr) {
+		for (const auto& e : *cached) {
+			visit(e.first, e.second);
+		}
+		return;
+	}
+	// Appends waiting to be written would be missed when reading the directory
+	writeStagedUnder(dirname);
+	File root = mountFor(dirname).system->open(dirname);
+	if (!root || !root.isDirectory()) {
+		Serial.println("Failed to open directory");
+		return;
+	}
+	// The directory is only read once, and is cached along the way unless it turns out to be too large
+	bool cache = uncacheable.count(dirname) == 0;
+	std::map<String, file_info> contents = mountPoints(dirname);
+	for (const auto& m : contents) {
+		visit(m.first, m.second);
+	}
+	File file = root.openNextFile();
+	while (file) {
+		file_info info = { .directory = file.isDirectory(), .size = file.size(), .modified = file.getLastWrite() };
+		visit(file.name(), info);
+		if (cache) {
+			if (contents.size() >= max_dir_entries) {
+				// Remember the directory is too large so its contents aren't collected again
+				uncacheable.insert(dirname);
+				contents.clear();
+				cache = false;
+			} else {
+				contents[file.name()] = info;
+			}
+		}
+		file = root.openNextFile();
+	}
+	if (cache) {
+		storeDir(dirname, std::move(contents));
+	}
+}
+
+/// @brief Gets the cached contents of a directory, marking it as recently used
+/// @param dirname The normalized directory path
+/// @return A pointer to the contents by name, or nullptr if the directory isn't cached
+std::map<String, Storage::file_info>* Storage::cachedDir(String dirname) {
+	auto cached = directories.find(dirname);
+	if (cached == directories.end()) {
+		return nullptr;
+	}
+	recent_dirs.remove(dirname);
+	recent_dirs.push_back(dirname);
+	return &cached->second;
+}
+
+/// @brief Adds the contents of a directory to the cache, dropping the least recently used directories to make room
+/// @param dirname The normalized directory path
+/// @param contents The contents by name
+void Storage::storeDir(String dirname, std::map<String, file_info> contents) {
+	auto existing = directories.find(dirname);
+	if (existing != directories.end()) {
+		dropDir(existing);
+	}
+	makeRoom(contents.size(), dirname);
+	cached_entries += contents.size();
+	directories[dirname] = std::move(contents);
+	recent_dirs.remove(dirname);
+	recent_dirs.push_back(dirname);
+}
+
+/// @brief Removes a directory from the cache
+/// @param dir The directory in the cache
+/// @return The next directory in the cache
+std::map<String, std::map<String, Storage::file_info>>::iterator Storage::dropDir(std::map<String, std::map<String, file_info>>::iterator dir) {
+	cached_entries -= dir->second.size();
+	recent_dirs.remove(dir->first);
+	return directories.erase(dir);
+}
+
+/// @brief Drops the least recently used directories until more entries fit in the cache
+/// @param needed The number of entries to make room for
+/// @param keep The normalized path of a directory not to drop
+void Storage::makeRoom(size_t needed, String keep) {
+	auto oldest = recent_dirs.begin();
+	while (cached_entries + needed > max_cached_entries && oldest != recent_dirs.end()) {
+		String dirname = *oldest;
+		oldest++;
+		if (dirname != keep) {
+			dropDir(directories.find(dirname));
+		}
+	}
+}
+
+/// @brief Gets the media mounted directly in a directory, which are stored elsewhere so don't show up when reading it
+/// @param dirname The normalized directory path
+/// @return The information about each mounted directory, by name
+std::map<String, Storage::file_info> Storage::mountPoints(String dirname) {
+	std::map<String, file_info> points;
+	for (const auto& m : mounts) {
+		if (m.prefix != "/" && parentDir(m.prefix) == dirname && m.system->exists(m.prefix)) {
+			points[m.prefix.substring(m.prefix.lastIndexOf('/') + 1)] = { .directory = true, .size = 0, .modified = 0 };
+		}
+	}
+	return points;
+}
+
+/// @brief Gets the cached information about a file or directory
+/// @param path The path of the file or directory
+/// @return A pointer to the information, or nullptr if it isn't cached
+const Storage::file_info* Storage::cachedInfo(String path) {
+	path = normalizePath(path);
+	auto dir = directories.find(parentDir(path));
+	if (dir == directories.end()) {
+		return nullptr;
+	}
+	auto info = dir->second.find(path.substring(path.lastIndexOf('/') + 1));
+	return info != dir->second.end() ? &info->second : nullptr;
+}
+
+/// @brief Updates the cached information about a file or directory, if its directory is cached
+/// @param path The path of the file or directory
+/// @param info The information to cache
+void Storage::cacheEntry(String path, file_info info) {
+	path = normalizePath(path);
+	auto dir = directories.find(parentDir(path));
+	if (dir == directories.end()) {
+		return;
+	}
+	String name = path.substring(path.lastIndexOf('/') + 1);
+	if (dir->second.count(name) == 0) {
+		if (dir->second.size() >= max_dir_entries) {
+			// Stop caching the directory once it has grown too large
+			uncacheable.insert(dir->first);
+			dropDir(dir);
+			return;
+		}
+		makeRoom(1, dir->first);
+		cached_entries++;
+	}
+	dir->second[name] = info;
+}
+
+/// @brief Removes a file or directory, and anything cached under it, from the cache
+/// @param path The path of the file or directory
+void Storage::uncacheEntry(String path) {
+	path = normalizePath(path);
+	auto dir = directories.find(parentDir(path));
+	if (dir != directories.end() && dir->second.erase(path.substring(path.lastIndexOf('/') + 1)) > 0) {
+		cached_entries--;
+	}
+	// A directory that was too large may fit in the cache once entries are removed
+	uncacheable.erase(parentDir(path));
+	for (auto d = directories.begin(); d != directories.end();) {
+		if (d->first == path || d->first.startsWith(path + "/")) {
+			d = dropDir(d);
+		} else {
+			d++;
+		}
+	}
+	for (auto u = uncacheable.begin(); u != uncacheable.end();) {
+		if (*u == path || u->startsWith(path + "/")) {
+			u = uncacheable.erase(u);
+		} else {
+			u++;
+		}
+	}
+}
+
+/// @brief Empties the directory cache
+void Storage::clearCache() {
+	directories.clear();
+	recent_dirs.clear();
+	uncacheable.clear();
+	cached_entries = 0;
+}
+
+/// @brief Removes any trailing slash from a path, except for the root directory
+/// @param path The path
+/// @return The normalized path
+String Storage::normalizePath(String path) {
+	if (path.length() > 1 && path.endsWith("/")) {
+		path.remove(path.length() - 1);
+	}
+	return path;
+}
+
+/// @brief Gets the directory containing a file or directory
+/// @param path The path of the file or directory
+/// @return The path of the containing directory
+String Storage::parentDir(String path) {
+	path = normalizePath(path);
+	int separator = path.lastIndexOf('/');
+	return separator <= 0 ? "/" : path.substring(0, separator);
+}
+
+/// @brief Joins a directory path and a name
+/// @param dirname The directory path
+/// @param name The name of the file or directory in it
+/// @return The full path
+String Storage::joinPath(String dirname, String name) {
+	dirname = normalizePath(dirname);
+	return dirname == "/" ? "/" + name : dirname + "/" + name;
+}
+
+/// @brief Checks if a name matches a glob pattern
+/// @param pattern The pattern, where '*' matches any characters and '?' matches one character
+/// @param name The name to check
+/// @return True if the name matches
+bool Storage::matchGlob(const char* pattern, const char* name) {
+	const char* star = nullptr;
+	const char* retry = nullptr;
+	while (*name) {
+		if (*pattern == '?' || *pattern == *name) {
+			pattern++;
+			name++;
+		} else if (*pattern == '*') {
+			// Try matching nothing first, and come back to match more if needed
+			star = pattern++;
+			retry = name;
+		} else if (star != nullptr) {
+			pattern = star + 1;
+			name = ++retry;
+		} else {
+			return false;
+		}
+	}
+	while (*pattern == '*') {
+		pattern++;
+	}
+	return *pattern == '\0';
+}
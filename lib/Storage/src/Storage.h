@@ -2,6 +2,10 @@
  * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
  * 
  * Adapted from: https://docs.espressif.com/projects/arduino-esp32/en/latest/api/sdmmc.html
+ *
+ * Several media can be mounted at once, each storing the paths under a prefix, e.g. configs and the web UI on the internal
+ * LittleFS and data logs under "/data" on an SD card. Paths are the same on every medium, only where they are stored changes.
+ * Appends to SD cards are staged in RAM and written in large chunks, since SD cards write whole blocks at a time.
  * 
  * Contributors: Sam Groveman
  */
@@ -13,6 +17,10 @@
 #include <SPI.h>
 #include <SD.h>
 #include <vector>
+#include <map>
+#include <list>
+#include <set>
+#include <functional>
 
 /// @brief Provides standardized access to various storage media
 class Storage {
@@ -24,28 +32,150 @@ class Storage {
 			SD_MMC,
 			LittleFS
 		};
+
+		/// @brief Describes a file or directory
+		typedef struct entry {
+			/// @brief The full path
+			String path;
+
+			/// @brief True if this is a directory
+			bool directory;
+
+			/// @brief The size in bytes
+			size_t size;
+
+			/// @brief The time it was last modified, in seconds since the epoch
+			time_t modified;
+		} entry;
 		
-		static bool begin();
-		static bool begin(int mi, int mo, int sck, int cs);
-		static bool begin(int clk, int cmd, int d0, int d1, int d2, int d3);
+		static bool begin(String prefix = "/");
+		static bool begin(int mi, int mo, int sck, int cs, String prefix = "/");
+		static bool begin(int clk, int cmd, int d0, int d1, int d2, int d3, String prefix = "/");
 		static FS* getFileSystem();
+		static FS* getFileSystem(String path);
 		static Storage::Media getMediaType();
+		static Storage::Media getMediaType(String path);
 		static std::vector<String> listFiles(String dirname, uint8_t levels);
 		static std::vector<String> listDirs(String dirname, uint8_t levels);
+		static size_t listEntries(String dirname, uint8_t levels, std::vector<entry>& entries, size_t offset = 0, size_t limit = SIZE_MAX, String glob = "*");
+		static void refreshEntry(String path);
 		static bool fileExists(String path);
 		static bool createDir(String path);
 		static bool removeDir(String path);
 		static String readFile(String path);
 		static bool writeFile(String path, String content);
+		static bool writeFile(String path, const uint8_t* data, size_t length);
 		static bool appendToFile(String path, String content);
 		static bool renameFile(String path1, String path2);
 		static bool deleteFile(String path);
-		static size_t freeSpace();
+		static size_t fileSize(String path);
+		static size_t freeSpace(String path = "/");
+		static size_t refreshFreeSpace(String path = "/");
+		static bool flush(bool all = false);
+		static bool matchGlob(const char* pattern, const char* name);
 		
 	private:
-		/// @brief The storage media type being used
-		static Media storageMedia;
+		/// @brief Describes a mounted storage medium
+		typedef struct mount {
+			/// @brief Paths starting with this prefix are stored on this medium, "/" stores any paths not stored elsewhere
+			String prefix;
+
+			/// @brief The storage media type
+			Media media;
+
+			/// @brief The file system of the medium
+			FS* system;
+
+			/// @brief Free bytes on the medium, -1 if it needs to be queried from the file system
+			int64_t free_space;
+		} mount;
+
+		/// @brief Appends waiting to be written to a file
+		typedef struct staged_append {
+			/// @brief The data waiting to be appended
+			String data;
+
+			/// @brief The time in ms since boot of the first append waiting
+			ulong since;
+		} staged_append;
+
+		/// @brief The mounted media, longest prefix first
+		static std::vector<mount> mounts;
+
+		/// @brief Appends waiting to be written, by path
+		static std::map<String, staged_append> staged;
+
+		/// @brief Number of bytes of appends waiting to be written
+		static size_t staged_bytes;
+
+		/// @brief Appends to a file are written once this many bytes are waiting
+		static const size_t stage_chunk = 8192;
+
+		/// @brief Appends are written once this many bytes are waiting across all files
+		static const size_t max_staged = 16384;
+
+		/// @brief Appends are written after waiting this many ms
+		static const ulong stage_delay = 5000;
+
+		/// @brief Path of the journal of writes in progress, one on each medium
+		static constexpr const char* journal_path = "/storage.journal";
+
+		/// @brief Serializes writes so journal records don't interleave, and guards the directory cache and staged appends
+		static SemaphoreHandle_t write_lock;
+
+		/// @brief Cached information about a file or directory
+		typedef struct file_info {
+			/// @brief True if this is a directory
+			bool directory;
+
+			/// @brief The size in bytes
+			size_t size;
+
+			/// @brief The time it was last modified, in seconds since the epoch
+			time_t modified;
+		} file_info;
+
+		/// @brief Contents of the directories read so far, by directory path then name
+		static std::map<String, std::map<String, file_info>> directories;
+
+		/// @brief Paths of the cached directories, least recently used first
+		static std::list<String> recent_dirs;
+
+		/// @brief Directories with too many entries to cache, which are read from the file system each time
+		static std::set<String> uncacheable;
+
+		/// @brief Number of files and directories in the cache
+		static size_t cached_entries;
+
+		/// @brief Maximum number of files and directories to cache, the least recently used directories are dropped to stay under it
+		static const size_t max_cached_entries = 1024;
+
+		/// @brief Maximum number of files and directories in a directory for it to be cached
+		static const size_t max_dir_entries = 256;
 
-		/// @brief The file system being used
-		static FS* storageSystem;	
+		static bool addMount(String prefix, Media media, FS* system);
+		static mount& mountFor(String path);
+		static bool recover(mount& m);
+		static bool journal(String path, String record);
+		static bool clearJournal(String path);
+		static bool writeStaged(String path);
+		static bool writeStagedUnder(String path);
+		static void discardStaged(String path);
+		static size_t stagedSize(String path);
+		static bool replaceFile(String path);
+		static bool truncateFile(String path, size_t size);
+		static void collectEntries(String dirname, uint8_t levels, std::vector<entry>& entries, size_t offset, size_t limit, String glob, size_t& matched);
+		static void forEachEntry(String dirname, std::function<void(const String&, const file_info&)> visit);
+		static std::map<String, file_info>* cachedDir(String dirname);
+		static void storeDir(String dirname, std::map<String, file_info> contents);
+		static std::map<String, std::map<String, file_info>>::iterator dropDir(std::map<String, std::map<String, file_info>>::iterator dir);
+		static void makeRoom(size_t needed, String keep);
+		static std::map<String, file_info> mountPoints(String dirname);
+		static const file_info* cachedInfo(String path);
+		static void cacheEntry(String path, file_info info);
+		static void uncacheEntry(String path);
+		static void clearCache();
+		static String normalizePath(String path);
+		static String parentDir(String path);
+		static String joinPath(String dirname, String name);
 };
\ No newline at end of file
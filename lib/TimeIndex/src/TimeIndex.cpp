@@ -0,0 +1,195 @@
+#include "TimeIndex.h"
+
+/// @brief Gets the path of the index of a data file
+/// @param dataPath The path of the data file
+/// @return The path of the index file
+String TimeIndex::indexPath(String dataPath) {
+	return dataPath + ".idx";
+}
+
+/// @brief Starts a new, empty index for a data file, replacing any existing index
+/// @param dataPath The path of the data file
+/// @param generation The generation of the data file
+/// @param started The time the data file was started, in local time as seconds since the epoch
+/// @return True on success
+bool TimeIndex::createIndex(String dataPath, uint32_t generation, uint32_t started) {
+	File file = Storage::getFileSystem(indexPath(dataPath))->open(indexPath(dataPath), FILE_WRITE);
+	if (!file) {
+		Serial.println("Failed to open index for writing");
+		return false;
+	}
+	header h = { .magic = index_magic, .generation = generation, .started = started };
+	bool success = file.write((uint8_t*)&h, sizeof(header)) == sizeof(header);
+	file.close();
+	Storage::refreshEntry(indexPath(dataPath));
+	return success;
+}
+
+/// @brief Gets the generation of a data file and the time it was started from its index
+/// @param dataPath The path of the data file
+/// @param generation Set to the generation of the data file
+/// @param started Set to the time the data file was started, in local time as seconds since the epoch
+/// @return True on success, false if it has no index or the index was written by an older version
+bool TimeIndex::getHeader(String dataPath, uint32_t& generation, uint32_t& started) {
+	File file = Storage::getFileSystem(indexPath(dataPath))->open(indexPath(dataPath));
+	if (!file) {
+		return false;
+	}
+	header h;
+	bool success = file.read((uint8_t*)&h, sizeof(header)) == sizeof(header) && h.magic == index_magic;
+	file.close();
+	if (success) {
+		generation = h.generation;
+		started = h.started;
+	}
+	return success;
+}
+
+/// @brief Gets the generation of a data file from its index
+/// @param dataPath The path of the data file
+/// @return The generation of the data file, 0 if it has no index
+uint32_t TimeIndex::getGeneration(String dataPath) {
+	uint32_t generation;
+	uint32_t started;
+	return getHeader(dataPath, generation, started) ? generation : 0;
+}
+
+/// @brief Creates a cursor for a position in a data file. Cursors only ever increase, even when the data file is recreated
+/// @param generation The generation of the data file
+/// @param offset The byte offset in the data file
+/// @return The cursor
+uint64_t TimeIndex::cursor(uint32_t generation, uint32_t offset) {
+	return ((uint64_t)generation << 32) | offset;
+}
+
+/// @brief Adds an entry to the index of a data file
+/// @param dataPath The path of the data file
+/// @param time The time the row was logged, in seconds since the epoch
+/// @param offset The byte offset of the row in the data file
+/// @return True on success
+bool TimeIndex::addEntry(String dataPath, uint32_t time, uint32_t offset) {
+	File file = Storage::getFileSystem(indexPath(dataPath))->open(indexPath(dataPath), FILE_APPEND);
+	if (!file) {
+		Serial.println("Failed to open index for appending");
+		return false;
+	}
+	entry e = { .time = time, .offset = offset };
+	bool success = file.write((uint8_t*)&e, sizeof(entry)) == sizeof(entry);
+	file.close();
+	Storage::refreshEntry(indexPath(dataPath));
+	return success;
+}
+
+/// @brief Gets the last entry of the index of a data file
+/// @param dataPath The path of the data file
+/// @param last Set to the last entry
+/// @return True if the index has any entries
+bool TimeIndex::lastEntry(String dataPath, entry& last) {
+	File file = Storage::getFileSystem(indexPath(dataPath))->open(indexPath(dataPath));
+	if (!file) {
+		return false;
+	}
+	size_t count = file.size() > sizeof(header) ? (file.size() - sizeof(header)) / sizeof(entry) : 0;
+	bool success = count > 0 && readEntry(file, count - 1, last);
+	file.close();
+	return success;
+}
+
+/// @brief Finds the part of a data file covering a time range. Since the index is sparse, the range found may include some rows either side of the times requested
+/// @param dataPath The path of the data file
+/// @param from The start of the time range, in seconds since the epoch
+/// @param to The end of the time range, in seconds since the epoch
+/// @return A tuple with the byte offset of the start of the range (0 for the start of the file) and the byte offset of the end of the range (SIZE_MAX for the end of the file)
+std::tuple<size_t, size_t> TimeIndex::findRange(String dataPath, uint32_t from, uint32_t to) {
+	size_t start = 0;
+	size_t end = SIZE_MAX;
+	File file = Storage::getFileSystem(indexPath(dataPath))->open(indexPath(dataPath));
+	if (!file) {
+		return { start, end };
+	}
+	int count = file.size() > sizeof(header) ? (file.size() - sizeof(header)) / sizeof(entry) : 0;
+	entry e;
+	// Find the last entry before the start time, rows logged earlier in the same second as an entry come before it
+	int low = 0;
+	int high = count - 1;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		if (!readEntry(file, mid, e)) {
+			break;
+		}
+		if (e.time < from) {
+			start = e.offset;
+			low = mid + 1;
+		} else {
+			high = mid - 1;
+		}
+	}
+	// Find the first entry after the end time
+	low = 0;
+	high = count - 1;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		if (!readEntry(file, mid, e)) {
+			break;
+		}
+		if (e.time > to) {
+			end = e.offset;
+			high = mid - 1;
+		} else {
+			low = mid + 1;
+		}
+	}
+	file.close();
+	return { start, end };
+}
+
+/// @brief Deletes the index of a data file
+/// @param dataPath The path of the data file
+/// @return True on success or if there was no index
+bool TimeIndex::removeIndex(String dataPath) {
+	String path = indexPath(dataPath);
+	if (Storage::getFileSystem(path)->exists(path)) {
+		return Storage::deleteFile(path);
+	}
+	return true;
+}
+
+/// @brief Parses the time at the start of a data file row
+/// @param row The row to parse
+/// @param seconds Set to the time of the row, in local time as seconds since the epoch
+/// @return True on success
+bool TimeIndex::parseTime(const char* row, uint32_t& seconds) {
+	struct tm time = {};
+	if (sscanf(row, "%d-%d-%d %d:%d:%d", &time.tm_mon, &time.tm_mday, &time.tm_year, &time.tm_hour, &time.tm_min, &time.tm_sec) != 6) {
+		return false;
+	}
+	time.tm_mon -= 1;
+	time.tm_year -= 1900;
+	time.tm_isdst = -1;
+	seconds = mktime(&time);
+	return true;
+}
+
+/// @brief Formats a time the same way as the rows of a data file
+/// @param seconds The time in local time as seconds since the epoch, as returned by parseTime()
+/// @return The formatted time
+String TimeIndex::formatTime(uint32_t seconds) {
+	time_t t = seconds;
+	struct tm time;
+	localtime_r(&t, &time);
+	char buffer[20];
+	strftime(buffer, sizeof(buffer), "%m-%d-%Y %T", &time);
+	return String(buffer);
+}
+
+/// @brief Reads an entry from an index file
+/// @param file The open index file
+/// @param position The position of the entry in the index
+/// @param e Set to the entry read
+/// @return True on success
+bool TimeIndex::readEntry(File& file, size_t position, entry& e) {
+	if (!file.seek(sizeof(header) + position * sizeof(entry))) {
+		return false;
+	}
+	return file.read((uint8_t*)&e, sizeof(entry)) == sizeof(entry);
+}
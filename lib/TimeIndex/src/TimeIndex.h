@@ -0,0 +1,61 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* A time index is a binary file stored alongside a data file (<data file>.idx) holding fixed size entries that map a time
+* to the byte offset of the row logged at that time. Entries are only added every few kilobytes of data, so the index
+* stays small while still allowing a slice of the data file to be found without reading through it.
+*
+* The index starts with a header holding the generation of the data file, which is incremented each time the data file
+* is recreated, and the time the data file was started. Combined with a byte offset the generation gives a cursor that only
+* ever increases (see cursor()).
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <Storage.h>
+#include <tuple>
+
+/// @brief Maintains sparse time indexes of data files
+class TimeIndex {
+	public:
+		/// @brief Describes an index entry
+		typedef struct entry {
+			/// @brief The time the row was logged, in seconds since the epoch
+			uint32_t time;
+
+			/// @brief The byte offset of the row in the data file
+			uint32_t offset;
+		} entry;
+
+		static String indexPath(String dataPath);
+		static bool createIndex(String dataPath, uint32_t generation, uint32_t started);
+		static bool getHeader(String dataPath, uint32_t& generation, uint32_t& started);
+		static uint32_t getGeneration(String dataPath);
+		static uint64_t cursor(uint32_t generation, uint32_t offset);
+		static bool addEntry(String dataPath, uint32_t time, uint32_t offset);
+		static bool lastEntry(String dataPath, entry& last);
+		static std::tuple<size_t, size_t> findRange(String dataPath, uint32_t from, uint32_t to);
+		static bool removeIndex(String dataPath);
+		static bool parseTime(const char* row, uint32_t& seconds);
+		static String formatTime(uint32_t seconds);
+
+	private:
+		/// @brief Describes the header of an index file
+		typedef struct header {
+			/// @brief Identifies the file as a time index
+			uint32_t magic;
+
+			/// @brief The generation of the data file
+			uint32_t generation;
+
+			/// @brief The time the data file was started, in local time as seconds since the epoch
+			uint32_t started;
+		} header;
+
+		/// @brief Value of the magic number in the header ("TID2")
+		static const uint32_t index_magic = 0x32444954;
+
+		static bool readEntry(File& file, size_t position, entry& e);
+};
@@ -0,0 +1,417 @@
+#include "UploadStream.h"
+
+// Initialize static variables
+std::map<String, UploadStream::progress> UploadStream::uploads;
+SemaphoreHandle_t UploadStream::lock = xSemaphoreCreateMutex();
+
+/// @brief Starts an upload, storing its state in the request. Call from the upload handler when the index is 0
+/// @param request The request of the upload
+/// @param sink Where the uploaded data is written. For files, the file must be opened in the request's _tempFile
+/// @param id The ID to report the progress of the upload under
+/// @param inflate True if the upload is gzip compressed and should be inflated
+/// @param patch True if the upload is a delta to apply to the running firmware
+/// @return True on success
+bool UploadStream::begin(AsyncWebServerRequest* request, Sink sink, String id, bool inflate, bool patch) {
+	context* ctx = getContext(request);
+	if (ctx != nullptr) {
+		// Another file in the same request
+		release(ctx);
+	} else {
+		ctx = (context*)malloc(sizeof(context));
+		if (ctx == nullptr) {
+			Serial.println("Not enough memory to start upload");
+			return false;
+		}
+		request->_tempObject = ctx;
+		// Free the hash and inflater if the client goes away before the upload finishes
+		request->onDisconnect([request]() {
+			context* ctx = getContext(request);
+			if (ctx != nullptr) {
+				release(ctx);
+			}
+		});
+	}
+	memset(ctx, 0, sizeof(context));
+	ctx->sink = sink;
+	strlcpy(ctx->id, request->hasHeader("X-Upload-Id") ? request->header("X-Upload-Id").c_str() : id.c_str(), sizeof(ctx->id));
+	ctx->status = HTTP_CODE_CREATED;
+	ctx->message = "File uploaded";
+	mbedtls_sha256_init(&ctx->hash);
+	mbedtls_sha256_starts(&ctx->hash, 0);
+	ctx->active = true;
+	if (request->hasHeader("X-SHA256")) {
+		String expected = request->header("X-SHA256");
+		if (expected.length() != sizeof(ctx->expected_hash) * 2) {
+			fail(request, HTTP_CODE_BAD_REQUEST, "Invalid SHA-256 hash");
+			return false;
+		}
+		for (int i = 0; i < sizeof(ctx->expected_hash); i++) {
+			ctx->expected_hash[i] = strtoul(expected.substring(i * 2, i * 2 + 2).c_str(), nullptr, 16);
+		}
+		ctx->check_hash = true;
+	}
+	if (inflate) {
+		ctx->inflate = true;
+		ctx->gzip_stage = GzipStage::Fixed;
+		ctx->inflater = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+		ctx->window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+		if (ctx->inflater == nullptr || ctx->window == nullptr) {
+			fail(request, HTTP_CODE_SERVICE_UNAVAILABLE, "Not enough memory to inflate upload");
+			return false;
+		}
+		tinfl_init(ctx->inflater);
+	}
+	if (patch) {
+		ctx->patch = true;
+		DeltaPatch::begin(ctx->delta);
+	}
+	updateProgress(request, ctx, false);
+	return true;
+}
+
+/// @brief Adds a chunk of an upload
+/// @param request The request of the upload
+/// @param data The chunk
+/// @param len The length of the chunk in bytes
+/// @return True on success, false if the upload has failed
+bool UploadStream::write(AsyncWebServerRequest* request, uint8_t* data, size_t len) {
+	context* ctx = getContext(request);
+	if (ctx == nullptr || !ctx->active) {
+		return false;
+	}
+	if (len == 0) {
+		return true;
+	}
+	ctx->received += len;
+	mbedtls_sha256_update(&ctx->hash, data, len);
+	bool success = ctx->inflate ? inflate(request, ctx, data, len) : produce(request, ctx, data, len);
+	updateProgress(request, ctx, false);
+	return success;
+}
+
+/// @brief Finishes an upload, writing any buffered data and checking its hash. Call from the upload handler when final is true
+/// @param request The request of the upload
+/// @return True if the upload succeeded
+bool UploadStream::end(AsyncWebServerRequest* request) {
+	context* ctx = getContext(request);
+	if (ctx == nullptr || !ctx->active) {
+		return false;
+	}
+	if (ctx->buffered > 0 && writeSink(request, ctx, ctx->buffer, ctx->buffered)) {
+		ctx->buffered = 0;
+	}
+	if (ctx->active && ctx->inflate && !ctx->inflated) {
+		fail(request, HTTP_CODE_BAD_REQUEST, "Compressed upload is incomplete");
+	}
+	if (ctx->active && ctx->patch && !DeltaPatch::finished(ctx->delta)) {
+		fail(request, HTTP_CODE_BAD_REQUEST, "Firmware delta is incomplete");
+	}
+	if (ctx->active && ctx->check_hash) {
+		uint8_t hash[32];
+		mbedtls_sha256_finish(&ctx->hash, hash);
+		if (memcmp(hash, ctx->expected_hash, sizeof(hash)) != 0) {
+			fail(request, HTTP_CODE_BAD_REQUEST, "SHA-256 hash doesn't match");
+		}
+	}
+	bool success = ctx->active;
+	if (success) {
+		Serial.printf("Upload %s finished: %u bytes received, %u bytes written in %u writes\n", ctx->id, ctx->received, ctx->written, ctx->writes);
+		updateProgress(request, ctx, true);
+		release(ctx);
+	}
+	return success;
+}
+
+/// @brief Marks an upload as failed, ignoring the rest of it
+/// @param request The request of the upload
+/// @param status The HTTP status code to respond with
+/// @param message The description of the failure
+void UploadStream::fail(AsyncWebServerRequest* request, int status, const char* message) {
+	context* ctx = getContext(request);
+	if (ctx == nullptr) {
+		return;
+	}
+	Serial.printf("Upload %s failed: %s\n", ctx->id, message);
+	ctx->status = status;
+	ctx->message = message;
+	updateProgress(request, ctx, true);
+	release(ctx);
+}
+
+/// @brief Gets the HTTP status code of an upload
+/// @param request The request of the upload
+/// @return The status code to respond with
+int UploadStream::getStatus(AsyncWebServerRequest* request) {
+	context* ctx = getContext(request);
+	if (ctx == nullptr) {
+		// Either no file was sent, or there wasn't memory to start the upload
+		return request->contentLength() > 0 ? HTTP_CODE_SERVICE_UNAVAILABLE : HTTP_CODE_BAD_REQUEST;
+	}
+	return ctx->status;
+}
+
+/// @brief Gets the description of the result of an upload
+/// @param request The request of the upload
+/// @return The description of the result
+String UploadStream::getMessage(AsyncWebServerRequest* request) {
+	context* ctx = getContext(request);
+	if (ctx == nullptr) {
+		return "Upload failed";
+	}
+	return ctx->message;
+}
+
+/// @brief Gets the progress of recent uploads
+/// @param id The ID of the upload to get, empty for all uploads
+/// @return A JSON string with the progress of each upload under its ID
+String UploadStream::getProgress(String id) {
+	// Allocate the JSON document
+	JsonDocument doc;
+	// An empty document serializes as null, so start with an object
+	doc.to<JsonObject>();
+	xSemaphoreTake(lock, portMAX_DELAY);
+	for (const auto& u : uploads) {
+		if (!id.isEmpty() && u.first != id) {
+			continue;
+		}
+		JsonObject upload = doc[u.first].to<JsonObject>();
+		upload["received"] = u.second.received;
+		upload["total"] = u.second.total;
+		upload["written"] = u.second.written;
+		upload["writes"] = u.second.writes;
+		upload["finished"] = u.second.finished;
+		upload["status"] = u.second.status;
+	}
+	xSemaphoreGive(lock);
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Gets the state of an upload from its request
+/// @param request The request of the upload
+/// @return A pointer to the state, or nullptr if the upload hasn't started
+UploadStream::context* UploadStream::getContext(AsyncWebServerRequest* request) {
+	return (context*)request->_tempObject;
+}
+
+/// @brief Skips over the gzip header at the start of a compressed upload
+/// @param ctx The state of the upload
+/// @param data The chunk, moved past any header bytes read
+/// @param len The length of the chunk, reduced by any header bytes read
+/// @return True on success, false if the upload isn't gzip compressed
+bool UploadStream::readGzipHeader(context* ctx, const uint8_t*& data, size_t& len) {
+	while (len > 0 && ctx->gzip_stage != GzipStage::Data) {
+		switch (ctx->gzip_stage) {
+			case GzipStage::Fixed:
+				// ID1, ID2, compression method, flags, time, extra flags, OS
+				ctx->gzip_field[ctx->gzip_field_length++] = *data++;
+				len--;
+				if (ctx->gzip_field_length == 10) {
+					if (ctx->gzip_field[0] != 0x1F || ctx->gzip_field[1] != 0x8B || ctx->gzip_field[2] != 8) {
+						return false;
+					}
+					ctx->gzip_flags = ctx->gzip_field[3];
+					ctx->gzip_field_length = 0;
+					ctx->gzip_stage = GzipStage::ExtraLength;
+				}
+				break;
+			case GzipStage::ExtraLength:
+				if (!(ctx->gzip_flags & 0x04)) {
+					ctx->gzip_stage = GzipStage::Name;
+					break;
+				}
+				ctx->gzip_field[ctx->gzip_field_length++] = *data++;
+				len--;
+				if (ctx->gzip_field_length == 2) {
+					ctx->gzip_skip = ctx->gzip_field[0] | (ctx->gzip_field[1] << 8);
+					ctx->gzip_field_length = 0;
+					ctx->gzip_stage = GzipStage::Extra;
+				}
+				break;
+			case GzipStage::Extra:
+				{
+					size_t skip = std::min(ctx->gzip_skip, len);
+					data += skip;
+					len -= skip;
+					ctx->gzip_skip -= skip;
+					if (ctx->gzip_skip == 0) {
+						ctx->gzip_stage = GzipStage::Name;
+					}
+				}
+				break;
+			case GzipStage::Name:
+			case GzipStage::Comment:
+				{
+					// Both are zero terminated strings, present if their flag is set
+					uint8_t flag = ctx->gzip_stage == GzipStage::Name ? 0x08 : 0x10;
+					if (ctx->gzip_flags & flag) {
+						uint8_t c = *data++;
+						len--;
+						if (c != 0) {
+							break;
+						}
+					}
+					ctx->gzip_stage = ctx->gzip_stage == GzipStage::Name ? GzipStage::Comment : GzipStage::HeaderCRC;
+					ctx->gzip_skip = 2;
+				}
+				break;
+			case GzipStage::HeaderCRC:
+				if (ctx->gzip_flags & 0x02) {
+					data++;
+					len--;
+					ctx->gzip_skip--;
+				}
+				if (!(ctx->gzip_flags & 0x02) || ctx->gzip_skip == 0) {
+					ctx->gzip_stage = GzipStage::Data;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return true;
+}
+
+/// @brief Inflates a chunk of a compressed upload and passes on the output
+/// @param request The request of the upload
+/// @param ctx The state of the upload
+/// @param data The compressed chunk
+/// @param len The length of the chunk in bytes
+/// @return True on success
+bool UploadStream::inflate(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len) {
+	if (!readGzipHeader(ctx, data, len)) {
+		fail(request, HTTP_CODE_BAD_REQUEST, "Upload isn't gzip compressed");
+		return false;
+	}
+	// Anything after the compressed data is the gzip trailer
+	while (len > 0 && !ctx->inflated) {
+		size_t in_size = len;
+		size_t out_size = TINFL_LZ_DICT_SIZE - ctx->window_position;
+		tinfl_status status = tinfl_decompress(ctx->inflater, data, &in_size, ctx->window, ctx->window + ctx->window_position, &out_size, TINFL_FLAG_HAS_MORE_INPUT);
+		data += in_size;
+		len -= in_size;
+		if (out_size > 0 && !produce(request, ctx, ctx->window + ctx->window_position, out_size)) {
+			return false;
+		}
+		// The window wraps around, the inflater keeps track of where earlier output is
+		ctx->window_position = (ctx->window_position + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+		if (status == TINFL_STATUS_DONE) {
+			ctx->inflated = true;
+		} else if (status < TINFL_STATUS_DONE) {
+			fail(request, HTTP_CODE_BAD_REQUEST, "Compressed upload is corrupt");
+			return false;
+		} else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+			break;
+		}
+	}
+	return true;
+}
+
+/// @brief Applies uncompressed data to the running firmware if it's a delta, and buffers the result
+/// @param request The request of the upload
+/// @param ctx The state of the upload
+/// @param data The uncompressed data
+/// @param len The length of the data in bytes
+/// @return True on success
+bool UploadStream::produce(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len) {
+	if (!ctx->patch) {
+		return buffer(request, ctx, data, len);
+	}
+	bool success = DeltaPatch::apply(ctx->delta, data, len, [request, ctx](const uint8_t* output, size_t length) {
+		return buffer(request, ctx, output, length);
+	});
+	// Write failures have already been reported
+	if (!success && ctx->active) {
+		fail(request, HTTP_CODE_BAD_REQUEST, ctx->delta.error);
+	}
+	return success;
+}
+
+/// @brief Collects data into whole pages before writing it. Whole pages at the start of the data are written without copying
+/// @param request The request of the upload
+/// @param ctx The state of the upload
+/// @param data The data to write
+/// @param len The length of the data in bytes
+/// @return True on success
+bool UploadStream::buffer(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len) {
+	const size_t page = sizeof(ctx->buffer);
+	if (ctx->buffered == 0 && len >= page) {
+		size_t direct = len - len % page;
+		if (!writeSink(request, ctx, data, direct)) {
+			return false;
+		}
+		data += direct;
+		len -= direct;
+	}
+	while (len > 0) {
+		size_t length = std::min(len, page - ctx->buffered);
+		memcpy(ctx->buffer + ctx->buffered, data, length);
+		ctx->buffered += length;
+		data += length;
+		len -= length;
+		if (ctx->buffered == page) {
+			if (!writeSink(request, ctx, ctx->buffer, page)) {
+				return false;
+			}
+			ctx->buffered = 0;
+		}
+	}
+	return true;
+}
+
+/// @brief Writes data to where the upload is going
+/// @param request The request of the upload
+/// @param ctx The state of the upload
+/// @param data The data to write
+/// @param len The length of the data in bytes
+/// @return True on success
+bool UploadStream::writeSink(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len) {
+	size_t written = 0;
+	if (ctx->sink == Sink::File) {
+		written = request->_tempFile.write(data, len);
+	} else {
+		written = Update.write((uint8_t*)data, len);
+	}
+	ctx->writes++;
+	ctx->written += written;
+	if (written != len) {
+		fail(request, HTTP_CODE_INSUFFICIENT_STORAGE, "Could not write upload");
+		return false;
+	}
+	return true;
+}
+
+/// @brief Frees the hash and inflater of an upload, after which the rest of it is ignored
+/// @param ctx The state of the upload
+void UploadStream::release(context* ctx) {
+	if (ctx->active) {
+		mbedtls_sha256_free(&ctx->hash);
+		ctx->active = false;
+	}
+	free(ctx->inflater);
+	free(ctx->window);
+	ctx->inflater = nullptr;
+	ctx->window = nullptr;
+}
+
+/// @brief Records the progress of an upload
+/// @param request The request of the upload
+/// @param ctx The state of the upload
+/// @param finished True if the upload has finished
+void UploadStream::updateProgress(AsyncWebServerRequest* request, context* ctx, bool finished) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (uploads.count(ctx->id) == 0 && uploads.size() >= max_tracked) {
+		// Forget a finished upload to make room
+		for (auto u = uploads.begin(); u != uploads.end(); u++) {
+			if (u->second.finished) {
+				uploads.erase(u);
+				break;
+			}
+		}
+	}
+	uploads[ctx->id] = { .received = ctx->received, .total = request->contentLength(), .written = ctx->written, .writes = ctx->writes, .finished = finished, .status = ctx->status };
+	xSemaphoreGive(lock);
+}
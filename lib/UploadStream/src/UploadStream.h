@@ -0,0 +1,173 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* ESPAsyncWebServer: https://github.com/esphome/ESPAsyncWebServer
+* ArduinoJSON: https://arduinojson.org/
+*
+* Each upload keeps its state in its own request (in _tempObject), so uploads running at the same time don't interfere.
+* Incoming chunks are collected into whole flash pages before they are written, and chunks of a page or more are written
+* straight from the network buffer. Uploads can optionally be gzip compressed and inflated as they arrive ("inflate"
+* parameter), and checked against a SHA-256 hash of the uploaded bytes ("X-SHA256" header). Firmware can also be uploaded
+* as a delta against the running firmware (see DeltaPatch), which is applied after inflating.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <esp32/rom/miniz.h>
+#include <DeltaPatch.h>
+#include <map>
+
+/// @brief Streams uploads to a file or the firmware, inflating and checking them on the way
+class UploadStream {
+	public:
+		/// @brief Where uploaded data is written
+		enum class Sink {
+			File,
+			Firmware
+		};
+
+		static bool begin(AsyncWebServerRequest* request, Sink sink, String id, bool inflate, bool patch = false);
+		static bool write(AsyncWebServerRequest* request, uint8_t* data, size_t len);
+		static bool end(AsyncWebServerRequest* request);
+		static void fail(AsyncWebServerRequest* request, int status, const char* message);
+		static int getStatus(AsyncWebServerRequest* request);
+		static String getMessage(AsyncWebServerRequest* request);
+		static String getProgress(String id = "");
+
+	private:
+		/// @brief Stages of reading a gzip header
+		enum class GzipStage {
+			Fixed,
+			ExtraLength,
+			Extra,
+			Name,
+			Comment,
+			HeaderCRC,
+			Data
+		};
+
+		/// @brief State of an upload. Freed with free() when the request is deleted, so it must be plain data
+		typedef struct context {
+			/// @brief Data waiting to be written, kept first so it stays aligned
+			uint8_t buffer[4096];
+
+			/// @brief Number of bytes in the buffer
+			size_t buffered;
+
+			/// @brief Where the data is written
+			Sink sink;
+
+			/// @brief The ID the progress of the upload is reported under
+			char id[64];
+
+			/// @brief HTTP status code of the upload
+			int status;
+
+			/// @brief Description of the result of the upload
+			const char* message;
+
+			/// @brief Number of bytes received
+			size_t received;
+
+			/// @brief Number of bytes written
+			size_t written;
+
+			/// @brief Number of writes to the sink
+			uint32_t writes;
+
+			/// @brief True if the uploaded bytes are checked against an expected hash
+			bool check_hash;
+
+			/// @brief The expected SHA-256 hash of the uploaded bytes
+			uint8_t expected_hash[32];
+
+			/// @brief Running hash of the uploaded bytes
+			mbedtls_sha256_context hash;
+
+			/// @brief True until the hash and inflater are released
+			bool active;
+
+			/// @brief True if the upload is gzip compressed
+			bool inflate;
+
+			/// @brief The current stage of reading the gzip stream
+			GzipStage gzip_stage;
+
+			/// @brief Bytes of the current gzip header field read so far
+			uint8_t gzip_field[10];
+
+			/// @brief Number of bytes of the current gzip header field read so far
+			size_t gzip_field_length;
+
+			/// @brief Number of bytes left to skip in the gzip header
+			size_t gzip_skip;
+
+			/// @brief The gzip header flags
+			uint8_t gzip_flags;
+
+			/// @brief The inflater, allocated only for compressed uploads
+			tinfl_decompressor* inflater;
+
+			/// @brief The inflater's window of recent output
+			uint8_t* window;
+
+			/// @brief Position of the next output in the window
+			size_t window_position;
+
+			/// @brief True once all compressed data has been inflated
+			bool inflated;
+
+			/// @brief True if the upload is a delta to apply to the running firmware
+			bool patch;
+
+			/// @brief State of the delta being applied
+			DeltaPatch::state delta;
+		} context;
+
+		/// @brief Progress of an upload, kept after it finishes so it can still be checked
+		typedef struct progress {
+			/// @brief Number of bytes received
+			size_t received;
+
+			/// @brief Size of the request, including any multipart headers
+			size_t total;
+
+			/// @brief Number of bytes written
+			size_t written;
+
+			/// @brief Number of writes to the sink
+			uint32_t writes;
+
+			/// @brief True once the upload is finished
+			bool finished;
+
+			/// @brief HTTP status code of the upload
+			int status;
+		} progress;
+
+		/// @brief Progress of recent uploads, by ID
+		static std::map<String, progress> uploads;
+
+		/// @brief Guards the progress of uploads
+		static SemaphoreHandle_t lock;
+
+		/// @brief The maximum number of uploads to keep progress for
+		static const size_t max_tracked = 8;
+
+		static context* getContext(AsyncWebServerRequest* request);
+		static bool readGzipHeader(context* ctx, const uint8_t*& data, size_t& len);
+		static bool inflate(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len);
+		static bool produce(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len);
+		static bool buffer(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len);
+		static bool writeSink(AsyncWebServerRequest* request, context* ctx, const uint8_t* data, size_t len);
+		static void release(context* ctx);
+		static void updateProgress(AsyncWebServerRequest* request, context* ctx, bool finished);
+};
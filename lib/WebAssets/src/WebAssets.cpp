@@ -0,0 +1,223 @@
+#include "WebAssets.h"
+
+// Use the embedded web interface if it was generated by tools/build_www.py
+#if __has_include("WebBundle.h")
+#include "WebBundle.h"
+#define WEB_BUNDLE
+#endif
+
+/// @brief Creates a web asset handler
+/// @param Directory The directory on storage holding the web files (e.g. "/www")
+WebAssets::WebAssets(String Directory) {
+	directory = Directory;
+}
+
+/// @brief Loads the asset manifest, if there is one, and indexes the files on storage
+/// @return True on success
+bool WebAssets::begin() {
+	assets.clear();
+	files.clear();
+	// Index files on storage so requests can be matched without touching the file system
+	for (const auto& f : Storage::listFiles(directory, 0)) {
+		String url = f.substring(directory.length());
+		if (url.endsWith(".gz")) {
+			url.remove(url.length() - 3);
+		}
+		files.insert(url);
+	}
+	String manifest = directory + "/assets.json";
+	if (files.count("/assets.json") == 0) {
+		return true;
+	}
+	// Allocate the JSON document
+	JsonDocument doc;
+	// Deserialize file contents
+	DeserializationError error = deserializeJson(doc, Storage::readFile(manifest));
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	for (JsonPair a : doc["assets"].as<JsonObject>()) {
+		assets[a.key().c_str()] = asset {
+			.file = directory + "/" + a.value()["file"].as<String>(),
+			.etag = "\"" + a.value()["etag"].as<String>() + "\"",
+			.type = a.value()["type"].as<String>(),
+			.immutable = a.value()["immutable"].as<bool>()
+		};
+	}
+	Serial.println("Loaded " + String(assets.size()) + " web assets");
+	return true;
+}
+
+/// @brief Checks if there is an index page available to serve
+/// @return True if an index page is available
+bool WebAssets::hasIndex() {
+	return assets.count("/index.html") > 0 || files.count("/index.html") > 0 || findEmbedded("/index.html") != -1;
+}
+
+/// @brief Checks if a request is for a web asset
+/// @param request The request to check
+/// @return True if this handler can serve the request
+bool WebAssets::canHandle(AsyncWebServerRequest *request) {
+	if (request->method() != HTTP_GET) {
+		return false;
+	}
+	String url = resolveURL(request->url());
+	// Files uploaded or deleted since the handler started are kept in the index by refresh()
+	bool found = assets.count(url) > 0 || files.count(url) > 0 || findEmbedded(url) != -1;
+	if (found) {
+		// The server drops headers no handler asked for, and notModified() needs this one
+		request->addInterestingHeader("If-None-Match");
+	}
+	return found;
+}
+
+/// @brief Updates the index of files on storage after a file was uploaded or deleted
+/// @param path The path of the file
+void WebAssets::refresh(String path) {
+	if (!path.startsWith(directory + "/")) {
+		return;
+	}
+	String url = path.substring(directory.length());
+	if (url.endsWith(".gz")) {
+		url.remove(url.length() - 3);
+	}
+	String stored = directory + url;
+	if (Storage::getFileSystem()->exists(stored) || Storage::getFileSystem()->exists(stored + ".gz")) {
+		files.insert(url);
+	} else {
+		files.erase(url);
+	}
+}
+
+/// @brief Serves a web asset, or a 304 response if the client's copy is current. Files on storage take precedence over embedded files
+/// @param request The request to serve
+void WebAssets::handleRequest(AsyncWebServerRequest *request) {
+	String url = resolveURL(request->url());
+	auto a = assets.find(url);
+	if (a != assets.end()) {
+		const char* cache_control = a->second.immutable ? cache_immutable : cache_revalidate;
+		if (notModified(request, a->second.etag, cache_control)) {
+			return;
+		}
+		AsyncWebServerResponse *response = request->beginResponse(*Storage::getFileSystem(), a->second.file, a->second.type);
+		response->addHeader("Content-Encoding", "gzip");
+		response->addHeader("ETag", a->second.etag);
+		response->addHeader("Cache-Control", cache_control);
+		request->send(response);
+		return;
+	}
+	int embedded = findEmbedded(url);
+	if (files.count(url) > 0 || embedded == -1) {
+		sendStored(request, url);
+	} else {
+		sendEmbedded(request, embedded);
+	}
+}
+
+/// @brief Checks a request's If-None-Match header against an entity tag, and sends a 304 response if it matches
+/// @param request The request to check
+/// @param etag The current entity tag of the resource, including quotes
+/// @param cacheControl The Cache-Control header to send with a 304 response
+/// @return True if a 304 response was sent and the request needs no further handling
+bool WebAssets::notModified(AsyncWebServerRequest *request, String etag, String cacheControl) {
+	if (!request->hasHeader("If-None-Match")) {
+		return false;
+	}
+	String tags = request->header("If-None-Match");
+	// Compare opaque tags only, ignoring any weak indicators (RFC 9110 weak comparison)
+	String current = etag.startsWith("W/") ? etag.substring(2) : etag;
+	bool match = tags == "*";
+	int start = 0;
+	while (!match && start < tags.length()) {
+		int end = tags.indexOf(',', start);
+		if (end == -1) {
+			end = tags.length();
+		}
+		String tag = tags.substring(start, end);
+		tag.trim();
+		if (tag.startsWith("W/")) {
+			tag.remove(0, 2);
+		}
+		match = tag == current;
+		start = end + 1;
+	}
+	if (match) {
+		AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_NOT_MODIFIED);
+		response->addHeader("ETag", etag);
+		response->addHeader("Cache-Control", cacheControl);
+		request->send(response);
+	}
+	return match;
+}
+
+/// @brief Maps a request URL to the asset it refers to
+/// @param url The URL of the request
+/// @return The URL of the asset
+String WebAssets::resolveURL(String url) {
+	if (url.endsWith("/")) {
+		url += "index.html";
+	}
+	return url;
+}
+
+/// @brief Sends a file from storage that isn't listed in the manifest, validated against its size and modification time
+/// @param request The request to respond to
+/// @param url The URL of the file
+void WebAssets::sendStored(AsyncWebServerRequest *request, String url) {
+	String path = directory + url;
+	File file = Storage::getFileSystem()->open(Storage::getFileSystem()->exists(path) ? path : path + ".gz");
+	String etag = "W/\"" + String(file.size()) + "-" + String((unsigned long)file.getLastWrite()) + "\"";
+	if (notModified(request, etag)) {
+		file.close();
+		return;
+	}
+	// Content type comes from the requested path, and a gzipped file gets its Content-Encoding set automatically
+	AsyncWebServerResponse *response = request->beginResponse(file, path);
+	response->addHeader("ETag", etag);
+	response->addHeader("Cache-Control", cache_revalidate);
+	request->send(response);
+}
+
+/// @brief Sends a file embedded in the firmware directly from flash
+/// @param request The request to respond to
+/// @param index The index of the file in the embedded bundle
+void WebAssets::sendEmbedded(AsyncWebServerRequest *request, int index) {
+#ifdef WEB_BUNDLE
+	const WebBundle::entry& e = WebBundle::entries[index];
+	const char* cache_control = e.immutable ? cache_immutable : cache_revalidate;
+	if (notModified(request, e.etag, cache_control)) {
+		return;
+	}
+	AsyncWebServerResponse *response = request->beginResponse_P(HTTP_CODE_OK, e.type, e.data, e.length);
+	response->addHeader("Content-Encoding", "gzip");
+	response->addHeader("ETag", e.etag);
+	response->addHeader("Cache-Control", cache_control);
+	request->send(response);
+#endif
+}
+
+/// @brief Finds a file in the embedded bundle
+/// @param url The URL of the file
+/// @return The index of the file in the bundle, or -1 if not found
+int WebAssets::findEmbedded(String url) {
+#ifdef WEB_BUNDLE
+	// Binary search, the index is sorted by URL at build time
+	int low = 0;
+	int high = WebBundle::count - 1;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		int cmp = strcmp(url.c_str(), WebBundle::entries[mid].url);
+		if (cmp == 0) {
+			return mid;
+		} else if (cmp < 0) {
+			high = mid - 1;
+		} else {
+			low = mid + 1;
+		}
+	}
+#endif
+	return -1;
+}
@@ -0,0 +1,68 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* ESPAsyncWebServer: https://github.com/esphome/ESPAsyncWebServer
+* ArduinoJSON: https://arduinojson.org/
+*
+* Assets are prepared by tools/build_www.py, which gzips and fingerprints the files in www/, writes a manifest (assets.json)
+* for serving from storage, and generates WebBundle.h to compile the same files into the firmware
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <ESPAsyncWebServer.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include <Storage.h>
+#include <map>
+#include <set>
+
+/// @brief Serves web interface files with gzip encoding and cache validation, from storage or embedded in the firmware
+class WebAssets : public AsyncWebHandler {
+	public:
+		WebAssets(String Directory);
+		bool begin();
+		bool hasIndex();
+		void refresh(String path);
+		bool canHandle(AsyncWebServerRequest *request);
+		void handleRequest(AsyncWebServerRequest *request);
+		static bool notModified(AsyncWebServerRequest *request, String etag, String cacheControl = "no-cache");
+
+	private:
+		/// @brief Describes a file listed in the asset manifest
+		typedef struct asset {
+			/// @brief The name of the file in the asset directory
+			String file;
+
+			/// @brief Strong entity tag of the uncompressed content
+			String etag;
+
+			/// @brief The content type of the asset
+			String type;
+
+			/// @brief True if the file name is fingerprinted and can be cached forever
+			bool immutable;
+		} asset;
+
+		/// @brief Cache policy for fingerprinted assets
+		static constexpr const char* cache_immutable = "public, max-age=31536000, immutable";
+
+		/// @brief Cache policy for assets that must be revalidated on each use
+		static constexpr const char* cache_revalidate = "no-cache";
+
+		/// @brief The directory on storage holding the web files
+		String directory;
+
+		/// @brief Maps request URLs to the assets in the manifest
+		std::map<String, asset> assets;
+
+		/// @brief URLs of files found in the asset directory when the handler started
+		std::set<String> files;
+
+		String resolveURL(String url);
+		void sendStored(AsyncWebServerRequest *request, String url);
+		void sendEmbedded(AsyncWebServerRequest *request, int index);
+		int findEmbedded(String url);
+};
@@ -3,124 +3,241 @@
 /// @brief Creates a new Webhook
 /// @param URL The URL endpoint of the webhook
 /// @param URcustomHeadersL Optional custom headers as name and value pairs
-Webhook::Webhook(String URL, std::map<String, String> customHeaders) {
+/// @param maxConcurrent The maximum number of requests to this webhook that can be sent at the same time
+/// @param body Optional body template for requests rendered with render(), empty to send them as GET requests
+/// @param bodyType The content type of the body template
+/// @param maxResponse Maximum number of bytes of a response body to keep, 0 to discard response bodies
+Webhook::Webhook(String URL, std::map<String, String> customHeaders, int maxConcurrent, String body, String bodyType, size_t maxResponse) :
+	url_template(URL, PayloadTemplate::Encoding::URL), body_template(body, PayloadTemplate::encodingFor(bodyType)) {
 	Description.url = URL;
 	Description.custom_headers = customHeaders;
+	Description.max_concurrent = std::max(maxConcurrent, 1);
+	Description.body_type = bodyType;
+	Description.max_response = maxResponse;
+	// Only headers with placeholders need rendering
+	for (const auto& header : customHeaders) {
+		PayloadTemplate header_template(header.second);
+		if (header_template.hasPlaceholders()) {
+			header_templates.push_back({ header.first, header_template });
+		}
+	}
 }
 
 /// @brief Sends a GET request with no parameters
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String Webhook::getRequest() {
-	return sendGetRequest("");
+	return toJSON(sendGetRequest(""));
 }
 
 /// @brief Sends a GET request with parameters
 /// @param parameters A map<String, String> of parameter names and values
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String Webhook::getRequest(std::map<String, String> parameters) {
-	return sendGetRequest("?" + parseParameters(parameters));
+	return toJSON(sendGetRequest("?" + parseParameters(parameters)));
 }
 
 /// @brief Sends a GET request with parameters
 /// @param parameters A JSON string of parameter names and values
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String Webhook::getRequest(String parameters) {
-	// Allocate the JSON document
-  	JsonDocument doc;
-	// Deserialize file contents
-	DeserializationError error = deserializeJson(doc, parameters);
-	// Test if parsing succeeds.
-	if (error) {
-		Serial.print(F("Deserialization failed: "));
-		Serial.println(error.f_str());
-		return "{\"code\": 400, \"response\": \"Bad JSON data\"}";
-	}
-	// Build parameter map
-	std::map<String, String> params;
-	for (JsonPair param : doc.as<JsonObject>()) {
-		params[param.key().c_str()] = param.value().as<String>();
-	}
-	return sendGetRequest("?" + parseParameters(params));
+	return toJSON(send(Method::GET, parameters, true));
 }
 
 /// @brief Sends a POST request with parameters in the format of a URL encoded string
 /// @param parameters A map of the names and values of the parameters
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String Webhook::postRequest(std::map<String, String> parameters) {
-	return sendPostRequest(parameters, contentType::urlencoded);
+	return toJSON(sendPostRequest(parameters, contentType::urlencoded));
 }
 
 /// @brief Sends a POST request with parameters in the format of a JSON encoded string
 /// @param parameters The JSON string to send
 /// @return A JSON string with "code" as the response code and "response" as the response payload 
 String Webhook::postRequest(String parameters) {
-	return sendPostRequest(std::map<String, String>{{"params", parameters}}, contentType::JSON);
+	return toJSON(sendPostRequest(std::map<String, String>{{"params", parameters}}, contentType::JSON));
 }
 
-/// @brief Sends a GET request
-/// @param url_params String representing the URL encoded GET parameters, if any
+/// @brief Sends a request with parameters given as a JSON object
+/// @param method The HTTP method to use
+/// @param parameters A JSON string of parameter names and values, or an empty string for none
+/// @param json True to send the string as-is as the body of a POST request, false to send the parameters URL encoded
+/// @param bodyType The content type of the body when json is true
+/// @return The result of the request
+Webhook::result Webhook::send(Method method, String parameters, bool json, String bodyType) {
+	if (method == Method::POST && json) {
+		return sendPostRequest(std::map<String, String>{{"params", parameters}}, contentType::JSON, bodyType);
+	}
+	std::map<String, String> params;
+	if (!parameters.isEmpty() && !parseJSONParameters(parameters, params)) {
+		return { .code = 400, .response = "Bad JSON data" };
+	}
+	if (method == Method::POST) {
+		return sendPostRequest(params, contentType::urlencoded);
+	}
+	return sendGetRequest(params.empty() ? "" : "?" + parseParameters(params));
+}
+
+/// @brief Gets the body template
+/// @return The text of the body template, empty if there isn't one
+String Webhook::getBody() const {
+	return body_template.source;
+}
+
+/// @brief Converts the result of a request to JSON
+/// @param r The result of the request
 /// @return A JSON string with "code" as the response code and "response" as the response payload
-String Webhook::sendGetRequest(String url_params) {
-	client.begin(Description.url + url_params);
-	// Add any custom headers
-	if (!Description.custom_headers.empty()) {
-		for (std::pair<String, String> header : Description.custom_headers) {
-			client.addHeader(header.first, header.second);
-		}
+String Webhook::toJSON(result r) {
+	// Allocate the JSON document
+	JsonDocument doc;
+	doc["code"] = r.code;
+	doc["response"] = r.response;
+	if (r.truncated) {
+		doc["truncated"] = true;
 	}
-	// Get response
-	int response_code = client.GET();
-	String result = "{\"code\": " + String(response_code) + ",\"response\": \"";
-	if (response_code == HTTP_CODE_OK || response_code == HTTP_CODE_ACCEPTED) {
-		String response = client.getString();
-		Serial.println(response);
-		result += response + "\"}";
-	} else {
-		Serial.print("Webhook failed. Response code: ");
-		Serial.println(response_code);
-		result += "fail\"}";
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Sends a GET request
+/// @param url_params String representing the URL encoded GET parameters, if any
+/// @return The result of the request
+Webhook::result Webhook::sendGetRequest(String url_params) {
+	HTTPClient* client = connect(Description.url + url_params);
+	if (client == nullptr) {
+		return { .code = HTTPC_ERROR_CONNECTION_REFUSED, .response = "fail" };
 	}
-	client.end();
-	return result;
+	return finish(client, client->GET());
 }
 
 /// @brief Sends a POST request
 /// @param parameters The POST parameters
 /// @param format The format of the POST parameters
-/// @return A JSON string with "code" as the response code and "response" as the response payload 
-String Webhook::sendPostRequest(std::map<String, String> parameters, contentType format) {
-	client.begin(Description.url);
-	String params;
-	// Add any custom headers
-	if (!Description.custom_headers.empty()) {
-		for (std::pair<String, String> header : Description.custom_headers) {
-			client.addHeader(header.first, header.second);
-		}
+/// @param bodyType The content type sent with JSON format parameters
+/// @return The result of the request
+Webhook::result Webhook::sendPostRequest(std::map<String, String> parameters, contentType format, String bodyType) {
+	HTTPClient* client = connect(Description.url);
+	if (client == nullptr) {
+		return { .code = HTTPC_ERROR_CONNECTION_REFUSED, .response = "fail" };
 	}
+	String params;
 	if (format == contentType::JSON) {
-		client.addHeader("Content-Type", "text/json");
+		client->addHeader("Content-Type", bodyType);
 		params = parameters["params"];
 	} else {
 		params = parseParameters(parameters);
-		client.addHeader("Content-Type", "application/x-www-form-urlencoded");
-	}
-	// Get response
-	int response_code = client.POST(params);
-	String result = "{\"code\": " + String(response_code) + ",\"response\": \"";
-	if (response_code == HTTP_CODE_OK || response_code == HTTP_CODE_ACCEPTED) {
-		String response = client.getString();
-		Serial.println(response);
-		result += response + "\"}";
+		client->addHeader("Content-Type", "application/x-www-form-urlencoded");
+	}
+	return finish(client, client->POST(params));
+}
+
+/// @brief Renders the webhook's templates with the latest measurements
+/// @param r The request to render into, its buffers are reused
+void Webhook::render(request& r) {
+	url_template.render(r.url);
+	r.headers.resize(header_templates.size());
+	for (size_t i = 0; i < header_templates.size(); i++) {
+		header_templates[i].second.render(r.headers[i]);
+	}
+	body_template.render(r.body);
+}
+
+/// @brief Sends a request rendered from the webhook's templates, as a POST request if it has a body or a GET request otherwise
+/// @param r The rendered request
+/// @return The result of the request
+Webhook::result Webhook::send(const request& r) {
+	HTTPClient* client = connect(r.url);
+	if (client == nullptr) {
+		return { .code = HTTPC_ERROR_CONNECTION_REFUSED, .response = "fail" };
+	}
+	// Replace the templated headers with their rendered values
+	for (size_t i = 0; i < header_templates.size() && i < r.headers.size(); i++) {
+		client->addHeader(header_templates[i].first, r.headers[i]);
+	}
+	if (r.body.isEmpty()) {
+		return finish(client, client->GET());
+	}
+	client->addHeader("Content-Type", Description.body_type);
+	return finish(client, client->POST((uint8_t*)r.body.c_str(), r.body.length()));
+}
+
+/// @brief Starts a request on a pooled connection, with the custom headers added
+/// @param url The full URL of the request
+/// @return The client to send the request with, to be passed to finish(), or nullptr if there's no free connection
+HTTPClient* Webhook::connect(String url) {
+	// Each request gets a client of its own from the pool, so requests can be sent from more than one task
+	HTTPClient* client = ConnectionPool::acquire(url);
+	if (client == nullptr) {
+		return nullptr;
+	}
+	// Add any custom headers
+	for (const auto& header : Description.custom_headers) {
+		client->addHeader(header.first, header.second);
+	}
+	return client;
+}
+
+/// @brief Reads the response of a request and returns its connection to the pool
+/// @param client The client from connect()
+/// @param response_code The response code of the request
+/// @return The result of the request
+Webhook::result Webhook::finish(HTTPClient* client, int response_code) {
+	result r = { .code = response_code, .response = "", .truncated = false };
+	bool reusable = response_code > 0;
+	if (response_code <= 0) {
+		r.response = "fail";
+	} else if (response_code >= 200 && response_code != HTTP_CODE_NO_CONTENT && response_code != HTTP_CODE_NOT_MODIFIED) {
+		// Stream the body through, keeping only the start of it, so large responses don't need to fit in memory
+		ResponseCapture capture(r.response, Description.max_response);
+		reusable = client->writeToStream(&capture) >= 0;
+		r.truncated = capture.total > r.response.length();
+	}
+	if (response_code >= 200 && response_code < 300) {
+		Serial.println(r.response);
 	} else {
 		Serial.print("Webhook failed. Response code: ");
 		Serial.println(response_code);
-		result += "fail\"}";
 	}
-	client.end();
-	return result;
+	// Only keep the connection if the whole response was read, otherwise the next request would read the rest of it
+	ConnectionPool::release(client, reusable);
+	return r;
 }
 
-/// @brief Parses a map of parameter names and values to a query string (param1=foo&param2=bar etc...)
+/// @brief Creates a capture for a response body
+/// @param output The string to receive the start of the body
+/// @param limit Maximum number of bytes to keep
+Webhook::ResponseCapture::ResponseCapture(String& output, size_t limit) : output(output), limit(limit) {}
+
+/// @brief Writes a byte of the body
+/// @param c The byte
+/// @return Always 1, bytes past the limit are discarded rather than refused
+size_t Webhook::ResponseCapture::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+/// @brief Writes part of the body
+/// @param buffer The bytes
+/// @param size Number of bytes
+/// @return Always size, bytes past the limit are discarded rather than refused
+size_t Webhook::ResponseCapture::write(const uint8_t* buffer, size_t size) {
+	total += size;
+	if (!full) {
+		size_t length = std::min(size, limit - output.length());
+		if (length < size) {
+			// Don't keep part of a UTF-8 character
+			while (length > 0 && (buffer[length] & 0xC0) == 0x80) {
+				length--;
+			}
+			full = true;
+		}
+		output.concat((const char*)buffer, length);
+	}
+	return size;
+}
+
+/// @brief Parses a map of parameter names and values to a URL encoded query string (param1=foo&param2=bar etc...)
 /// @param parameters  A map<String, String> of parameter names and values
 /// @return The formatted query string
 String Webhook::parseParameters(std::map<String, String> parameters) {
@@ -133,8 +250,32 @@ String Webhook::parseParameters(std::map<String, String> parameters) {
 			} else {
 				params += '&';
 			}
-			params += param.first + '=' + param.second;
+			PayloadTemplate::encode(params, param.first.c_str(), PayloadTemplate::Encoding::URL);
+			params += '=';
+			PayloadTemplate::encode(params, param.second.c_str(), PayloadTemplate::Encoding::URL);
 		}
 	}
 	return params;
-}
\ No newline at end of file
+}
+
+/// @brief Parses a JSON object of parameter names and values
+/// @param parameters A JSON string of parameter names and values
+/// @param params Receives the parameter names and values
+/// @return True on success
+bool Webhook::parseJSONParameters(String parameters, std::map<String, String>& params) {
+	// Allocate the JSON document
+  	JsonDocument doc;
+	// Deserialize file contents
+	DeserializationError error = deserializeJson(doc, parameters);
+	// Test if parsing succeeds.
+	if (error) {
+		Serial.print(F("Deserialization failed: "));
+		Serial.println(error.f_str());
+		return false;
+	}
+	// Build parameter map
+	for (JsonPair param : doc.as<JsonObject>()) {
+		params[param.key().c_str()] = param.value().as<String>();
+	}
+	return true;
+}
@@ -1,20 +1,23 @@
 /*
 * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
-* 
+*
 * External libraries needed:
 * ArduinoJSON: https://arduinojson.org/
-* 
+*
 * Contributors: Sam Groveman
 */
 
 #pragma once
 #include <HTTPClient.h>
+#include <ConnectionPool.h>
+#include <PayloadTemplate.h>
 #include <ArduinoJson.h>
 #include <map>
+#include <vector>
 
 /// @brief Defines a generic webhook class for inheriting
 class Webhook {
-	public:		
+	public:
 		/// @brief Describes a webhook
 		struct {
 			/// @brief The full URL endpoint of this webhook
@@ -22,23 +25,100 @@ class Webhook {
 
 			/// @brief A collection of custom header names and values
 			std::map<String, String> custom_headers;
+
+			/// @brief The maximum number of requests to this webhook that can be sent at the same time
+			int max_concurrent;
+
+			/// @brief The content type of the body template
+			String body_type;
+
+			/// @brief Maximum number of bytes of a response body to keep, the rest is discarded. 0 to discard response bodies
+			size_t max_response;
 		} Description;
 
-		Webhook(String url, std::map<String, String> customHeaders = {});
+		/// @brief The HTTP methods a webhook can be sent with
+		enum class Method {
+			GET,
+			POST
+		};
+
+		/// @brief The result of sending a request
+		typedef struct result {
+			/// @brief The HTTP response code, negative if the request couldn't be sent (see HTTPClient)
+			int code;
+
+			/// @brief The start of the response body (up to max_response bytes), or "fail" if there was no response
+			String response;
+
+			/// @brief True if the response body was longer than max_response
+			bool truncated;
+		} result;
+
+		/// @brief A request rendered from the webhook's templates
+		typedef struct request {
+			/// @brief The full URL
+			String url;
+
+			/// @brief Values of the templated headers
+			std::vector<String> headers;
+
+			/// @brief The body, empty for a GET request
+			String body;
+		} request;
+
+		Webhook(String url, std::map<String, String> customHeaders = {}, int maxConcurrent = 1, String body = "", String bodyType = "application/json", size_t maxResponse = 1024);
 		String getRequest();
 		String getRequest(String parameters);
 		String getRequest(std::map<String, String> parameters);
 		String postRequest(std::map<String, String> parameters);
 		String postRequest(String parameters);
-	
+		result send(Method method, String parameters, bool json, String bodyType = "text/json");
+		void render(request& r);
+		result send(const request& r);
+		String getBody() const;
+		static String toJSON(result r);
+
 	private:
-		/// @brief HTTPClient object
-		HTTPClient client;
+		/// @brief Keeps the start of a response body as it's read and discards the rest
+		class ResponseCapture : public Stream {
+			public:
+				ResponseCapture(String& output, size_t limit);
+				size_t write(uint8_t c) override;
+				size_t write(const uint8_t* buffer, size_t size) override;
+				int available() override { return 0; }
+				int read() override { return -1; }
+				int peek() override { return -1; }
+
+				/// @brief Total number of bytes written
+				size_t total = 0;
+
+			private:
+				/// @brief Receives the start of the body
+				String& output;
+
+				/// @brief Maximum number of bytes to keep
+				size_t limit;
+
+				/// @brief Set once the limit is reached
+				bool full = false;
+		};
 
 		/// @brief The format of the parameters for a POST request
 		enum contentType { JSON, urlencoded };
 
-		String sendGetRequest(String url_params);
-		String sendPostRequest(std::map<String, String> parameters, contentType format);
+		/// @brief Template of the URL, with the values of placeholders URL encoded
+		PayloadTemplate url_template;
+
+		/// @brief Templates of the custom headers that have placeholders
+		std::vector<std::pair<String, PayloadTemplate>> header_templates;
+
+		/// @brief Template of the body
+		PayloadTemplate body_template;
+
+		result sendGetRequest(String url_params);
+		result sendPostRequest(std::map<String, String> parameters, contentType format, String bodyType = "text/json");
 		String parseParameters(std::map<String, String> parameters);
+		bool parseJSONParameters(String parameters, std::map<String, String>& params);
+		HTTPClient* connect(String url);
+		result finish(HTTPClient* client, int response_code);
 };
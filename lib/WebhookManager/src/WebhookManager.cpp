@@ -3,20 +3,38 @@
 // Initialize static variables
 std::vector<WebhookManager::Webhook_info> WebhookManager::webhooks;
 String WebhookManager::config;
+QueueHandle_t WebhookManager::queue = NULL;
+std::vector<WebhookManager::job*> WebhookManager::waiting;
+std::map<Webhook*, int> WebhookManager::in_flight;
+std::map<uint32_t, WebhookManager::job_result> WebhookManager::results;
+uint32_t WebhookManager::next_id = 1;
+SemaphoreHandle_t WebhookManager::lock = xSemaphoreCreateMutex();
 
-/// @brief Starts the webhook manager
+/// @brief Starts the webhook manager and its dispatcher tasks
 /// @param configFile Name of config file
 bool WebhookManager::begin(String configFile) {
 	config = "/settings/" + configFile;
+	if (queue == NULL) {
+		queue = xQueueCreate(max_queued, sizeof(job*));
+		// Templates are rendered from a copy of the measurements, since they're rendered on the web server's task
+		SensorManager::addMeasurementCallback(PayloadTemplate::takeSnapshot);
+		for (int i = 0; i < dispatchers; i++) {
+			// 8K of stack since requests may use TLS
+			if (xTaskCreate(dispatcher, "Webhook Dispatcher", 8192, NULL, 1, NULL) != pdPASS) {
+				Serial.println("Could not start webhook dispatcher");
+				return false;
+			}
+		}
+	}
 	return true;
 }
 
 /// @brief Loads webhooks from config file
 /// @return True on success or if nothing has been configured yet
 bool WebhookManager::loadWebhooks() {
-	if (Storage::fileExists(config)) {
-		// Attempt to load and read config file
-		String json_string = Storage::readFile(config);
+	if (ConfigStore::has(config)) {
+		// Attempt to load and read config
+		String json_string = ConfigStore::get(config);
 		if (json_string == "") {
 			Serial.println("Could not load webhook config file");
 			return false;
@@ -33,14 +51,15 @@ bool WebhookManager::updateWebhooks(String hooks) {
 	// Allocate the JSON document
   	JsonDocument doc;
 	// Deserialize file contents
-	DeserializationError error = deserializeJson(doc, config);
+	DeserializationError error = deserializeJson(doc, hooks);
 	// Test if parsing succeeds.
 	if (error) {
 		Serial.print(F("Deserialization failed: "));
 		Serial.println(error.f_str());
 		return false;
 	}
-	// Clear old hooks
+	xSemaphoreTake(lock, portMAX_DELAY);
+	// Clear old hooks, any queued requests keep their webhook until they're sent
 	webhooks.clear();
 	// Add webhooks
 	int i = 0;
@@ -53,10 +72,11 @@ bool WebhookManager::updateWebhooks(String hooks) {
 		// Add webhook to vector
 		webhooks.push_back(Webhook_info {
 			.positionID = i,
-			.hook = std::shared_ptr<Webhook>(new Webhook(hook["url"].as<String>(), headers))
+			.hook = std::shared_ptr<Webhook>(new Webhook(hook["url"].as<String>(), headers, hook["maxConcurrent"] | 1, hook["body"] | "", hook["bodyType"] | "application/json", hook["maxResponse"] | 1024))
 		});
 		i++;
 	}
+	xSemaphoreGive(lock);
 	return true;
 }
 
@@ -66,11 +86,12 @@ bool WebhookManager::saveWebhooks() {
 	return saveWebhooks(hooksToJSON());
 }
 
-/// @brief Saves a string of webhooks to a config file. Does not apply the webhooks without a call to loadWebhooks()
+/// @brief Saves a string of webhooks to a config file. Does not apply the webhooks without a call to loadWebhooks().
+/// Unchanged webhooks aren't rewritten, and changes are written shortly after (see DeviceConfig::writeConfig())
 /// @param hooks A complete and properly formatted JSON string of all the webhooks
 /// @return True on success
 bool WebhookManager::saveWebhooks(String hooks) { 
-	if(!Storage::writeFile(config, hooks)) {
+	if(!DeviceConfig::writeConfig(config, hooks)) {
 		Serial.println("Could not write webhooks config file");
 		return false;
 	}
@@ -87,13 +108,11 @@ String WebhookManager::getWebhooks() {
 /// @param PositionID The positionID (vector index) of the webhook
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String WebhookManager::fireGet(int PositionID) {
-	String response;
-	if (PositionID > 0 && PositionID < webhooks.size()) {
-		response = webhooks[PositionID].hook->getRequest();
-	} else {
-		response = "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
 	}
-	return response;
+	return hook->getRequest();
 }
 
 /// @brief Sends a GET request with parameters
@@ -101,13 +120,11 @@ String WebhookManager::fireGet(int PositionID) {
 /// @param parameters A JSON string of parameter names and values
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String WebhookManager::fireGet(int PositionID, String Parameters) {
-	String response;
-	if (PositionID > 0 && PositionID < webhooks.size()) {
-		response = webhooks[PositionID].hook->getRequest(Parameters);
-	} else {
-		response = "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
 	}
-	return response;
+	return hook->getRequest(Parameters);
 }
 
 /// @brief Sends a GET request with parameters
@@ -115,13 +132,11 @@ String WebhookManager::fireGet(int PositionID, String Parameters) {
 /// @param parameters A map<String, String> of parameter names and values
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String WebhookManager::fireGet(int PositionID, std::map<String,String> Parameters) {
-	String response;
-	if (PositionID > 0 && PositionID < webhooks.size()) {
-		response = webhooks[PositionID].hook->getRequest(Parameters);
-	} else {
-		response = "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
 	}
-	return response;
+	return hook->getRequest(Parameters);
 }
 
 /// @brief Sends a POST request with parameters in the format of a JSON encoded string
@@ -129,13 +144,11 @@ String WebhookManager::fireGet(int PositionID, std::map<String,String> Parameter
 /// @param parameters The JSON string to send
 /// @return A JSON string with "code" as the response code and "response" as the response payload 
 String WebhookManager::firePost(int PositionID, String Parameters) {
-	String response;
-	if (PositionID > 0 && PositionID < webhooks.size()) {
-		response = webhooks[PositionID].hook->postRequest(Parameters);
-	} else {
-		response = "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
 	}
-	return response;
+	return hook->postRequest(Parameters);
 }
 
 /// @brief Sends a POST request with parameters in the format of a URL encoded string
@@ -143,13 +156,191 @@ String WebhookManager::firePost(int PositionID, String Parameters) {
 /// @param parameters A map of the names and values of the parameters
 /// @return A JSON string with "code" as the response code and "response" as the response payload
 String WebhookManager::firePost(int PositionID, std::map<String,String> Parameters) {
-	String response;
-	if (PositionID > 0 && PositionID < webhooks.size()) {
-		response = webhooks[PositionID].hook->postRequest(Parameters);
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
+	}
+	return hook->postRequest(Parameters);
+}
+
+/// @brief Queues a request to be sent in the background
+/// @param PositionID The positionID (vector index) of the webhook
+/// @param method The HTTP method to use
+/// @param parameters A JSON string of parameter names and values, or an empty string for none
+/// @param json True to send the string as-is as the body of a POST request, false to send the parameters URL encoded
+/// @param bodyType The content type of the body when json is true
+/// @return The ID of the request, -1 if the position ID is invalid, or -2 if too many requests are waiting
+int64_t WebhookManager::queueRequest(int PositionID, Webhook::Method method, String parameters, bool json, String bodyType) {
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return -1;
+	}
+	return enqueue(new job { .id = 0, .hook = hook, .method = method, .parameters = parameters, .json = json, .body_type = bodyType, .templated = false, .rendered = {}, .attempts = 0, .next_attempt = 0 });
+}
+
+/// @brief Queues a request rendered from a webhook's templates with the latest measurements
+/// @param PositionID The positionID (vector index) of the webhook
+/// @return The ID of the request, -1 if the position ID is invalid, or -2 if too many requests are waiting
+int64_t WebhookManager::queueTemplate(int PositionID) {
+	std::shared_ptr<Webhook> hook = getHook(PositionID);
+	if (!hook) {
+		return -1;
+	}
+	job* j = new job { .id = 0, .hook = hook, .method = Webhook::Method::GET, .parameters = "", .json = false, .body_type = "", .templated = true, .rendered = {}, .attempts = 0, .next_attempt = 0 };
+	// Render now so the request has the values that triggered it, even if it's sent later
+	hook->render(j->rendered);
+	return enqueue(j);
+}
+
+/// @brief Gets the outcome of a queued request
+/// @param id The ID of the request
+/// @return A JSON string with the status of the request and the result of its last attempt, empty string if the request isn't known
+String WebhookManager::getResult(uint32_t id) {
+	const char* status_names[] = { "queued", "sending", "retrying", "done", "failed" };
+	xSemaphoreTake(lock, portMAX_DELAY);
+	auto r = results.find(id);
+	if (r == results.end()) {
+		xSemaphoreGive(lock);
+		return "";
+	}
+	job_result result = r->second;
+	xSemaphoreGive(lock);
+	// Allocate the JSON document
+	JsonDocument doc;
+	doc["id"] = id;
+	doc["status"] = status_names[(int)result.status];
+	doc["attempts"] = result.attempts;
+	doc["code"] = result.result.code;
+	doc["response"] = result.result.response;
+	// Create string to hold output
+	String output;
+	// Serialize to string
+	serializeJson(doc, output);
+	return output;
+}
+
+/// @brief Adds a request to the queue
+/// @param j The request, deleted if it can't be queued
+/// @return The ID of the request, or -2 if too many requests are waiting
+int64_t WebhookManager::enqueue(job* j) {
+	int64_t id = -2;
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (queue != NULL && uxQueueMessagesWaiting(queue) + waiting.size() < max_queued) {
+		j->id = next_id++;
+		if (xQueueSend(queue, &j, 0) == pdTRUE) {
+			id = j->id;
+			setResult(j->id, Status::Queued, 0, { .code = 0, .response = "" });
+		}
+	}
+	xSemaphoreGive(lock);
+	if (id < 0) {
+		delete j;
+	}
+	return id;
+}
+
+/// @brief Gets a webhook by its position ID
+/// @param positionID The positionID (vector index) of the webhook
+/// @return A pointer to the webhook, empty if the position ID is invalid
+std::shared_ptr<Webhook> WebhookManager::getHook(int positionID) {
+	std::shared_ptr<Webhook> hook;
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (positionID >= 0 && positionID < webhooks.size()) {
+		hook = webhooks[positionID].hook;
+	}
+	xSemaphoreGive(lock);
+	return hook;
+}
+
+/// @brief Task that sends queued requests
+/// @param arg Unused
+void WebhookManager::dispatcher(void* arg) {
+	while (true) {
+		job* j = nextJob();
+		if (j == nullptr) {
+			// Nothing to send, close connections that are no longer needed
+			ConnectionPool::prune();
+			continue;
+		}
+		xSemaphoreTake(lock, portMAX_DELAY);
+		setResult(j->id, Status::Sending, j->attempts, results[j->id].result);
+		xSemaphoreGive(lock);
+		finishJob(j, j->templated ? j->hook->send(j->rendered) : j->hook->send(j->method, j->parameters, j->json, j->body_type));
+	}
+}
+
+/// @brief Gets the next request that can be sent, waiting briefly for one to be queued if there isn't one
+/// @return The request to send, or nullptr if there isn't one yet
+WebhookManager::job* WebhookManager::nextJob() {
+	job* next = nullptr;
+	xSemaphoreTake(lock, portMAX_DELAY);
+	// Requests that have waited come first, once they're due and their webhook is free
+	for (auto w = waiting.begin(); w != waiting.end(); w++) {
+		if ((long)(millis() - (*w)->next_attempt) >= 0 && in_flight[(*w)->hook.get()] < (*w)->hook->Description.max_concurrent) {
+			next = *w;
+			waiting.erase(w);
+			in_flight[next->hook.get()]++;
+			break;
+		}
+	}
+	xSemaphoreGive(lock);
+	if (next != nullptr) {
+		return next;
+	}
+	job* received;
+	if (xQueueReceive(queue, &received, pdMS_TO_TICKS(100)) == pdTRUE) {
+		xSemaphoreTake(lock, portMAX_DELAY);
+		if (in_flight[received->hook.get()] < received->hook->Description.max_concurrent) {
+			next = received;
+			in_flight[next->hook.get()]++;
+		} else {
+			// Wait for the webhook to be free
+			received->next_attempt = millis();
+			waiting.push_back(received);
+		}
+		xSemaphoreGive(lock);
+	}
+	return next;
+}
+
+/// @brief Records the result of sending a request, and schedules a retry if it failed in a way that might not happen again
+/// @param j The request that was sent
+/// @param r The result of sending the request
+void WebhookManager::finishJob(job* j, Webhook::result r) {
+	j->attempts++;
+	bool success = r.code >= 200 && r.code < 300;
+	// Retry connection errors, server errors and rate limiting
+	bool retry = !success && (r.code < 0 || r.code >= 500 || r.code == 429) && j->attempts < max_attempts;
+	xSemaphoreTake(lock, portMAX_DELAY);
+	if (--in_flight[j->hook.get()] <= 0) {
+		in_flight.erase(j->hook.get());
+	}
+	if (retry) {
+		j->next_attempt = millis() + (retry_delay << (j->attempts - 1));
+		waiting.push_back(j);
+		setResult(j->id, Status::Retrying, j->attempts, r);
 	} else {
-		response = "{\"code\": 400, \"response\": \"Bad PositionID data\"}";
+		setResult(j->id, success ? Status::Done : Status::Failed, j->attempts, r);
+		delete j;
+	}
+	xSemaphoreGive(lock);
+}
+
+/// @brief Records the outcome of a request, forgetting the oldest finished request if there are too many. Must be called with the lock held
+/// @param id The ID of the request
+/// @param status The state of the request
+/// @param attempts Number of times the request has been sent
+/// @param r The result of the last attempt
+void WebhookManager::setResult(uint32_t id, Status status, int attempts, Webhook::result r) {
+	results[id] = { .status = status, .attempts = attempts, .result = r };
+	if (results.size() > max_results) {
+		for (auto old = results.begin(); old != results.end(); old++) {
+			if (old->second.status == Status::Done || old->second.status == Status::Failed) {
+				results.erase(old);
+				break;
+			}
+		}
 	}
-	return response;
 }
 
 /// @brief Converts the current webhooks to a JSON string
@@ -158,15 +349,23 @@ String WebhookManager::hooksToJSON() {
 	// Allocate the JSON document
 	JsonDocument doc;
 	JsonArray hooks = doc["hooks"].to<JsonArray>();
+	xSemaphoreTake(lock, portMAX_DELAY);
 	// Add webhook description
 	for (const auto &h : webhooks) {
 		hooks[h.positionID]["positionID"] = h.positionID;
 		hooks[h.positionID]["url"] = h.hook->Description.url;
+		hooks[h.positionID]["maxConcurrent"] = h.hook->Description.max_concurrent;
+		hooks[h.positionID]["maxResponse"] = h.hook->Description.max_response;
+		if (!h.hook->getBody().isEmpty()) {
+			hooks[h.positionID]["body"] = h.hook->getBody();
+			hooks[h.positionID]["bodyType"] = h.hook->Description.body_type;
+		}
 		// Add custom headers
 		for (auto const &header : h.hook->Description.custom_headers) {
 			hooks[h.positionID]["headers"][header.first] = header.second;
 		}
 	}
+	xSemaphoreGive(lock);
 	// Create string to hold output
 	String output;
 	// Serialize to string
@@ -3,6 +3,12 @@
 * 
 * External libraries needed:
 * ArduinoJSON: https://arduinojson.org/
+*
+* Webhooks can be fired straight away (fireGet()/firePost()), which blocks until the request finishes, or queued
+* (queueRequest()) to be sent by dispatcher tasks in the background. Queued requests are retried with exponential backoff
+* if they fail, and their outcome can be checked afterwards with getResult().
+* Webhooks can also have templates for their URL, headers and body (see PayloadTemplate), which queueTemplate() renders
+* with the latest measurements, e.g. to report a value that crossed a threshold.
 * 
 * Contributors: Sam Groveman
 */
@@ -11,6 +17,7 @@
 #include <ArduinoJson.h>
 #include <Webhook.h>
 #include <Storage.h>
+#include <DeviceConfig.h>
 #include <vector>
 #include <map>
 
@@ -25,13 +32,106 @@ class WebhookManager {
 			std::shared_ptr<Webhook> hook;
 		} Webhook_info;
 
+		/// @brief States a queued request can be in
+		enum class Status {
+			Queued,
+			Sending,
+			Retrying,
+			Done,
+			Failed
+		};
+
+		/// @brief A request waiting to be sent by the dispatcher
+		typedef struct job {
+			/// @brief The ID of the request
+			uint32_t id;
+
+			/// @brief The webhook to send the request to, kept even if the webhooks are replaced
+			std::shared_ptr<Webhook> hook;
+
+			/// @brief The HTTP method to use
+			Webhook::Method method;
+
+			/// @brief A JSON string of the parameters
+			String parameters;
+
+			/// @brief True to send the parameters as-is as the body
+			bool json;
+
+			/// @brief The content type of the body
+			String body_type;
+
+			/// @brief True to send the request rendered from the webhook's templates instead of the parameters
+			bool templated;
+
+			/// @brief The request rendered from the webhook's templates
+			Webhook::request rendered;
+
+			/// @brief Number of times the request has been sent
+			int attempts;
+
+			/// @brief The time in ms since boot to send the request
+			ulong next_attempt;
+		} job;
+
+		/// @brief The outcome of a queued request
+		typedef struct job_result {
+			/// @brief The state of the request
+			Status status;
+
+			/// @brief Number of times the request has been sent
+			int attempts;
+
+			/// @brief The result of the last attempt
+			Webhook::result result;
+		} job_result;
+
 		/// @brief Stores all the in-use webhooks
 		static std::vector<Webhook_info> webhooks;
 
 		/// @brief Full path to config file
 		static String config;
-		
+
+		/// @brief Requests waiting for a dispatcher task
+		static QueueHandle_t queue;
+
+		/// @brief Requests waiting to be retried, or waiting for their webhook to be free
+		static std::vector<job*> waiting;
+
+		/// @brief Number of requests being sent to each webhook
+		static std::map<Webhook*, int> in_flight;
+
+		/// @brief Outcomes of recent requests, by ID
+		static std::map<uint32_t, job_result> results;
+
+		/// @brief The ID of the next request
+		static uint32_t next_id;
+
+		/// @brief Guards the webhooks, waiting requests and results, since they're used by the web server and dispatcher tasks
+		static SemaphoreHandle_t lock;
+
+		/// @brief Maximum number of requests waiting to be sent
+		static const int max_queued = 16;
+
+		/// @brief Number of dispatcher tasks, and so the most requests that can be sent at once
+		static const int dispatchers = 2;
+
+		/// @brief Maximum number of times to send a request
+		static const int max_attempts = 4;
+
+		/// @brief Time in ms to wait before the first retry, doubled for each retry after that
+		static const ulong retry_delay = 1000;
+
+		/// @brief Maximum number of request outcomes to keep
+		static const size_t max_results = 32;
+
 		static String hooksToJSON();
+		static std::shared_ptr<Webhook> getHook(int positionID);
+		static int64_t enqueue(job* j);
+		static void dispatcher(void* arg);
+		static job* nextJob();
+		static void finishJob(job* j, Webhook::result r);
+		static void setResult(uint32_t id, Status status, int attempts, Webhook::result r);
 
 	public:
 		static bool begin(String configFile);
@@ -45,4 +145,7 @@ class WebhookManager {
 		static String fireGet(int positionID, std::map<String,String> parameters);
 		static String firePost(int positionID, String parameters);
 		static String firePost(int positionID, std::map<String,String> parameters);
-};
\ No newline at end of file
+		static int64_t queueRequest(int positionID, Webhook::Method method, String parameters, bool json, String bodyType = "text/json");
+		static int64_t queueTemplate(int positionID);
+		static String getResult(uint32_t id);
+};
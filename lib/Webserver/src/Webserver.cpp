@@ -7,9 +7,8 @@ extern const String FW_VERSION;
 extern bool POSTSuccess;
 
 // Initialize static variables
-bool Webserver::upload_abort = false;
 bool Webserver::shouldReboot = false;
-int Webserver::upload_response_code = 201;
+WebAssets* Webserver::assets = nullptr;
 
 /// @brief Creates a Webserver object
 /// @param Webserver A pointer to an AsyncWebServer object
@@ -28,375 +27,345 @@ bool Webserver::ServerStart() {
 		if (!Storage::createDir("/www"))
 			return false;
 
+	// Load the web interface asset manifest, if the assets were built
+	assets = new WebAssets("/www");
+	assets->begin();
+
+	// API routes are kept in one table, so each request is found with a single lookup
+	Router* router = new Router();
+
+	// Asks for the API user name and password, when one is set in the global configuration
+	Router::Middleware auth = Router::authenticated(Configuration::currentConfig.apiUser, Configuration::currentConfig.apiPW);
+
+	// Stops requests that need sensors and receivers until the hub has started successfully
+	Router::Middleware ready = Router::ready(POSTSuccess);
+
+	// Keeps enough memory free for the rest of the hub when starting handlers that build large responses
+	Router::Middleware memory = Router::memory(min_free_block);
+
+	// Leave sockets free for the hub's own connections (webhooks, MQTT) and keep each response's buffers affordable
+	router->setInFlightLimit(max_in_flight);
+
 	// Add request handler for index page
-	if (Storage::fileExists("/www/index.html")) {
-		// Serve any page from filesystem
-		server->serveStatic("/", *Storage::getFileSystem(), "/www/").setDefaultFile("index.html");
-	} else {
+	if (!assets->hasIndex()) {
 		// Serve the embedded index page
-		server->on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		router->on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
 			request->send_P(HTTP_CODE_OK, "text/html", index_page);
 		});
 	}
 
-	// Handle file uploads
-	server->on("/upload-file", HTTP_POST, [](AsyncWebServerRequest *request) {
-		// Let upload start
-		delay(50);
+	// Handle file uploads, add "inflate" to store a gzip compressed upload uncompressed
+	router->on("/upload-file", HTTP_POST, [](AsyncWebServerRequest *request) {
 		// Construct response
-		AsyncWebServerResponse *response = request->beginResponse(Webserver::upload_response_code, "text/plain", Webserver::upload_abort ? "Upload failed": "File uploaded");
+		AsyncWebServerResponse *response = request->beginResponse(UploadStream::getStatus(request), "text/plain", UploadStream::getMessage(request));
 		response->addHeader("Connection", "close");
 		request->send(response);
-	}, onUpload_file);
+	}, { auth }, onUpload_file);
+
+	// Get the progress of recent uploads, add "id" to get a single upload (its X-Upload-Id header, or its file name)
+	router->on("/upload-progress", HTTP_GET, [](AsyncWebServerRequest *request) {
+		String id = request->hasParam("id") ? request->getParam("id")->value() : "";
+		request->send(HTTP_CODE_OK, "text/json", UploadStream::getProgress(id));
+	}, { auth });
 
 	// Handle deletion of files
-	server->on("/delete", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if(request->hasParam("path", true)) {
-			String path = request->getParam("path", true)->value();
-			Serial.println("Deleting " + path);
-			if (Storage::fileExists(path)) {
-				if (!Storage::deleteFile(path)) {
-					request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not delete file");
-				} else {
-					request->send(HTTP_CODE_OK, "text/json", "{\"file\":\"" + path + "\"}");
-				}
+	router->on("/delete", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		String path = request->getParam("path", true)->value();
+		Serial.println("Deleting " + path);
+		if (Storage::fileExists(path)) {
+			if (!Storage::deleteFile(path)) {
+				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not delete file");
 			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
+				assets->refresh(path);
+				request->send(HTTP_CODE_OK, "text/json", "{\"file\":\"" + path + "\"}");
 			}
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
 		}
-	});
+	}, { auth, Router::params({ "path" }, true) });
 
 	// Get descriptions of available sensors
-	server->on("/sensors/", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		request->send(HTTP_CODE_OK, "text/json", SensorManager::getSensorInfo());
-	});
+	router->on("/sensors/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String etag;
+		String info = SensorManager::getSensorInfo(etag);
+		sendDescription(request, info, etag);
+	}, { auth });
 
 	// Get curent configuration of a sensor
-	server->on("/sensors/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("sensor")) {
-			int sensorPosID = request->getParam("sensor")->value().toInt();
-			request->send(HTTP_CODE_OK, "text/json", SensorManager::getSensorConfig(sensorPosID));
-		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
-		}
-	});
+	router->on("/sensors/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		int sensorPosID = request->getParam("sensor")->value().toInt();
+		request->send(HTTP_CODE_OK, "text/json", SensorManager::getSensorConfig(sensorPosID));
+	}, { auth, Router::params({ "sensor" }) });
 
 	// Update configuration of a sensor
-	server->on("/sensors/config", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("config", true) && request->hasParam("sensor", true)) {
-			// Parse data payload
-			int sensorPosID = request->getParam("sensor", true)->value().toInt();
-			String config = request->getParam("config", true)->value();
-			// Attempt to apply config data
-			if (SensorManager::setSensorConfig(sensorPosID, config)) {
-				request->send(HTTP_CODE_OK, "text/plain", "OK");
-			} else {
-				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply config settings");
-			}
+	router->on("/sensors/config", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		int sensorPosID = request->getParam("sensor", true)->value().toInt();
+		String config = request->getParam("config", true)->value();
+		// Attempt to apply config data
+		if (SensorManager::setSensorConfig(sensorPosID, config)) {
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply config settings");
 		}
-	});
+	}, { auth, Router::params({ "config", "sensor" }, true) });
+
 	// Gets last measurement. Add GET paramater "update" (/sensors/measurement?update) to take a new measurement first
-	server->on("/sensors/measurement", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		if (POSTSuccess) {
-			if (request->hasParam("update")) {
-				// Attempt to take new measurement
-				if (!SensorManager::takeMeasurement()) {
-					request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not take measurement");
-					return;
-				}
+	// Send "Accept: application/msgpack" to get the measurement as MessagePack, with values as float32
+	router->on("/sensors/measurement", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		if (request->hasParam("update")) {
+			// Attempt to take new measurement
+			if (!SensorManager::takeMeasurement()) {
+				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not take measurement");
+				return;
 			}
-			request->send(HTTP_CODE_OK, "text/json", SensorManager::getLastMeasurement());
+		}
+		if (acceptsMsgPack(request)) {
+			JsonDocument doc;
+			SensorManager::getLastMeasurement(doc, true);
+			sendMsgPack(request, doc);
 		} else {
-			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain");
+			request->send(HTTP_CODE_OK, "text/json", SensorManager::getLastMeasurement());
 		}
-	});
+	}, { auth, ready, Router::rateLimit(2, 5) });
+
+	// Pushes measurements to clients as they are taken, connect with EventSource("/sensors/stream")
+	server->addHandler(MeasurementStream::begin("/sensors/stream"));
 	
 	// Runs a calibration procedure on a sensor
-	server->on("/sensors/calibrate", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (POSTSuccess) {
-			if (request->hasParam("sensor", true) && request->hasParam("step", true)) {
-				// Parse data payload
-				int sensorPosID = request->getParam("sensor", true)->value().toInt();
-				int step = request->getParam("step", true)->value().toInt();
+	router->on("/sensors/calibrate", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		int sensorPosID = request->getParam("sensor", true)->value().toInt();
+		int step = request->getParam("step", true)->value().toInt();
 
-				// Run sensor calibration
-				std::tuple<Sensor::calibration_response, String> response = SensorManager::calibrateSensor(sensorPosID, step);
+		// Run sensor calibration
+		std::tuple<Sensor::calibration_response, String> response = SensorManager::calibrateSensor(sensorPosID, step);
 
-				// Create response
-				request->send(HTTP_CODE_OK, "text/json", "{ \"response\":" + String(std::get<0>(response)) + ",\"message\":" + std::get<1>(response) + "}");
-			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
-			}
-		} else {
-			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain");
-		}
-	});
+		// Create response
+		request->send(HTTP_CODE_OK, "text/json", "{ \"response\":" + String(std::get<0>(response)) + ",\"message\":" + std::get<1>(response) + "}");
+	}, { auth, ready, Router::params({ "sensor", "step" }, true), Router::rateLimit(1, 3) });
 
 	// Get descriptions of available signal receivers
-	server->on("/signals/", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		request->send(HTTP_CODE_OK, "text/json", SignalManager::getReceiverInfo());
-	});
+	router->on("/signals/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String etag;
+		String info = SignalManager::getReceiverInfo(etag);
+		sendDescription(request, info, etag);
+	}, { auth });
 
 	// Get curent configuration of a receiver
-	server->on("/signals/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("receiver")) {
-			int receiverPosID = request->getParam("receiver")->value().toInt();
-			request->send(HTTP_CODE_OK, "text/json", SignalManager::getReceiverConfig(receiverPosID));
-		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
-		}
-	});
+	router->on("/signals/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		int receiverPosID = request->getParam("receiver")->value().toInt();
+		request->send(HTTP_CODE_OK, "text/json", SignalManager::getReceiverConfig(receiverPosID));
+	}, { auth, Router::params({ "receiver" }) });
 
 	// Update configuration of a receiver
-	server->on("/signals/config", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("config", true) && request->hasParam("receiver", true)) {
-			// Parse data payload
-			int receiverPosID = request->getParam("receiver", true)->value().toInt();
-			String config = request->getParam("config", true)->value();
-			// Attempt to apply config data
-			if (SignalManager::setReceiverConfig(receiverPosID, config)) {
-				request->send(HTTP_CODE_OK, "text/plain", "OK");
-			} else {
-				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply config settings");
-			}
+	router->on("/signals/config", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		int receiverPosID = request->getParam("receiver", true)->value().toInt();
+		String config = request->getParam("config", true)->value();
+		// Attempt to apply config data
+		if (SignalManager::setReceiverConfig(receiverPosID, config)) {
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply config settings");
 		}
-	});
+	}, { auth, Router::params({ "config", "receiver" }, true) });
 
 	// Adds a signal to the signal queue using the signal's name or ID
-	server->on("/signals/add", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (POSTSuccess) {
-			if (request->hasParam("receiver", true) && (request->hasParam("id", true) || request->hasParam("name", true))) {
-				// Parse data payload
-				bool id = true;
-				int receiverPosID = request->getParam("receiver", true)->value().toInt();
-				String payload = "";
-				if (request->hasParam("payload", true)) {
-					payload = request->getParam("payload", true)->value();
-				}
-				// Attempt to add signal to queue
-				bool success = false;
-				if (request->hasParam("id", true)) {
-					success = SignalManager::addSignalToQueue(receiverPosID, request->getParam("id", true)->value().toInt(), payload);
-				} else {
-					success = SignalManager::addSignalToQueue(receiverPosID, request->getParam("name", true)->value(), payload);
-				}
-				if (!success) {
-					request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not add signal to queue");
-				} else {
-					request->send(HTTP_CODE_OK, "text/plain", "OK");
-				}
-			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
-			}
+	router->on("/signals/add", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		int receiverPosID = request->getParam("receiver", true)->value().toInt();
+		String payload = "";
+		if (request->hasParam("payload", true)) {
+			payload = request->getParam("payload", true)->value();
+		}
+		// Attempt to add signal to queue
+		bool success = false;
+		if (request->hasParam("id", true)) {
+			success = SignalManager::addSignalToQueue(receiverPosID, request->getParam("id", true)->value().toInt(), payload);
 		} else {
-			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain");
+			success = SignalManager::addSignalToQueue(receiverPosID, request->getParam("name", true)->value(), payload);
 		}
-	});
+		if (!success) {
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not add signal to queue");
+		} else {
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
+		}
+	}, { auth, ready, Router::params({ "receiver" }, true), Router::anyParam({ "id", "name" }, true) });
 
 	// Sends a signal to a receiver immediately using the signal'a name or ID, and returns any response
-	server->on("/signals/execute", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (POSTSuccess) {	
-			if (request->hasParam("receiver", true) && (request->hasParam("id", true) || request->hasParam("name", true))) {
-				// Parse data payload
-				bool id = true;
-				int receiverPosID = request->getParam("receiver", true)->value().toInt();
-				String payload = "";
-				if (request->hasParam("payload", true)) {
-					payload = request->getParam("payload", true)->value();
-				}
-				std::tuple<bool, String> result;
-				if (request->hasParam("id", true)) {
-					result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("id", true)->value().toInt(), payload);
-				} else {
-					result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("name", true)->value(), payload);
-				}
-				String mime = "text/json";
-				if (!std::get<0>(result)) {
-					mime = "text/plain";
-				}
-				// Execute signal and return response
-				request->send(HTTP_CODE_OK, mime, std::get<1>(result));
-			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
-			}
+	router->on("/signals/execute", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		int receiverPosID = request->getParam("receiver", true)->value().toInt();
+		String payload = "";
+		if (request->hasParam("payload", true)) {
+			payload = request->getParam("payload", true)->value();
+		}
+		std::tuple<bool, String> result;
+		if (request->hasParam("id", true)) {
+			result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("id", true)->value().toInt(), payload);
 		} else {
-			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain");
+			result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("name", true)->value(), payload);
 		}
-	});
+		String mime = "text/json";
+		if (!std::get<0>(result)) {
+			mime = "text/plain";
+		}
+		// Execute signal and return response
+		request->send(HTTP_CODE_OK, mime, std::get<1>(result));
+	}, { auth, ready, Router::params({ "receiver" }, true), Router::anyParam({ "id", "name" }, true), Router::rateLimit(2, 5) });
 
 	// Sends a signal to a receiver immediately using the signal'a name or ID, and returns any response
-	server->on("/signals/execute", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		if (POSTSuccess){
-			if (request->hasParam("receiver") && (request->hasParam("id") || request->hasParam("name"))) {
-				// Parse data payload
-				bool id = true;
-				int receiverPosID = request->getParam("receiver")->value().toInt();
-				String payload = "";
-				if (request->hasParam("payload")) {
-					payload = request->getParam("payload")->value();
-				}
-				std::tuple<bool, String> result;
-				if (request->hasParam("id")) {
-					result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("id")->value().toInt(), payload);
-				} else {
-					result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("name")->value(), payload);
-				}
-				String mime = "text/json";
-				if (!std::get<0>(result)) {
-					mime = "text/plain";
-				}
-				// Execute signal and return response
-				request->send(HTTP_CODE_OK, mime, std::get<1>(result));
-			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
-			}
+	router->on("/signals/execute", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		int receiverPosID = request->getParam("receiver")->value().toInt();
+		String payload = "";
+		if (request->hasParam("payload")) {
+			payload = request->getParam("payload")->value();
+		}
+		std::tuple<bool, String> result;
+		if (request->hasParam("id")) {
+			result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("id")->value().toInt(), payload);
 		} else {
-			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain");
+			result = SignalManager::processSignalImmediately(receiverPosID, request->getParam("name")->value(), payload);
 		}
-	});
+		String mime = "text/json";
+		if (!std::get<0>(result)) {
+			mime = "text/plain";
+		}
+		// Execute signal and return response
+		request->send(HTTP_CODE_OK, mime, std::get<1>(result));
+	}, { auth, ready, Router::params({ "receiver" }), Router::anyParam({ "id", "name" }), Router::rateLimit(2, 5) });
+
+	// Get the number of config file writes made and avoided
+	router->on("/config/writes", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		request->send(HTTP_CODE_OK, "text/json", DeviceConfig::getWriteStats());
+	}, { auth });
+
+	// Get all stored configuration as one JSON object, for backup or copying to another hub
+	router->on("/config/export", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		DeviceConfig::flushConfigs(true);
+		AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_OK, "application/json", ConfigStore::exportJSON());
+		response->addHeader("Content-Disposition", "attachment; filename=\"config.json\"");
+		request->send(response);
+	}, { auth, memory, Router::rateLimit(0.2, 2) });
+
+	// Replace stored configuration from an exported JSON object, and reboot to apply it
+	router->on("/config/import", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Write pending changes first so they don't overwrite the imported config
+		DeviceConfig::flushConfigs(true);
+		if (ConfigStore::importJSON(request->getParam("config", true)->value())) {
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
+			Webserver::shouldReboot = true;
+		} else {
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not import config");
+		}
+	}, { auth, Router::params({ "config" }, true) });
 
 	// Get curent global configuration
-	server->on("/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
+	router->on("/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
 		request->send(HTTP_CODE_OK, "text/json", Configuration::getConfig());
-	});
+	}, { auth });
 
 	// Update global configuration
-	server->on("/config", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("config", true) && request->hasParam("save", true)) {
-			// Parse data payload
-			bool save = request->getParam("save", true)->value() == "true";
-			String config_string = request->getParam("config", true)->value();
-			// Attempt to apply config data
-			if (Configuration::updateConfig(config_string)) {
-				if (save) {
-					// Attempt to save config
-					if(!Configuration::saveConfig(config_string)) {
-						request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not save config settings");
-						return;
-					}
+	router->on("/config", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		bool save = request->getParam("save", true)->value() == "true";
+		String config_string = request->getParam("config", true)->value();
+		// Attempt to apply config data
+		if (Configuration::updateConfig(config_string)) {
+			if (save) {
+				// Attempt to save config
+				if(!Configuration::saveConfig(config_string)) {
+					request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not save config settings");
+					return;
 				}
-				request->send(HTTP_CODE_OK, "text/plain", "OK");
-			} else {
-				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply config settings");
 			}
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply config settings");
 		}
-	});
+	}, { auth, Router::params({ "config", "save" }, true) });
 
 	// Get curent webhooks
-	server->on("/webhooks/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+	router->on("/webhooks/", HTTP_GET, [this](AsyncWebServerRequest *request) {
 		request->send(HTTP_CODE_OK, "text/json", WebhookManager::getWebhooks());
-	});
+	}, { auth });
 
 	// Update webhooks
-	server->on("/webhooks/", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("webhooks", true) && request->hasParam("save", true)) {
-			// Parse data payload
-			bool save = request->getParam("save", true)->value() == "1";
-			String webhooks_string = request->getParam("webhooks", true)->value();
-			// Attempt to apply config data
-			if (WebhookManager::updateWebhooks(webhooks_string)) {
-				if (save) {
-					// Attempt to save config
-					if(!WebhookManager::saveWebhooks(webhooks_string)) {
-						request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not save webhook settings");
-						return;
-					}
+	router->on("/webhooks/", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		bool save = request->getParam("save", true)->value() == "1";
+		String webhooks_string = request->getParam("webhooks", true)->value();
+		// Attempt to apply config data
+		if (WebhookManager::updateWebhooks(webhooks_string)) {
+			if (save) {
+				// Attempt to save config
+				if(!WebhookManager::saveWebhooks(webhooks_string)) {
+					request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not save webhook settings");
+					return;
 				}
-				request->send(HTTP_CODE_OK, "text/plain", "OK");
-			} else {
-				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply webhook settings");
 			}
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply webhook settings");
 		}
-	});
-
-	// Fires a webhook using a GET request and the webhook's position ID
-	server->on("/webhooks/get", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("webhook", true) && request->hasParam("type", true)) {
-			int webhookPosID = request->getParam("receiver", true)->value().toInt();
-			String type = request->getParam("type", true)->value();
-			type.toLowerCase();
-			if (request->hasParam("parameters", true)) {
-				String parameters = request->getParam("parameters", true)->value();
-				if (type == "json") {
-					request->send(HTTP_CODE_OK, "text/json", WebhookManager::fireGet(webhookPosID, parameters));
-				} else {
-					// Convert from JSON to std::map<String, String>
-					// Allocate the JSON document
-					JsonDocument doc;
-					// Deserialize file contents
-					DeserializationError error = deserializeJson(doc, parameters);
-					// Test if parsing succeeds.
-					if (error) {
-						Serial.print(F("Deserialization failed: "));
-						Serial.println(error.f_str());
-						request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad JSON parameter data");
-						return;
-					}
-					// Build parameter map
-					std::map<String, String> params;
-					for (JsonPair param : doc.as<JsonObject>()) {
-						params[param.key().c_str()] = param.value().as<String>();
-					}
-					request->send(HTTP_CODE_OK, "text/json", WebhookManager::fireGet(webhookPosID, params));
-				}
-
-			} else {
-				request->send(HTTP_CODE_OK, "text/json", WebhookManager::fireGet(webhookPosID));
+	}, { auth, Router::params({ "webhooks", "save" }, true) });
+
+	// Get current MQTT settings and connection status
+	router->on("/mqtt/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		request->send(HTTP_CODE_OK, "text/json", MqttManager::getConfig());
+	}, { auth });
+
+	// Update MQTT settings
+	router->on("/mqtt/", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		// Parse data payload
+		bool save = request->getParam("save", true)->value() == "1";
+		String mqtt_string = request->getParam("mqtt", true)->value();
+		// Attempt to apply settings
+		if (MqttManager::updateConfig(mqtt_string)) {
+			if (save && !MqttManager::saveConfig(mqtt_string)) {
+				request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not save MQTT settings");
+				return;
 			}
-			
+			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", "Could not apply MQTT settings");
 		}
-	});
-
-	// Fires a webhook using a POST request and the webhook's position ID
-	server->on("/webhooks/post", HTTP_POST, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("webhook", true) && request->hasParam("type", true) && request->hasParam("parameters", true)) {
-			int webhookPosID = request->getParam("receiver", true)->value().toInt();
-			String type = request->getParam("type", true)->value();
-			type.toLowerCase();
-			String parameters = request->getParam("parameters", true)->value();
-			if (type == "json") {
-				request->send(HTTP_CODE_OK, "text/json", WebhookManager::fireGet(webhookPosID, parameters));
-			} else {
-				// Convert from JSON to std::map<String, String>
-				// Allocate the JSON document
-				JsonDocument doc;
-				// Deserialize file contents
-				DeserializationError error = deserializeJson(doc, parameters);
-				// Test if parsing succeeds.
-				if (error) {
-					Serial.print(F("Deserialization failed: "));
-					Serial.println(error.f_str());
-					request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad JSON parameter data");
-					return;
-				}
-				// Build parameter map
-				std::map<String, String> params;
-				for (JsonPair param : doc.as<JsonObject>()) {
-					params[param.key().c_str()] = param.value().as<String>();
-				}
-				request->send(HTTP_CODE_OK, "text/json", WebhookManager::firePost(webhookPosID, params));
-			}			
+	}, { auth, Router::params({ "mqtt", "save" }, true) });
+
+	// Queues a webhook to be sent using a GET request and the webhook's position ID
+	router->on("/webhooks/get", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		String parameters = request->hasParam("parameters", true) ? request->getParam("parameters", true)->value() : "";
+		queueWebhook(request, Webhook::Method::GET, parameters, false);
+	}, { auth, Router::params({ "webhook", "type" }, true) });
+
+	// Queues a webhook to be sent using a POST request and the webhook's position ID
+	router->on("/webhooks/post", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		String type = request->getParam("type", true)->value();
+		type.toLowerCase();
+		queueWebhook(request, Webhook::Method::POST, request->getParam("parameters", true)->value(), type == "json");
+	}, { auth, Router::params({ "webhook", "type", "parameters" }, true) });
+
+	// Queues a webhook rendered from its templates with the latest measurements
+	router->on("/webhooks/fire", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		respondQueued(request, WebhookManager::queueTemplate(request->getParam("webhook", true)->value().toInt()));
+	}, { auth, Router::params({ "webhook" }, true) });
+
+	// Gets the outcome of a queued webhook
+	router->on("/webhooks/result", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String result = WebhookManager::getResult(request->getParam("id")->value().toInt());
+		if (result.isEmpty()) {
+			request->send(HTTP_CODE_NOT_FOUND, "text/plain", "Unknown webhook request");
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_OK, "text/json", result);
 		}
-	});
+	}, { auth, Router::params({ "id" }) });
 
 	// Sets the time on the device (example of parsing JSON parameters)
-	server->on("/setTime", HTTP_POST, [this](AsyncWebServerRequest *request) {
+	router->on("/setTime", HTTP_POST, [this](AsyncWebServerRequest *request) {
 		if (!Configuration::currentConfig.WiFiClient) {
-			if (request->hasParam("time", true) && request->hasParam("offset")) {
+			if (request->hasParam("time", true) && request->hasParam("offset", true)) {
 				// Parse data payload
 				long time = request->getParam("time", true)->value().toInt();
 				long offset = request->getParam("offset", true)->value().toInt();
@@ -417,16 +386,27 @@ bool Webserver::ServerStart() {
 			request->send(HTTP_CODE_OK, "text/plain", "OK");
 			Serial.println("Time already set by NTP");
 		}
-	});
-
-	// Handle request for the amount of free space on the storage device (example of returning JSON data)
-	server->on("/freeSpace", HTTP_GET, [this](AsyncWebServerRequest *request) {	
-		String result = "{ \"space\": " + String(Storage::freeSpace()) + " }";
+	}, { auth });
+
+	// Get how long each stage of startup took
+	router->on("/boot", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		request->send(HTTP_CODE_OK, "text/json", Startup::getTimings());
+	}, { auth });
+
+	// Get how often each API route was used and how long it took to handle
+	router->on("/routes", HTTP_GET, [router](AsyncWebServerRequest *request) {
+		request->send(HTTP_CODE_OK, "text/json", router->getMetrics());
+	}, { auth });
+
+	// Handle request for the amount of free space on the storage device (example of returning JSON data), add "path" to check the medium storing a path
+	router->on("/freeSpace", HTTP_GET, [this](AsyncWebServerRequest *request) {	
+		String path = request->hasParam("path") ? request->getParam("path")->value() : "/";
+		String result = "{ \"space\": " + String(Storage::refreshFreeSpace(path)) + " }";
 		request->send(HTTP_CODE_OK, "text/json", result);
-	});
+	}, { auth });
 
 	// Handle reset request
-	server->on("/reset", HTTP_PUT, [this](AsyncWebServerRequest *request) {
+	router->on("/reset", HTTP_PUT, [this](AsyncWebServerRequest *request) {
 		Serial.println("Resetting WiFi settings");
 		 if (Storage::fileExists("/www/reset.html")) {
 			request->send(*Storage::getFileSystem(), "/www/reset.html", "text/html");
@@ -438,80 +418,170 @@ bool Webserver::ServerStart() {
 		WiFi.disconnect(true, true);
 		WiFi.persistent(false);
 		Webserver::shouldReboot = true;
-	});
+	}, { auth });
 
 	// Handle reboot request
-	server->on("/reboot", HTTP_PUT, [this](AsyncWebServerRequest *request) {
+	router->on("/reboot", HTTP_PUT, [this](AsyncWebServerRequest *request) {
 		if (Storage::fileExists("/www/reboot.html")) {
 			request->send(*Storage::getFileSystem(), "/www/reboot.html", "text/html");
 		} else {
 			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		}
 		Webserver::shouldReboot = true;
-	});
+	}, { auth });
 
 	// Handle listing files
-	server->on("/list", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("path")) {
-			String path = request->getParam("path")->value();
-			if (Storage::fileExists(path)) {
-				int depth = 0;
-				if (request->hasParam("depth")) {
-					depth = request->getParam("depth")->value().toInt();
-				}
-				std::vector<String> file_list = Storage::listFiles(path, depth);
-				JsonDocument files;
-				for (int i = 0; i < file_list.size(); i++) {
-					files["files"][i] = file_list[i];
-				}
-				String files_string;
-				serializeJson(files, files_string);
-				request->send(HTTP_CODE_OK, "text/json", files_string);
-			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Folder doesn't exist");
+	router->on("/list", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String path = request->getParam("path")->value();
+		if (Storage::fileExists(path)) {
+			int depth = 0;
+			if (request->hasParam("depth")) {
+				depth = request->getParam("depth")->value().toInt();
+			}
+			size_t offset = 0;
+			if (request->hasParam("offset")) {
+				offset = request->getParam("offset")->value().toInt();
 			}
+			size_t limit = SIZE_MAX;
+			if (request->hasParam("limit")) {
+				limit = request->getParam("limit")->value().toInt();
+			}
+			String glob = "*";
+			if (request->hasParam("glob")) {
+				glob = request->getParam("glob")->value();
+			}
+			std::vector<Storage::entry> file_list;
+			size_t total = Storage::listEntries(path, depth, file_list, offset, limit, glob);
+			JsonDocument files;
+			files["total"] = total;
+			files["offset"] = offset;
+			JsonArray file_array = files["files"].to<JsonArray>();
+			for (const auto& f : file_list) {
+				JsonObject file = file_array.add<JsonObject>();
+				file["path"] = f.path;
+				file["size"] = f.size;
+				file["modified"] = f.modified;
+			}
+			String files_string;
+			serializeJson(files, files_string);
+			request->send(HTTP_CODE_OK, "text/json", files_string);
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Folder doesn't exist");
 		}
-	});
+	}, { auth, Router::params({ "path" }), memory, Router::rateLimit(1, 3) });
 
 	// Handle downloads
-	server->on("/download", HTTP_GET, [this](AsyncWebServerRequest *request) {
-		if (request->hasParam("path")) {
-			String path = request->getParam("path")->value();
-			if (Storage::fileExists(path)) {
-				request->send(*Storage::getFileSystem(), path, "application/octet-stream");
+	router->on("/download", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String path = request->getParam("path")->value();
+		if (Storage::fileExists(path)) {
+			sendFile(request, path, "application/octet-stream");
+		} else {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
+		}
+	}, { auth, Router::params({ "path" }), memory, Router::rateLimit(1, 3) });
+
+	// Gets the rows of a data file logged between two times (/data/query?path=/data/LocalData.csv&from=1718000000&to=1718086400), found using the file's time index
+	// Add "format=bin" for compact binary records, or "format=msgpack" (or send "Accept: application/msgpack") for MessagePack
+	router->on("/data/query", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String path = request->getParam("path")->value();
+		if (Storage::fileExists(path)) {
+			uint32_t from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+			uint32_t to = UINT32_MAX;
+			if (request->hasParam("to")) {
+				to = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+			}
+			File file = Storage::getFileSystem(path)->open(path);
+			// Always include the column header
+			String header = file.readStringUntil('\n') + '\n';
+			std::tuple<size_t, size_t> range = TimeIndex::findRange(path, from, to);
+			size_t start = std::max(std::get<0>(range), (size_t)header.length());
+			size_t end = std::max(std::min(std::get<1>(range), file.size()), start);
+			String format = request->hasParam("format") ? request->getParam("format")->value() : (acceptsMsgPack(request) ? "msgpack" : "csv");
+			if (format == "bin" || format == "msgpack") {
+				request->send(beginBinaryRows(request, file, start, end, header, format == "msgpack"));
 			} else {
-				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
+				request->send(beginFileSlice(request, file, start, end - start, "text/csv", header));
 			}
 		} else {
-			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
 		}
-	});
+	}, { auth, Router::params({ "path", "from" }), memory, Router::rateLimit(1, 3) });
+
+	// Gets the rows of a data file added after a cursor (/data/since?path=/data/LocalData.csv&cursor=0), the cursor to use next time is returned in the X-Next-Cursor header
+	// Add "format=bin" for compact binary records or "format=msgpack" (or send "Accept: application/msgpack") for MessagePack, and "limit" to set the maximum number of bytes of rows to read (default 64KB)
+	router->on("/data/since", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		String path = request->getParam("path")->value();
+		if (Storage::fileExists(path)) {
+			uint64_t cursor = 0;
+			if (request->hasParam("cursor")) {
+				cursor = strtoull(request->getParam("cursor")->value().c_str(), nullptr, 10);
+			}
+			size_t limit = 65536;
+			if (request->hasParam("limit")) {
+				limit = std::max(request->getParam("limit")->value().toInt(), 1024L);
+			}
+			String format = request->hasParam("format") ? request->getParam("format")->value() : (acceptsMsgPack(request) ? "msgpack" : "csv");
+			uint32_t generation = TimeIndex::getGeneration(path);
+			File file = Storage::getFileSystem(path)->open(path);
+			String header = file.readStringUntil('\n') + '\n';
+			// Start from the cursor if it points into the current data file, otherwise start over
+			size_t start = header.length();
+			bool resume = (cursor >> 32) == generation && (cursor & 0xFFFFFFFF) >= start && (cursor & 0xFFFFFFFF) <= file.size();
+			if (resume) {
+				start = cursor & 0xFFFFFFFF;
+			}
+			size_t end = rowBoundary(file, start, std::min(file.size(), start + limit));
+			AsyncWebServerResponse *response;
+			if (format == "bin" || format == "msgpack") {
+				response = beginBinaryRows(request, file, start, end, header, format == "msgpack");
+			} else {
+				// Include the column header when starting over
+				response = beginFileSlice(request, file, start, end - start, "text/csv", resume ? "" : header);
+			}
+			char next_cursor[21];
+			snprintf(next_cursor, sizeof(next_cursor), "%llu", TimeIndex::cursor(generation, end));
+			response->addHeader("X-Next-Cursor", next_cursor);
+			request->send(response);
+		} else {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
+		}
+	}, { auth, Router::params({ "path" }), memory, Router::rateLimit(2, 5) });
 
 	// Update page is special and hard-coded to always be available
-	server->on("/update", HTTP_GET, [this](AsyncWebServerRequest *request) {
+	router->on("/update", HTTP_GET, [this](AsyncWebServerRequest *request) {
 		request->send_P(HTTP_CODE_OK, "text/html", update_page);
 	});
 
 	// Used to fetch current firmware version
-	server->on("/version", HTTP_GET, [this](AsyncWebServerRequest *request) {
+	router->on("/version", HTTP_GET, [this](AsyncWebServerRequest *request) {
 		request->send(HTTP_CODE_OK, "text/json", "{\"version\":\"" + FW_VERSION + "\"}");
 	});
 
-	// Update firmware
-	server->on("/update", HTTP_POST, [this](AsyncWebServerRequest *request) {
+	// Update firmware, add "inflate" for a gzip compressed image and "delta" for a delta made with tools/make_delta.py (both for a compressed delta)
+	router->on("/update", HTTP_POST, [this](AsyncWebServerRequest *request) {
 		// Let update start
 		delay(50);
 		
 		// Check if should reboot
-		Webserver::shouldReboot = !Update.hasError();
+		Webserver::shouldReboot = !Update.hasError() && UploadStream::getStatus(request) < 300;
 
 		// Construct response
 		AsyncWebServerResponse *response = request->beginResponse(Webserver::shouldReboot ? HTTP_CODE_ACCEPTED : HTTP_CODE_INTERNAL_SERVER_ERROR, "text/plain", this->Webserver::shouldReboot ? "OK" : "ERROR");
 		response->addHeader("Connection", "close");
 		request->send(response);
-	}, onUpdate);    
+	}, { auth }, onUpdate);
+
+	// A refused route (a duplicate, or a path whose hash collides with another) would never be served, the router logs which
+	if (!router->allRegistered()) {
+		Serial.println("Could not register all API routes");
+		return false;
+	}
+
+	// Add the API routes
+	server->addHandler(router);
+
+	// Serve web interface files from storage (added last so API routes take precedence)
+	server->addHandler(assets);
 
 	// 404 handler
 	server->onNotFound([](AsyncWebServerRequest *request) { 
@@ -540,6 +610,8 @@ void Webserver::RebootChecker() {
 	while (true) {
 		if (Webserver::shouldReboot) {
 			Serial.println("Rebooting from API call...");
+			DeviceConfig::flushConfigs(true);
+			Storage::flush(true);
 			// Delay to show LED and let server send response
 			EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Rebooting);
 			delay(3000 );
@@ -550,6 +622,295 @@ void Webserver::RebootChecker() {
 	}
 }
 
+/// @brief Sends a file, supporting conditional and range requests so interrupted downloads can be resumed
+/// @param request The request to respond to
+/// @param path The path of the file to send
+/// @param contentType The content type of the file
+void Webserver::sendFile(AsyncWebServerRequest *request, String path, String contentType) {
+	File file = Storage::getFileSystem(path)->open(path);
+	size_t size = file.size();
+	time_t modified = file.getLastWrite();
+	String etag = "\"" + String(size) + "-" + String((unsigned long)modified) + "\"";
+	char last_modified[30];
+	strftime(last_modified, sizeof(last_modified), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&modified));
+	if (WebAssets::notModified(request, etag)) {
+		file.close();
+		return;
+	}
+	// Only honor a range if the client's copy is still current (If-Range), otherwise send the whole file
+	bool use_range = request->hasHeader("Range");
+	if (use_range && request->hasHeader("If-Range")) {
+		String if_range = request->header("If-Range");
+		use_range = if_range == etag || if_range == last_modified;
+	}
+	size_t start = 0;
+	size_t end = size - 1;
+	if (use_range) {
+		// Single ranges only ("bytes=start-end", "bytes=start-", or "bytes=-suffix"), anything else gets the whole file
+		String range = request->header("Range");
+		int dash = range.indexOf('-');
+		if (!range.startsWith("bytes=") || range.indexOf(',') != -1 || dash == -1) {
+			use_range = false;
+		} else {
+			String first = range.substring(6, dash);
+			String last = range.substring(dash + 1);
+			if (first.length() > 0) {
+				start = strtoul(first.c_str(), nullptr, 10);
+				if (last.length() > 0) {
+					end = std::min((size_t)strtoul(last.c_str(), nullptr, 10), size - 1);
+				}
+			} else {
+				size_t suffix = strtoul(last.c_str(), nullptr, 10);
+				start = suffix < size ? size - suffix : 0;
+			}
+			if (size == 0 || start > end) {
+				file.close();
+				AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_RANGE_NOT_SATISFIABLE);
+				response->addHeader("Content-Range", "bytes */" + String(size));
+				request->send(response);
+				return;
+			}
+		}
+	}
+	AsyncWebServerResponse *response;
+	if (use_range) {
+		response = beginFileSlice(request, file, start, end - start + 1, contentType);
+		response->setCode(HTTP_CODE_PARTIAL_CONTENT);
+		response->addHeader("Content-Range", "bytes " + String(start) + "-" + String(end) + "/" + String(size));
+	} else {
+		response = request->beginResponse(file, path, contentType);
+	}
+	response->addHeader("Accept-Ranges", "bytes");
+	response->addHeader("ETag", etag);
+	response->addHeader("Last-Modified", last_modified);
+	request->send(response);
+}
+
+/// @brief Creates a response that streams part of a file, without loading it into memory
+/// @param request The request being responded to
+/// @param file The open file to send from
+/// @param start The byte offset to start sending from
+/// @param length The number of bytes to send
+/// @param contentType The content type of the response
+/// @param prefix Optional content to send before the file contents
+/// @return The response
+AsyncWebServerResponse* Webserver::beginFileSlice(AsyncWebServerRequest *request, File file, size_t start, size_t length, String contentType, String prefix) {
+	return request->beginResponse(contentType, prefix.length() + length, [file, start, length, prefix](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+		size_t written = 0;
+		// Send any prefix first
+		if (index < prefix.length()) {
+			written = std::min(maxLen, prefix.length() - index);
+			memcpy(buffer, prefix.c_str() + index, written);
+		}
+		// Then the requested part of the file
+		size_t position = index + written - prefix.length();
+		if (written < maxLen && position < length) {
+			if (file.position() != start + position) {
+				file.seek(start + position);
+			}
+			written += file.read(buffer + written, std::min(maxLen - written, length - position));
+		}
+		return written;
+	});
+}
+
+/// @brief Finds the end of the last complete row of a data file before a position
+/// @param file The open data file
+/// @param start The byte offset of the first row being read
+/// @param end The byte offset to search back from
+/// @return The byte offset just past the last complete row, or start if there are none
+size_t Webserver::rowBoundary(File& file, size_t start, size_t end) {
+	uint8_t buffer[128];
+	while (end > start) {
+		size_t chunk = std::min(sizeof(buffer), end - start);
+		file.seek(end - chunk);
+		file.read(buffer, chunk);
+		for (int i = chunk - 1; i >= 0; i--) {
+			if (buffer[i] == '\n') {
+				return end - chunk + i + 1;
+			}
+		}
+		end -= chunk;
+	}
+	return start;
+}
+
+/// @brief Creates a response that converts rows of a CSV data file to compact binary records as they are sent.
+/// The response starts with "SHB1" and the number of values per record (uint16), then each record is the time the row was logged
+/// in local time as seconds since the epoch (uint32) followed by the values (float32). All numbers are little-endian.
+/// As MessagePack, the response is a sequence of MessagePack objects: a map with the column names ({"columns": [...]}), then an
+/// array for each row holding the time (uint32) followed by the values (float32, or nil for a missing value).
+/// @param request The request being responded to
+/// @param file The open data file
+/// @param start The byte offset of the first row to send
+/// @param end The byte offset just past the last row to send
+/// @param header The column header of the data file
+/// @param msgpack True to send MessagePack instead of SHB1 records
+/// @return The response
+AsyncWebServerResponse* Webserver::beginBinaryRows(AsyncWebServerRequest *request, File file, size_t start, size_t end, String header, bool msgpack) {
+	// The first column is the time
+	uint16_t columns = 0;
+	for (const char c : header) {
+		if (c == ',') {
+			columns++;
+		}
+	}
+	std::vector<uint8_t> pending;
+	if (msgpack) {
+		JsonDocument doc;
+		JsonArray names = doc["columns"].to<JsonArray>();
+		header.trim();
+		int position = 0;
+		while (position <= header.length()) {
+			int comma = header.indexOf(',', position);
+			if (comma < 0) {
+				comma = header.length();
+			}
+			names.add(header.substring(position, comma));
+			position = comma + 1;
+		}
+		pending.resize(measureMsgPack(doc));
+		serializeMsgPack(doc, pending.data(), pending.size());
+	} else {
+		pending = { 'S', 'H', 'B', '1', (uint8_t)(columns & 0xFF), (uint8_t)(columns >> 8) };
+	}
+	file.seek(start);
+	return request->beginChunkedResponse(msgpack ? "application/msgpack" : "application/octet-stream", [file, end, columns, pending, msgpack](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+		// Convert rows until there's enough to fill the buffer
+		while (pending.size() < maxLen && file.position() < end) {
+			String row = file.readStringUntil('\n');
+			uint32_t seconds;
+			if (!TimeIndex::parseTime(row.c_str(), seconds)) {
+				continue;
+			}
+			if (msgpack) {
+				// Array of the time and values, with big-endian numbers
+				uint16_t items = columns + 1;
+				if (items < 16) {
+					pending.push_back(0x90 | items);
+				} else {
+					pending.insert(pending.end(), { 0xDC, (uint8_t)(items >> 8), (uint8_t)(items & 0xFF) });
+				}
+				pending.insert(pending.end(), { 0xCE, (uint8_t)(seconds >> 24), (uint8_t)(seconds >> 16), (uint8_t)(seconds >> 8), (uint8_t)seconds });
+			} else {
+				pending.insert(pending.end(), (uint8_t*)&seconds, (uint8_t*)&seconds + sizeof(seconds));
+			}
+			const char* field = strchr(row.c_str(), ',');
+			for (int i = 0; i < columns; i++) {
+				float value = NAN;
+				if (field != nullptr) {
+					// Cells that aren't numbers (e.g. "null" for a failed reading) are left as NaN instead of being read as 0
+					char* end;
+					float parsed = strtof(field + 1, &end);
+					if (end != field + 1) {
+						value = parsed;
+					}
+					field = strchr(field + 1, ',');
+				}
+				if (!msgpack) {
+					pending.insert(pending.end(), (uint8_t*)&value, (uint8_t*)&value + sizeof(value));
+				} else if (isnan(value)) {
+					pending.push_back(0xC0);
+				} else {
+					uint32_t bits;
+					memcpy(&bits, &value, sizeof(bits));
+					pending.insert(pending.end(), { 0xCA, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits });
+				}
+			}
+		}
+		size_t length = std::min(maxLen, pending.size());
+		memcpy(buffer, pending.data(), length);
+		pending.erase(pending.begin(), pending.begin() + length);
+		return length;
+	});
+}
+
+/// @brief Checks if a request asks for a MessagePack response
+/// @param request The request
+/// @return True if its Accept header includes MessagePack
+bool Webserver::acceptsMsgPack(AsyncWebServerRequest *request) {
+	if (!request->hasHeader("Accept")) {
+		return false;
+	}
+	String accept = request->header("Accept");
+	accept.toLowerCase();
+	return accept.indexOf("application/msgpack") >= 0 || accept.indexOf("application/x-msgpack") >= 0;
+}
+
+/// @brief Sends a document as MessagePack
+/// @param request The request
+/// @param doc The document
+/// @param etag The entity tag of the document, empty for none
+void Webserver::sendMsgPack(AsyncWebServerRequest *request, JsonDocument& doc, String etag) {
+	AsyncResponseStream *response = request->beginResponseStream("application/msgpack");
+	serializeMsgPack(doc, *response);
+	if (!etag.isEmpty()) {
+		response->addHeader("ETag", etag);
+		response->addHeader("Cache-Control", "no-cache");
+	}
+	response->addHeader("Vary", "Accept");
+	request->send(response);
+}
+
+/// @brief Sends a cached description, as MessagePack if the client asks for it, or a 304 response if the client already has it
+/// @param request The request
+/// @param description The description
+/// @param etag The entity tag of the description
+void Webserver::sendDescription(AsyncWebServerRequest *request, String description, String etag) {
+	bool msgpack = acceptsMsgPack(request);
+	if (msgpack) {
+		// Each representation needs its own tag
+		etag = etag.substring(0, etag.length() - 1) + "-msgpack\"";
+	}
+	if (WebAssets::notModified(request, etag)) {
+		return;
+	}
+	if (msgpack) {
+		JsonDocument doc;
+		deserializeJson(doc, description);
+		sendMsgPack(request, doc, etag);
+		return;
+	}
+	AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_OK, "text/json", description);
+	response->addHeader("ETag", etag);
+	response->addHeader("Cache-Control", "no-cache");
+	response->addHeader("Vary", "Accept");
+	request->send(response);
+}
+
+/// @brief Queues a webhook request and responds with its ID
+/// @param request The request holding the position ID of the webhook
+/// @param method The HTTP method to send the webhook with
+/// @param parameters A JSON string of the parameters for the webhook, empty for none
+/// @param json True to send the parameters as a JSON body
+void Webserver::queueWebhook(AsyncWebServerRequest *request, Webhook::Method method, String parameters, bool json) {
+	if (!parameters.isEmpty()) {
+		// Check the parameters now, rather than failing once the request is sent
+		JsonDocument doc;
+		DeserializationError error = deserializeJson(doc, parameters);
+		if (error || (!json && !doc.is<JsonObject>())) {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad JSON parameter data");
+			return;
+		}
+	}
+	respondQueued(request, WebhookManager::queueRequest(request->getParam("webhook", true)->value().toInt(), method, parameters, json));
+}
+
+/// @brief Responds to a request that queued a webhook
+/// @param request The request
+/// @param id The ID of the queued webhook request, or the error from WebhookManager
+void Webserver::respondQueued(AsyncWebServerRequest *request, int64_t id) {
+	if (id == -1) {
+		request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad PositionID data");
+	} else if (id == -2) {
+		AsyncWebServerResponse *response = request->beginResponse(HTTP_CODE_SERVICE_UNAVAILABLE, "text/plain", "Too many webhook requests waiting");
+		response->addHeader("Retry-After", "1");
+		request->send(response);
+	} else {
+		request->send(HTTP_CODE_ACCEPTED, "text/json", "{\"id\":" + String((uint32_t)id) + "}");
+	}
+}
+
 /// @brief Handle file uploads to a folder. Adapted from https://github.com/smford/esp32-asyncwebserver-fileupload-example
 /// @param request
 /// @param filename
@@ -559,37 +920,39 @@ void Webserver::RebootChecker() {
 /// @param final
 void Webserver::onUpload_file(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
 	if (!index) {
+		bool inflate = request->hasParam("inflate");
+		if (!UploadStream::begin(request, UploadStream::Sink::File, filename, inflate)) {
+			return;
+		}
 		if (!request->hasHeader("FILE_UPLOAD_PATH")) {
-			final = true;
-			Webserver::upload_abort = true;
-			Webserver::upload_response_code = HTTP_CODE_BAD_REQUEST;
+			UploadStream::fail(request, HTTP_CODE_BAD_REQUEST, "Bad request data");
 			return;
 		}
 		String path = request->header("FILE_UPLOAD_PATH");
-		Webserver::upload_abort = false;
-		request->_tempFile = Storage::getFileSystem()->open(path + "/" + filename, "w", true);
+		String name = inflate && filename.endsWith(".gz") ? filename.substring(0, filename.length() - 3) : filename;
+		request->_tempFile = Storage::getFileSystem(path)->open(path + "/" + name, "w", true);
+		if (!request->_tempFile) {
+			UploadStream::fail(request, HTTP_CODE_INSUFFICIENT_STORAGE, "Could not open file");
+			return;
+		}
 		Serial.println("Uploading file " + filename);
 	}
-	if (Webserver::upload_abort)
+	// Stream the incoming chunk to the opened file
+	bool written = UploadStream::write(request, data, len);
+	if (!final || !request->_tempFile) {
 		return;
-	if (len) {
-		// Stream the incoming chunk to the opened file
-		if (request->_tempFile.write(data, len) != len) {
-			final = true;
-			Webserver::upload_abort = true;
-			Webserver::upload_response_code = HTTP_CODE_INSUFFICIENT_STORAGE;
-		}
 	}
-	if (final) {
-		// Close the file handle as the upload is now done
-		String path = request->_tempFile.path();
-		request->_tempFile.close();
-		if (Webserver::upload_abort) {
-			// Remove failed upload
-			Storage::deleteFile(path);
-		} else {
-			Webserver::upload_response_code = HTTP_CODE_CREATED;
-		}
+	// Close the file handle as the upload is now done, even if writing failed part way so the partial file can be removed
+	String path = request->_tempFile.path();
+	bool success = written && UploadStream::end(request);
+	request->_tempFile.close();
+	if (!success) {
+		// Remove failed upload
+		Storage::deleteFile(path);
+	} else {
+		Storage::refreshEntry(path);
+		Storage::refreshFreeSpace(path);
+		assets->refresh(path);
 	}
 }
 
@@ -605,28 +968,32 @@ void Webserver::onUpdate(AsyncWebServerRequest *request, String filename, size_t
 	{
 		Serial.printf("Update Start: %s\n", filename.c_str());
 		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Updating);
+		if (!UploadStream::begin(request, UploadStream::Sink::Firmware, "firmware", request->hasParam("inflate"), request->hasParam("delta"))) {
+			return;
+		}
 		// Ensure firmware will fit into flash space
 		if (!Update.begin((ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000))
 		{
 			Update.printError(Serial);
+			UploadStream::fail(request, HTTP_CODE_INTERNAL_SERVER_ERROR, "Could not start update");
 		}
 	}
-	if (!Update.hasError())
-	{
-		if (Update.write(data, len) != len)
-		{
-			Update.printError(Serial);
+	if (!UploadStream::write(request, data, len) || !final) {
+		if (Update.isRunning() && UploadStream::getStatus(request) >= 300) {
+			// Don't leave a failed update half written
+			Update.abort();
 		}
+		return;
 	}
-	if (final)
+	if (UploadStream::end(request) && Update.end(true))
 	{
-		if (Update.end(true))
-		{
-			Serial.printf("Update Success: %uB\n", index + len);
-		}
-		else
-		{
-			Update.printError(Serial);
+		Serial.printf("Update Success: %uB\n", index + len);
+	}
+	else
+	{
+		if (Update.isRunning()) {
+			Update.abort();
 		}
+		Update.printError(Serial);
 	}
-}
\ No newline at end of file
+}
@@ -20,11 +20,19 @@
 #include <ESP32Time.h>
 #include <Storage.h>
 #include <Configuration.h>
+#include <ConfigStore.h>
 #include <SensorManager.h>
 #include <SignalManager.h>
 #include <WebhookManager.h>
+#include <MqttManager.h>
 #include <HTTPClient.h>
 #include <EventBroadcaster.h>
+#include <WebAssets.h>
+#include <MeasurementStream.h>
+#include <TimeIndex.h>
+#include <Startup.h>
+#include <UploadStream.h>
+#include <Router.h>
 #include <vector>
 
 /// @brief Local web server.
@@ -42,17 +50,29 @@ class Webserver {
 		/// @brief RTC object for setting and getting time of device
         ESP32Time* rtc;
 
-		/// @brief Used to indicate an upload had to be aborted
-		static bool upload_abort;
-
-		/// @brief Used to indicate the status code of the last upload
-		static int upload_response_code;
-
 		/// @brief Used to signal that a reboot is requested or needed
 		static bool shouldReboot;
 
+		/// @brief Serves the web interface, its index of stored files is updated as files are uploaded and deleted
+		static WebAssets* assets;
+
+		/// @brief Maximum number of API requests to respond to at once
+		static const uint16_t max_in_flight = 6;
+
+		/// @brief Size in bytes of the largest free block of memory needed to start handlers that build large responses
+		static const uint32_t min_free_block = 16384;
+
+		static void sendFile(AsyncWebServerRequest *request, String path, String contentType);
+		static AsyncWebServerResponse* beginFileSlice(AsyncWebServerRequest *request, File file, size_t start, size_t length, String contentType, String prefix = "");
+		static size_t rowBoundary(File& file, size_t start, size_t end);
+		static AsyncWebServerResponse* beginBinaryRows(AsyncWebServerRequest *request, File file, size_t start, size_t end, String header, bool msgpack = false);
+		static bool acceptsMsgPack(AsyncWebServerRequest *request);
+		static void sendMsgPack(AsyncWebServerRequest *request, JsonDocument& doc, String etag = "");
 		static void onUpload_file(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
 		static void onUpdate(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
+		static void sendDescription(AsyncWebServerRequest *request, String description, String etag);
+		static void queueWebhook(AsyncWebServerRequest *request, Webhook::Method method, String parameters, bool json);
+		static void respondQueued(AsyncWebServerRequest *request, int64_t id);
 		void RebootChecker();
 };
 
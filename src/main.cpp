@@ -12,7 +12,9 @@
 #include <ESP32Time.h>
 #include <Storage.h>
 #include <WebhookManager.h>
+#include <MqttManager.h>
 #include <Configuration.h>
+#include <ConfigStore.h>
 #include <EventBroadcaster.h>
 #include <SignalManager.h>
 #include <WebServer.h>
@@ -22,8 +24,11 @@
 #include <PeriodicTasks.h>
 #include <LEDIndicator.h>
 #include <LocalDataLogger.h>
+#include <LogCompactor.h>
+#include <TelemetryExporter.h>
 #include <DataTemplate.h>
 #include <TimerSwitch.h>
+#include <Startup.h>
 
 /// @brief Current firmware version
 extern const String FW_VERSION = "0.5.0";
@@ -40,6 +45,9 @@ ESP32Time rtc;
 /// @brief AsyncWebServer object (passed to WfiFiConfig and WebServer)
 AsyncWebServer server(80);
 
+/// @brief Webserver handling all requests
+Webserver webserver(&server, &rtc);
+
 /******** Declare sensor and receiver objects here ********/
 
 /// @brief LED indicator object
@@ -51,6 +59,12 @@ ResetButton reset_button(D4);
 /// @brief For logging data to local storage
 LocalDataLogger logger(&rtc);
 
+/// @brief For downsampling old data logger segments
+LogCompactor compactor(&rtc);
+
+/// @brief For pushing data to a remote collector
+TelemetryExporter exporter(&rtc);
+
 /// @brief For retrieving data formatted for Prometheus
 DataTemplate schema_maker;
 
@@ -89,92 +103,86 @@ void setup() {
 		while(true);
 	};
 
-	// Start storage
-	if (!Storage::begin()) {
-		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
-		Serial.println("Could not start storage");
-		while(true);
-	}
-
-	// Start configuration manager
-	if (!Configuration::begin()) {
-		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
-		Serial.println("Could not start configuration manager");
-		while(true);
-	}
-
-	if (Configuration::currentConfig.WiFiClient) {
-		// Configure WiFi client
-		DNSServer dns;
-		AsyncWiFiManager manager(&server, &dns);
-		WiFiConfig configurator(&manager, Configuration::currentConfig.configSSID, Configuration::currentConfig.configPW);
-		configurator.connectWiFi();
-		WiFi.setAutoReconnect(true);
-		server.reset();
-		// Set local time via NTP
-		configTime(Configuration::currentConfig.gmtOffset_sec, Configuration::currentConfig.daylightOffset_sec, Configuration::currentConfig.ntpServer.c_str());
-		Serial.println("Time set via NTP");
-	} else {
-		// Start AP
-		WiFi.softAP(Configuration::currentConfig.configSSID, Configuration::currentConfig.configPW);
-	}
-	
-	/// @brief Webserver handling all requests
-	Webserver webserver(&server, &rtc);
-
-	// Clear server settings, just in case
-	webserver.ServerStop();
-
-	// Start the update server
-	webserver.ServerStart();
-	xTaskCreate(Webserver::RebootCheckerTaskWrapper, "Reboot Checker Loop", 1024, &webserver, 1, NULL);
-
-	// Load saved configuration if there is one
-	if (!Configuration::loadConfig()) {
-		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
-		Serial.println("Could not load configuration");
-		while(true);
-	}
-
-	/// Start webhooks
-	if (!WebhookManager::begin("webhooks.json")) {
-		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
-		Serial.println("Could not start webhook manager");
-		while(true);
-	}
-
 	/******** Add sensors and receivers here ********/
 
 	SignalManager::addReceiver(&reset_button);
 	SignalManager::addReceiver(&logger);
+	SignalManager::addReceiver(&compactor);
+	SignalManager::addReceiver(&exporter);
 	SignalManager::addReceiver(&schema_maker);
 	SignalManager::addReceiver(&timer1);
 
 	/******** End sensor and receiver addition section ********/
 
-	// Start sensors
-	if (!SensorManager::beginSensors()) {
-		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
-		while(true);
-	}
-
-	// Start receivers
-	if (!SignalManager::beginReceivers()) {
+	// Describe the stages of startup, stages that don't depend on each other run at the same time
+	Startup::addStage("storage", []() {
+		// To keep data logs on an SD card, also mount it for "/data", e.g. Storage::begin(clk, cmd, d0, d1, d2, d3, "/data")
+		return Storage::begin();
+	});
+	Startup::addStage("config", []() {
+		// Load saved configuration if there is one
+		return ConfigStore::begin() && Configuration::begin() && Configuration::loadConfig() && WebhookManager::begin("webhooks.json");
+	}, { "storage" });
+	Startup::addStage("wifi", []() {
+		if (Configuration::currentConfig.WiFiClient) {
+			// Configure WiFi client
+			DNSServer dns;
+			AsyncWiFiManager manager(&server, &dns);
+			WiFiConfig configurator(&manager, Configuration::currentConfig.configSSID, Configuration::currentConfig.configPW);
+			configurator.connectWiFi();
+			WiFi.setAutoReconnect(true);
+			server.reset();
+		} else {
+			// Start AP
+			WiFi.softAP(Configuration::currentConfig.configSSID, Configuration::currentConfig.configPW);
+		}
+		return true;
+	}, { "config" });
+	Startup::addStage("webserver", []() {
+		// Clear server settings, just in case
+		webserver.ServerStop();
+		// Start the update server
+		return webserver.ServerStart();
+	}, { "wifi" });
+	Startup::addStage("sensors", []() {
+		return SensorManager::beginSensors();
+	}, { "config" });
+	// Receivers such as the data logger read the sensor descriptions when they start
+	Startup::addStage("receivers", []() {
+		return SignalManager::beginReceivers();
+	}, { "config", "sensors" });
+	// Not needed to be ready, so done in the background afterwards
+	Startup::addStage("ntp", []() {
+		if (Configuration::currentConfig.WiFiClient) {
+			// Set local time via NTP
+			configTime(Configuration::currentConfig.gmtOffset_sec, Configuration::currentConfig.daylightOffset_sec, Configuration::currentConfig.ntpServer.c_str());
+			Serial.println("Time set via NTP");
+		}
+		return true;
+	}, { "wifi" }, true);
+	Startup::addStage("mqtt", []() {
+		// Load MQTT settings, the broker is connected to from the main loop
+		return MqttManager::begin("mqtt.json");
+	}, { "config" });
+	Startup::addStage("webhooks", []() {
+		// Load saved webhooks if any
+		return WebhookManager::loadWebhooks();
+	}, { "config" }, true);
+
+	if (!Startup::run()) {
 		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
+		Serial.println("Could not start");
 		while(true);
 	}
+	xTaskCreate(Webserver::RebootCheckerTaskWrapper, "Reboot Checker Loop", 8192, &webserver, 1, NULL);
 
-	// Load saved webhooks if any
-	if (!WebhookManager::loadWebhooks()) {
-		EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Error);
-		Serial.println("Could not load webhooks");
-		while(true);
-	}
+	// Store any configuration moved from JSON files or created with defaults
+	DeviceConfig::flushConfigs(true);
+	ConfigStore::commit();
 
-	// Print the configured sensors, receivers, and webhooks
+	// Print the configured sensors and receivers
 	Serial.println(SensorManager::getSensorInfo());
 	Serial.println(SignalManager::getReceiverInfo());
-	Serial.println(WebhookManager::getWebhooks());
 
 	// Start signal processor loop (8K of stack depth is probably overkill, but it does process potentially large JSON strings and we have the RAM, so better to be safe)
 	xTaskCreate(SignalManager::signalProcessor, "Command Processor Loop", 8192, NULL, 1, NULL);
@@ -183,6 +191,9 @@ void setup() {
 	EventBroadcaster::broadcastEvent(EventBroadcaster::Events::Ready);
 	Serial.println("System ready!");
 	POSTSuccess = true;
+
+	// Finish the deferred startup stages
+	Startup::runDeferred();
 }
 
 // Used for tracking time intervals for timed events
@@ -201,6 +212,12 @@ void loop() {
 			previous_millis_ntp = current_mills;
 		}
 	}
+	// Write any config changes that have settled
+	DeviceConfig::flushConfigs();
+	// Write any staged appends that are ready
+	Storage::flush();
+	// Keep the MQTT connection up and send queued messages
+	MqttManager::loop();
 	if (Configuration::currentConfig.tasksEnabled) {
 		// Perform tasks periodically
 		if (current_mills - previous_mills_task > Configuration::currentConfig.period) {
@@ -0,0 +1,97 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* The parts of the Arduino core and FreeRTOS used by the hub's libraries, implemented on the host so the libraries can be
+* unit tested with "pio test -e native". Time is real time, tasks are threads, and semaphores are mutexes.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <cctype>
+#include <cmath>
+#include <math.h>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/types.h>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <WString.h>
+#include <Print.h>
+#include <Stream.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define F(string) (string)
+#define strlcpy host_strlcpy
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+size_t host_strlcpy(char* destination, const char* source, size_t size);
+
+/// @brief Writes to standard output
+class HardwareSerial : public Print {
+	public:
+		void begin(unsigned long baud);
+		size_t write(uint8_t c) override;
+		size_t write(const uint8_t* buffer, size_t size) override;
+};
+
+extern HardwareSerial Serial;
+
+/// @brief Reports memory as plentiful
+class EspClass {
+	public:
+		uint32_t getFreeHeap();
+		uint32_t getMaxAllocHeap();
+		void restart();
+};
+
+extern EspClass ESP;
+
+// FreeRTOS
+typedef void* SemaphoreHandle_t;
+typedef void* QueueHandle_t;
+typedef void* TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore);
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack, void* parameters, UBaseType_t priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack, void* parameters, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
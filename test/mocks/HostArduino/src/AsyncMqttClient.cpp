@@ -0,0 +1,202 @@
+#include "AsyncMqttClient.h"
+
+FakeBroker MqttBroker;
+
+/// @brief Runs the callbacks waiting, including any they schedule
+void FakeBroker::run() {
+	while (true) {
+		std::function<void()> callback;
+		{
+			std::lock_guard<std::recursive_mutex> guard(lock);
+			if (pending.empty()) {
+				return;
+			}
+			callback = pending.front();
+			pending.pop_front();
+		}
+		callback();
+	}
+}
+
+/// @brief Sends a message to the connected client, in parts like a large message
+/// @param topic The topic
+/// @param payload The payload
+/// @param partSize The largest part to pass to the callback, 0 for the whole payload at once
+void FakeBroker::deliver(const char* topic, const String& payload, size_t partSize) {
+	if (client == nullptr || !client->is_connected) {
+		return;
+	}
+	if (partSize == 0) {
+		partSize = std::max((size_t)1, (size_t)payload.length());
+	}
+	std::string t = topic;
+	std::string p = payload.c_str();
+	AsyncMqttClient* c = client;
+	schedule([c, t, p, partSize]() {
+		AsyncMqttClientMessageProperties properties = { .qos = 1, .dup = false, .retain = false };
+		size_t index = 0;
+		do {
+			size_t len = std::min(partSize, p.length() - index);
+			std::string part = p.substr(index, len);
+			for (auto& callback : c->message_callbacks) {
+				callback((char*)t.c_str(), (char*)part.c_str(), properties, len, index, p.length());
+			}
+			index += len;
+		} while (index < p.length());
+	});
+}
+
+/// @brief Closes the connection from the broker's side
+void FakeBroker::dropConnection() {
+	if (client == nullptr || !client->is_connected) {
+		return;
+	}
+	AsyncMqttClient* c = client;
+	c->is_connected = false;
+	client = nullptr;
+	schedule([c]() {
+		for (auto& callback : c->disconnect_callbacks) {
+			callback(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+		}
+	});
+}
+
+/// @brief Forgets everything recorded
+void FakeBroker::reset() {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	connections.clear();
+	published.clear();
+	subscriptions.clear();
+	pending.clear();
+	accepting = true;
+	auto_acknowledge = true;
+}
+
+void FakeBroker::schedule(std::function<void()> callback) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	pending.push_back(callback);
+}
+
+AsyncMqttClient& AsyncMqttClient::setServer(const char* host, uint16_t port) {
+	this->host = host;
+	this->port = port;
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::setClientId(const char* clientId) {
+	client_id = clientId;
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::setCredentials(const char* username, const char* password) {
+	this->username = username;
+	this->password = password;
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::setWill(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length) {
+	will_topic = topic;
+	will_payload = payload;
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::onConnect(OnConnectUserCallback callback) {
+	connect_callbacks.push_back(callback);
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::onDisconnect(OnDisconnectUserCallback callback) {
+	disconnect_callbacks.push_back(callback);
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::onMessage(OnMessageUserCallback callback) {
+	message_callbacks.push_back(callback);
+	return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::onPublish(OnPublishUserCallback callback) {
+	publish_callbacks.push_back(callback);
+	return *this;
+}
+
+/// @brief Connects to the broker with the settings the pointers point to now, the result is reported when the broker runs
+void AsyncMqttClient::connect() {
+	if (is_connected || connecting) {
+		return;
+	}
+	connecting = true;
+	FakeBroker::connection c = {
+		.host = host,
+		.port = port,
+		.client_id = client_id,
+		.has_username = username != nullptr,
+		.username = username,
+		.has_password = password != nullptr,
+		.password = password,
+		.will_topic = will_topic,
+		.will_payload = will_payload
+	};
+	bool accepted = MqttBroker.accepting;
+	MqttBroker.connections.push_back(c);
+	MqttBroker.schedule([this, accepted]() {
+		connecting = false;
+		if (accepted) {
+			is_connected = true;
+			MqttBroker.client = this;
+			for (auto& callback : connect_callbacks) {
+				callback(false);
+			}
+		} else {
+			for (auto& callback : disconnect_callbacks) {
+				callback(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+			}
+		}
+	});
+}
+
+void AsyncMqttClient::disconnect(bool force) {
+	if (!is_connected) {
+		return;
+	}
+	is_connected = false;
+	MqttBroker.client = nullptr;
+	MqttBroker.schedule([this]() {
+		for (auto& callback : disconnect_callbacks) {
+			callback(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED);
+		}
+	});
+}
+
+uint16_t AsyncMqttClient::subscribe(const char* topic, uint8_t qos) {
+	if (!is_connected) {
+		return 0;
+	}
+	MqttBroker.subscriptions.push_back(topic);
+	return next_packet_id++;
+}
+
+/// @brief Publishes a message
+/// @return The packet ID, 1 for QoS 0, or 0 if the message couldn't be sent
+uint16_t AsyncMqttClient::publish(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length, bool dup, uint16_t message_id) {
+	if (!is_connected) {
+		return 0;
+	}
+	String p;
+	if (payload != nullptr) {
+		p.concat(payload, length > 0 ? length : strlen(payload));
+	}
+	MqttBroker.published.push_back({ .topic = topic, .payload = p, .qos = qos, .retain = retain });
+	if (qos == 0) {
+		return 1;
+	}
+	uint16_t id = next_packet_id++;
+	if (MqttBroker.auto_acknowledge) {
+		MqttBroker.schedule([this, id]() {
+			for (auto& callback : publish_callbacks) {
+				callback(id);
+			}
+		});
+	}
+	return id;
+}
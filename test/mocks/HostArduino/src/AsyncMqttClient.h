@@ -0,0 +1,138 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* AsyncMqttClient connected to a fake broker that records connections, subscriptions and messages. Like the real client,
+* the server, client ID, credentials and will are kept as pointers and only read when connecting, and callbacks don't run
+* inside the client's methods: the test runs them with MqttBroker.run(), as the network task would.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+enum class AsyncMqttClientDisconnectReason : uint8_t {
+	TCP_DISCONNECTED = 0,
+	MQTT_UNACCEPTABLE_PROTOCOL_VERSION = 1,
+	MQTT_IDENTIFIER_REJECTED = 2,
+	MQTT_SERVER_UNAVAILABLE = 3,
+	MQTT_MALFORMED_CREDENTIALS = 4,
+	MQTT_NOT_AUTHORIZED = 5
+};
+
+/// @brief Properties of a received message
+struct AsyncMqttClientMessageProperties {
+	uint8_t qos;
+	bool dup;
+	bool retain;
+};
+
+typedef std::function<void(bool sessionPresent)> OnConnectUserCallback;
+typedef std::function<void(AsyncMqttClientDisconnectReason reason)> OnDisconnectUserCallback;
+typedef std::function<void(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total)> OnMessageUserCallback;
+typedef std::function<void(uint16_t packetId)> OnPublishUserCallback;
+
+class AsyncMqttClient;
+
+/// @brief Records what clients send and runs their callbacks
+class FakeBroker {
+	public:
+		/// @brief A connection made by a client, with the settings it connected with
+		typedef struct connection {
+			String host;
+			uint16_t port;
+			String client_id;
+			bool has_username;
+			String username;
+			bool has_password;
+			String password;
+			String will_topic;
+			String will_payload;
+		} connection;
+
+		/// @brief A message published by a client
+		typedef struct message {
+			String topic;
+			String payload;
+			uint8_t qos;
+			bool retain;
+		} message;
+
+		/// @brief Connections made, oldest first
+		std::vector<connection> connections;
+
+		/// @brief Messages published, oldest first
+		std::vector<message> published;
+
+		/// @brief Topics subscribed to
+		std::vector<String> subscriptions;
+
+		/// @brief True to accept connections, false to refuse them
+		bool accepting = true;
+
+		/// @brief True to acknowledge messages published with QoS above 0 as soon as they arrive
+		bool auto_acknowledge = true;
+
+		void run();
+		void deliver(const char* topic, const String& payload, size_t partSize = 0);
+		void dropConnection();
+		void reset();
+
+	private:
+		friend class AsyncMqttClient;
+
+		/// @brief Callbacks waiting for run()
+		std::deque<std::function<void()>> pending;
+
+		/// @brief Guards the pending callbacks
+		std::recursive_mutex lock;
+
+		/// @brief The client connected, nullptr if none
+		AsyncMqttClient* client = nullptr;
+
+		void schedule(std::function<void()> callback);
+};
+
+extern FakeBroker MqttBroker;
+
+/// @brief An MQTT client
+class AsyncMqttClient {
+	public:
+		AsyncMqttClient& setServer(const char* host, uint16_t port);
+		AsyncMqttClient& setClientId(const char* clientId);
+		AsyncMqttClient& setCredentials(const char* username, const char* password = nullptr);
+		AsyncMqttClient& setWill(const char* topic, uint8_t qos, bool retain, const char* payload = nullptr, size_t length = 0);
+		AsyncMqttClient& setKeepAlive(uint16_t keepAlive) { return *this; }
+		AsyncMqttClient& setCleanSession(bool cleanSession) { return *this; }
+		AsyncMqttClient& onConnect(OnConnectUserCallback callback);
+		AsyncMqttClient& onDisconnect(OnDisconnectUserCallback callback);
+		AsyncMqttClient& onMessage(OnMessageUserCallback callback);
+		AsyncMqttClient& onPublish(OnPublishUserCallback callback);
+		bool connected() const { return is_connected; }
+		void connect();
+		void disconnect(bool force = false);
+		uint16_t subscribe(const char* topic, uint8_t qos);
+		uint16_t publish(const char* topic, uint8_t qos, bool retain, const char* payload = nullptr, size_t length = 0, bool dup = false, uint16_t message_id = 0);
+
+	private:
+		friend class FakeBroker;
+
+		const char* host = nullptr;
+		uint16_t port = 1883;
+		const char* client_id = nullptr;
+		const char* username = nullptr;
+		const char* password = nullptr;
+		const char* will_topic = nullptr;
+		const char* will_payload = nullptr;
+		std::vector<OnConnectUserCallback> connect_callbacks;
+		std::vector<OnDisconnectUserCallback> disconnect_callbacks;
+		std::vector<OnMessageUserCallback> message_callbacks;
+		std::vector<OnPublishUserCallback> publish_callbacks;
+		bool is_connected = false;
+		bool connecting = false;
+		uint16_t next_packet_id = 1;
+};
@@ -0,0 +1,50 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* ESP32Time on the host clock. setTime() shifts the clock seen through this object instead of setting the host's.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <ctime>
+
+/// @brief The real time clock
+class ESP32Time {
+	public:
+		ESP32Time(unsigned long offset = 0) : offset(offset) {}
+
+		void setTime(unsigned long epoch = 1609459200, int ms = 0) { shift = (long)epoch - (long)::time(nullptr); }
+		unsigned long getEpoch() { return ::time(nullptr) + shift; }
+		unsigned long getLocalEpoch() { return getEpoch() + offset; }
+		unsigned long getMillis() { return millis() % 1000; }
+
+		struct tm getTimeStruct() {
+			time_t now = getLocalEpoch();
+			struct tm t;
+			gmtime_r(&now, &t);
+			return t;
+		}
+
+		String getTime(String format = "%H:%M:%S") {
+			struct tm t = getTimeStruct();
+			char buffer[64];
+			strftime(buffer, sizeof(buffer), format.c_str(), &t);
+			return buffer;
+		}
+
+		int getHour(bool mode = false) { struct tm t = getTimeStruct(); return mode ? t.tm_hour : (t.tm_hour % 12 == 0 ? 12 : t.tm_hour % 12); }
+		int getMinute() { return getTimeStruct().tm_min; }
+		int getSecond() { return getTimeStruct().tm_sec; }
+		int getDay() { return getTimeStruct().tm_mday; }
+		int getMonth() { return getTimeStruct().tm_mon; }
+		int getYear() { return getTimeStruct().tm_year + 1900; }
+
+		/// @brief Offset of local time from UTC in seconds
+		long offset;
+
+	private:
+		/// @brief Difference between the clock and the host's clock in seconds
+		long shift = 0;
+};
@@ -0,0 +1,300 @@
+#include "ESPAsyncWebServer.h"
+
+/// @brief Returned for headers and arguments a request doesn't have
+static const String empty_string;
+
+/// @brief Gets the content type of a file from its extension, as AsyncFileResponse does
+/// @param path The path of the file
+/// @return The content type
+static String contentTypeFor(const String& path) {
+	static const std::vector<std::pair<const char*, const char*>> types = {
+		{ ".html", "text/html" }, { ".htm", "text/html" }, { ".css", "text/css" }, { ".json", "application/json" },
+		{ ".js", "application/javascript" }, { ".png", "image/png" }, { ".gif", "image/gif" }, { ".jpg", "image/jpeg" },
+		{ ".ico", "image/x-icon" }, { ".svg", "image/svg+xml" }, { ".xml", "text/xml" }, { ".pdf", "application/pdf" },
+		{ ".zip", "application/zip" }, { ".gz", "application/x-gzip" }
+	};
+	for (const auto& t : types) {
+		if (path.endsWith(t.first)) {
+			return t.second;
+		}
+	}
+	return "text/plain";
+}
+
+String AsyncWebServerResponse::header(const String& name) const {
+	for (const auto& h : headers) {
+		if (h.first.equalsIgnoreCase(name)) {
+			return h.second;
+		}
+	}
+	return String();
+}
+
+bool AsyncWebServerResponse::hasHeader(const String& name) const {
+	for (const auto& h : headers) {
+		if (h.first.equalsIgnoreCase(name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String& url) : _method(method) {
+	int query = url.indexOf('?');
+	_url = query < 0 ? url : url.substring(0, query);
+	while (query >= 0) {
+		int next = url.indexOf('&', query + 1);
+		String pair = next < 0 ? url.substring(query + 1) : url.substring(query + 1, next);
+		int equals = pair.indexOf('=');
+		if (!pair.isEmpty()) {
+			receiveParam(equals < 0 ? pair : pair.substring(0, equals), equals < 0 ? String() : pair.substring(equals + 1));
+		}
+		query = next;
+	}
+}
+
+/// @brief Calls the disconnect handler and frees the handler's state, as the real request does when the client disconnects
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+	if (_onDisconnect) {
+		_onDisconnect();
+	}
+	if (_tempObject != nullptr) {
+		free(_tempObject);
+	}
+	_tempFile.close();
+}
+
+void AsyncWebServerRequest::addInterestingHeader(const String& name) {
+	for (const auto& h : _interestingHeaders) {
+		if (h.equalsIgnoreCase(name)) {
+			return;
+		}
+	}
+	_interestingHeaders.push_back(name);
+}
+
+bool AsyncWebServerRequest::hasHeader(const String& name) const {
+	return getHeader(name) != nullptr;
+}
+
+const String& AsyncWebServerRequest::header(const char* name) const {
+	AsyncWebHeader* h = getHeader(name);
+	return h == nullptr ? empty_string : h->value();
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
+	for (const auto& h : _headers) {
+		if (h->name().equalsIgnoreCase(name)) {
+			return h.get();
+		}
+	}
+	return nullptr;
+}
+
+bool AsyncWebServerRequest::hasParam(const String& name, bool post, bool file) const {
+	return getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) const {
+	for (const auto& p : _params) {
+		if (p->name() == name && p->isPost() == post && p->isFile() == file) {
+			return p.get();
+		}
+	}
+	return nullptr;
+}
+
+bool AsyncWebServerRequest::hasArg(const char* name) const {
+	for (const auto& p : _params) {
+		if (p->name() == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const String& AsyncWebServerRequest::arg(const String& name) const {
+	for (const auto& p : _params) {
+		if (p->name() == name) {
+			return p->value();
+		}
+	}
+	return empty_string;
+}
+
+/// @brief Checks Basic credentials in the Authorization header
+/// @param username The user name
+/// @param password The password
+/// @param realm Unused
+/// @param passwordIsHash Unused
+/// @return True if the credentials match
+bool AsyncWebServerRequest::authenticate(const char* username, const char* password, const char* realm, bool passwordIsHash) {
+	static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	AsyncWebHeader* h = getHeader("Authorization");
+	if (h == nullptr || !h->value().startsWith("Basic ")) {
+		return false;
+	}
+	String encoded = h->value().substring(6);
+	String decoded;
+	uint32_t bits = 0;
+	int count = 0;
+	for (char c : encoded) {
+		const char* found = strchr(alphabet, c);
+		if (c == '=' || found == nullptr) {
+			break;
+		}
+		bits = (bits << 6) | (found - alphabet);
+		count += 6;
+		if (count >= 8) {
+			count -= 8;
+			decoded += (char)((bits >> count) & 0xFF);
+		}
+	}
+	return decoded == String(username) + ":" + password;
+}
+
+void AsyncWebServerRequest::requestAuthentication(const char* realm, bool isDigest) {
+	AsyncWebServerResponse* r = beginResponse(401);
+	r->addHeader("WWW-Authenticate", String("Basic realm=\"") + (realm == nullptr ? "Login Required" : realm) + "\"");
+	send(r);
+}
+
+void AsyncWebServerRequest::redirect(const String& url) {
+	AsyncWebServerResponse* r = beginResponse(302);
+	r->addHeader("Location", url);
+	send(r);
+}
+
+/// @brief Sends a response, only the first response sent is kept, as with the real server
+/// @param response The response
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response) {
+	if (_response) {
+		delete response;
+		return;
+	}
+	_response.reset(response);
+}
+
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content) {
+	send(beginResponse(code, contentType, content));
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType, const String& content) {
+	return new AsyncWebServerResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(FS& fs, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback) {
+	bool gzipped = !download && !fs.exists(path) && fs.exists(path + ".gz");
+	File file = fs.open(gzipped ? path + ".gz" : path);
+	if (!file) {
+		return new AsyncWebServerResponse(404);
+	}
+	AsyncWebServerResponse* r = beginResponse(file, path, contentType, download, callback);
+	return r;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(File content, const String& path, const String& contentType, bool download, AwsTemplateProcessor callback) {
+	AsyncWebServerResponse* r = new AsyncWebServerResponse(200, contentType.isEmpty() ? contentTypeFor(path) : contentType, content.readString());
+	if (String(content.path()).endsWith(".gz") && !path.endsWith(".gz")) {
+		r->addHeader("Content-Encoding", "gzip");
+	}
+	content.close();
+	return r;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String& contentType, const uint8_t* content, size_t len, AwsTemplateProcessor callback) {
+	AsyncWebServerResponse* r = new AsyncWebServerResponse(code, contentType);
+	r->content.concat(content, len);
+	return r;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse_P(int code, const String& contentType, const char* content, AwsTemplateProcessor callback) {
+	return new AsyncWebServerResponse(code, contentType, content);
+}
+
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String& contentType, size_t bufferSize) {
+	return new AsyncResponseStream(contentType);
+}
+
+/// @brief Adds a header sent by the client, kept by parseHeaders() if a handler asked for it
+/// @param name The name of the header
+/// @param value The value of the header
+void AsyncWebServerRequest::receiveHeader(const String& name, const String& value) {
+	_receivedHeaders.push_back({ name, value });
+}
+
+/// @brief Adds a query or body parameter sent by the client
+/// @param name The name of the parameter
+/// @param value The value of the parameter
+/// @param post True for a body parameter
+void AsyncWebServerRequest::receiveParam(const String& name, const String& value, bool post) {
+	_params.emplace_back(new AsyncWebParameter(name, value, post));
+}
+
+/// @brief Keeps the headers handlers asked for, dropping the rest
+void AsyncWebServerRequest::parseHeaders() {
+	for (const auto& h : _receivedHeaders) {
+		bool interesting = false;
+		for (const auto& i : _interestingHeaders) {
+			interesting = interesting || i.equalsIgnoreCase(h.first) || i.equalsIgnoreCase("ANY");
+		}
+		if (interesting) {
+			_headers.emplace_back(new AsyncWebHeader(h.first, h.second));
+		}
+	}
+	_receivedHeaders.clear();
+}
+
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler) {
+	handlers.push_back(handler);
+	return *handler;
+}
+
+bool AsyncWebServer::removeHandler(AsyncWebHandler* handler) {
+	for (auto h = handlers.begin(); h != handlers.end(); h++) {
+		if (*h == handler) {
+			handlers.erase(h);
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief Runs a request through the handlers: attaches the first that can handle it, parses the headers, passes it any upload, then lets it respond
+/// @param request The request
+/// @param upload The uploaded file, nullptr for none
+/// @param length The length of the uploaded file
+/// @param chunk The size of the parts the upload is passed in
+/// @param filename The name of the uploaded file
+/// @return The handler attached, nullptr if none could handle the request
+AsyncWebHandler* AsyncWebServer::handle(AsyncWebServerRequest* request, const uint8_t* upload, size_t length, size_t chunk, String filename) {
+	AsyncWebHandler* attached = nullptr;
+	for (auto h : handlers) {
+		if (h->canHandle(request)) {
+			attached = h;
+			break;
+		}
+	}
+	request->parseHeaders();
+	if (attached == nullptr) {
+		if (not_found) {
+			not_found(request);
+		} else {
+			request->send(404);
+		}
+		return nullptr;
+	}
+	if (upload != nullptr) {
+		request->setContentLength(length);
+		std::vector<uint8_t> part;
+		size_t index = 0;
+		do {
+			size_t n = std::min(chunk, length - index);
+			part.assign(upload + index, upload + index + n);
+			attached->handleUpload(request, filename, index, part.data(), n, index + n >= length);
+			index += n;
+		} while (index < length);
+	}
+	attached->handleRequest(request);
+	return attached;
+}
@@ -0,0 +1,204 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* The request and handler API of ESPAsyncWebServer, without a network. Tests build a request, pass it to
+* AsyncWebServer::handle() to run it through the registered handlers, and check the response it was sent. As in the
+* real server, handlers are attached before the request headers are parsed, and headers no handler asked for with
+* addInterestingHeader() are dropped.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <utility>
+
+typedef enum {
+	HTTP_GET = 0b00000001,
+	HTTP_POST = 0b00000010,
+	HTTP_DELETE = 0b00000100,
+	HTTP_PUT = 0b00001000,
+	HTTP_PATCH = 0b00010000,
+	HTTP_HEAD = 0b00100000,
+	HTTP_OPTIONS = 0b01000000,
+	HTTP_ANY = 0b01111111
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+typedef std::function<void(void)> ArDisconnectHandler;
+typedef std::function<String(const String&)> AwsTemplateProcessor;
+typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
+
+class AsyncWebServerRequest;
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, const String&, size_t, uint8_t*, size_t, bool)> ArUploadHandlerFunction;
+
+/// @brief A request header
+class AsyncWebHeader {
+	public:
+		AsyncWebHeader(const String& name, const String& value) : _name(name), _value(value) {}
+		const String& name() const { return _name; }
+		const String& value() const { return _value; }
+
+	private:
+		String _name;
+		String _value;
+};
+
+/// @brief A query, body or file parameter
+class AsyncWebParameter {
+	public:
+		AsyncWebParameter(const String& name, const String& value, bool form = false, bool file = false, size_t size = 0) : _name(name), _value(value), _size(size), _isForm(form), _isFile(file) {}
+		const String& name() const { return _name; }
+		const String& value() const { return _value; }
+		size_t size() const { return _size; }
+		bool isPost() const { return _isForm; }
+		bool isFile() const { return _isFile; }
+
+	private:
+		String _name;
+		String _value;
+		size_t _size;
+		bool _isForm;
+		bool _isFile;
+};
+
+/// @brief A response, holding its whole content
+class AsyncWebServerResponse {
+	public:
+		AsyncWebServerResponse(int code = 200, const String& contentType = String(), const String& content = String()) : code(code), content_type(contentType), content(content) {}
+		virtual ~AsyncWebServerResponse() {}
+		void setCode(int code) { this->code = code; }
+		void setContentLength(size_t len) {}
+		void setContentType(const String& type) { content_type = type; }
+		void addHeader(const String& name, const String& value) { headers.push_back({ name, value }); }
+		String header(const String& name) const;
+		bool hasHeader(const String& name) const;
+
+		/// @brief The status code
+		int code;
+
+		/// @brief The content type
+		String content_type;
+
+		/// @brief The body
+		String content;
+
+		/// @brief The headers added to the response
+		std::vector<std::pair<String, String>> headers;
+};
+
+/// @brief A response written with print()
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+	public:
+		AsyncResponseStream(const String& contentType) : AsyncWebServerResponse(200, contentType) {}
+		size_t write(uint8_t c) override { content += (char)c; return 1; }
+		size_t write(const uint8_t* buffer, size_t size) override { content.concat(buffer, size); return size; }
+		using Print::write;
+};
+
+/// @brief A request received by the server
+class AsyncWebServerRequest {
+	public:
+		AsyncWebServerRequest(WebRequestMethodComposite method, const String& url);
+		~AsyncWebServerRequest();
+
+		/// @brief A file handlers can keep open while an upload is received
+		File _tempFile;
+
+		/// @brief State handlers can keep while an upload is received, freed with free() when the request is deleted
+		void* _tempObject = nullptr;
+
+		WebRequestMethodComposite method() const { return _method; }
+		const String& url() const { return _url; }
+		size_t contentLength() const { return _contentLength; }
+		void addInterestingHeader(const String& name);
+		bool hasHeader(const String& name) const;
+		const String& header(const char* name) const;
+		AsyncWebHeader* getHeader(const String& name) const;
+		size_t headers() const { return _headers.size(); }
+		bool hasParam(const String& name, bool post = false, bool file = false) const;
+		AsyncWebParameter* getParam(const String& name, bool post = false, bool file = false) const;
+		size_t params() const { return _params.size(); }
+		bool hasArg(const char* name) const;
+		const String& arg(const String& name) const;
+		bool authenticate(const char* username, const char* password, const char* realm = nullptr, bool passwordIsHash = false);
+		void requestAuthentication(const char* realm = nullptr, bool isDigest = true);
+		void onDisconnect(ArDisconnectHandler fn) { _onDisconnect = fn; }
+		void redirect(const String& url);
+
+		void send(AsyncWebServerResponse* response);
+		void send(int code, const String& contentType = String(), const String& content = String());
+		AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(), const String& content = String());
+		AsyncWebServerResponse* beginResponse(FS& fs, const String& path, const String& contentType = String(), bool download = false, AwsTemplateProcessor callback = nullptr);
+		AsyncWebServerResponse* beginResponse(File content, const String& path, const String& contentType = String(), bool download = false, AwsTemplateProcessor callback = nullptr);
+		AsyncWebServerResponse* beginResponse_P(int code, const String& contentType, const uint8_t* content, size_t len, AwsTemplateProcessor callback = nullptr);
+		AsyncWebServerResponse* beginResponse_P(int code, const String& contentType, const char* content, AwsTemplateProcessor callback = nullptr);
+		AsyncResponseStream* beginResponseStream(const String& contentType, size_t bufferSize = 1460);
+
+		// Used by tests to describe the request and check the response
+		void receiveHeader(const String& name, const String& value);
+		void receiveParam(const String& name, const String& value, bool post = false);
+		void setContentLength(size_t length) { _contentLength = length; }
+		void parseHeaders();
+		AsyncWebServerResponse* response() const { return _response.get(); }
+
+	private:
+		WebRequestMethodComposite _method;
+		String _url;
+		size_t _contentLength = 0;
+
+		/// @brief Names of the headers handlers asked for, "ANY" for all
+		std::vector<String> _interestingHeaders;
+
+		/// @brief Headers sent by the client, before parseHeaders() keeps the interesting ones
+		std::vector<std::pair<String, String>> _receivedHeaders;
+
+		/// @brief Headers available to handlers
+		std::vector<std::unique_ptr<AsyncWebHeader>> _headers;
+
+		/// @brief Query and body parameters
+		std::vector<std::unique_ptr<AsyncWebParameter>> _params;
+
+		/// @brief Called when the request is deleted
+		ArDisconnectHandler _onDisconnect;
+
+		/// @brief The response sent, nullptr until one is
+		std::unique_ptr<AsyncWebServerResponse> _response;
+};
+
+/// @brief Base class of request handlers
+class AsyncWebHandler {
+	public:
+		virtual ~AsyncWebHandler() {}
+		virtual bool canHandle(AsyncWebServerRequest* request) { return false; }
+		virtual void handleRequest(AsyncWebServerRequest* request) {}
+		virtual void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final) {}
+		virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {}
+		virtual bool isRequestHandlerTrivial() { return true; }
+};
+
+/// @brief Holds the handlers and runs requests through them
+class AsyncWebServer {
+	public:
+		AsyncWebServer(uint16_t port) {}
+		void begin() {}
+		void end() {}
+		AsyncWebHandler& addHandler(AsyncWebHandler* handler);
+		bool removeHandler(AsyncWebHandler* handler);
+		void onNotFound(ArRequestHandlerFunction fn) { not_found = fn; }
+
+		// Used by tests
+		AsyncWebHandler* handle(AsyncWebServerRequest* request, const uint8_t* upload = nullptr, size_t length = 0, size_t chunk = 1460, String filename = "upload");
+
+	private:
+		/// @brief The handlers, in the order they were added
+		std::vector<AsyncWebHandler*> handlers;
+
+		/// @brief Responds to requests no handler can
+		ArRequestHandlerFunction not_found;
+};
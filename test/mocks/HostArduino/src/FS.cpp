@@ -0,0 +1,232 @@
+#include "FS.h"
+#include "HostTest.h"
+#include <algorithm>
+#include <filesystem>
+#include <sys/stat.h>
+
+namespace stdfs = std::filesystem;
+
+namespace fs {
+	File::handle::~handle() {
+		if (file != nullptr) {
+			fclose(file);
+		}
+	}
+
+	size_t File::write(uint8_t c) {
+		return write(&c, 1);
+	}
+
+	size_t File::write(const uint8_t* buffer, size_t size) {
+		if (!h || h->file == nullptr || !h->writable) {
+			return 0;
+		}
+		return fwrite(buffer, 1, size, h->file);
+	}
+
+	int File::available() {
+		if (!h || h->file == nullptr) {
+			return 0;
+		}
+		return size() - position();
+	}
+
+	int File::read() {
+		uint8_t c;
+		return read(&c, 1) == 1 ? c : -1;
+	}
+
+	size_t File::read(uint8_t* buffer, size_t size) {
+		if (!h || h->file == nullptr) {
+			return 0;
+		}
+		return fread(buffer, 1, size, h->file);
+	}
+
+	int File::peek() {
+		if (!h || h->file == nullptr) {
+			return -1;
+		}
+		int c = fgetc(h->file);
+		if (c != EOF) {
+			ungetc(c, h->file);
+		}
+		return c == EOF ? -1 : c;
+	}
+
+	void File::flush() {
+		if (h && h->file != nullptr) {
+			fflush(h->file);
+		}
+	}
+
+	bool File::seek(uint32_t pos, SeekMode mode) {
+		if (!h || h->file == nullptr) {
+			return false;
+		}
+		return fseek(h->file, pos, mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END)) == 0;
+	}
+
+	size_t File::position() const {
+		if (!h || h->file == nullptr) {
+			return 0;
+		}
+		return ftell(h->file);
+	}
+
+	size_t File::size() const {
+		if (!h || h->file == nullptr) {
+			return 0;
+		}
+		fflush(h->file);
+		struct stat info;
+		return fstat(fileno(h->file), &info) == 0 ? info.st_size : 0;
+	}
+
+	void File::close() {
+		h.reset();
+	}
+
+	time_t File::getLastWrite() {
+		if (!h) {
+			return 0;
+		}
+		struct stat info;
+		return stat(h->host_path.c_str(), &info) == 0 ? info.st_mtime : 0;
+	}
+
+	const char* File::path() const {
+		return h ? h->path.c_str() : nullptr;
+	}
+
+	const char* File::name() const {
+		if (!h) {
+			return nullptr;
+		}
+		size_t slash = h->path.rfind('/');
+		return h->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+	}
+
+	bool File::isDirectory() {
+		return h && h->file == nullptr;
+	}
+
+	File File::openNextFile(const char* mode) {
+		if (!isDirectory() || h->next_entry >= h->entries.size()) {
+			return File();
+		}
+		std::string path = h->path == "/" ? "/" : h->path + "/";
+		path += h->entries[h->next_entry++];
+		std::shared_ptr<handle> next = std::make_shared<handle>();
+		next->path = path;
+		next->host_path = h->host_path + "/" + h->entries[h->next_entry - 1];
+		next->file = nullptr;
+		next->next_entry = 0;
+		next->writable = false;
+		if (stdfs::is_directory(next->host_path)) {
+			for (const auto& e : stdfs::directory_iterator(next->host_path)) {
+				next->entries.push_back(e.path().filename().string());
+			}
+			std::sort(next->entries.begin(), next->entries.end());
+		} else {
+			next->file = fopen(next->host_path.c_str(), "rb");
+			if (next->file == nullptr) {
+				return File();
+			}
+		}
+		return File(next);
+	}
+
+	void File::rewindDirectory() {
+		if (isDirectory()) {
+			h->next_entry = 0;
+		}
+	}
+
+	std::string FS::hostPath(const char* path) {
+		std::string root = HostTest::storageRoot() + "/" + medium;
+		stdfs::create_directories(root);
+		return root + (path[0] == '/' ? "" : "/") + path;
+	}
+
+	File FS::open(const char* path, const char* mode, const bool create) {
+		if (path == nullptr || path[0] != '/') {
+			return File();
+		}
+		std::shared_ptr<File::handle> h = std::make_shared<File::handle>();
+		h->path = path;
+		h->host_path = hostPath(path);
+		if (h->path.length() > 1 && h->path.back() == '/') {
+			h->path.pop_back();
+		}
+		h->file = nullptr;
+		h->next_entry = 0;
+		h->writable = mode[0] != 'r' || strchr(mode, '+') != nullptr;
+		std::error_code error;
+		if (stdfs::is_directory(h->host_path, error)) {
+			if (h->writable) {
+				return File();
+			}
+			for (const auto& e : stdfs::directory_iterator(h->host_path)) {
+				h->entries.push_back(e.path().filename().string());
+			}
+			std::sort(h->entries.begin(), h->entries.end());
+			return File(h);
+		}
+		if (h->writable && (create || create_parents)) {
+			stdfs::create_directories(stdfs::path(h->host_path).parent_path(), error);
+		}
+		std::string host_mode = mode;
+		if (host_mode.find('b') == std::string::npos) {
+			host_mode += 'b';
+		}
+		h->file = fopen(h->host_path.c_str(), host_mode.c_str());
+		if (h->file == nullptr) {
+			return File();
+		}
+		if (mode[0] == 'a') {
+			fseek(h->file, 0, SEEK_END);
+		}
+		return File(h);
+	}
+
+	bool FS::exists(const char* path) {
+		std::error_code error;
+		return stdfs::exists(hostPath(path), error);
+	}
+
+	bool FS::remove(const char* path) {
+		std::error_code error;
+		std::string host = hostPath(path);
+		return stdfs::is_regular_file(host, error) && stdfs::remove(host, error);
+	}
+
+	bool FS::rename(const char* pathFrom, const char* pathTo) {
+		std::error_code error;
+		stdfs::rename(hostPath(pathFrom), hostPath(pathTo), error);
+		return !error;
+	}
+
+	bool FS::mkdir(const char* path) {
+		std::error_code error;
+		std::string host = hostPath(path);
+		return stdfs::create_directory(host, error) || stdfs::is_directory(host, error);
+	}
+
+	bool FS::rmdir(const char* path) {
+		std::error_code error;
+		std::string host = hostPath(path);
+		return stdfs::is_directory(host, error) && stdfs::is_empty(host, error) && stdfs::remove(host, error);
+	}
+
+	uint64_t FS::usedBytes() {
+		uint64_t used = 0;
+		std::error_code error;
+		for (const auto& e : stdfs::recursive_directory_iterator(hostPath("/"), error)) {
+			if (e.is_regular_file()) {
+				used += e.file_size();
+			}
+		}
+		return used;
+	}
+}
@@ -0,0 +1,121 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* The Arduino file system API, storing files in a directory on the host. Each medium (LittleFS, SD, SD_MMC) has its own
+* directory under the test's storage root.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+	enum SeekMode {
+		SeekSet = 0,
+		SeekCur = 1,
+		SeekEnd = 2
+	};
+
+	/// @brief An open file or directory, copies refer to the same file
+	class File : public Stream {
+		public:
+			/// @brief The state shared by copies of a file
+			typedef struct handle {
+				/// @brief The path on the file system
+				std::string path;
+
+				/// @brief The path on the host
+				std::string host_path;
+
+				/// @brief The open file, nullptr for a directory
+				FILE* file;
+
+				/// @brief The names of the entries in a directory, sorted
+				std::vector<std::string> entries;
+
+				/// @brief The next entry of a directory to open
+				size_t next_entry;
+
+				/// @brief True if the file can be written
+				bool writable;
+
+				~handle();
+			} handle;
+
+			File() {}
+			File(std::shared_ptr<handle> h) : h(h) {}
+			size_t write(uint8_t c) override;
+			size_t write(const uint8_t* buffer, size_t size) override;
+			using Print::write;
+			int available() override;
+			int read() override;
+			size_t read(uint8_t* buffer, size_t size);
+			size_t readBytes(uint8_t* buffer, size_t length) override { return read(buffer, length); }
+			using Stream::readBytes;
+			int peek() override;
+			void flush() override;
+			bool seek(uint32_t pos, SeekMode mode);
+			bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+			size_t position() const;
+			size_t size() const;
+			bool setBufferSize(size_t size) { return true; }
+			void close();
+			operator bool() const { return h != nullptr; }
+			time_t getLastWrite();
+			const char* path() const;
+			const char* name() const;
+			bool isDirectory();
+			File openNextFile(const char* mode = FILE_READ);
+			void rewindDirectory();
+
+		private:
+			/// @brief The open file, nullptr if closed or not found
+			std::shared_ptr<handle> h;
+	};
+
+	/// @brief A file system stored in a directory on the host
+	class FS {
+		public:
+			FS(std::string medium, bool createParents) : medium(medium), create_parents(createParents) {}
+			File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+			File open(const String& path, const char* mode = FILE_READ, const bool create = false) { return open(path.c_str(), mode, create); }
+			bool exists(const char* path);
+			bool exists(const String& path) { return exists(path.c_str()); }
+			bool remove(const char* path);
+			bool remove(const String& path) { return remove(path.c_str()); }
+			bool rename(const char* pathFrom, const char* pathTo);
+			bool rename(const String& pathFrom, const String& pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+			bool mkdir(const char* path);
+			bool mkdir(const String& path) { return mkdir(path.c_str()); }
+			bool rmdir(const char* path);
+			bool rmdir(const String& path) { return rmdir(path.c_str()); }
+			uint64_t totalBytes() { return total_bytes; }
+			uint64_t usedBytes();
+			std::string hostPath(const char* path);
+
+		protected:
+			/// @brief Name of the directory holding the medium's files under the storage root
+			std::string medium;
+
+			/// @brief True if opening a file to write creates its parent directories, as LittleFS does
+			bool create_parents;
+
+			/// @brief The capacity reported for the medium
+			uint64_t total_bytes = 1024 * 1024;
+	};
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
@@ -0,0 +1,91 @@
+#include "Update.h"
+#include "esp_ota_ops.h"
+#include "HostTest.h"
+
+UpdateClass Update;
+
+/// @brief The running app partition
+static esp_partition_t running_partition = { .address = 0x10000, .size = 0, .label = "app0" };
+
+/// @brief The contents of the running app partition
+static std::vector<uint8_t> running_image;
+
+bool UpdateClass::begin(size_t size, int command, int ledPin, uint8_t ledOn, const char* label) {
+	if (running) {
+		error = "Already running";
+		return false;
+	}
+	image.clear();
+	expected = size;
+	running = true;
+	finished = false;
+	error = nullptr;
+	return true;
+}
+
+size_t UpdateClass::write(uint8_t* data, size_t len) {
+	if (!running) {
+		error = "Not running";
+		return 0;
+	}
+	if (expected != UPDATE_SIZE_UNKNOWN && image.size() + len > expected) {
+		error = "Too much data";
+		return 0;
+	}
+	image.insert(image.end(), data, data + len);
+	return len;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+	if (!running) {
+		return false;
+	}
+	running = false;
+	if (!evenIfRemaining && expected != UPDATE_SIZE_UNKNOWN && image.size() != expected) {
+		error = "Not enough data";
+		return false;
+	}
+	finished = true;
+	return true;
+}
+
+void UpdateClass::abort() {
+	running = false;
+	error = "Aborted";
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) {
+	return &running_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+	if (partition != &running_partition) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (src_offset + size > running_partition.size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	memcpy(dst, running_image.data() + src_offset, size);
+	return ESP_OK;
+}
+
+namespace HostTest {
+	/// @brief Sets the contents of the running app partition
+	/// @param image The firmware image
+	void setRunningFirmware(const std::vector<uint8_t>& image) {
+		running_image = image;
+		running_partition.size = image.size();
+	}
+
+	/// @brief Gets the bytes written by the last firmware update
+	/// @return The bytes
+	const std::vector<uint8_t>& updateWritten() {
+		return Update.image;
+	}
+
+	/// @brief Checks if the last firmware update ended successfully
+	/// @return True if it did
+	bool updateFinished() {
+		return Update.isFinished();
+	}
+}
@@ -0,0 +1,335 @@
+#include "HTTPClient.h"
+
+/// @brief Closes the connection, as arduino-esp32 does, even if it's shared with a pool
+HTTPClient::~HTTPClient() {
+	if (client != nullptr) {
+		client->stop();
+	}
+}
+
+/// @brief Starts a request to a URL
+/// @param client The connection to send it on
+/// @param url The URL, http:// or https://, optionally with credentials
+/// @return True if the URL could be parsed
+bool HTTPClient::begin(WiFiClient& client, String url) {
+	clear();
+	this->client = &client;
+	int scheme_end = url.indexOf("://");
+	if (scheme_end < 0) {
+		return false;
+	}
+	String scheme = url.substring(0, scheme_end);
+	port = scheme == "https" ? 443 : 80;
+	String rest = url.substring(scheme_end + 3);
+	int path = rest.indexOf('/');
+	host = path < 0 ? rest : rest.substring(0, path);
+	uri = path < 0 ? "/" : rest.substring(path);
+	int credentials = host.lastIndexOf('@');
+	if (credentials >= 0) {
+		authorization = base64(host.substring(0, credentials));
+		host = host.substring(credentials + 1);
+	}
+	int colon = host.indexOf(':');
+	if (colon >= 0) {
+		port = host.substring(colon + 1).toInt();
+		host = host.substring(0, colon);
+	}
+	return true;
+}
+
+/// @brief Finishes a request, keeping the connection open if it can be reused
+void HTTPClient::end() {
+	if (connected()) {
+		// Drop any of the response that wasn't read
+		uint8_t discard[512];
+		while (client->available() > 0 && client->read(discard, sizeof(discard)) > 0) {}
+		if (!reuse || !can_reuse) {
+			client->stop();
+		}
+	}
+	clear();
+}
+
+bool HTTPClient::connected() {
+	return client != nullptr && client->connected();
+}
+
+void HTTPClient::setReuse(bool reuse) {
+	this->reuse = reuse;
+}
+
+/// @brief Sets Base64 encoded credentials, an empty string clears them
+/// @param auth The credentials
+void HTTPClient::setAuthorization(const char* auth) {
+	if (auth != nullptr) {
+		authorization = auth;
+	}
+}
+
+void HTTPClient::setAuthorization(const char* user, const char* password) {
+	if (user != nullptr && password != nullptr) {
+		authorization = base64(String(user) + ":" + password);
+	}
+}
+
+void HTTPClient::setTimeout(uint16_t timeout) {
+	this->timeout = timeout;
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool first, bool replace) {
+	if (replace) {
+		for (auto& h : headers) {
+			if (h.first.equalsIgnoreCase(name)) {
+				h.second = value;
+				return;
+			}
+		}
+	}
+	if (first) {
+		headers.insert(headers.begin(), { name, value });
+	} else {
+		headers.push_back({ name, value });
+	}
+}
+
+int HTTPClient::GET() {
+	return sendRequest("GET");
+}
+
+int HTTPClient::POST(String payload) {
+	return sendRequest("POST", payload);
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+	return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::PUT(String payload) {
+	return sendRequest("PUT", payload);
+}
+
+int HTTPClient::sendRequest(const char* type, String payload) {
+	return sendRequest(type, (uint8_t*)payload.c_str(), payload.length());
+}
+
+/// @brief Sends a request and reads the response headers
+/// @param type The method
+/// @param payload The body, nullptr for none
+/// @param size The length of the body
+/// @return The response code, or a negative HTTPC_ERROR code
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size) {
+	if (!connect()) {
+		return HTTPC_ERROR_CONNECTION_REFUSED;
+	}
+	String request = String(type) + " " + uri + " HTTP/1.1\r\nHost: " + host;
+	if (port != 80 && port != 443) {
+		request += ":" + String(port);
+	}
+	request += "\r\nUser-Agent: ESP32HTTPClient\r\nConnection: ";
+	request += reuse ? "keep-alive" : "close";
+	request += "\r\n";
+	if (!authorization.isEmpty()) {
+		request += "Authorization: Basic " + authorization + "\r\n";
+	}
+	for (const auto& h : headers) {
+		request += h.first + ": " + h.second + "\r\n";
+	}
+	if (payload != nullptr && size > 0) {
+		request += "Content-Length: " + String((unsigned int)size) + "\r\n";
+	}
+	request += "\r\n";
+	if (client->write((const uint8_t*)request.c_str(), request.length()) != request.length()) {
+		return HTTPC_ERROR_SEND_HEADER_FAILED;
+	}
+	if (payload != nullptr && size > 0 && client->write(payload, size) != size) {
+		return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+	}
+	return readResponse();
+}
+
+int HTTPClient::getSize() {
+	return size;
+}
+
+String HTTPClient::getString() {
+	String body;
+	class StringStream : public Stream {
+		public:
+			StringStream(String& s) : s(s) {}
+			size_t write(uint8_t c) override { s += (char)c; return 1; }
+			size_t write(const uint8_t* buffer, size_t size) override { s.concat(buffer, size); return size; }
+			int available() override { return 0; }
+			int read() override { return -1; }
+			int peek() override { return -1; }
+			String& s;
+	} stream(body);
+	writeToStream(&stream);
+	return body;
+}
+
+/// @brief Reads the response body into a stream
+/// @param stream The stream to write to
+/// @return The number of bytes written, or a negative HTTPC_ERROR code
+int HTTPClient::writeToStream(Stream* stream) {
+	if (!connected() && size != 0) {
+		return HTTPC_ERROR_NOT_CONNECTED;
+	}
+	int total = 0;
+	uint8_t buffer[1024];
+	client->setTimeout((timeout + 999) / 1000);
+	if (chunked) {
+		while (true) {
+			String line = readLine();
+			int length = strtol(line.c_str(), nullptr, 16);
+			if (line.isEmpty()) {
+				return HTTPC_ERROR_READ_TIMEOUT;
+			}
+			if (length == 0) {
+				readLine();
+				return total;
+			}
+			while (length > 0) {
+				size_t n = client->readBytes(buffer, std::min((size_t)length, sizeof(buffer)));
+				if (n == 0) {
+					return HTTPC_ERROR_READ_TIMEOUT;
+				}
+				if (stream->write(buffer, n) != n) {
+					return HTTPC_ERROR_STREAM_WRITE;
+				}
+				length -= n;
+				total += n;
+			}
+			readLine();
+		}
+	}
+	while (size < 0 || total < size) {
+		size_t wanted = size < 0 ? sizeof(buffer) : std::min((size_t)(size - total), sizeof(buffer));
+		size_t n = client->readBytes(buffer, wanted);
+		if (n == 0) {
+			// Without a length the body ends when the connection closes
+			if (size < 0) {
+				can_reuse = false;
+				return total;
+			}
+			return HTTPC_ERROR_READ_TIMEOUT;
+		}
+		if (stream->write(buffer, n) != n) {
+			return HTTPC_ERROR_STREAM_WRITE;
+		}
+		total += n;
+	}
+	return total;
+}
+
+String HTTPClient::errorToString(int error) {
+	switch (error) {
+		case HTTPC_ERROR_CONNECTION_REFUSED:
+			return "connection refused";
+		case HTTPC_ERROR_SEND_HEADER_FAILED:
+			return "send header failed";
+		case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+			return "send payload failed";
+		case HTTPC_ERROR_NOT_CONNECTED:
+			return "not connected";
+		case HTTPC_ERROR_CONNECTION_LOST:
+			return "connection lost";
+		case HTTPC_ERROR_READ_TIMEOUT:
+			return "read Timeout";
+		default:
+			return String();
+	}
+}
+
+/// @brief Resets the state of the last request, but not the authorization or connection
+void HTTPClient::clear() {
+	headers.clear();
+	size = -1;
+	chunked = false;
+	can_reuse = false;
+}
+
+/// @brief Connects to the server, unless the connection is already open
+/// @return True if connected
+bool HTTPClient::connect() {
+	if (client == nullptr) {
+		return false;
+	}
+	if (connected()) {
+		return true;
+	}
+	return client->connect(host.c_str(), port);
+}
+
+/// @brief Reads a line of the response, without the line ending
+/// @return The line, empty if nothing could be read
+String HTTPClient::readLine() {
+	String line;
+	uint8_t c;
+	client->setTimeout((timeout + 999) / 1000);
+	while (client->readBytes(&c, 1) == 1 && c != '\n') {
+		if (c != '\r') {
+			line += (char)c;
+		}
+	}
+	return line;
+}
+
+/// @brief Reads the status line and headers of a response
+/// @return The response code, or a negative HTTPC_ERROR code
+int HTTPClient::readResponse() {
+	String status = readLine();
+	if (!status.startsWith("HTTP/1.")) {
+		return status.isEmpty() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_NO_HTTP_SERVER;
+	}
+	int code = status.substring(9, 12).toInt();
+	can_reuse = reuse && status.startsWith("HTTP/1.1");
+	while (true) {
+		String line = readLine();
+		if (line.isEmpty()) {
+			break;
+		}
+		int colon = line.indexOf(':');
+		if (colon < 0) {
+			continue;
+		}
+		String name = line.substring(0, colon);
+		String value = line.substring(colon + 1);
+		value.trim();
+		name.toLowerCase();
+		value.toLowerCase();
+		if (name == "content-length") {
+			size = value.toInt();
+		} else if (name == "transfer-encoding" && value == "chunked") {
+			chunked = true;
+		} else if (name == "connection" && value.indexOf("close") >= 0) {
+			can_reuse = false;
+		}
+	}
+	if (code == HTTP_CODE_NO_CONTENT || code == HTTP_CODE_NOT_MODIFIED) {
+		size = 0;
+	}
+	return code;
+}
+
+/// @brief Encodes text as Base64
+/// @param text The text
+/// @return The encoded text
+String HTTPClient::base64(const String& text) {
+	static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	String encoded;
+	const uint8_t* bytes = (const uint8_t*)text.c_str();
+	for (size_t i = 0; i < text.length(); i += 3) {
+		uint32_t group = bytes[i] << 16;
+		if (i + 1 < text.length()) {
+			group |= bytes[i + 1] << 8;
+		}
+		if (i + 2 < text.length()) {
+			group |= bytes[i + 2];
+		}
+		encoded += alphabet[(group >> 18) & 63];
+		encoded += alphabet[(group >> 12) & 63];
+		encoded += i + 1 < text.length() ? alphabet[(group >> 6) & 63] : '=';
+		encoded += i + 2 < text.length() ? alphabet[group & 63] : '=';
+	}
+	return encoded;
+}
@@ -0,0 +1,125 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* HTTP/1.1 client with the same connection handling as arduino-esp32's HTTPClient: begin() resets the request headers
+* but not the authorization, end() keeps the connection open when reuse is on and the server allows it, and deleting
+* the client closes its connection.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <vector>
+#include <utility>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+/// @brief HTTP status codes
+typedef enum {
+	HTTP_CODE_OK = 200,
+	HTTP_CODE_CREATED = 201,
+	HTTP_CODE_ACCEPTED = 202,
+	HTTP_CODE_NO_CONTENT = 204,
+	HTTP_CODE_PARTIAL_CONTENT = 206,
+	HTTP_CODE_MOVED_PERMANENTLY = 301,
+	HTTP_CODE_FOUND = 302,
+	HTTP_CODE_NOT_MODIFIED = 304,
+	HTTP_CODE_BAD_REQUEST = 400,
+	HTTP_CODE_UNAUTHORIZED = 401,
+	HTTP_CODE_FORBIDDEN = 403,
+	HTTP_CODE_NOT_FOUND = 404,
+	HTTP_CODE_METHOD_NOT_ALLOWED = 405,
+	HTTP_CODE_NOT_ACCEPTABLE = 406,
+	HTTP_CODE_REQUEST_TIMEOUT = 408,
+	HTTP_CODE_CONFLICT = 409,
+	HTTP_CODE_LENGTH_REQUIRED = 411,
+	HTTP_CODE_PRECONDITION_FAILED = 412,
+	HTTP_CODE_PAYLOAD_TOO_LARGE = 413,
+	HTTP_CODE_UNSUPPORTED_MEDIA_TYPE = 415,
+	HTTP_CODE_RANGE_NOT_SATISFIABLE = 416,
+	HTTP_CODE_TOO_MANY_REQUESTS = 429,
+	HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+	HTTP_CODE_NOT_IMPLEMENTED = 501,
+	HTTP_CODE_BAD_GATEWAY = 502,
+	HTTP_CODE_SERVICE_UNAVAILABLE = 503,
+	HTTP_CODE_GATEWAY_TIMEOUT = 504,
+	HTTP_CODE_INSUFFICIENT_STORAGE = 507
+} t_http_codes;
+
+/// @brief Sends HTTP requests over a client connection
+class HTTPClient {
+	public:
+		~HTTPClient();
+		bool begin(WiFiClient& client, String url);
+		void end();
+		bool connected();
+		void setReuse(bool reuse);
+		void setAuthorization(const char* auth);
+		void setAuthorization(const char* user, const char* password);
+		void setTimeout(uint16_t timeout);
+		void setConnectTimeout(int32_t timeout) {}
+		void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+		int GET();
+		int POST(String payload);
+		int POST(uint8_t* payload, size_t size);
+		int PUT(String payload);
+		int sendRequest(const char* type, String payload);
+		int sendRequest(const char* type, uint8_t* payload = nullptr, size_t size = 0);
+		int getSize();
+		String getString();
+		int writeToStream(Stream* stream);
+		WiFiClient& getStream() { return *client; }
+		static String errorToString(int error);
+
+	private:
+		/// @brief The connection requests are sent on
+		WiFiClient* client = nullptr;
+
+		/// @brief The host of the URL
+		String host;
+
+		/// @brief The port of the URL
+		uint16_t port = 80;
+
+		/// @brief The path and query of the URL
+		String uri;
+
+		/// @brief Base64 encoded credentials, empty for none
+		String authorization;
+
+		/// @brief Headers added to the next request
+		std::vector<std::pair<String, String>> headers;
+
+		/// @brief True to ask the server to keep the connection open
+		bool reuse = true;
+
+		/// @brief True if the server agreed to keep the connection open
+		bool can_reuse = false;
+
+		/// @brief Length of the response body, -1 if unknown
+		int size = -1;
+
+		/// @brief True if the response body is chunked
+		bool chunked = false;
+
+		/// @brief Time in ms to wait for the response
+		uint16_t timeout = 5000;
+
+		void clear();
+		bool connect();
+		String readLine();
+		int readResponse();
+		static String base64(const String& text);
+};
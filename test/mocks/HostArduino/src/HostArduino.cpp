@@ -0,0 +1,225 @@
+#include "Arduino.h"
+#include "HostTest.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+/// @brief The time the program started
+static const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+/// @brief Thrown by vTaskDelete() to end the calling task's thread
+struct TaskDeleted {};
+
+/// @brief A FreeRTOS queue
+typedef struct queue {
+	/// @brief The maximum number of items
+	size_t length;
+
+	/// @brief The size of each item in bytes
+	size_t item_size;
+
+	/// @brief The items, oldest first
+	std::deque<std::vector<uint8_t>> items;
+
+	/// @brief Guards the items
+	std::mutex lock;
+
+	/// @brief Signalled when an item is added or removed
+	std::condition_variable changed;
+} queue;
+
+/// @brief Waits on a condition variable for a number of ticks, forever for portMAX_DELAY
+/// @param changed The condition variable
+/// @param lock The lock held
+/// @param ticks The number of ticks (ms) to wait
+/// @param ready Returns true once the wait is over
+/// @return True if ready returned true
+static bool waitFor(std::condition_variable& changed, std::unique_lock<std::mutex>& lock, TickType_t ticks, std::function<bool()> ready) {
+	if (ticks == portMAX_DELAY) {
+		changed.wait(lock, ready);
+		return true;
+	}
+	return changed.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+unsigned long millis() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+unsigned long micros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+void delay(unsigned long ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+	std::this_thread::yield();
+}
+
+size_t host_strlcpy(char* destination, const char* source, size_t size) {
+	size_t length = strlen(source);
+	if (size > 0) {
+		size_t n = std::min(length, size - 1);
+		memcpy(destination, source, n);
+		destination[n] = '\0';
+	}
+	return length;
+}
+
+void HardwareSerial::begin(unsigned long baud) {}
+
+size_t HardwareSerial::write(uint8_t c) {
+	return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+	return fwrite(buffer, 1, size, stdout);
+}
+
+uint32_t EspClass::getFreeHeap() {
+	return 256 * 1024;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+	return 128 * 1024;
+}
+
+void EspClass::restart() {
+	printf("Restart requested\n");
+	HostTest::finish(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+	return new std::timed_mutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+	return new std::recursive_timed_mutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+	std::timed_mutex* m = (std::timed_mutex*)semaphore;
+	if (ticks == portMAX_DELAY) {
+		m->lock();
+		return pdTRUE;
+	}
+	return m->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+	((std::timed_mutex*)semaphore)->unlock();
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+	std::recursive_timed_mutex* m = (std::recursive_timed_mutex*)semaphore;
+	if (ticks == portMAX_DELAY) {
+		m->lock();
+		return pdTRUE;
+	}
+	return m->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+	((std::recursive_timed_mutex*)semaphore)->unlock();
+	return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+	queue* q = new queue();
+	q->length = length;
+	q->item_size = itemSize;
+	return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void* item, TickType_t ticks) {
+	queue* q = (queue*)handle;
+	std::unique_lock<std::mutex> lock(q->lock);
+	if (!waitFor(q->changed, lock, ticks, [q]() { return q->items.size() < q->length; })) {
+		return pdFALSE;
+	}
+	q->items.emplace_back((const uint8_t*)item, (const uint8_t*)item + q->item_size);
+	q->changed.notify_all();
+	return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void* item, TickType_t ticks) {
+	queue* q = (queue*)handle;
+	std::unique_lock<std::mutex> lock(q->lock);
+	if (!waitFor(q->changed, lock, ticks, [q]() { return !q->items.empty(); })) {
+		return pdFALSE;
+	}
+	memcpy(item, q->items.front().data(), q->item_size);
+	q->items.pop_front();
+	q->changed.notify_all();
+	return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+	queue* q = (queue*)handle;
+	std::lock_guard<std::mutex> lock(q->lock);
+	return q->items.size();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack, void* parameters, UBaseType_t priority, TaskHandle_t* handle) {
+	std::thread thread([task, parameters]() {
+		try {
+			task(parameters);
+		} catch (const TaskDeleted&) {
+		}
+	});
+	if (handle != nullptr) {
+		*handle = (TaskHandle_t)(uintptr_t)std::hash<std::thread::id>()(thread.get_id());
+	}
+	thread.detach();
+	return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stack, void* parameters, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+	return xTaskCreate(task, name, stack, parameters, priority, handle);
+}
+
+void vTaskDelay(TickType_t ticks) {
+	delay(ticks);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+	// Only tasks ending themselves are supported
+	if (task == nullptr) {
+		throw TaskDeleted();
+	}
+}
+
+namespace HostTest {
+	/// @brief Gets the directory holding the files of each storage medium, unique to the process
+	/// @return The path on the host
+	std::string storageRoot() {
+		static const std::string root = (std::filesystem::temp_directory_path() / ("hub-test-" + std::to_string(getpid()))).string();
+		return root;
+	}
+
+	/// @brief Deletes all files on every storage medium
+	void resetStorage() {
+		std::error_code error;
+		std::filesystem::remove_all(storageRoot(), error);
+	}
+
+	/// @brief Flushes output and exits without destroying static objects, which tasks still running may use
+	/// @param result The exit code
+	void finish(int result) {
+		resetStorage();
+		fflush(stdout);
+		fflush(stderr);
+		_Exit(result);
+	}
+}
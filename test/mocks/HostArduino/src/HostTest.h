@@ -0,0 +1,22 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Controls for the host implementations of the Arduino core, used by tests to set up the hub's surroundings.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace HostTest {
+	std::string storageRoot();
+	void resetStorage();
+	void setWiFiConnected(bool connected);
+	void setRunningFirmware(const std::vector<uint8_t>& image);
+	const std::vector<uint8_t>& updateWritten();
+	bool updateFinished();
+	void finish(int result) __attribute__((noreturn));
+}
@@ -0,0 +1,23 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* LittleFS, stored in the "littlefs" directory under the test's storage root.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <FS.h>
+
+namespace fs {
+	/// @brief The internal flash file system
+	class LittleFSFS : public FS {
+		public:
+			LittleFSFS() : FS("littlefs", true) { total_bytes = 1408 * 1024; }
+			bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs") { return true; }
+			bool format();
+			void end() {}
+	};
+}
+
+extern fs::LittleFSFS LittleFS;
@@ -0,0 +1,230 @@
+#include "LocalServer.h"
+#include <algorithm>
+#include <chrono>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+LocalServer::~LocalServer() {
+	stop();
+}
+
+/// @brief Starts listening on a free port
+/// @return True on success
+bool LocalServer::start() {
+	stop();
+	sockets.clear();
+	received.clear();
+	next_responses.clear();
+	concurrent = 0;
+	peak_concurrent = 0;
+	listener = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0) {
+		return false;
+	}
+	int on = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+	socklen_t length = sizeof(address);
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0 || getsockname(listener, (sockaddr*)&address, &length) != 0) {
+		::close(listener);
+		listener = -1;
+		return false;
+	}
+	port = ntohs(address.sin_port);
+	acceptor = std::thread(&LocalServer::accept, this);
+	return true;
+}
+
+/// @brief Stops listening and closes all connections
+void LocalServer::stop() {
+	if (listener < 0) {
+		return;
+	}
+	// Wakes the acceptor up
+	shutdown(listener, SHUT_RDWR);
+	acceptor.join();
+	::close(listener);
+	listener = -1;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		for (int fd : sockets) {
+			if (fd >= 0) {
+				shutdown(fd, SHUT_RDWR);
+			}
+		}
+	}
+	for (auto& handler : handlers) {
+		handler.join();
+	}
+	handlers.clear();
+}
+
+/// @brief Gets the URL of a path on the server
+/// @param path The path, starting with a slash
+/// @return The URL
+String LocalServer::url(const String& path) const {
+	return "http://127.0.0.1:" + String(port) + path;
+}
+
+/// @brief Sets the response to send to requests from now on
+/// @param code The status code
+/// @param body The body
+/// @param keepAlive True to keep the connection open, false to close it after responding
+void LocalServer::respond(int code, const String& body, bool keepAlive) {
+	std::lock_guard<std::mutex> guard(lock);
+	this->code = code;
+	this->body = body;
+	keep_alive = keepAlive;
+}
+
+/// @brief Sets a response for the next request that hasn't been given one, before going back to the usual response
+/// @param code The status code, or 0 to close the connection without responding
+/// @param body The body
+void LocalServer::respondNext(int code, const String& body) {
+	std::lock_guard<std::mutex> guard(lock);
+	next_responses.push_back({ code, body });
+}
+
+/// @brief Sets how long to wait before responding to requests from now on
+/// @param latency The time in ms
+void LocalServer::setLatency(ulong latency) {
+	std::lock_guard<std::mutex> guard(lock);
+	this->latency = latency;
+}
+
+/// @brief Gets the number of connections accepted
+/// @return The number of connections
+int LocalServer::connections() {
+	std::lock_guard<std::mutex> guard(lock);
+	return sockets.size();
+}
+
+/// @brief Gets the most requests that have waited for their responses at once
+/// @return The number of requests
+int LocalServer::peakConcurrency() {
+	std::lock_guard<std::mutex> guard(lock);
+	return peak_concurrent;
+}
+
+/// @brief Gets the requests received
+/// @return The requests, oldest first
+std::vector<LocalServer::request> LocalServer::requests() {
+	std::lock_guard<std::mutex> guard(lock);
+	return received;
+}
+
+/// @brief Waits for a number of requests to have been received
+/// @param count The number of requests
+/// @param timeout The time in ms to wait
+/// @return True if they were received in time
+bool LocalServer::waitForRequests(size_t count, ulong timeout) {
+	std::unique_lock<std::mutex> guard(lock);
+	return changed.wait_for(guard, std::chrono::milliseconds(timeout), [this, count]() { return received.size() >= count; });
+}
+
+/// @brief Accepts connections until the server is stopped, serving each on a thread of its own
+void LocalServer::accept() {
+	while (true) {
+		int fd = ::accept(listener, nullptr, nullptr);
+		if (fd < 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		sockets.push_back(fd);
+		handlers.emplace_back(&LocalServer::serve, this, fd, (int)sockets.size());
+	}
+}
+
+/// @brief Reads requests from a connection and responds to them until it's closed
+/// @param fd The socket of the connection
+/// @param number The number of the connection
+void LocalServer::serve(int fd, int number) {
+	std::string data;
+	char buffer[4096];
+	bool open = true;
+	while (open) {
+		// Read the request line and headers
+		size_t header_end;
+		while (open && (header_end = data.find("\r\n\r\n")) == std::string::npos) {
+			ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+			open = n > 0;
+			data.append(buffer, open ? n : 0);
+		}
+		if (!open) {
+			break;
+		}
+		request r = { .method = "", .path = "", .headers = {}, .body = "", .connection = number, .time = millis() };
+		size_t line_start = 0;
+		size_t length = 0;
+		while (line_start < header_end) {
+			size_t line_end = data.find("\r\n", line_start);
+			String line = data.substr(line_start, line_end - line_start);
+			if (line_start == 0) {
+				int first = line.indexOf(' ');
+				r.method = line.substring(0, first);
+				r.path = line.substring(first + 1, line.indexOf(' ', first + 1));
+			} else {
+				int colon = line.indexOf(':');
+				String name = line.substring(0, colon);
+				String value = line.substring(colon + 1);
+				name.toLowerCase();
+				value.trim();
+				r.headers[name] = value;
+				if (name == "content-length") {
+					length = value.toInt();
+				}
+			}
+			line_start = line_end + 2;
+		}
+		// Read the body
+		size_t request_end = header_end + 4 + length;
+		while (open && data.size() < request_end) {
+			ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+			open = n > 0;
+			data.append(buffer, open ? n : 0);
+		}
+		if (!open) {
+			break;
+		}
+		r.body = data.substr(header_end + 4, length);
+		data.erase(0, request_end);
+		int response_code;
+		String response_body;
+		ulong wait;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			received.push_back(r);
+			changed.notify_all();
+			response_code = code;
+			response_body = body;
+			open = keep_alive;
+			if (!next_responses.empty()) {
+				response_code = next_responses.front().first;
+				response_body = next_responses.front().second;
+				next_responses.erase(next_responses.begin());
+			}
+			wait = latency;
+			peak_concurrent = std::max(peak_concurrent, ++concurrent);
+		}
+		if (wait > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			concurrent--;
+		}
+		if (response_code == 0) {
+			break;
+		}
+		std::string response = "HTTP/1.1 " + std::to_string(response_code) + (response_code == 200 ? " OK" : " Error") + "\r\nContent-Length: " + std::to_string(response_body.length()) + "\r\nConnection: " + (open ? "keep-alive" : "close") + "\r\n\r\n" + response_body.c_str();
+		send(fd, response.c_str(), response.length(), MSG_NOSIGNAL);
+	}
+	std::lock_guard<std::mutex> guard(lock);
+	sockets[number - 1] = -1;
+	::close(fd);
+}
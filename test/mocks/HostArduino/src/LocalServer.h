@@ -0,0 +1,103 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* An HTTP/1.1 server on 127.0.0.1 standing in for the servers webhooks and telemetry are sent to. It records the requests
+* and connections it receives, and answers every request with the same response, keeping connections open unless the
+* response closes them. Responses can be delayed, and failures injected for the next few requests.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief A local HTTP server for tests
+class LocalServer {
+	public:
+		/// @brief A request received by the server
+		typedef struct request {
+			/// @brief The method
+			String method;
+
+			/// @brief The path, with any query string
+			String path;
+
+			/// @brief The headers, by lower case name
+			std::map<String, String> headers;
+
+			/// @brief The body
+			String body;
+
+			/// @brief The number of the connection the request came on, counting from 1
+			int connection;
+
+			/// @brief The time in ms since boot the request was received
+			ulong time;
+		} request;
+
+		~LocalServer();
+		bool start();
+		void stop();
+		String url(const String& path) const;
+		void respond(int code, const String& body, bool keepAlive = true);
+		void respondNext(int code, const String& body = "");
+		void setLatency(ulong latency);
+		int connections();
+		int peakConcurrency();
+		std::vector<request> requests();
+		bool waitForRequests(size_t count, ulong timeout);
+
+	private:
+		/// @brief The listening socket, -1 if stopped
+		int listener = -1;
+
+		/// @brief The port listened on
+		uint16_t port = 0;
+
+		/// @brief Accepts connections
+		std::thread acceptor;
+
+		/// @brief Serve each accepted connection
+		std::vector<std::thread> handlers;
+
+		/// @brief Sockets of open connections, -1 once closed
+		std::vector<int> sockets;
+
+		/// @brief Guards everything the server's threads share with the test
+		std::mutex lock;
+
+		/// @brief Signalled when a request is received
+		std::condition_variable changed;
+
+		/// @brief Requests received, oldest first
+		std::vector<request> received;
+
+		/// @brief The status code to respond with
+		int code = 200;
+
+		/// @brief The body to respond with
+		String body = "ok";
+
+		/// @brief True to keep connections open after responding
+		bool keep_alive = true;
+
+		/// @brief Status codes and bodies to respond to the next requests with, before the usual response. A code of 0 closes the connection without responding
+		std::vector<std::pair<int, String>> next_responses;
+
+		/// @brief Time in ms to wait before responding
+		ulong latency = 0;
+
+		/// @brief Number of requests waiting for their response
+		int concurrent = 0;
+
+		/// @brief Most requests that have waited for their response at once
+		int peak_concurrent = 0;
+
+		void accept();
+		void serve(int fd, int number);
+};
@@ -0,0 +1,16 @@
+#include "LittleFS.h"
+#include "SD.h"
+#include "SD_MMC.h"
+#include "HostTest.h"
+#include <filesystem>
+
+fs::LittleFSFS LittleFS;
+fs::SDFS SD;
+fs::SDMMCFS SD_MMC;
+SPIClass SPI;
+
+bool fs::LittleFSFS::format() {
+	std::error_code error;
+	std::filesystem::remove_all(hostPath("/"), error);
+	return !error;
+}
@@ -0,0 +1,36 @@
+#include "Print.h"
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+/// @brief Writes bytes one at a time, classes that can do better override this
+/// @param buffer The bytes
+/// @param size The number of bytes
+/// @return The number of bytes written
+size_t Print::write(const uint8_t* buffer, size_t size) {
+	size_t written = 0;
+	while (size-- > 0 && write(*buffer++) == 1) {
+		written++;
+	}
+	return written;
+}
+
+/// @brief Prints formatted text
+/// @param format The format, as for printf()
+/// @return The number of bytes written
+size_t Print::printf(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	va_list copy;
+	va_copy(copy, args);
+	int length = vsnprintf(nullptr, 0, format, copy);
+	va_end(copy);
+	if (length < 0) {
+		va_end(args);
+		return 0;
+	}
+	std::vector<char> text(length + 1);
+	vsnprintf(text.data(), text.size(), format, args);
+	va_end(args);
+	return write((const uint8_t*)text.data(), length);
+}
@@ -0,0 +1,45 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Arduino's Print, for classes that output text or bytes.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <WString.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/// @brief Base class of everything that can be printed to
+class Print {
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t* buffer, size_t size);
+		size_t write(const char* str) { return str == nullptr ? 0 : write((const uint8_t*)str, strlen(str)); }
+		size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+		virtual void flush() {}
+
+		size_t printf(const char* format, ...);
+		size_t print(const String& s) { return write(s.c_str(), s.length()); }
+		size_t print(const char* s) { return write(s); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(unsigned char value, int base = DEC) { return print(String(value, base)); }
+		size_t print(int value, int base = DEC) { return print(String(value, base)); }
+		size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+		size_t print(long value, int base = DEC) { return print(String(value, base)); }
+		size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+		size_t print(long long value, int base = DEC) { return print(String(value, base)); }
+		size_t print(unsigned long long value, int base = DEC) { return print(String(value, base)); }
+		size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+		size_t println() { return write("\r\n"); }
+		template <typename T> size_t println(const T& value) { return print(value) + println(); }
+		template <typename T> size_t println(const T& value, int format) { return print(value, format) + println(); }
+};
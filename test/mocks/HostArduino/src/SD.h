@@ -0,0 +1,31 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* An SD card on an SPI bus, stored in the "sd" directory under the test's storage root.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <FS.h>
+#include <SPI.h>
+
+#define CARD_NONE 0
+#define CARD_MMC 1
+#define CARD_SD 2
+#define CARD_SDHC 3
+#define CARD_UNKNOWN 4
+
+namespace fs {
+	/// @brief An SD card on an SPI bus
+	class SDFS : public FS {
+		public:
+			SDFS() : FS("sd", false) { total_bytes = 4ULL * 1024 * 1024 * 1024; }
+			bool begin(uint8_t ssPin = 5, SPIClass& spi = SPI, uint32_t frequency = 4000000, const char* mountpoint = "/sd", uint8_t max_files = 5, bool format_if_empty = false) { return true; }
+			void end() {}
+			uint8_t cardType() { return CARD_SDHC; }
+			uint64_t cardSize() { return total_bytes; }
+	};
+}
+
+extern fs::SDFS SD;
@@ -0,0 +1,26 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* An SD card on an SDIO bus, stored in the "sdmmc" directory under the test's storage root.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <FS.h>
+#include <SD.h>
+
+namespace fs {
+	/// @brief An SD card on an SDIO bus
+	class SDMMCFS : public FS {
+		public:
+			SDMMCFS() : FS("sdmmc", false) { total_bytes = 4ULL * 1024 * 1024 * 1024; }
+			bool setPins(int clk, int cmd, int d0, int d1 = -1, int d2 = -1, int d3 = -1) { return true; }
+			bool begin(const char* mountpoint = "/sdcard", bool mode1bit = false, bool format_if_mount_failed = false, int sdmmc_frequency = 20000, uint8_t maxOpenFiles = 5) { return true; }
+			void end() {}
+			uint8_t cardType() { return CARD_SDHC; }
+			uint64_t cardSize() { return total_bytes; }
+	};
+}
+
+extern fs::SDMMCFS SD_MMC;
@@ -0,0 +1,19 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* The SPI bus, which does nothing on the host.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+
+/// @brief An SPI bus
+class SPIClass {
+	public:
+		void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+		void end() {}
+};
+
+extern SPIClass SPI;
@@ -0,0 +1,41 @@
+#include "Stream.h"
+
+/// @brief Reads bytes until the length is read or none are left
+/// @param buffer The buffer to read into
+/// @param length The number of bytes to read
+/// @return The number of bytes read
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+	size_t count = 0;
+	while (count < length) {
+		int c = read();
+		if (c < 0) {
+			break;
+		}
+		buffer[count++] = (uint8_t)c;
+	}
+	return count;
+}
+
+/// @brief Reads everything left
+/// @return The text read
+String Stream::readString() {
+	String text;
+	uint8_t buffer[512];
+	size_t length;
+	while ((length = readBytes(buffer, sizeof(buffer))) > 0) {
+		text.concat(buffer, length);
+	}
+	return text;
+}
+
+/// @brief Reads up to a character, which is consumed but not returned
+/// @param terminator The character to stop at
+/// @return The text read
+String Stream::readStringUntil(char terminator) {
+	String text;
+	int c;
+	while ((c = read()) >= 0 && c != terminator) {
+		text += (char)c;
+	}
+	return text;
+}
@@ -0,0 +1,27 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Arduino's Stream, for classes that can be read from as well as printed to.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Print.h>
+
+/// @brief Base class of everything that can be read from
+class Stream : public Print {
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+		virtual size_t readBytes(uint8_t* buffer, size_t length);
+		size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+		String readString();
+		String readStringUntil(char terminator);
+		void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+
+	protected:
+		/// @brief Time in ms to wait for more data, the host never waits since reads don't block
+		unsigned long timeout = 1000;
+};
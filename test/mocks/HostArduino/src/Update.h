@@ -0,0 +1,50 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Firmware updates, collecting the new image in memory where tests can check it with HostTest::updateWritten().
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH 0
+#define U_SPIFFS 100
+
+/// @brief Writes a new firmware image
+class UpdateClass {
+	public:
+		bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH, int ledPin = -1, uint8_t ledOn = LOW, const char* label = NULL);
+		size_t write(uint8_t* data, size_t len);
+		bool end(bool evenIfRemaining = false);
+		void abort();
+		bool hasError() { return error != nullptr; }
+		const char* errorString() { return error == nullptr ? "No Error" : error; }
+		void printError(Print& out) { out.println(errorString()); }
+		bool isRunning() { return running; }
+		bool isFinished() { return finished; }
+		size_t size() { return expected; }
+		size_t progress() { return image.size(); }
+		size_t remaining() { return expected == UPDATE_SIZE_UNKNOWN ? 0 : expected - image.size(); }
+
+		/// @brief The bytes written so far
+		std::vector<uint8_t> image;
+
+	private:
+		/// @brief The size of the update, UPDATE_SIZE_UNKNOWN if not given
+		size_t expected = UPDATE_SIZE_UNKNOWN;
+
+		/// @brief True between begin() and end()
+		bool running = false;
+
+		/// @brief True once the update ended successfully
+		bool finished = false;
+
+		/// @brief Description of the error, nullptr if none
+		const char* error = nullptr;
+};
+
+extern UpdateClass Update;
@@ -0,0 +1,362 @@
+#include "WString.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/// @brief Formats an integer in a base, the same as Arduino's ultoa()
+/// @param value The value
+/// @param negative True to add a minus sign
+/// @param base The base, from 2 to 36
+/// @return The formatted value
+static std::string formatInteger(unsigned long long value, bool negative, unsigned char base) {
+	if (base < 2 || base > 36) {
+		base = 10;
+	}
+	std::string digits;
+	do {
+		int digit = value % base;
+		digits += (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+		value /= base;
+	} while (value > 0);
+	if (negative) {
+		digits += '-';
+	}
+	std::reverse(digits.begin(), digits.end());
+	return digits;
+}
+
+/// @brief Formats a floating point value, the same as Arduino's dtostrf()
+/// @param value The value
+/// @param decimalPlaces The number of decimals
+/// @return The formatted value
+static std::string formatFloat(double value, unsigned char decimalPlaces) {
+	if (std::isnan(value)) {
+		return "nan";
+	}
+	if (std::isinf(value)) {
+		return value > 0 ? "inf" : "-inf";
+	}
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+	return buffer;
+}
+
+String::String(const char* cstr) : buffer(cstr == nullptr ? "" : cstr) {}
+
+String::String(const char* cstr, unsigned int length) : buffer(cstr == nullptr ? "" : std::string(cstr, length)) {}
+
+String::String(const std::string& str) : buffer(str) {}
+
+String::String(char c) : buffer(1, c) {}
+
+String::String(unsigned char value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+
+String::String(int value, unsigned char base) : buffer(base == 10 ? formatInteger(value < 0 ? -(long long)value : value, value < 0, base) : formatInteger((unsigned int)value, false, base)) {}
+
+String::String(unsigned int value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+
+String::String(long value, unsigned char base) : buffer(base == 10 ? formatInteger(value < 0 ? -(long long)value : value, value < 0, base) : formatInteger((unsigned long)value, false, base)) {}
+
+String::String(unsigned long value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+
+String::String(long long value, unsigned char base) : buffer(base == 10 ? formatInteger(value < 0 ? -(unsigned long long)value : value, value < 0, base) : formatInteger((unsigned long long)value, false, base)) {}
+
+String::String(unsigned long long value, unsigned char base) : buffer(formatInteger(value, false, base)) {}
+
+String::String(float value, unsigned char decimalPlaces) : buffer(formatFloat(value, decimalPlaces)) {}
+
+String::String(double value, unsigned char decimalPlaces) : buffer(formatFloat(value, decimalPlaces)) {}
+
+bool String::reserve(unsigned int size) {
+	buffer.reserve(size);
+	return true;
+}
+
+bool String::concat(const String& str) {
+	buffer += str.buffer;
+	return true;
+}
+
+bool String::concat(const char* cstr) {
+	if (cstr == nullptr) {
+		return false;
+	}
+	buffer += cstr;
+	return true;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+	if (cstr == nullptr) {
+		return false;
+	}
+	buffer.append(cstr, length);
+	return true;
+}
+
+bool String::concat(const uint8_t* cstr, unsigned int length) {
+	return concat((const char*)cstr, length);
+}
+
+bool String::concat(char c) {
+	buffer += c;
+	return true;
+}
+
+bool String::concat(unsigned char value) {
+	return concat(String(value));
+}
+
+bool String::concat(int value) {
+	return concat(String(value));
+}
+
+bool String::concat(unsigned int value) {
+	return concat(String(value));
+}
+
+bool String::concat(long value) {
+	return concat(String(value));
+}
+
+bool String::concat(unsigned long value) {
+	return concat(String(value));
+}
+
+bool String::concat(long long value) {
+	return concat(String(value));
+}
+
+bool String::concat(unsigned long long value) {
+	return concat(String(value));
+}
+
+bool String::concat(float value) {
+	return concat(String(value));
+}
+
+bool String::concat(double value) {
+	return concat(String(value));
+}
+
+int String::compareTo(const String& s) const {
+	return buffer.compare(s.buffer);
+}
+
+bool String::equals(const String& s) const {
+	return buffer == s.buffer;
+}
+
+bool String::equals(const char* cstr) const {
+	return buffer == (cstr == nullptr ? "" : cstr);
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+	if (buffer.length() != s.buffer.length()) {
+		return false;
+	}
+	for (size_t i = 0; i < buffer.length(); i++) {
+		if (tolower((unsigned char)buffer[i]) != tolower((unsigned char)s.buffer[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool String::startsWith(const String& prefix) const {
+	return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+	return offset + prefix.buffer.length() <= buffer.length() && buffer.compare(offset, prefix.buffer.length(), prefix.buffer) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+	return suffix.buffer.length() <= buffer.length() && buffer.compare(buffer.length() - suffix.buffer.length(), suffix.buffer.length(), suffix.buffer) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+	return index < buffer.length() ? buffer[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+	if (index < buffer.length()) {
+		buffer[index] = c;
+	}
+}
+
+char String::operator[](unsigned int index) const {
+	return charAt(index);
+}
+
+char& String::operator[](unsigned int index) {
+	static char dummy;
+	if (index >= buffer.length()) {
+		dummy = 0;
+		return dummy;
+	}
+	return buffer[index];
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+	toCharArray((char*)buf, bufsize, index);
+}
+
+void String::toCharArray(char* buf, unsigned int bufsize, unsigned int index) const {
+	if (bufsize == 0 || buf == nullptr) {
+		return;
+	}
+	if (index >= buffer.length()) {
+		buf[0] = 0;
+		return;
+	}
+	size_t n = std::min((size_t)bufsize - 1, buffer.length() - index);
+	memcpy(buf, buffer.c_str() + index, n);
+	buf[n] = 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+	size_t found = buffer.find(ch, fromIndex);
+	return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+	size_t found = buffer.find(str.buffer, fromIndex);
+	return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(char ch) const {
+	size_t found = buffer.rfind(ch);
+	return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const {
+	size_t found = buffer.rfind(ch, fromIndex);
+	return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(const String& str) const {
+	size_t found = buffer.rfind(str.buffer);
+	return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::lastIndexOf(const String& str, unsigned int fromIndex) const {
+	size_t found = buffer.rfind(str.buffer, fromIndex);
+	return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int beginIndex) const {
+	return substring(beginIndex, buffer.length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+	if (beginIndex > endIndex) {
+		std::swap(beginIndex, endIndex);
+	}
+	if (beginIndex >= buffer.length()) {
+		return String();
+	}
+	endIndex = std::min(endIndex, (unsigned int)buffer.length());
+	return String(buffer.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(char find, char replace) {
+	std::replace(buffer.begin(), buffer.end(), find, replace);
+}
+
+void String::replace(const String& find, const String& replace) {
+	if (find.buffer.empty()) {
+		return;
+	}
+	size_t position = 0;
+	while ((position = buffer.find(find.buffer, position)) != std::string::npos) {
+		buffer.replace(position, find.buffer.length(), replace.buffer);
+		position += replace.buffer.length();
+	}
+}
+
+void String::remove(unsigned int index) {
+	if (index < buffer.length()) {
+		buffer.erase(index);
+	}
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+	if (index < buffer.length()) {
+		buffer.erase(index, count);
+	}
+}
+
+void String::toLowerCase() {
+	for (auto& c : buffer) {
+		c = tolower((unsigned char)c);
+	}
+}
+
+void String::toUpperCase() {
+	for (auto& c : buffer) {
+		c = toupper((unsigned char)c);
+	}
+}
+
+void String::trim() {
+	size_t first = buffer.find_first_not_of(" \t\r\n\f\v");
+	if (first == std::string::npos) {
+		buffer.clear();
+		return;
+	}
+	size_t last = buffer.find_last_not_of(" \t\r\n\f\v");
+	buffer = buffer.substr(first, last - first + 1);
+}
+
+long String::toInt() const {
+	return atol(buffer.c_str());
+}
+
+float String::toFloat() const {
+	return atof(buffer.c_str());
+}
+
+double String::toDouble() const {
+	return atof(buffer.c_str());
+}
+
+String operator+(const String& lhs, const String& rhs) {
+	String sum = lhs;
+	sum.concat(rhs);
+	return sum;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+	String sum = lhs;
+	sum.concat(rhs);
+	return sum;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+	String sum = lhs;
+	sum.concat(rhs);
+	return sum;
+}
+
+String operator+(const String& lhs, char rhs) {
+	String sum = lhs;
+	sum.concat(rhs);
+	return sum;
+}
+
+String operator+(char lhs, const String& rhs) {
+	String sum = lhs;
+	sum.concat(rhs);
+	return sum;
+}
+
+bool operator==(const char* lhs, const String& rhs) {
+	return rhs.equals(lhs);
+}
+
+bool operator!=(const char* lhs, const String& rhs) {
+	return !rhs.equals(lhs);
+}
@@ -0,0 +1,131 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Arduino's String, kept in a std::string.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/// @brief Arduino String
+class String {
+	public:
+		String(const char* cstr = "");
+		String(const char* cstr, unsigned int length);
+		String(const std::string& str);
+		String(char c);
+		String(unsigned char value, unsigned char base = 10);
+		String(int value, unsigned char base = 10);
+		String(unsigned int value, unsigned char base = 10);
+		String(long value, unsigned char base = 10);
+		String(unsigned long value, unsigned char base = 10);
+		String(long long value, unsigned char base = 10);
+		String(unsigned long long value, unsigned char base = 10);
+		String(float value, unsigned char decimalPlaces = 2);
+		String(double value, unsigned char decimalPlaces = 2);
+
+		unsigned int length() const { return buffer.length(); }
+		bool isEmpty() const { return buffer.empty(); }
+		const char* c_str() const { return buffer.c_str(); }
+		char* begin() { return &buffer[0]; }
+		char* end() { return &buffer[0] + buffer.length(); }
+		const char* begin() const { return buffer.c_str(); }
+		const char* end() const { return buffer.c_str() + buffer.length(); }
+		bool reserve(unsigned int size);
+
+		bool concat(const String& str);
+		bool concat(const char* cstr);
+		bool concat(const char* cstr, unsigned int length);
+		bool concat(const uint8_t* cstr, unsigned int length);
+		bool concat(char c);
+		bool concat(unsigned char value);
+		bool concat(int value);
+		bool concat(unsigned int value);
+		bool concat(long value);
+		bool concat(unsigned long value);
+		bool concat(long long value);
+		bool concat(unsigned long long value);
+		bool concat(float value);
+		bool concat(double value);
+
+		template <typename T> String& operator+=(const T& value) {
+			concat(value);
+			return *this;
+		}
+
+		explicit operator bool() const { return true; }
+		int compareTo(const String& s) const;
+		bool equals(const String& s) const;
+		bool equals(const char* cstr) const;
+		bool equalsIgnoreCase(const String& s) const;
+		bool operator==(const String& rhs) const { return equals(rhs); }
+		bool operator==(const char* cstr) const { return equals(cstr); }
+		bool operator!=(const String& rhs) const { return !equals(rhs); }
+		bool operator!=(const char* cstr) const { return !equals(cstr); }
+		bool operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+		bool operator>(const String& rhs) const { return compareTo(rhs) > 0; }
+		bool operator<=(const String& rhs) const { return compareTo(rhs) <= 0; }
+		bool operator>=(const String& rhs) const { return compareTo(rhs) >= 0; }
+		bool startsWith(const String& prefix) const;
+		bool startsWith(const String& prefix, unsigned int offset) const;
+		bool endsWith(const String& suffix) const;
+
+		char charAt(unsigned int index) const;
+		void setCharAt(unsigned int index, char c);
+		char operator[](unsigned int index) const;
+		char& operator[](unsigned int index);
+		void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+		void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const;
+
+		int indexOf(char ch, unsigned int fromIndex = 0) const;
+		int indexOf(const String& str, unsigned int fromIndex = 0) const;
+		int lastIndexOf(char ch) const;
+		int lastIndexOf(char ch, unsigned int fromIndex) const;
+		int lastIndexOf(const String& str) const;
+		int lastIndexOf(const String& str, unsigned int fromIndex) const;
+		String substring(unsigned int beginIndex) const;
+		String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+		void replace(char find, char replace);
+		void replace(const String& find, const String& replace);
+		void remove(unsigned int index);
+		void remove(unsigned int index, unsigned int count);
+		void toLowerCase();
+		void toUpperCase();
+		void trim();
+
+		long toInt() const;
+		float toFloat() const;
+		double toDouble() const;
+
+	private:
+		/// @brief The characters of the string
+		std::string buffer;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+String operator+(char lhs, const String& rhs);
+bool operator==(const char* lhs, const String& rhs);
+bool operator!=(const char* lhs, const String& rhs);
+
+/// @brief Appends a number as text, the same as Arduino
+template <typename T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, int>::type = 0>
+String operator+(const String& lhs, T rhs) {
+	String sum = lhs;
+	sum.concat(rhs);
+	return sum;
+}
+
+/// @brief Prepends a number as text, the same as Arduino
+template <typename T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, int>::type = 0>
+String operator+(T lhs, const String& rhs) {
+	return String(lhs) + rhs;
+}
@@ -0,0 +1,146 @@
+#include "WiFi.h"
+#include "HostTest.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+String IPAddress::toString() const {
+	return String(octets[0]) + "." + octets[1] + "." + octets[2] + "." + octets[3];
+}
+
+/// @brief Closes a socket once the last client using it is gone
+/// @param fd The socket
+static void closeSocket(int* fd) {
+	if (*fd >= 0) {
+		::close(*fd);
+	}
+	delete fd;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+	stop();
+	if (!WiFi.isConnected()) {
+		return 0;
+	}
+	addrinfo hints = {};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* found = nullptr;
+	if (getaddrinfo(host, String(port).c_str(), &hints, &found) != 0) {
+		return 0;
+	}
+	int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	int success = fd >= 0 && ::connect(fd, found->ai_addr, found->ai_addrlen) == 0;
+	freeaddrinfo(found);
+	if (!success) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+		return 0;
+	}
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	socket = std::shared_ptr<int>(new int(fd), closeSocket);
+	return 1;
+}
+
+uint8_t WiFiClient::connected() {
+	if (!socket || *socket < 0) {
+		return 0;
+	}
+	// Readable with nothing to read means the other end closed the connection
+	pollfd p = { .fd = *socket, .events = POLLIN, .revents = 0 };
+	if (poll(&p, 1, 0) > 0) {
+		char c;
+		if (recv(*socket, &c, 1, MSG_PEEK | MSG_DONTWAIT) <= 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void WiFiClient::stop() {
+	if (socket && *socket >= 0) {
+		::close(*socket);
+		*socket = -1;
+	}
+	socket.reset();
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+	if (!socket || *socket < 0) {
+		return 0;
+	}
+	size_t sent = 0;
+	while (sent < size) {
+		ssize_t n = send(*socket, buffer + sent, size - sent, MSG_NOSIGNAL);
+		if (n <= 0) {
+			break;
+		}
+		sent += n;
+	}
+	return sent;
+}
+
+int WiFiClient::available() {
+	if (!socket || *socket < 0) {
+		return 0;
+	}
+	char buffer[4096];
+	ssize_t n = recv(*socket, buffer, sizeof(buffer), MSG_PEEK | MSG_DONTWAIT);
+	return n > 0 ? n : 0;
+}
+
+/// @brief Waits for data to read
+/// @param ms The time to wait
+/// @return True if there's data, or the connection was closed
+bool WiFiClient::waitReadable(uint32_t ms) {
+	pollfd p = { .fd = *socket, .events = POLLIN, .revents = 0 };
+	return poll(&p, 1, ms) > 0;
+}
+
+int WiFiClient::read() {
+	uint8_t c;
+	return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+	if (!socket || *socket < 0 || available() == 0) {
+		return -1;
+	}
+	return recv(*socket, buffer, size, MSG_DONTWAIT);
+}
+
+size_t WiFiClient::readBytes(uint8_t* buffer, size_t length) {
+	size_t count = 0;
+	while (count < length && socket && *socket >= 0 && waitReadable(timeout_ms)) {
+		ssize_t n = recv(*socket, buffer + count, length - count, MSG_DONTWAIT);
+		if (n <= 0) {
+			break;
+		}
+		count += n;
+	}
+	return count;
+}
+
+int WiFiClient::peek() {
+	if (!socket || *socket < 0) {
+		return -1;
+	}
+	uint8_t c;
+	return recv(*socket, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? c : -1;
+}
+
+namespace HostTest {
+	/// @brief Sets whether WiFi is connected, clients can't connect while it isn't
+	/// @param connected True if connected
+	void setWiFiConnected(bool connected) {
+		WiFi.is_connected = connected;
+	}
+}
@@ -0,0 +1,85 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* WiFi and TCP clients. Clients use the host's sockets, and whether WiFi is connected is set by the test.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <Arduino.h>
+#include <memory>
+
+#define WL_IDLE_STATUS 0
+#define WL_DISCONNECTED 6
+#define WL_CONNECTED 3
+#define WIFI_STA 1
+#define WIFI_AP 2
+#define WIFI_AP_STA 3
+
+/// @brief An IPv4 address
+class IPAddress {
+	public:
+		IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets{a, b, c, d} {}
+		String toString() const;
+
+	private:
+		/// @brief The parts of the address
+		uint8_t octets[4];
+};
+
+/// @brief A TCP connection
+class Client : public Stream {
+	public:
+		virtual int connect(const char* host, uint16_t port) = 0;
+		virtual uint8_t connected() = 0;
+		virtual void stop() = 0;
+};
+
+/// @brief A TCP connection over a host socket, copies refer to the same socket
+class WiFiClient : public Client {
+	public:
+		virtual ~WiFiClient() {}
+		int connect(const char* host, uint16_t port) override;
+		int connect(const char* host, uint16_t port, int32_t timeout) { return connect(host, port); }
+		uint8_t connected() override;
+		void stop() override;
+		size_t write(uint8_t c) override { return write(&c, 1); }
+		size_t write(const uint8_t* buffer, size_t size) override;
+		using Print::write;
+		int available() override;
+		int read() override;
+		int read(uint8_t* buffer, size_t size);
+		size_t readBytes(uint8_t* buffer, size_t length) override;
+		using Stream::readBytes;
+		int peek() override;
+		void setTimeout(uint32_t seconds) { timeout_ms = seconds * 1000; }
+		operator bool() { return connected(); }
+
+	protected:
+		/// @brief The socket, shared by copies of the client
+		std::shared_ptr<int> socket;
+
+		/// @brief Time in ms to wait for data
+		uint32_t timeout_ms = 5000;
+
+		bool waitReadable(uint32_t ms);
+};
+
+/// @brief The WiFi interface
+class WiFiClass {
+	public:
+		bool isConnected() { return is_connected; }
+		int status() { return is_connected ? WL_CONNECTED : WL_DISCONNECTED; }
+		IPAddress localIP() { return is_connected ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+		String macAddress() { return "02:00:00:00:00:01"; }
+		bool mode(int m) { return true; }
+		void persistent(bool persistent) {}
+		void setAutoReconnect(bool autoReconnect) {}
+		bool disconnect(bool wifiOff = false, bool eraseAP = false) { return true; }
+
+		/// @brief Whether WiFi is connected, set by tests
+		bool is_connected = true;
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,17 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* TLS clients, which are plain TCP on the host so tests can use a local server.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <WiFi.h>
+
+/// @brief A TLS connection, plain TCP on the host so tests can use a local server
+class WiFiClientSecure : public WiFiClient {
+	public:
+		void setInsecure() {}
+		void setCACert(const char* rootCA) {}
+};
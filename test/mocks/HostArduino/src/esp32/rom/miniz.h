@@ -0,0 +1,92 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* External libraries needed:
+* zlib: https://zlib.net/
+*
+* The tinfl inflater from the ESP32's ROM, implemented with zlib. As with tinfl, the decompressor is plain data that's
+* started with tinfl_init() and needs no cleanup, so zlib's state is left allocated when the decompressor is freed.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+enum {
+	TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+	TINFL_FLAG_HAS_MORE_INPUT = 2,
+	TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+	TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+typedef enum {
+	TINFL_STATUS_BAD_PARAM = -3,
+	TINFL_STATUS_ADLER32_MISMATCH = -2,
+	TINFL_STATUS_FAILED = -1,
+	TINFL_STATUS_DONE = 0,
+	TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+	TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+/// @brief State of an inflater
+typedef struct {
+	/// @brief 0 until zlib is started, 1 while inflating, 2 once the end of the stream is reached
+	mz_uint32 m_state;
+
+	/// @brief The zlib stream
+	z_stream stream;
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->m_state = 0; } while (0)
+
+/// @brief Inflates as much input as fits in the output
+/// @param r The inflater
+/// @param pIn_buf_next The input
+/// @param pIn_buf_size The length of the input, set to the number of bytes used
+/// @param pOut_buf_start The start of the output window
+/// @param pOut_buf_next Where to write output
+/// @param pOut_buf_size The space for output, set to the number of bytes written
+/// @param decomp_flags TINFL_FLAG values
+/// @return The status of the inflater
+static inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const mz_uint8* pIn_buf_next, size_t* pIn_buf_size, mz_uint8* pOut_buf_start, mz_uint8* pOut_buf_next, size_t* pOut_buf_size, const mz_uint32 decomp_flags) {
+	if (r->m_state == 2) {
+		*pIn_buf_size = 0;
+		*pOut_buf_size = 0;
+		return TINFL_STATUS_DONE;
+	}
+	if (r->m_state == 0) {
+		memset(&r->stream, 0, sizeof(r->stream));
+		if (inflateInit2(&r->stream, (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK) {
+			return TINFL_STATUS_FAILED;
+		}
+		r->m_state = 1;
+	}
+	r->stream.next_in = (Bytef*)pIn_buf_next;
+	r->stream.avail_in = *pIn_buf_size;
+	r->stream.next_out = pOut_buf_next;
+	r->stream.avail_out = *pOut_buf_size;
+	int result = inflate(&r->stream, Z_NO_FLUSH);
+	*pIn_buf_size -= r->stream.avail_in;
+	*pOut_buf_size -= r->stream.avail_out;
+	if (result == Z_STREAM_END) {
+		inflateEnd(&r->stream);
+		r->m_state = 2;
+		return TINFL_STATUS_DONE;
+	}
+	if (result != Z_OK && result != Z_BUF_ERROR) {
+		return TINFL_STATUS_FAILED;
+	}
+	if (r->stream.avail_out == 0) {
+		return TINFL_STATUS_HAS_MORE_OUTPUT;
+	}
+	return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED;
+}
@@ -0,0 +1,12 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Over the air update functions, see esp_partition.h.
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <esp_partition.h>
+
+const esp_partition_t* esp_ota_get_running_partition(void);
@@ -0,0 +1,26 @@
+/*
+* This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* Flash partitions, the running app partition holds the image set with HostTest::setRunningFirmware().
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+/// @brief A partition
+typedef struct {
+	uint32_t address;
+	uint32_t size;
+	char label[17];
+} esp_partition_t;
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size);
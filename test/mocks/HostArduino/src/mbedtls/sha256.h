@@ -0,0 +1,26 @@
+/*
+* This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+*
+* The SHA-256 functions of mbed TLS, as plain data so contexts can be kept in memory freed with free().
+*
+* Contributors: Sam Groveman
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief State of a running hash
+typedef struct {
+	uint32_t state[8];
+	uint8_t buffer[64];
+	uint64_t total;
+	int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]);
+int mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char output[32], int is224);
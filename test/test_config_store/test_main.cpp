@@ -0,0 +1,151 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <ConfigStore.h>
+
+/// @brief The path of the store file
+static const char* store_path = "/settings/config.bin";
+
+/// @brief Reads the store file
+/// @return The bytes of the file
+static std::vector<uint8_t> readStore() {
+	File file = Storage::getFileSystem(store_path)->open(store_path);
+	std::vector<uint8_t> data(file ? file.size() : 0);
+	if (file) {
+		file.read(data.data(), data.size());
+		file.close();
+	}
+	return data;
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	Storage::begin();
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+}
+
+void tearDown() {}
+
+void test_empty_store() {
+	TEST_ASSERT_FALSE(ConfigStore::has("/settings/mqtt.json"));
+	TEST_ASSERT_EQUAL_STRING("", ConfigStore::get("/settings/mqtt.json").c_str());
+	TEST_ASSERT_EQUAL_STRING("{}", ConfigStore::exportJSON().c_str());
+	// Nothing has changed, so nothing is written
+	TEST_ASSERT_TRUE(ConfigStore::commit());
+	TEST_ASSERT_FALSE(Storage::fileExists(store_path));
+}
+
+void test_sections_survive_reload() {
+	TEST_ASSERT_TRUE(ConfigStore::set("/settings/mqtt.json", "{\"enabled\":true,\"host\":\"broker.local\",\"port\":1883}"));
+	TEST_ASSERT_TRUE(ConfigStore::set("/settings/sig/TimerSwitch.json", "{\"times\":[1,2,3],\"name\":\"Fan\"}"));
+	TEST_ASSERT_TRUE(ConfigStore::commit());
+	std::vector<uint8_t> data = readStore();
+	TEST_ASSERT_GREATER_THAN(4, data.size());
+	TEST_ASSERT_EQUAL_MEMORY("SHC1", data.data(), 4);
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	TEST_ASSERT_TRUE(ConfigStore::has("/settings/mqtt.json"));
+	TEST_ASSERT_EQUAL_STRING("{\"enabled\":true,\"host\":\"broker.local\",\"port\":1883}", ConfigStore::get("/settings/mqtt.json").c_str());
+	TEST_ASSERT_EQUAL_STRING("{\"times\":[1,2,3],\"name\":\"Fan\"}", ConfigStore::get("/settings/sig/TimerSwitch.json").c_str());
+	// Bad JSON and keys that don't fit are refused
+	TEST_ASSERT_FALSE(ConfigStore::set("/settings/bad.json", "{\"enabled\":"));
+	TEST_ASSERT_FALSE(ConfigStore::set(String(std::string(256, 'k')), "{}"));
+}
+
+void test_json_files_are_migrated() {
+	Storage::createDir("/settings/sig");
+	TEST_ASSERT_TRUE(Storage::writeFile("/settings/sig/TimerSwitch.json", "{\"name\":\"Fan\"}"));
+	TEST_ASSERT_TRUE(ConfigStore::has("/settings/sig/TimerSwitch.json"));
+	// The file is only removed once the store holding its section is written
+	TEST_ASSERT_TRUE(Storage::fileExists("/settings/sig/TimerSwitch.json"));
+	TEST_ASSERT_TRUE(ConfigStore::commit());
+	TEST_ASSERT_FALSE(Storage::fileExists("/settings/sig/TimerSwitch.json"));
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	TEST_ASSERT_EQUAL_STRING("{\"name\":\"Fan\"}", ConfigStore::get("/settings/sig/TimerSwitch.json").c_str());
+}
+
+void test_invalid_and_truncated_stores() {
+	TEST_ASSERT_TRUE(ConfigStore::set("/settings/a.json", "{\"a\":1}"));
+	TEST_ASSERT_TRUE(ConfigStore::set("/settings/b.json", "{\"b\":2}"));
+	TEST_ASSERT_TRUE(ConfigStore::commit());
+	std::vector<uint8_t> data = readStore();
+	// Complete sections are kept from a truncated store
+	TEST_ASSERT_TRUE(Storage::writeFile(store_path, data.data(), data.size() - 2));
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	TEST_ASSERT_TRUE(ConfigStore::has("/settings/a.json"));
+	TEST_ASSERT_FALSE(ConfigStore::has("/settings/b.json"));
+	// A file that isn't a store is ignored
+	TEST_ASSERT_TRUE(Storage::writeFile(store_path, "{\"a\":1}"));
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	TEST_ASSERT_FALSE(ConfigStore::has("/settings/a.json"));
+}
+
+void test_export_and_import() {
+	TEST_ASSERT_TRUE(ConfigStore::set("/settings/a.json", "{\"a\":1}"));
+	TEST_ASSERT_TRUE(ConfigStore::set("/settings/b.json", "{\"b\":[true,\"x\"]}"));
+	String exported = ConfigStore::exportJSON();
+	TEST_ASSERT_EQUAL_STRING("{\"/settings/a.json\":{\"a\":1},\"/settings/b.json\":{\"b\":[true,\"x\"]}}", exported.c_str());
+	// Importing replaces the sections it has and keeps the others
+	TEST_ASSERT_TRUE(ConfigStore::importJSON("{\"/settings/a.json\":{\"a\":2}}"));
+	TEST_ASSERT_EQUAL_STRING("{\"a\":2}", ConfigStore::get("/settings/a.json").c_str());
+	TEST_ASSERT_EQUAL_STRING("{\"b\":[true,\"x\"]}", ConfigStore::get("/settings/b.json").c_str());
+	// Imports are committed
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	TEST_ASSERT_EQUAL_STRING("{\"a\":2}", ConfigStore::get("/settings/a.json").c_str());
+	TEST_ASSERT_FALSE(ConfigStore::importJSON("not json"));
+}
+
+void test_boot_with_fifty_devices() {
+	const int devices = 50;
+	Storage::createDir("/settings/sig");
+	std::vector<String> paths;
+	std::vector<String> configs;
+	size_t json_bytes = 0;
+	for (int i = 0; i < devices; i++) {
+		paths.push_back("/settings/sig/Device" + String(i) + ".json");
+		configs.push_back("{\"pin\":" + String(i % 40) + ",\"name\":\"Device " + String(i) + "\",\"enabled\":" + (i % 2 ? "true" : "false") + ",\"samplingPeriod\":" + String(1000 * (i + 1)) + ",\"taskName\":\"Device" + String(i) + "\",\"active\":\"Active high\"}");
+		TEST_ASSERT_TRUE(Storage::writeFile(paths.back(), configs.back()));
+		json_bytes += configs.back().length();
+	}
+	// Before the store, each device read its own JSON file at boot
+	Storage::begin();
+	ulong start = micros();
+	for (int i = 0; i < devices; i++) {
+		TEST_ASSERT_EQUAL_STRING(configs[i].c_str(), Storage::readFile(paths[i]).c_str());
+	}
+	ulong files = micros() - start;
+	// The first boot with the store moves every file into it
+	Storage::begin();
+	start = micros();
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	for (int i = 0; i < devices; i++) {
+		TEST_ASSERT_EQUAL_STRING(configs[i].c_str(), ConfigStore::get(paths[i]).c_str());
+	}
+	TEST_ASSERT_TRUE(ConfigStore::commit());
+	ulong migration = micros() - start;
+	for (const auto& path : paths) {
+		TEST_ASSERT_FALSE(Storage::fileExists(path));
+	}
+	// Later boots read the one file
+	Storage::begin();
+	start = micros();
+	TEST_ASSERT_TRUE(ConfigStore::begin(store_path));
+	for (int i = 0; i < devices; i++) {
+		TEST_ASSERT_EQUAL_STRING(configs[i].c_str(), ConfigStore::get(paths[i]).c_str());
+	}
+	ulong store = micros() - start;
+	size_t store_bytes = readStore().size();
+	TEST_MESSAGE((String(devices) + " devices, JSON files: " + String(json_bytes) + " bytes read in " + String(files) + "us, migration: " + String(migration) + "us, store: " + String(store_bytes) + " bytes read in " + String(store) + "us").c_str());
+	// LittleFS gives each file at least one 4096 byte block
+	TEST_ASSERT_LESS_THAN(devices, (store_bytes + 4095) / 4096);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_empty_store);
+	RUN_TEST(test_sections_survive_reload);
+	RUN_TEST(test_json_files_are_migrated);
+	RUN_TEST(test_invalid_and_truncated_stores);
+	RUN_TEST(test_export_and_import);
+	RUN_TEST(test_boot_with_fifty_devices);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,182 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <DeltaPatch.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+/// @brief Makes an image of random bytes, standing in for a firmware image
+/// @param size The size in bytes
+/// @param seed The seed of the contents
+/// @return The image
+static std::vector<uint8_t> makeImage(size_t size, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::vector<uint8_t> image(size);
+	for (auto& b : image) {
+		b = random();
+	}
+	return image;
+}
+
+/// @brief Writes bytes to a file
+/// @param path The path of the file
+/// @param data The bytes
+static void writeBytes(const std::string& path, const std::vector<uint8_t>& data) {
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)data.data(), data.size());
+}
+
+/// @brief Makes a delta with tools/make_delta.py
+/// @param from The image the delta is made against
+/// @param to The image the delta produces
+/// @return The delta, empty if the tool failed
+static std::vector<uint8_t> makeDelta(const std::vector<uint8_t>& from, const std::vector<uint8_t>& to) {
+	// The tool is found relative to this file, which is in test/<suite>/
+	std::string root = __FILE__;
+	for (int i = 0; i < 3; i++) {
+		size_t slash = root.find_last_of('/');
+		root = slash == std::string::npos ? "." : root.substr(0, slash);
+	}
+	std::string dir = HostTest::storageRoot();
+	std::filesystem::create_directories(dir);
+	writeBytes(dir + "/old.bin", from);
+	writeBytes(dir + "/new.bin", to);
+	std::string command = "python3 \"" + root + "/tools/make_delta.py\" \"" + dir + "/old.bin\" \"" + dir + "/new.bin\" \"" + dir + "/firmware.delta\" --no-gzip > /dev/null";
+	if (system(command.c_str()) != 0) {
+		return {};
+	}
+	std::ifstream file(dir + "/firmware.delta", std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// @brief Applies a delta to the running firmware in chunks
+/// @param delta The delta
+/// @param chunk The size of the chunks
+/// @param output Receives the new firmware
+/// @param s The state of the delta after the last chunk
+/// @return True if every chunk was applied
+static bool applyDelta(const std::vector<uint8_t>& delta, size_t chunk, std::vector<uint8_t>& output, DeltaPatch::state& s) {
+	output.clear();
+	DeltaPatch::begin(s);
+	for (size_t position = 0; position < delta.size(); position += chunk) {
+		size_t length = std::min(chunk, delta.size() - position);
+		bool success = DeltaPatch::apply(s, delta.data() + position, length, [&output](const uint8_t* data, size_t len) {
+			output.insert(output.end(), data, data + len);
+			return true;
+		});
+		if (!success) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// @brief The firmware the device is running
+static std::vector<uint8_t> old_image;
+
+/// @brief The firmware to update to
+static std::vector<uint8_t> new_image;
+
+void setUp() {
+	HostTest::resetStorage();
+	old_image = makeImage(65536, 1);
+	// Code moved around, a patched section, new code, and removed code
+	new_image.assign(old_image.begin() + 32768, old_image.begin() + 49152);
+	new_image.insert(new_image.end(), old_image.begin(), old_image.begin() + 20000);
+	std::vector<uint8_t> added = makeImage(3000, 2);
+	new_image.insert(new_image.end(), added.begin(), added.end());
+	new_image.insert(new_image.end(), old_image.begin() + 20000, old_image.begin() + 32768);
+	for (size_t i = 1000; i < new_image.size(); i += 4099) {
+		new_image[i] ^= 0x5A;
+	}
+	new_image.push_back(0xE9);
+	HostTest::setRunningFirmware(old_image);
+}
+
+void tearDown() {}
+
+void test_round_trip() {
+	std::vector<uint8_t> delta = makeDelta(old_image, new_image);
+	TEST_ASSERT_TRUE_MESSAGE(delta.size() > 44, "tools/make_delta.py failed");
+	// Most of the new image is copied from the running one
+	TEST_ASSERT_TRUE(delta.size() < new_image.size() / 4);
+	for (size_t chunk : { (size_t)1, (size_t)7, (size_t)512, delta.size() }) {
+		std::vector<uint8_t> output;
+		DeltaPatch::state s;
+		TEST_ASSERT_TRUE(applyDelta(delta, chunk, output, s));
+		TEST_ASSERT_TRUE(DeltaPatch::finished(s));
+		TEST_ASSERT_EQUAL(new_image.size(), output.size());
+		TEST_ASSERT_TRUE(output == new_image);
+	}
+}
+
+void test_unrelated_image_is_inserted() {
+	std::vector<uint8_t> other = makeImage(5000, 3);
+	std::vector<uint8_t> delta = makeDelta(old_image, other);
+	TEST_ASSERT_TRUE_MESSAGE(delta.size() > 44, "tools/make_delta.py failed");
+	std::vector<uint8_t> output;
+	DeltaPatch::state s;
+	TEST_ASSERT_TRUE(applyDelta(delta, 100, output, s));
+	TEST_ASSERT_TRUE(DeltaPatch::finished(s));
+	TEST_ASSERT_TRUE(output == other);
+}
+
+void test_wrong_running_firmware() {
+	std::vector<uint8_t> delta = makeDelta(old_image, new_image);
+	TEST_ASSERT_TRUE_MESSAGE(delta.size() > 44, "tools/make_delta.py failed");
+	std::vector<uint8_t> running = old_image;
+	running[100] ^= 1;
+	HostTest::setRunningFirmware(running);
+	std::vector<uint8_t> output;
+	DeltaPatch::state s;
+	TEST_ASSERT_FALSE(applyDelta(delta, 64, output, s));
+	TEST_ASSERT_NOT_NULL(s.error);
+	TEST_ASSERT_EQUAL(0, output.size());
+}
+
+void test_truncated_and_extended_deltas() {
+	std::vector<uint8_t> delta = makeDelta(old_image, new_image);
+	TEST_ASSERT_TRUE_MESSAGE(delta.size() > 44, "tools/make_delta.py failed");
+	std::vector<uint8_t> output;
+	DeltaPatch::state s;
+	std::vector<uint8_t> truncated(delta.begin(), delta.end() - 1);
+	TEST_ASSERT_TRUE(applyDelta(truncated, 256, output, s));
+	TEST_ASSERT_FALSE(DeltaPatch::finished(s));
+	std::vector<uint8_t> extended = delta;
+	extended.push_back(2);
+	TEST_ASSERT_FALSE(applyDelta(extended, 256, output, s));
+	TEST_ASSERT_FALSE(DeltaPatch::finished(s));
+}
+
+void test_corrupt_deltas() {
+	std::vector<uint8_t> delta = makeDelta(old_image, new_image);
+	TEST_ASSERT_TRUE_MESSAGE(delta.size() > 44, "tools/make_delta.py failed");
+	std::vector<uint8_t> output;
+	DeltaPatch::state s;
+	std::vector<uint8_t> bad_magic = delta;
+	bad_magic[0] = 'X';
+	TEST_ASSERT_FALSE(applyDelta(bad_magic, 256, output, s));
+	TEST_ASSERT_EQUAL_STRING("Not a firmware delta", s.error);
+	std::vector<uint8_t> bad_operation = delta;
+	bad_operation[44] = 7;
+	TEST_ASSERT_FALSE(applyDelta(bad_operation, 256, output, s));
+	TEST_ASSERT_EQUAL_STRING("Firmware delta is corrupt", s.error);
+	// A copy reaching past the end of the running firmware
+	std::vector<uint8_t> bad_copy(delta.begin(), delta.begin() + 44);
+	uint8_t copy[] = { 1, 0xF0, 0xFF, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00 };
+	bad_copy.insert(bad_copy.end(), copy, copy + sizeof(copy));
+	TEST_ASSERT_FALSE(applyDelta(bad_copy, 256, output, s));
+	TEST_ASSERT_EQUAL_STRING("Firmware delta is corrupt", s.error);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_round_trip);
+	RUN_TEST(test_unrelated_image_is_inserted);
+	RUN_TEST(test_wrong_running_firmware);
+	RUN_TEST(test_truncated_and_extended_deltas);
+	RUN_TEST(test_corrupt_deltas);
+	HostTest::finish(UNITY_END());
+}
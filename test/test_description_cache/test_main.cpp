@@ -0,0 +1,154 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <DescriptionCache.h>
+#include <SensorManager.h>
+#include <SignalManager.h>
+
+/// @brief A sensor whose description is set by the test
+class FakeSensor : public Sensor {
+	public:
+		FakeSensor(String name) {
+			Description = { .parameterQuantity = 1, .type = "Fake", .name = name, .parameters = { "Temperature" }, .units = { "C" }, .id = 0 };
+		}
+
+		bool begin() override {
+			return true;
+		}
+};
+
+/// @brief A signal receiver with a handful of signals
+class FakeReceiver : public SignalReceiver {
+	public:
+		FakeReceiver(String name) {
+			Description = { .signalQuantity = 8, .type = "Fake", .name = name, .signals = { { "on", 0 }, { "off", 1 }, { "toggle", 2 }, { "set_level", 3 }, { "set_color", 4 }, { "blink", 5 }, { "reset", 6 }, { "identify", 7 } }, .id = 0 };
+		}
+
+		bool begin() override {
+			return true;
+		}
+};
+
+/// @brief Number of times the description was built
+static int builds;
+
+/// @brief The description the builder returns
+static String contents;
+
+/// @brief The cache under test
+static DescriptionCache cache([]() {
+	builds++;
+	return contents;
+});
+
+void setUp() {
+	builds = 0;
+	contents = "{\"sensors\":[]}";
+	cache.invalidate();
+}
+
+void tearDown() {}
+
+void test_built_once_until_invalidated() {
+	String etag;
+	TEST_ASSERT_EQUAL_STRING("{\"sensors\":[]}", cache.get(etag).c_str());
+	TEST_ASSERT_EQUAL_STRING("{\"sensors\":[]}", cache.get().c_str());
+	TEST_ASSERT_EQUAL(1, builds);
+	contents = "{\"sensors\":[1]}";
+	// Changes aren't seen until the cache is told about them
+	TEST_ASSERT_EQUAL_STRING("{\"sensors\":[]}", cache.get().c_str());
+	uint32_t generation = cache.getGeneration();
+	cache.invalidate();
+	TEST_ASSERT_EQUAL(generation + 1, cache.getGeneration());
+	TEST_ASSERT_EQUAL_STRING("{\"sensors\":[1]}", cache.get().c_str());
+	TEST_ASSERT_EQUAL(2, builds);
+}
+
+void test_etags_follow_contents() {
+	String first;
+	cache.get(first);
+	TEST_ASSERT_TRUE(first.startsWith("\"") && first.endsWith("\""));
+	TEST_ASSERT_GREATER_THAN(2, first.length());
+	// Rebuilding the same contents gives the same tag, so clients' copies stay valid across reboots
+	cache.invalidate();
+	String same;
+	cache.get(same);
+	TEST_ASSERT_EQUAL_STRING(first.c_str(), same.c_str());
+	contents = "{\"sensors\":[1]}";
+	cache.invalidate();
+	String changed;
+	cache.get(changed);
+	TEST_ASSERT_NOT_EQUAL(first, changed);
+}
+
+void test_sensor_info_changes_with_sensors() {
+	String empty_tag;
+	String empty = SensorManager::getSensorInfo(empty_tag);
+	static FakeSensor sensor("Fake Sensor");
+	SensorManager::addSensor(&sensor);
+	String added_tag;
+	String added = SensorManager::getSensorInfo(added_tag);
+	TEST_ASSERT_TRUE(added.indexOf("Fake Sensor") >= 0);
+	TEST_ASSERT_NOT_EQUAL(empty_tag, added_tag);
+	// Sensors can change their descriptions when they start
+	sensor.Description.name = "Started Sensor";
+	TEST_ASSERT_TRUE(SensorManager::beginSensors());
+	String started_tag;
+	TEST_ASSERT_TRUE(SensorManager::getSensorInfo(started_tag).indexOf("Started Sensor") >= 0);
+	TEST_ASSERT_NOT_EQUAL(added_tag, started_tag);
+}
+
+/// @brief Times requests for a description, cached and rebuilt each time
+/// @param name What the description describes
+/// @param get Gets the description
+/// @param invalidate Marks the description as changed
+/// @return The time in us of a cached request, and of a rebuilt one
+static std::pair<ulong, ulong> timeRequests(String name, std::function<String(String&)> get, std::function<void()> invalidate) {
+	const int requests = 200;
+	String etag;
+	String expected = get(etag);
+	ulong cached = 0;
+	ulong rebuilt = 0;
+	for (int i = 0; i < requests; i++) {
+		String tag;
+		ulong start = micros();
+		String description = get(tag);
+		cached += micros() - start;
+		TEST_ASSERT_TRUE(description == expected && tag == etag);
+		invalidate();
+		start = micros();
+		description = get(tag);
+		rebuilt += micros() - start;
+		TEST_ASSERT_TRUE(description == expected && tag == etag);
+	}
+	TEST_MESSAGE((name + " (" + String(expected.length()) + " bytes): cached " + String(cached / requests) + "us, rebuilt " + String(rebuilt / requests) + "us").c_str());
+	return { cached / requests, rebuilt / requests };
+}
+
+void test_cached_requests_are_faster() {
+	// A full hub: 8 sensors of 4 parameters, and 6 receivers of 8 signals
+	for (int i = 0; i < 8; i++) {
+		FakeSensor* sensor = new FakeSensor("Bench Sensor " + String(i));
+		sensor->Description.parameterQuantity = 4;
+		sensor->Description.parameters = { "Temperature", "Relative Humidity", "Pressure", "Gas Resistance" };
+		sensor->Description.units = { "C", "%RH", "hPa", "Ohms" };
+		SensorManager::addSensor(sensor);
+	}
+	for (int i = 0; i < 6; i++) {
+		SignalManager::addReceiver(new FakeReceiver("Bench Receiver " + String(i)));
+	}
+	// Starting the sensors and receivers is the cheapest way to make their managers rebuild the descriptions
+	auto sensor_times = timeRequests("/sensors/", [](String& etag) { return SensorManager::getSensorInfo(etag); }, []() { SensorManager::beginSensors(); });
+	auto signal_times = timeRequests("/signals/", [](String& etag) { return SignalManager::getReceiverInfo(etag); }, []() { SignalManager::beginReceivers(); });
+	TEST_ASSERT_LESS_THAN(sensor_times.second, sensor_times.first);
+	TEST_ASSERT_LESS_THAN(signal_times.second, signal_times.first);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_built_once_until_invalidated);
+	RUN_TEST(test_etags_follow_contents);
+	RUN_TEST(test_sensor_info_changes_with_sensors);
+	RUN_TEST(test_cached_requests_are_faster);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,181 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <DeviceConfig.h>
+#include <ConfigStore.h>
+
+/// @brief A device, to reach the config methods devices use
+class FakeDevice : public DeviceConfig {
+	public:
+		using DeviceConfig::checkConfig;
+		using DeviceConfig::readConfig;
+		using DeviceConfig::saveConfig;
+};
+
+/// @brief Counts of config writes
+typedef struct counts {
+	int written;
+	int skipped;
+	int coalesced;
+	int pending;
+} counts;
+
+/// @brief The device under test
+static FakeDevice device;
+
+/// @brief Gets the counts of config writes made and avoided
+/// @return The counts
+static counts getCounts() {
+	JsonDocument doc;
+	TEST_ASSERT_FALSE(deserializeJson(doc, DeviceConfig::getWriteStats()));
+	return { .written = doc["written"], .skipped = doc["skipped"], .coalesced = doc["coalesced"], .pending = doc["pending"] };
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	Storage::begin();
+	TEST_ASSERT_TRUE(ConfigStore::begin());
+}
+
+void tearDown() {
+	DeviceConfig::flushConfigs(true);
+}
+
+void test_writes_are_deferred() {
+	const char* path = "/settings/deferred.json";
+	counts before = getCounts();
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":1}"));
+	// Waiting changes are read back before they're written
+	TEST_ASSERT_FALSE(ConfigStore::has(path));
+	TEST_ASSERT_TRUE(device.checkConfig(path));
+	TEST_ASSERT_EQUAL_STRING("{\"a\":1}", device.readConfig(path).c_str());
+	TEST_ASSERT_EQUAL(before.pending + 1, getCounts().pending);
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs());
+	TEST_ASSERT_FALSE(ConfigStore::has(path));
+	// Written once the delay has passed
+	delay(2100);
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs());
+	TEST_ASSERT_EQUAL_STRING("{\"a\":1}", ConfigStore::get(path).c_str());
+	counts after = getCounts();
+	TEST_ASSERT_EQUAL(before.written + 1, after.written);
+	TEST_ASSERT_EQUAL(0, after.pending);
+	// The store was committed as well
+	TEST_ASSERT_TRUE(ConfigStore::begin());
+	TEST_ASSERT_EQUAL_STRING("{\"a\":1}", ConfigStore::get(path).c_str());
+}
+
+void test_changes_are_coalesced() {
+	const char* path = "/settings/coalesced.json";
+	counts before = getCounts();
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":1}"));
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":2}"));
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":3}"));
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs(true));
+	TEST_ASSERT_EQUAL_STRING("{\"a\":3}", ConfigStore::get(path).c_str());
+	counts after = getCounts();
+	TEST_ASSERT_EQUAL(before.written + 1, after.written);
+	TEST_ASSERT_EQUAL(before.coalesced + 2, after.coalesced);
+}
+
+void test_unchanged_config_is_skipped() {
+	const char* path = "/settings/unchanged.json";
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":1}"));
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs(true));
+	counts before = getCounts();
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":1}"));
+	TEST_ASSERT_EQUAL(before.skipped + 1, getCounts().skipped);
+	TEST_ASSERT_EQUAL(0, getCounts().pending);
+	// A change that's changed back before it's written isn't written
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":2}"));
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":1}"));
+	TEST_ASSERT_EQUAL(0, getCounts().pending);
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs(true));
+	TEST_ASSERT_EQUAL(before.written, getCounts().written);
+	TEST_ASSERT_EQUAL_STRING("{\"a\":1}", device.readConfig(path).c_str());
+}
+
+void test_stored_config_is_compared() {
+	const char* path = "/settings/stored.json";
+	TEST_ASSERT_TRUE(ConfigStore::set(path, "{\"a\":1}"));
+	TEST_ASSERT_TRUE(ConfigStore::commit());
+	counts before = getCounts();
+	// Saving what's already stored, e.g. at boot, doesn't write it again
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":1}"));
+	TEST_ASSERT_EQUAL(before.skipped + 1, getCounts().skipped);
+	TEST_ASSERT_EQUAL(0, getCounts().pending);
+}
+
+void test_immediate_write() {
+	const char* path = "/settings/immediate.json";
+	counts before = getCounts();
+	TEST_ASSERT_TRUE(DeviceConfig::writeConfig(path, "{\"a\":1}", false));
+	TEST_ASSERT_EQUAL_STRING("{\"a\":1}", ConfigStore::get(path).c_str());
+	TEST_ASSERT_EQUAL(before.written + 1, getCounts().written);
+	TEST_ASSERT_EQUAL(0, getCounts().pending);
+}
+
+void test_invalid_config_is_dropped() {
+	const char* path = "/settings/invalid.json";
+	TEST_ASSERT_TRUE(device.saveConfig(path, "{\"a\":"));
+	// It can't be stored, so it isn't kept waiting to be tried again
+	TEST_ASSERT_FALSE(DeviceConfig::flushConfigs(true));
+	TEST_ASSERT_EQUAL(0, getCounts().pending);
+	TEST_ASSERT_FALSE(device.checkConfig(path));
+}
+
+void test_boot_with_all_receivers() {
+	// Config like each of the hub's receivers saves when it starts
+	const std::vector<std::pair<String, String>> receivers = {
+		{ "/settings/sig/ResetButton.json", "{\"pin\":0,\"holdTime\":5000,\"enabled\":true}" },
+		{ "/settings/sig/LocalLogger.json", "{\"enabled\":true,\"dataFile\":\"LocalData.csv\",\"maxSize\":1048576,\"segments\":30,\"samplingPeriod\":60000,\"taskName\":\"LocalLogger\"}" },
+		{ "/settings/sig/LogCompactor.json", "{\"dataFile\":\"LocalData.csv\",\"enabled\":true,\"minAge\":3,\"resolution\":3600,\"samplingPeriod\":1000,\"taskName\":\"LogCompactor\"}" },
+		{ "/settings/sig/TelemetryExporter.json", "{\"enabled\":false,\"url\":\"\",\"format\":\"influx\",\"batchSize\":20,\"samplingPeriod\":10000,\"taskName\":\"TelemetryExporter\"}" },
+		{ "/settings/sig/DataTemplate.json", "{\"name\":\"Schema\",\"template\":\"{{Temperature}},{{Relative Humidity}}\"}" },
+		{ "/settings/sig/TimerSwitch.json", "{\"pin\":5,\"name\":\"Timer Switch\",\"onTime\":\"9:30\",\"offTime\":\"22:15\",\"enabled\":false,\"active\":\"Active high\"}" },
+		{ "/settings/sig/GenericOutput.json", "{\"pin\":2,\"name\":\"Status LED\"}" }
+	};
+	// Before deferred writes, each save at boot was written and committed on its own
+	counts before = getCounts();
+	ulong start = micros();
+	for (const auto& r : receivers) {
+		TEST_ASSERT_TRUE(DeviceConfig::writeConfig(r.first + ".old", r.second, false));
+	}
+	ulong immediate = micros() - start;
+	TEST_ASSERT_EQUAL(before.written + receivers.size(), getCounts().written);
+	// First boot: every receiver saves its defaults, and they're written together
+	before = getCounts();
+	start = micros();
+	for (const auto& r : receivers) {
+		TEST_ASSERT_TRUE(device.saveConfig(r.first, r.second));
+	}
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs(true));
+	ulong first = micros() - start;
+	counts after = getCounts();
+	TEST_ASSERT_EQUAL(before.written + 1, after.written);
+	// Later boots save the same config again, and nothing is written
+	before = after;
+	start = micros();
+	for (const auto& r : receivers) {
+		TEST_ASSERT_TRUE(device.saveConfig(r.first, r.second));
+	}
+	TEST_ASSERT_TRUE(DeviceConfig::flushConfigs(true));
+	ulong later = micros() - start;
+	after = getCounts();
+	TEST_ASSERT_EQUAL(before.written, after.written);
+	TEST_ASSERT_EQUAL(before.skipped + receivers.size(), after.skipped);
+	TEST_MESSAGE((String(receivers.size()) + " receivers, written one at a time: " + String(receivers.size()) + " writes in " + String(immediate) + "us, first boot: 1 write in " + String(first) + "us, later boots: 0 writes in " + String(later) + "us").c_str());
+	TEST_ASSERT_LESS_THAN(immediate, first);
+	TEST_ASSERT_LESS_THAN(first, later);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_writes_are_deferred);
+	RUN_TEST(test_changes_are_coalesced);
+	RUN_TEST(test_unchanged_config_is_skipped);
+	RUN_TEST(test_stored_config_is_compared);
+	RUN_TEST(test_immediate_write);
+	RUN_TEST(test_invalid_config_is_dropped);
+	RUN_TEST(test_boot_with_all_receivers);
+	HostTest::finish(UNITY_END());
+}
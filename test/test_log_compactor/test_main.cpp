@@ -0,0 +1,232 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <LogCompactor.h>
+#include <map>
+
+/// @brief Seconds between logged rows
+static const uint32_t row_period = 300;
+
+/// @brief Length in seconds of each aggregate interval
+static const uint32_t resolution = 3600;
+
+/// @brief Days in each segment
+static const int segment_days = 10;
+
+/// @brief Number of segments in the month of data
+static const int segments = 3;
+
+/// @brief The time the month of data starts, 2024-01-01 00:00:00
+static const uint32_t month_start = 1704067200;
+
+/// @brief The clock segments are aged by
+static ESP32Time rtc;
+
+/// @brief The compactor under test
+static LogCompactor* compactor;
+
+/// @brief Running aggregate of one column, as the compactor keeps it
+typedef struct aggregate {
+	float min;
+	float max;
+	double sum;
+	uint32_t count;
+} aggregate;
+
+/// @brief Gets the path of a segment
+/// @param start The time the segment was started
+/// @param aggregated True for the path of its compacted version
+/// @return The path
+static String segmentPath(uint32_t start, bool aggregated = false) {
+	time_t t = start;
+	struct tm time;
+	localtime_r(&t, &time);
+	char name[20];
+	strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &time);
+	return "/data/LocalData-" + String(name) + (aggregated ? ".agg.csv" : ".csv");
+}
+
+/// @brief Gets the temperature logged in a row
+/// @param row The number of the row since the start of the month
+/// @return The temperature
+static float temperature(uint32_t row) {
+	return 15 + (row % 12) * 0.25f + (row / 288) * 0.5f;
+}
+
+/// @brief Gets the humidity cell logged in a row, some readings failed and are logged as "null"
+/// @param row The number of the row since the start of the month
+/// @return The cell
+static String humidity(uint32_t row) {
+	// The sensor was disconnected for the whole of the sixth hour
+	if (row % 7 == 3 || (row >= 60 && row < 72)) {
+		return "null";
+	}
+	return String(40 + (row % 5) * 1.5f, 2);
+}
+
+/// @brief Writes a segment of the data file with its time index, and works out the rows compacting it should give
+/// @param first The number of the segment's first row since the start of the month
+/// @param rows The number of rows in the segment
+/// @return The expected contents of the compacted segment
+static String writeSegment(uint32_t first, uint32_t rows) {
+	uint32_t start = month_start + first * row_period;
+	String path = segmentPath(start);
+	TEST_ASSERT_TRUE(TimeIndex::createIndex(path, 1, start));
+	String data = "time,Temperature,Relative Humidity\n";
+	std::map<uint32_t, std::pair<uint32_t, std::vector<aggregate>>> intervals;
+	for (uint32_t row = first; row < first + rows; row++) {
+		uint32_t time = month_start + row * row_period;
+		if (row % 100 == 0) {
+			TEST_ASSERT_TRUE(TimeIndex::addEntry(path, time, data.length()));
+		}
+		String h = humidity(row);
+		data += TimeIndex::formatTime(time) + "," + String(temperature(row), 2) + "," + h + "\n";
+		auto& interval = intervals[time - time % resolution];
+		interval.first++;
+		interval.second.resize(2, { NAN, NAN, 0, 0 });
+		float values[2] = { temperature(row), h == "null" ? NAN : h.toFloat() };
+		for (int i = 0; i < 2; i++) {
+			aggregate& a = interval.second[i];
+			if (isnan(values[i])) {
+				continue;
+			}
+			a.min = a.count == 0 ? values[i] : std::min(a.min, values[i]);
+			a.max = a.count == 0 ? values[i] : std::max(a.max, values[i]);
+			a.sum += values[i];
+			a.count++;
+		}
+	}
+	Storage::createDir("/data");
+	TEST_ASSERT_TRUE(Storage::writeFile(path, data));
+	String expected = "time,samples,Temperature min,Temperature max,Temperature mean,Relative Humidity min,Relative Humidity max,Relative Humidity mean\n";
+	for (const auto& interval : intervals) {
+		expected += TimeIndex::formatTime(interval.first) + "," + String(interval.second.first);
+		for (const auto& a : interval.second.second) {
+			if (a.count == 0) {
+				expected += ",nan,nan,nan";
+			} else {
+				expected += "," + String(a.min, 6) + "," + String(a.max, 6) + "," + String(a.sum / a.count, 6);
+			}
+		}
+		expected += "\n";
+	}
+	return expected;
+}
+
+/// @brief Counts the lines of a file
+/// @param path The path of the file
+/// @return The number of lines
+static int countLines(String path) {
+	String contents = Storage::readFile(path);
+	int lines = 0;
+	for (char c : contents) {
+		lines += c == '\n';
+	}
+	return lines;
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	Storage::begin();
+	compactor = new LogCompactor(&rtc);
+	TEST_ASSERT_TRUE(compactor->begin());
+	TEST_ASSERT_TRUE(compactor->setConfig("{\"dataFile\":\"LocalData.csv\",\"enabled\":true,\"minAge\":3,\"resolution\":" + String(resolution) + ",\"samplingPeriod\":1000,\"taskName\":\"LogCompactor\"}"));
+}
+
+void tearDown() {
+	compactor->enableTask(false);
+	delete compactor;
+}
+
+void test_month_is_compacted() {
+	uint32_t rows = segment_days * 86400 / row_period;
+	std::vector<String> expected;
+	for (int s = 0; s < segments; s++) {
+		expected.push_back(writeSegment(s * rows, rows));
+	}
+	// The file being logged to is never compacted
+	TEST_ASSERT_TRUE(Storage::writeFile("/data/LocalData.csv", "time,Temperature,Relative Humidity\n"));
+	rtc.setTime(month_start + segments * segment_days * 86400 + 4 * 86400);
+	int runs = 0;
+	while (runs < 1000 && (Storage::fileExists(segmentPath(month_start)) || Storage::fileExists(segmentPath(month_start + segment_days * 86400)) || Storage::fileExists(segmentPath(month_start + 2 * segment_days * 86400)))) {
+		compactor->runTask(1000);
+		runs++;
+	}
+	// A few rows are compacted each time the task runs
+	TEST_ASSERT_GREATER_OR_EQUAL(segments * rows / 200, runs);
+	for (int s = 0; s < segments; s++) {
+		uint32_t start = month_start + s * segment_days * 86400;
+		// The segment and its index are replaced by the aggregates
+		TEST_ASSERT_FALSE(Storage::fileExists(segmentPath(start)));
+		TEST_ASSERT_FALSE(Storage::fileExists(TimeIndex::indexPath(segmentPath(start))));
+		TEST_ASSERT_FALSE(Storage::fileExists(segmentPath(start, true) + ".tmp"));
+		String compacted = Storage::readFile(segmentPath(start, true));
+		TEST_ASSERT_EQUAL(segment_days * 24 + 1, countLines(segmentPath(start, true)));
+		TEST_ASSERT_EQUAL_STRING(expected[s].c_str(), compacted.c_str());
+	}
+	TEST_ASSERT_TRUE(Storage::fileExists("/data/LocalData.csv"));
+	// Nothing left to do
+	compactor->runTask(1000);
+	TEST_ASSERT_EQUAL(segments, Storage::listFiles("/data", 0).size() - 1);
+}
+
+void test_aggregates_skip_null_cells() {
+	String expected = writeSegment(0, 288);
+	rtc.setTime(month_start + 5 * 86400);
+	for (int i = 0; i < 10; i++) {
+		compactor->runTask(1000);
+	}
+	String compacted = Storage::readFile(segmentPath(month_start, true));
+	TEST_ASSERT_EQUAL_STRING(expected.c_str(), compacted.c_str());
+	// The first hour: 12 rows, temperatures 15 to 17.75, and failed humidity readings in rows 3 and 10
+	int first = compacted.indexOf('\n') + 1;
+	String row = compacted.substring(first, compacted.indexOf('\n', first));
+	String mean = String((40 + 41.5 + 43 + 46 + 40 + 41.5 + 43 + 44.5 + 46 + 41.5) / 10.0, 6);
+	TEST_ASSERT_EQUAL_STRING((TimeIndex::formatTime(month_start) + ",12,15.000000,17.750000,16.375000,40.000000,46.000000," + mean).c_str(), row.c_str());
+	// An hour with no readings at all
+	TEST_ASSERT_TRUE(compacted.indexOf(TimeIndex::formatTime(month_start + 5 * 3600) + ",12,15.000000,17.750000,16.375000,nan,nan,nan\n") >= 0);
+}
+
+void test_partial_runs_resume() {
+	String expected = writeSegment(0, 1000);
+	rtc.setTime(month_start + 10 * 86400);
+	compactor->runTask(1000);
+	// 200 rows in, the intervals that have ended are written and the segment is kept
+	String temp = segmentPath(month_start, true) + ".tmp";
+	TEST_ASSERT_TRUE(Storage::fileExists(temp));
+	TEST_ASSERT_TRUE(Storage::fileExists(segmentPath(month_start)));
+	TEST_ASSERT_EQUAL(1 + 200 / 12, countLines(temp));
+	// Runs shorter than the sampling period do nothing
+	compactor->runTask(500);
+	TEST_ASSERT_EQUAL(1 + 200 / 12, countLines(temp));
+	// Each run carries on from where the last stopped, so no row is counted twice or missed
+	compactor->runTask(500);
+	TEST_ASSERT_EQUAL(1 + 400 / 12, countLines(temp));
+	for (int i = 0; i < 3; i++) {
+		compactor->runTask(1000);
+	}
+	TEST_ASSERT_FALSE(Storage::fileExists(temp));
+	TEST_ASSERT_EQUAL_STRING(expected.c_str(), Storage::readFile(segmentPath(month_start, true)).c_str());
+}
+
+void test_young_segments_are_kept() {
+	writeSegment(0, 288);
+	// The last row is two days old
+	rtc.setTime(month_start + 3 * 86400);
+	for (int i = 0; i < 5; i++) {
+		compactor->runTask(1000);
+	}
+	TEST_ASSERT_TRUE(Storage::fileExists(segmentPath(month_start)));
+	TEST_ASSERT_TRUE(Storage::fileExists(TimeIndex::indexPath(segmentPath(month_start))));
+	TEST_ASSERT_FALSE(Storage::fileExists(segmentPath(month_start, true)));
+	TEST_ASSERT_FALSE(Storage::fileExists(segmentPath(month_start, true) + ".tmp"));
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_month_is_compacted);
+	RUN_TEST(test_aggregates_skip_null_cells);
+	RUN_TEST(test_partial_runs_resume);
+	RUN_TEST(test_young_segments_are_kept);
+	HostTest::finish(UNITY_END());
+}
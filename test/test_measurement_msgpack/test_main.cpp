@@ -0,0 +1,98 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <SensorManager.h>
+
+/// @brief Encodes the last measurements as MessagePack
+/// @param singlePrecision True to store values as 32-bit floats
+/// @return The encoded measurements
+static std::vector<uint8_t> encode(bool singlePrecision) {
+	JsonDocument doc;
+	SensorManager::getLastMeasurement(doc, singlePrecision);
+	std::vector<uint8_t> output(measureMsgPack(doc));
+	serializeMsgPack(doc, output.data(), output.size());
+	return output;
+}
+
+/// @brief Finds a sequence of bytes
+/// @param data The bytes to search
+/// @param sequence The bytes to find
+/// @return True if they were found
+static bool contains(const std::vector<uint8_t>& data, std::vector<uint8_t> sequence) {
+	return std::search(data.begin(), data.end(), sequence.begin(), sequence.end()) != data.end();
+}
+
+void setUp() {
+	SensorManager::measurements.clear();
+	SensorManager::measurements.push_back({ "Temperature", 21.5, "C" });
+	SensorManager::measurements.push_back({ "Humidity", 0.1, "%" });
+}
+
+void tearDown() {}
+
+void test_same_shape_as_json() {
+	std::vector<uint8_t> packed = encode(false);
+	JsonDocument doc;
+	TEST_ASSERT_FALSE(deserializeMsgPack(doc, packed.data(), packed.size()));
+	String json;
+	serializeJson(doc, json);
+	TEST_ASSERT_EQUAL_STRING(SensorManager::getLastMeasurement().c_str(), json.c_str());
+	TEST_ASSERT_EQUAL_STRING("Temperature", doc["measurements"][0]["parameter"].as<String>().c_str());
+	TEST_ASSERT_EQUAL_STRING("%", doc["measurements"][1]["unit"].as<String>().c_str());
+}
+
+void test_single_precision_values() {
+	std::vector<uint8_t> packed = encode(true);
+	// float32 (0xCA) 21.5 and 0.1, with no float64 values
+	TEST_ASSERT_TRUE(contains(packed, { 0xCA, 0x41, 0xAC, 0x00, 0x00 }));
+	TEST_ASSERT_TRUE(contains(packed, { 0xCA, 0x3D, 0xCC, 0xCC, 0xCD }));
+	TEST_ASSERT_FALSE(contains(packed, { 0xCB }));
+	TEST_ASSERT_LESS_THAN(encode(false).size(), packed.size());
+	JsonDocument doc;
+	TEST_ASSERT_FALSE(deserializeMsgPack(doc, packed.data(), packed.size()));
+	TEST_ASSERT_EQUAL_FLOAT(21.5f, doc["measurements"][0]["value"].as<float>());
+	TEST_ASSERT_EQUAL_FLOAT(0.1f, doc["measurements"][1]["value"].as<float>());
+}
+
+void test_smaller_than_json() {
+	// A hub with an environment sensor, a particulate sensor and a power monitor
+	SensorManager::measurements = {
+		{ "Temperature", 21.37, "C" }, { "Relative Humidity", 45.82, "%RH" }, { "Pressure", 1013.25, "hPa" },
+		{ "Gas Resistance", 152340.0, "Ohms" }, { "CO2", 612.0, "ppm" }, { "VOC Index", 104.0, "" },
+		{ "PM1.0", 3.2, "ug/m3" }, { "PM2.5", 5.7, "ug/m3" }, { "PM4.0", 6.9, "ug/m3" }, { "PM10", 7.4, "ug/m3" },
+		{ "Voltage", 230.4, "V" }, { "Current", 1.283, "A" }, { "Power", 295.6, "W" }, { "Energy", 1532.78, "kWh" },
+		{ "Frequency", 50.02, "Hz" }, { "Power Factor", 0.97, "" }
+	};
+	const int frames = 1000;
+	ulong start = micros();
+	String json;
+	for (int i = 0; i < frames; i++) {
+		json = SensorManager::getLastMeasurement();
+	}
+	ulong json_time = (micros() - start) / frames;
+	start = micros();
+	std::vector<uint8_t> doubles;
+	for (int i = 0; i < frames; i++) {
+		doubles = encode(false);
+	}
+	ulong double_time = (micros() - start) / frames;
+	start = micros();
+	std::vector<uint8_t> singles;
+	for (int i = 0; i < frames; i++) {
+		singles = encode(true);
+	}
+	ulong single_time = (micros() - start) / frames;
+	TEST_MESSAGE(("JSON: " + String(json.length()) + " bytes in " + String(json_time) + "us, MessagePack: " + String(doubles.size()) + " bytes in " + String(double_time) + "us, with single precision: " + String(singles.size()) + " bytes in " + String(single_time) + "us").c_str());
+	TEST_ASSERT_LESS_THAN(json.length(), doubles.size());
+	TEST_ASSERT_LESS_THAN(doubles.size(), singles.size());
+	// Each value is 4 bytes smaller as a float32
+	TEST_ASSERT_EQUAL(doubles.size() - 4 * SensorManager::measurements.size(), singles.size());
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_same_shape_as_json);
+	RUN_TEST(test_single_precision_values);
+	RUN_TEST(test_smaller_than_json);
+	HostTest::finish(UNITY_END());
+}
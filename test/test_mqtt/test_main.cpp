@@ -0,0 +1,259 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <MqttManager.h>
+#include <mutex>
+
+/// @brief A sensor with readings set by the test, measuring the same parameter twice
+class FakeSensor : public Sensor {
+	public:
+		FakeSensor() {
+			Description = { .parameterQuantity = 3, .type = "Fake", .name = "Fake Sensor", .parameters = { "Temperature", "Relative Humidity", "Temperature" }, .units = { "C", "%RH", "C" }, .id = 0 };
+			values = { 21.5, 40, 22 };
+		}
+
+		bool begin() override {
+			return true;
+		}
+
+		bool takeMeasurement() override {
+			return true;
+		}
+};
+
+/// @brief A receiver that records the signals it gets
+class FakeReceiver : public SignalReceiver {
+	public:
+		FakeReceiver() {
+			Description = { .signalQuantity = 2, .type = "Fake", .name = "Fake Receiver", .signals = { { "on", 0 }, { "set", 1 } }, .id = 0 };
+		}
+
+		std::tuple<bool, String> receiveSignal(int signal, String payload) override {
+			std::lock_guard<std::mutex> guard(lock);
+			received.push_back({ signal, payload });
+			return { true, "" };
+		}
+
+		/// @brief Gets the signals received
+		/// @return The signal IDs and payloads, oldest first
+		std::vector<std::pair<int, String>> signals() {
+			std::lock_guard<std::mutex> guard(lock);
+			return received;
+		}
+
+	private:
+		/// @brief Signals received
+		std::vector<std::pair<int, String>> received;
+
+		/// @brief Guards the signals, which arrive on the signal processor's task
+		std::mutex lock;
+};
+
+/// @brief The sensor measurements are taken from
+static FakeSensor sensor;
+
+/// @brief The receiver commands are sent to
+static FakeReceiver receiver;
+
+/// @brief Applies a configuration and lets the manager connect
+/// @param config The configuration, as a JSON string
+static void configure(String config) {
+	TEST_ASSERT_TRUE(MqttManager::updateConfig(config));
+	MqttManager::loop();
+	MqttBroker.run();
+}
+
+/// @brief Publishes what's queued
+static void flush() {
+	MqttManager::loop();
+	MqttBroker.run();
+}
+
+/// @brief Finds the last message published to a topic
+/// @param topic The topic
+/// @return The message, or nullptr if there isn't one
+static const FakeBroker::message* lastMessage(const char* topic) {
+	for (auto m = MqttBroker.published.rbegin(); m != MqttBroker.published.rend(); m++) {
+		if (m->topic == topic) {
+			return &*m;
+		}
+	}
+	return nullptr;
+}
+
+/// @brief Counts the messages published to a topic
+/// @param topic The topic
+/// @return The number of messages
+static int count(const char* topic) {
+	int n = 0;
+	for (const auto& m : MqttBroker.published) {
+		n += m.topic == topic;
+	}
+	return n;
+}
+
+/// @brief Waits for the signal processor to pass on a number of signals
+/// @param n The number of signals
+/// @return True if they arrived in time
+static bool waitForSignals(size_t n) {
+	ulong start = millis();
+	while (receiver.signals().size() < n && millis() - start < 2000) {
+		delay(10);
+	}
+	return receiver.signals().size() >= n;
+}
+
+void setUp() {
+	HostTest::setWiFiConnected(true);
+	// Disconnects from the last test's broker
+	TEST_ASSERT_TRUE(MqttManager::updateConfig("{\"enabled\":false}"));
+	MqttBroker.run();
+	MqttBroker.reset();
+}
+
+void tearDown() {}
+
+void test_connects_with_settings() {
+	configure("{\"enabled\":true,\"host\":\"broker.local\",\"port\":1884,\"clientID\":\"hub1\",\"username\":\"user\",\"password\":\"secret\",\"baseTopic\":\"lab\"}");
+	TEST_ASSERT_EQUAL(1, MqttBroker.connections.size());
+	auto& c = MqttBroker.connections[0];
+	TEST_ASSERT_EQUAL_STRING("broker.local", c.host.c_str());
+	TEST_ASSERT_EQUAL(1884, c.port);
+	TEST_ASSERT_EQUAL_STRING("hub1", c.client_id.c_str());
+	TEST_ASSERT_TRUE(c.has_username);
+	TEST_ASSERT_EQUAL_STRING("user", c.username.c_str());
+	TEST_ASSERT_EQUAL_STRING("secret", c.password.c_str());
+	// The broker announces the hub went offline if the connection is lost
+	TEST_ASSERT_EQUAL_STRING("lab/status", c.will_topic.c_str());
+	TEST_ASSERT_EQUAL_STRING("offline", c.will_payload.c_str());
+	TEST_ASSERT_EQUAL(1, MqttBroker.subscriptions.size());
+	TEST_ASSERT_EQUAL_STRING("lab/cmd/#", MqttBroker.subscriptions[0].c_str());
+	const FakeBroker::message* status = lastMessage("lab/status");
+	TEST_ASSERT_NOT_NULL(status);
+	TEST_ASSERT_EQUAL_STRING("online", status->payload.c_str());
+	TEST_ASSERT_TRUE(status->retain);
+	TEST_ASSERT_TRUE(MqttManager::getConfig().indexOf("\"connected\":true") >= 0);
+}
+
+void test_credentials_are_removed() {
+	configure("{\"enabled\":true,\"host\":\"broker.local\",\"username\":\"user\",\"password\":\"secret\"}");
+	configure("{\"enabled\":true,\"host\":\"broker.local\"}");
+	TEST_ASSERT_EQUAL(2, MqttBroker.connections.size());
+	TEST_ASSERT_TRUE(MqttBroker.connections[0].has_username);
+	TEST_ASSERT_FALSE(MqttBroker.connections[1].has_username);
+	TEST_ASSERT_FALSE(MqttBroker.connections[1].has_password);
+}
+
+void test_measurements_are_published() {
+	configure("{\"enabled\":true,\"host\":\"broker.local\",\"baseTopic\":\"lab\",\"qos\":1,\"frame\":true}");
+	TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	flush();
+	const FakeBroker::message* temperature = lastMessage("lab/Temperature");
+	TEST_ASSERT_NOT_NULL(temperature);
+	TEST_ASSERT_EQUAL_STRING("21.5", temperature->payload.c_str());
+	TEST_ASSERT_EQUAL(1, temperature->qos);
+	TEST_ASSERT_TRUE(temperature->retain);
+	// Topic levels can't have spaces, and repeated parameters are numbered
+	TEST_ASSERT_NOT_NULL(lastMessage("lab/Relative_Humidity"));
+	TEST_ASSERT_EQUAL_STRING("40", lastMessage("lab/Relative_Humidity")->payload.c_str());
+	TEST_ASSERT_NOT_NULL(lastMessage("lab/Temperature_2"));
+	TEST_ASSERT_EQUAL_STRING("22", lastMessage("lab/Temperature_2")->payload.c_str());
+	const FakeBroker::message* frame = lastMessage("lab/frame");
+	TEST_ASSERT_NOT_NULL(frame);
+	TEST_ASSERT_FALSE(frame->retain);
+	TEST_ASSERT_TRUE(frame->payload.indexOf("\"parameter\":\"Relative Humidity\"") >= 0);
+}
+
+void test_unsent_values_are_replaced() {
+	configure("{\"enabled\":true,\"host\":\"broker.local\",\"baseTopic\":\"lab\"}");
+	MqttBroker.dropConnection();
+	MqttBroker.run();
+	// Measurements keep coming while the broker can't be reached
+	for (int i = 0; i < 5; i++) {
+		sensor.values[0] = 20 + i;
+		TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	}
+	TEST_ASSERT_TRUE(MqttManager::getConfig().indexOf("\"queued\":3") >= 0);
+	// Reconnects once the backoff has passed
+	delay(1100);
+	flush();
+	flush();
+	TEST_ASSERT_EQUAL(2, MqttBroker.connections.size());
+	TEST_ASSERT_EQUAL(1, count("lab/Temperature"));
+	TEST_ASSERT_EQUAL_STRING("24", lastMessage("lab/Temperature")->payload.c_str());
+	sensor.values[0] = 21.5;
+}
+
+void test_in_flight_limit() {
+	configure("{\"enabled\":true,\"host\":\"broker.local\",\"baseTopic\":\"lab\"}");
+	MqttBroker.auto_acknowledge = false;
+	for (int i = 0; i < 10; i++) {
+		TEST_ASSERT_TRUE(MqttManager::publish("event", String(i), 1, false));
+	}
+	flush();
+	// Messages with QoS above 0 wait for earlier ones to be acknowledged
+	TEST_ASSERT_EQUAL(8, count("lab/event"));
+	TEST_ASSERT_TRUE(MqttManager::getConfig().indexOf("\"queued\":2") >= 0);
+	TEST_ASSERT_TRUE(MqttManager::publish("now", "x", 0, false));
+	flush();
+	TEST_ASSERT_EQUAL(0, count("lab/now"));
+}
+
+void test_reconnect_backoff() {
+	MqttBroker.accepting = false;
+	configure("{\"enabled\":true,\"host\":\"broker.local\"}");
+	TEST_ASSERT_EQUAL(1, MqttBroker.connections.size());
+	// The next attempt waits
+	flush();
+	TEST_ASSERT_EQUAL(1, MqttBroker.connections.size());
+	delay(1100);
+	flush();
+	TEST_ASSERT_EQUAL(2, MqttBroker.connections.size());
+	// The wait doubles
+	delay(1100);
+	flush();
+	TEST_ASSERT_EQUAL(2, MqttBroker.connections.size());
+	// New settings are tried straight away
+	MqttBroker.accepting = true;
+	configure("{\"enabled\":true,\"host\":\"broker.local\"}");
+	TEST_ASSERT_EQUAL(3, MqttBroker.connections.size());
+	TEST_ASSERT_TRUE(MqttManager::getConfig().indexOf("\"connected\":true") >= 0);
+}
+
+void test_commands_reach_receivers() {
+	configure("{\"enabled\":true,\"host\":\"broker.local\",\"baseTopic\":\"lab\"}");
+	size_t before = receiver.signals().size();
+	MqttBroker.deliver("lab/cmd/0/set", "{\"level\":50}", 4);
+	MqttBroker.deliver("lab/cmd/0/0", "");
+	MqttBroker.run();
+	TEST_ASSERT_TRUE(waitForSignals(before + 2));
+	auto signals = receiver.signals();
+	TEST_ASSERT_EQUAL(1, signals[before].first);
+	TEST_ASSERT_EQUAL_STRING("{\"level\":50}", signals[before].second.c_str());
+	TEST_ASSERT_EQUAL(0, signals[before + 1].first);
+	// Bad topics, unknown signals and receivers, and payloads that are too long are ignored
+	MqttBroker.deliver("lab/cmd/0", "x");
+	MqttBroker.deliver("lab/cmd/0/off", "x");
+	MqttBroker.deliver("lab/cmd/5/on", "x");
+	MqttBroker.deliver("other/cmd/0/on", "x");
+	MqttBroker.deliver("lab/cmd/0/on", String(std::string(2000, 'x')), 500);
+	MqttBroker.run();
+	delay(300);
+	TEST_ASSERT_EQUAL(before + 2, receiver.signals().size());
+}
+
+int main(int argc, char **argv) {
+	SensorManager::addSensor(&sensor);
+	SignalManager::addReceiver(&receiver);
+	xTaskCreate(SignalManager::signalProcessor, "Signal Processor", 4096, NULL, 1, NULL);
+	MqttManager::begin("mqtt.json");
+	UNITY_BEGIN();
+	RUN_TEST(test_connects_with_settings);
+	RUN_TEST(test_credentials_are_removed);
+	RUN_TEST(test_measurements_are_published);
+	RUN_TEST(test_unsent_values_are_replaced);
+	RUN_TEST(test_in_flight_limit);
+	RUN_TEST(test_reconnect_backoff);
+	RUN_TEST(test_commands_reach_receivers);
+	HostTest::finish(UNITY_END());
+}
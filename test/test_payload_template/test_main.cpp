@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <PayloadTemplate.h>
+
+/// @brief Renders a template
+/// @param t The template
+/// @return The output
+static String render(PayloadTemplate& t) {
+	String output;
+	t.render(output);
+	return output;
+}
+
+/// @brief Encodes a value
+/// @param value The value
+/// @param encoding The encoding
+/// @return The encoded value
+static String encode(const char* value, PayloadTemplate::Encoding encoding) {
+	String output = "";
+	PayloadTemplate::encode(output, value, encoding);
+	return output;
+}
+
+void setUp() {
+	SensorManager::measurements.clear();
+	SensorManager::measurements.push_back({ "Temperature", 21.5, "C" });
+	SensorManager::measurements.push_back({ "Humidity", 40.25, "%" });
+	SensorManager::measurements.push_back({ "Pressure", NAN, "hPa" });
+	PayloadTemplate::takeSnapshot();
+}
+
+void tearDown() {}
+
+void test_parse_segments() {
+	TEST_ASSERT_TRUE(PayloadTemplate().isEmpty());
+	PayloadTemplate literal("no placeholders here");
+	TEST_ASSERT_FALSE(literal.isEmpty());
+	TEST_ASSERT_FALSE(literal.hasPlaceholders());
+	TEST_ASSERT_EQUAL_STRING("no placeholders here", render(literal).c_str());
+	PayloadTemplate t("t={{ Temperature }}&h={{Humidity}}");
+	TEST_ASSERT_TRUE(t.hasPlaceholders());
+	TEST_ASSERT_EQUAL_STRING("t=21.5&h=40.25", render(t).c_str());
+	// An unclosed placeholder is kept as text
+	PayloadTemplate open("{{Temperature}} {{Humidity");
+	TEST_ASSERT_EQUAL_STRING("21.5 {{Humidity", render(open).c_str());
+	PayloadTemplate adjacent("{{Temperature}}{{Humidity}}");
+	TEST_ASSERT_EQUAL_STRING("21.540.25", render(adjacent).c_str());
+}
+
+void test_missing_values() {
+	PayloadTemplate plain("[{{Pressure}}|{{Wind}}]");
+	TEST_ASSERT_EQUAL_STRING("[|]", render(plain).c_str());
+	PayloadTemplate json("{\"p\":{{Pressure}},\"w\":{{Wind}},\"t\":{{Temperature}}}", PayloadTemplate::Encoding::JSON);
+	TEST_ASSERT_EQUAL_STRING("{\"p\":null,\"w\":null,\"t\":21.5}", render(json).c_str());
+}
+
+void test_timestamp() {
+	PayloadTemplate t("{{timestamp}}");
+	time_t before = time(nullptr);
+	long rendered = render(t).toInt();
+	TEST_ASSERT_TRUE(rendered >= before && rendered <= time(nullptr));
+}
+
+void test_render_follows_measurements() {
+	PayloadTemplate t("{{Humidity}}/{{Temperature}}");
+	String output = "old contents";
+	t.render(output);
+	TEST_ASSERT_EQUAL_STRING("40.25/21.5", output.c_str());
+	// Parameters are found again when the measurements change order
+	std::swap(SensorManager::measurements[0], SensorManager::measurements[1]);
+	SensorManager::measurements[0].value = -3.125;
+	// Templates render from the snapshot until the next one is taken
+	t.render(output);
+	TEST_ASSERT_EQUAL_STRING("40.25/21.5", output.c_str());
+	PayloadTemplate::takeSnapshot();
+	t.render(output);
+	TEST_ASSERT_EQUAL_STRING("-3.125/21.5", output.c_str());
+	SensorManager::measurements.erase(SensorManager::measurements.begin());
+	PayloadTemplate::takeSnapshot();
+	t.render(output);
+	TEST_ASSERT_EQUAL_STRING("/21.5", output.c_str());
+	SensorManager::measurements[0].value = 1234567.0;
+	PayloadTemplate::takeSnapshot();
+	t.render(output);
+	TEST_ASSERT_EQUAL_STRING("/1.23457e+06", output.c_str());
+}
+
+void test_url_values_are_encoded() {
+	SensorManager::measurements[0].value = -0.5;
+	PayloadTemplate::takeSnapshot();
+	PayloadTemplate t("v={{Temperature}}", PayloadTemplate::Encoding::URL);
+	TEST_ASSERT_EQUAL_STRING("v=-0.5", render(t).c_str());
+	TEST_ASSERT_EQUAL_STRING("AZaz09-_.~", encode("AZaz09-_.~", PayloadTemplate::Encoding::URL).c_str());
+	TEST_ASSERT_EQUAL_STRING("a%20b%26c%3Dd%2F%2B", encode("a b&c=d/+", PayloadTemplate::Encoding::URL).c_str());
+	TEST_ASSERT_EQUAL_STRING("%C3%A9", encode("\xC3\xA9", PayloadTemplate::Encoding::URL).c_str());
+}
+
+void test_json_strings_are_escaped() {
+	TEST_ASSERT_EQUAL_STRING("say \\\"hi\\\"", encode("say \"hi\"", PayloadTemplate::Encoding::JSON).c_str());
+	TEST_ASSERT_EQUAL_STRING("C:\\\\data", encode("C:\\data", PayloadTemplate::Encoding::JSON).c_str());
+	TEST_ASSERT_EQUAL_STRING("a\\u000Ab\\u0009", encode("a\nb\t", PayloadTemplate::Encoding::JSON).c_str());
+	TEST_ASSERT_EQUAL_STRING("\xC3\xA9", encode("\xC3\xA9", PayloadTemplate::Encoding::JSON).c_str());
+	TEST_ASSERT_EQUAL_STRING("a b&c", encode("a b&c", PayloadTemplate::Encoding::None).c_str());
+}
+
+void test_encoding_for_content_type() {
+	TEST_ASSERT_TRUE(PayloadTemplate::encodingFor("application/json") == PayloadTemplate::Encoding::JSON);
+	TEST_ASSERT_TRUE(PayloadTemplate::encodingFor("Application/JSON; charset=utf-8") == PayloadTemplate::Encoding::JSON);
+	TEST_ASSERT_TRUE(PayloadTemplate::encodingFor("application/x-www-form-urlencoded") == PayloadTemplate::Encoding::URL);
+	TEST_ASSERT_TRUE(PayloadTemplate::encodingFor("text/plain") == PayloadTemplate::Encoding::None);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_parse_segments);
+	RUN_TEST(test_missing_values);
+	RUN_TEST(test_timestamp);
+	RUN_TEST(test_render_follows_measurements);
+	RUN_TEST(test_url_values_are_encoded);
+	RUN_TEST(test_json_strings_are_escaped);
+	RUN_TEST(test_encoding_for_content_type);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,176 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <Router.h>
+
+// Routes are found at compile time by the same hash
+static_assert(Router::key("/version", HTTP_GET) != Router::key("/version", HTTP_POST), "Methods must hash differently");
+
+/// @brief Two paths whose hashes are the same for GET requests
+static const char* colliding[] = { "/api/255009", "/api/1030054" };
+
+/// @brief The server routing requests
+static AsyncWebServer* server;
+
+/// @brief The router under test
+static Router* router;
+
+/// @brief Number of times a handler ran
+static int handled;
+
+/// @brief Sends a request through the server
+/// @param method The method
+/// @param url The URL, with any query string
+/// @return The status code of the response
+static int send(WebRequestMethod method, String url) {
+	AsyncWebServerRequest request(method, url);
+	server->handle(&request);
+	return request.response() == nullptr ? 0 : request.response()->code;
+}
+
+void setUp() {
+	server = new AsyncWebServer(80);
+	router = new Router();
+	server->addHandler(router);
+	handled = 0;
+}
+
+void tearDown() {
+	delete server;
+	delete router;
+}
+
+void test_key_is_stable() {
+	TEST_ASSERT_EQUAL(Router::key("/version", HTTP_GET), Router::key(String("/version").c_str(), HTTP_GET));
+	TEST_ASSERT_NOT_EQUAL(Router::key("/version", HTTP_GET), Router::key("/versions", HTTP_GET));
+	TEST_ASSERT_EQUAL(Router::key(colliding[0], HTTP_GET), Router::key(colliding[1], HTTP_GET));
+	TEST_ASSERT_NOT_EQUAL(Router::key(colliding[0], HTTP_POST), Router::key(colliding[1], HTTP_POST));
+}
+
+void test_duplicates_and_collisions_are_rejected() {
+	auto handler = [](AsyncWebServerRequest* request) {
+		handled++;
+		request->send(200, "text/plain", request->url());
+	};
+	TEST_ASSERT_TRUE(router->on("/version", HTTP_GET, handler));
+	TEST_ASSERT_TRUE(router->allRegistered());
+	TEST_ASSERT_FALSE(router->on("/version", HTTP_GET, handler));
+	TEST_ASSERT_FALSE(router->allRegistered());
+	TEST_ASSERT_TRUE(router->on("/version", HTTP_POST, handler));
+	TEST_ASSERT_TRUE(router->on(colliding[0], HTTP_GET, handler));
+	TEST_ASSERT_FALSE(router->on(colliding[1], HTTP_GET, handler));
+	// The path is checked as well as the hash, so the rejected route isn't served by the other
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, colliding[0]));
+	TEST_ASSERT_EQUAL(404, send(HTTP_GET, colliding[1]));
+	TEST_ASSERT_EQUAL(404, send(HTTP_PUT, "/version"));
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, "/version?verbose=1"));
+	TEST_ASSERT_EQUAL(2, handled);
+}
+
+void test_headers_reach_handler() {
+	String received;
+	router->on("/echo", HTTP_GET, [&received](AsyncWebServerRequest* request) {
+		received = request->hasHeader("X-Custom") ? request->header("X-Custom") : "missing";
+		request->send(200);
+	});
+	AsyncWebServerRequest request(HTTP_GET, "/echo");
+	request.receiveHeader("X-Custom", "value");
+	TEST_ASSERT_TRUE(server->handle(&request) == router);
+	TEST_ASSERT_EQUAL_STRING("value", received.c_str());
+}
+
+void test_middleware_runs_in_order() {
+	std::vector<int> order;
+	router->on("/data", HTTP_GET, [&order](AsyncWebServerRequest* request) {
+		order.push_back(3);
+		request->send(200);
+	}, {
+		[&order](AsyncWebServerRequest* request, bool respond) { order.push_back(1); return true; },
+		[&order](AsyncWebServerRequest* request, bool respond) { order.push_back(2); return true; }
+	});
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, "/data"));
+	TEST_ASSERT_EQUAL(3, order.size());
+	TEST_ASSERT_EQUAL(1, order[0]);
+	TEST_ASSERT_EQUAL(3, order[2]);
+}
+
+void test_param_and_auth_middleware() {
+	String username = "admin";
+	String password = "secret";
+	bool ready = false;
+	router->on("/config", HTTP_GET, [](AsyncWebServerRequest* request) {
+		handled++;
+		request->send(200);
+	}, { Router::ready(ready), Router::authenticated(username, password), Router::params({ "path" }) });
+	TEST_ASSERT_EQUAL(500, send(HTTP_GET, "/config?path=/a"));
+	ready = true;
+	TEST_ASSERT_EQUAL(401, send(HTTP_GET, "/config?path=/a"));
+	AsyncWebServerRequest request(HTTP_GET, "/config");
+	request.receiveHeader("Authorization", "Basic YWRtaW46c2VjcmV0");
+	server->handle(&request);
+	TEST_ASSERT_EQUAL(400, request.response()->code);
+	AsyncWebServerRequest authorized(HTTP_GET, "/config?path=/a");
+	authorized.receiveHeader("Authorization", "Basic YWRtaW46c2VjcmV0");
+	server->handle(&authorized);
+	TEST_ASSERT_EQUAL(200, authorized.response()->code);
+	// Clearing the user name turns authentication off straight away
+	username = "";
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, "/config?path=/a"));
+	TEST_ASSERT_EQUAL(2, handled);
+}
+
+void test_rate_limit() {
+	router->on("/limited", HTTP_GET, [](AsyncWebServerRequest* request) {
+		request->send(200);
+	}, { Router::rateLimit(0.5, 2) });
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, "/limited"));
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, "/limited"));
+	AsyncWebServerRequest request(HTTP_GET, "/limited");
+	server->handle(&request);
+	TEST_ASSERT_EQUAL(429, request.response()->code);
+	TEST_ASSERT_EQUAL_STRING("2", request.response()->header("Retry-After").c_str());
+}
+
+void test_in_flight_limit() {
+	router->setInFlightLimit(1);
+	router->on("/slow", HTTP_GET, [](AsyncWebServerRequest* request) {
+		request->send(200);
+	});
+	// A request is in flight until it is deleted, when its connection closes
+	AsyncWebServerRequest* first = new AsyncWebServerRequest(HTTP_GET, "/slow");
+	server->handle(first);
+	TEST_ASSERT_EQUAL(200, first->response()->code);
+	AsyncWebServerRequest second(HTTP_GET, "/slow");
+	server->handle(&second);
+	TEST_ASSERT_EQUAL(503, second.response()->code);
+	TEST_ASSERT_TRUE(second.response()->hasHeader("Retry-After"));
+	delete first;
+	TEST_ASSERT_EQUAL(200, send(HTTP_GET, "/slow"));
+	TEST_ASSERT_TRUE(router->getMetrics().indexOf("\"shed\":1") >= 0);
+}
+
+void test_metrics() {
+	router->on("/version", HTTP_GET, [](AsyncWebServerRequest* request) {
+		request->send(200);
+	}, { Router::params({ "x" }) });
+	send(HTTP_GET, "/version?x=1");
+	send(HTTP_GET, "/version");
+	String metrics = router->getMetrics();
+	TEST_ASSERT_TRUE(metrics.indexOf("\"method\":\"GET\"") >= 0);
+	TEST_ASSERT_TRUE(metrics.indexOf("\"path\":\"/version\"") >= 0);
+	TEST_ASSERT_TRUE(metrics.indexOf("\"count\":2") >= 0);
+	TEST_ASSERT_TRUE(metrics.indexOf("\"rejected\":1") >= 0);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_key_is_stable);
+	RUN_TEST(test_duplicates_and_collisions_are_rejected);
+	RUN_TEST(test_headers_reach_handler);
+	RUN_TEST(test_middleware_runs_in_order);
+	RUN_TEST(test_param_and_auth_middleware);
+	RUN_TEST(test_rate_limit);
+	RUN_TEST(test_in_flight_limit);
+	RUN_TEST(test_metrics);
+	HostTest::finish(UNITY_END());
+}
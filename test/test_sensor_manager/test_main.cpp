@@ -0,0 +1,58 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <SensorManager.h>
+#include <atomic>
+#include <thread>
+
+/// @brief Number of times the callbacks were called
+static std::atomic<int> calls;
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_callbacks_added_from_several_tasks() {
+	// Startup stages on both cores add callbacks at the same time, e.g. the web server's measurement stream and MQTT
+	const int per_task = 500;
+	std::thread first([]() {
+		for (int i = 0; i < per_task; i++) {
+			SensorManager::addMeasurementCallback([]() { calls++; });
+		}
+	});
+	std::thread second([]() {
+		for (int i = 0; i < per_task; i++) {
+			SensorManager::addMeasurementCallback([]() { calls++; });
+		}
+	});
+	first.join();
+	second.join();
+	calls = 0;
+	TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	TEST_ASSERT_EQUAL(2 * per_task, calls.load());
+}
+
+void test_callback_added_while_measuring() {
+	calls = 0;
+	TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	int before = calls;
+	std::atomic<bool> done(false);
+	std::thread adder([&done]() {
+		SensorManager::addMeasurementCallback([]() { calls++; });
+		done = true;
+	});
+	while (!done) {
+		TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	}
+	adder.join();
+	calls = 0;
+	TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	TEST_ASSERT_EQUAL(before + 1, calls.load());
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_callbacks_added_from_several_tasks);
+	RUN_TEST(test_callback_added_while_measuring);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,169 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <LittleFS.h>
+#include <Storage.h>
+
+/// @brief Lists the names of the files in a directory
+/// @param dirname The directory
+/// @param glob The pattern the names must match
+/// @return The paths, in listing order
+static std::vector<String> list(String dirname, String glob = "*") {
+	std::vector<Storage::entry> entries;
+	Storage::listEntries(dirname, 0, entries, 0, SIZE_MAX, glob);
+	std::vector<String> paths;
+	for (const auto& e : entries) {
+		paths.push_back(e.path);
+	}
+	return paths;
+}
+
+/// @brief Creates a file without going through Storage, as a library writing to the file system directly would
+/// @param path The path of the file
+static void writeBehindCache(String path) {
+	File file = LittleFS.open(path, FILE_WRITE, true);
+	file.print("x");
+	file.close();
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	// Mounting again clears the directory cache
+	Storage::begin();
+}
+
+void tearDown() {}
+
+void test_glob_literal_and_wildcards() {
+	TEST_ASSERT_TRUE(Storage::matchGlob("*", "data.csv"));
+	TEST_ASSERT_TRUE(Storage::matchGlob("*", ""));
+	TEST_ASSERT_TRUE(Storage::matchGlob("data.csv", "data.csv"));
+	TEST_ASSERT_FALSE(Storage::matchGlob("data.csv", "data.csv.gz"));
+	TEST_ASSERT_TRUE(Storage::matchGlob("*.csv", "data.csv"));
+	TEST_ASSERT_FALSE(Storage::matchGlob("*.csv", "data.csv.gz"));
+	TEST_ASSERT_TRUE(Storage::matchGlob("log-????.csv", "log-2024.csv"));
+	TEST_ASSERT_FALSE(Storage::matchGlob("log-????.csv", "log-24.csv"));
+	TEST_ASSERT_FALSE(Storage::matchGlob("?", ""));
+}
+
+void test_glob_backtracks() {
+	TEST_ASSERT_TRUE(Storage::matchGlob("*a*b", "xaxxab"));
+	TEST_ASSERT_TRUE(Storage::matchGlob("a*b*c", "abbbc"));
+	TEST_ASSERT_FALSE(Storage::matchGlob("a*b*c", "abcb"));
+	TEST_ASSERT_TRUE(Storage::matchGlob("**.gz", "a.b.gz"));
+	TEST_ASSERT_TRUE(Storage::matchGlob("*.*", "a.b"));
+	TEST_ASSERT_FALSE(Storage::matchGlob("*.*", "ab"));
+}
+
+void test_list_filters_and_pages() {
+	for (int i = 0; i < 5; i++) {
+		TEST_ASSERT_TRUE(Storage::writeFile("/data/log-" + String(i) + ".csv", "a,b\n"));
+	}
+	TEST_ASSERT_TRUE(Storage::writeFile("/data/notes.txt", "hi"));
+	TEST_ASSERT_EQUAL(5, list("/data", "*.csv").size());
+	std::vector<Storage::entry> entries;
+	TEST_ASSERT_EQUAL(5, Storage::listEntries("/data", 0, entries, 1, 2, "log-*"));
+	TEST_ASSERT_EQUAL(2, entries.size());
+	TEST_ASSERT_EQUAL_STRING("/data/log-1.csv", entries[0].path.c_str());
+	TEST_ASSERT_EQUAL_STRING("/data/log-2.csv", entries[1].path.c_str());
+	TEST_ASSERT_EQUAL(4, entries[0].size);
+}
+
+void test_cache_follows_storage_writes() {
+	TEST_ASSERT_TRUE(Storage::writeFile("/data/a.csv", "1"));
+	TEST_ASSERT_EQUAL(1, list("/data").size());
+	// The listing is now cached, and writes through Storage keep it current
+	TEST_ASSERT_TRUE(Storage::writeFile("/data/b.csv", "22"));
+	TEST_ASSERT_TRUE(Storage::appendToFile("/data/a.csv", "11"));
+	Storage::flush(true);
+	std::vector<Storage::entry> entries;
+	Storage::listEntries("/data", 0, entries);
+	TEST_ASSERT_EQUAL(2, entries.size());
+	TEST_ASSERT_EQUAL(3, entries[0].size);
+	TEST_ASSERT_TRUE(Storage::deleteFile("/data/b.csv"));
+	TEST_ASSERT_EQUAL(1, list("/data").size());
+}
+
+void test_refresh_entry_after_direct_write() {
+	TEST_ASSERT_TRUE(Storage::writeFile("/data/a.csv", "1"));
+	TEST_ASSERT_EQUAL(1, list("/data").size());
+	writeBehindCache("/data/b.csv");
+	// Changes made behind Storage's back are only seen once they are refreshed
+	TEST_ASSERT_EQUAL(1, list("/data").size());
+	Storage::refreshEntry("/data/b.csv");
+	TEST_ASSERT_EQUAL(2, list("/data").size());
+}
+
+void test_existing_directory_keeps_listing() {
+	TEST_ASSERT_TRUE(Storage::writeFile("/data/a.csv", "1"));
+	TEST_ASSERT_EQUAL(1, list("/data").size());
+	Storage::createDir("/data");
+	TEST_ASSERT_EQUAL(1, list("/data").size());
+	TEST_ASSERT_TRUE(Storage::fileExists("/data/a.csv"));
+}
+
+void test_large_directory_is_listed_uncached() {
+	for (int i = 0; i < 300; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "/big/%03d.csv", i);
+		writeBehindCache(name);
+	}
+	std::vector<Storage::entry> entries;
+	TEST_ASSERT_EQUAL(300, Storage::listEntries("/big", 0, entries, 290, 20));
+	TEST_ASSERT_EQUAL(10, entries.size());
+	TEST_ASSERT_EQUAL_STRING("/big/290.csv", entries[0].path.c_str());
+	// A directory too large to cache is read again each time, so new files show up
+	writeBehindCache("/big/300.csv");
+	entries.clear();
+	TEST_ASSERT_EQUAL(301, Storage::listEntries("/big", 0, entries, 0, 0));
+	// Smaller directories are still cached
+	TEST_ASSERT_TRUE(Storage::writeFile("/small/a.csv", "1"));
+	TEST_ASSERT_EQUAL(1, list("/small").size());
+	writeBehindCache("/small/b.csv");
+	TEST_ASSERT_EQUAL(1, list("/small").size());
+}
+
+void test_cached_listing_is_faster() {
+	// 10,000 log files, in directories small enough to cache
+	const int dirs = 40;
+	const int files = 250;
+	for (int d = 0; d < dirs; d++) {
+		for (int f = 0; f < files; f++) {
+			char name[32];
+			snprintf(name, sizeof(name), "/logs/%02d/%03d.csv", d, f);
+			writeBehindCache(name);
+		}
+	}
+	// Reading the whole tree is too much to cache, so it's read from the file system each time
+	std::vector<Storage::entry> entries;
+	ulong start = micros();
+	size_t total = Storage::listEntries("/logs", 1, entries, 0, 0);
+	ulong tree = micros() - start;
+	TEST_ASSERT_EQUAL(dirs * files, total);
+	// Listing one directory again and again, as the web interface does
+	const int repeats = 100;
+	start = micros();
+	std::vector<String> cold = list("/logs/07");
+	ulong uncached = micros() - start;
+	TEST_ASSERT_EQUAL(files, cold.size());
+	start = micros();
+	for (int i = 0; i < repeats; i++) {
+		TEST_ASSERT_TRUE(list("/logs/07") == cold);
+	}
+	ulong cached = (micros() - start) / repeats;
+	TEST_MESSAGE(("Tree of " + String(total) + " entries: " + String(tree) + "us, directory of " + String(files) + " cold: " + String(uncached) + "us, cached: " + String(cached) + "us").c_str());
+	TEST_ASSERT_LESS_THAN(uncached, cached);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_glob_literal_and_wildcards);
+	RUN_TEST(test_glob_backtracks);
+	RUN_TEST(test_list_filters_and_pages);
+	RUN_TEST(test_cache_follows_storage_writes);
+	RUN_TEST(test_refresh_entry_after_direct_write);
+	RUN_TEST(test_existing_directory_keeps_listing);
+	RUN_TEST(test_large_directory_is_listed_uncached);
+	RUN_TEST(test_cached_listing_is_faster);
+	HostTest::finish(UNITY_END());
+}
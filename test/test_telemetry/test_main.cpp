@@ -0,0 +1,217 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <LocalServer.h>
+#include <TelemetryExporter.h>
+
+/// @brief A sensor with fixed readings
+class FakeSensor : public Sensor {
+	public:
+		FakeSensor() {
+			Description = { .parameterQuantity = 2, .type = "Fake", .name = "Fake Sensor", .parameters = { "Temperature", "Relative Humidity" }, .units = { "C", "%RH" }, .id = 0 };
+		}
+
+		bool begin() override {
+			return true;
+		}
+
+		bool takeMeasurement() override {
+			values = { 21.5, 40 };
+			return true;
+		}
+};
+
+/// @brief The path lines are spilled to
+static const char* spill_path = "/data/telemetry.lp";
+
+/// @brief The collector
+static LocalServer* server;
+
+/// @brief The clock lines are stamped with
+static ESP32Time rtc;
+
+/// @brief The exporter under test
+static TelemetryExporter* exporter;
+
+/// @brief Configures the exporter
+/// @param batchSize Number of lines in a batch
+/// @param flushPeriod Time in ms after which lines are sent even if the batch isn't full
+static void configure(int batchSize, ulong flushPeriod) {
+	String config = "{\"enabled\":true,\"webhook\":0,\"measurement\":\"sensorhub\",\"tags\":\"host=hub1\",\"batchSize\":" + String(batchSize) +
+		",\"flushPeriod\":" + String(flushPeriod) + ",\"maxSpill\":512,\"samplingPeriod\":1000,\"taskName\":\"TelemetryExporter\"}";
+	TEST_ASSERT_TRUE(exporter->setConfig(config));
+}
+
+/// @brief Runs the exporter without taking measurements until a condition is met
+/// @param done Returns true once the condition is met
+/// @param timeout The time in ms to wait
+/// @return True if the condition was met in time
+static bool runUntil(std::function<bool()> done, ulong timeout = 3000) {
+	ulong start = millis();
+	while (!done() && millis() - start < timeout) {
+		exporter->runTask(0);
+		delay(5);
+	}
+	return done();
+}
+
+/// @brief Runs the exporter until the collector has received a number of batches and the last one has finished
+/// @param count The number of batches
+/// @return True if they arrived in time
+static bool sendBatches(size_t count) {
+	bool received = runUntil([count]() { return server->requests().size() >= count; });
+	// Let the exporter see the result of the last batch
+	ulong start = millis();
+	while (millis() - start < 300) {
+		exporter->runTask(0);
+		delay(5);
+	}
+	return received;
+}
+
+/// @brief Writes lines to the spill file
+/// @param lines The lines
+static void writeSpill(const String& lines) {
+	Storage::createDir("/data");
+	TEST_ASSERT_TRUE(Storage::appendToFile(spill_path, lines));
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	Storage::begin();
+	HostTest::setWiFiConnected(true);
+	server = new LocalServer();
+	TEST_ASSERT_TRUE(server->start());
+	WebhookManager::begin("webhooks.json");
+	TEST_ASSERT_TRUE(WebhookManager::updateWebhooks("{\"hooks\":[{\"url\":\"" + server->url("/write?precision=s") + "\"}]}"));
+	static FakeSensor* sensor = nullptr;
+	if (sensor == nullptr) {
+		sensor = new FakeSensor();
+		SensorManager::addSensor(sensor);
+	}
+	rtc.setTime(1700000000);
+	exporter = new TelemetryExporter(&rtc);
+	TEST_ASSERT_TRUE(exporter->begin());
+}
+
+void tearDown() {
+	exporter->enableTask(false);
+	delete exporter;
+	delete server;
+}
+
+void test_full_batch_is_sent() {
+	configure(3, 60000);
+	exporter->runTask(1000);
+	exporter->runTask(1000);
+	TEST_ASSERT_TRUE(server->requests().empty());
+	exporter->runTask(1000);
+	TEST_ASSERT_TRUE(sendBatches(1));
+	auto requests = server->requests();
+	TEST_ASSERT_EQUAL(1, requests.size());
+	TEST_ASSERT_EQUAL_STRING("POST", requests[0].method.c_str());
+	TEST_ASSERT_EQUAL_STRING("/write?precision=s", requests[0].path.c_str());
+	TEST_ASSERT_EQUAL_STRING("text/plain; charset=utf-8", requests[0].headers["content-type"].c_str());
+	String body = requests[0].body;
+	String first = body.substring(0, body.indexOf('\n'));
+	// Keys with spaces are escaped, and the timestamp is in seconds
+	TEST_ASSERT_TRUE(first.startsWith("sensorhub,host=hub1 Temperature=21.500000,Relative\\ Humidity=40.000000 17000000"));
+	int lines = 0;
+	for (char c : body) {
+		lines += c == '\n';
+	}
+	TEST_ASSERT_EQUAL(3, lines);
+	TEST_ASSERT_FALSE(Storage::fileExists(spill_path));
+}
+
+void test_partial_batch_is_flushed() {
+	configure(30, 100);
+	exporter->runTask(1000);
+	exporter->runTask(0);
+	TEST_ASSERT_TRUE(server->requests().empty());
+	TEST_ASSERT_TRUE(sendBatches(1));
+	// A single line
+	String body = server->requests()[0].body;
+	TEST_ASSERT_EQUAL(body.length(), body.indexOf('\n') + 1);
+}
+
+void test_rejected_batch_is_spilled_and_resent() {
+	configure(2, 200);
+	server->respond(400, "bad");
+	exporter->runTask(1000);
+	exporter->runTask(1000);
+	TEST_ASSERT_TRUE(sendBatches(1));
+	TEST_ASSERT_TRUE(Storage::fileExists(spill_path));
+	String rejected = server->requests()[0].body;
+	TEST_ASSERT_EQUAL(rejected.length(), Storage::fileSize(spill_path));
+	// Once the collector accepts batches again, the spilled lines are sent after waiting a flush period
+	server->respond(204, "");
+	TEST_ASSERT_TRUE(sendBatches(2));
+	TEST_ASSERT_EQUAL_STRING(rejected.c_str(), server->requests()[1].body.c_str());
+	TEST_ASSERT_TRUE(runUntil([]() { return !Storage::fileExists(spill_path); }));
+}
+
+void test_spilled_while_offline() {
+	configure(1000, 60000);
+	HostTest::setWiFiConnected(false);
+	// Collect more than the buffer holds
+	int taken = 0;
+	while (!Storage::fileExists(spill_path) && taken < 1000) {
+		exporter->runTask(1000);
+		taken++;
+	}
+	TEST_ASSERT_TRUE(Storage::fileExists(spill_path));
+	TEST_ASSERT_TRUE(server->requests().empty());
+	size_t spilled = Storage::fileSize(spill_path);
+	HostTest::setWiFiConnected(true);
+	// More than a batch was spilled, so it's sent as two batches of whole lines
+	TEST_ASSERT_TRUE(sendBatches(2));
+	auto requests = server->requests();
+	TEST_ASSERT_EQUAL(2, requests.size());
+	TEST_ASSERT_LESS_OR_EQUAL(8192, requests[0].body.length());
+	TEST_ASSERT_TRUE(requests[0].body.endsWith("\n"));
+	TEST_ASSERT_EQUAL(spilled, requests[0].body.length() + requests[1].body.length());
+	TEST_ASSERT_FALSE(Storage::fileExists(spill_path));
+}
+
+void test_long_spilled_line() {
+	configure(30, 60000);
+	String long_line = "sensorhub ";
+	for (int i = 0; long_line.length() < 9000; i++) {
+		long_line += "field" + String(i) + "=" + String(i) + ",";
+	}
+	long_line += "last=1 1700000000\n";
+	String short_line = "sensorhub Temperature=21.5 1700000001\n";
+	writeSpill(long_line + short_line);
+	// The long line is sent by itself, then the rest of the file
+	TEST_ASSERT_TRUE(sendBatches(2));
+	auto requests = server->requests();
+	TEST_ASSERT_EQUAL(2, requests.size());
+	TEST_ASSERT_EQUAL_STRING(long_line.c_str(), requests[0].body.c_str());
+	TEST_ASSERT_EQUAL_STRING(short_line.c_str(), requests[1].body.c_str());
+	TEST_ASSERT_TRUE(runUntil([]() { return !Storage::fileExists(spill_path); }));
+	// Both went on the same connection
+	TEST_ASSERT_EQUAL(1, server->connections());
+}
+
+void test_partial_spilled_line_is_skipped() {
+	configure(30, 60000);
+	// Left by a write that failed part way
+	writeSpill("sensorhub Temperature=21.5 1700000000\nsensorhub Tempera");
+	TEST_ASSERT_TRUE(sendBatches(1));
+	TEST_ASSERT_TRUE(runUntil([]() { return !Storage::fileExists(spill_path); }));
+	auto requests = server->requests();
+	TEST_ASSERT_EQUAL(1, requests.size());
+	TEST_ASSERT_EQUAL_STRING("sensorhub Temperature=21.5 1700000000\n", requests[0].body.c_str());
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_full_batch_is_sent);
+	RUN_TEST(test_partial_batch_is_flushed);
+	RUN_TEST(test_rejected_batch_is_spilled_and_resent);
+	RUN_TEST(test_spilled_while_offline);
+	RUN_TEST(test_long_spilled_line);
+	RUN_TEST(test_partial_spilled_line_is_skipped);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,136 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <TimeIndex.h>
+
+/// @brief The data file the index belongs to
+static const char* data_path = "/data/log.csv";
+
+/// @brief Gets the range of a data file covering a time range
+/// @param from The start of the time range
+/// @param to The end of the time range
+/// @param start Set to the start of the range
+/// @param end Set to the end of the range
+static void range(uint32_t from, uint32_t to, size_t& start, size_t& end) {
+	std::tie(start, end) = TimeIndex::findRange(data_path, from, to);
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	Storage::begin();
+}
+
+void tearDown() {}
+
+void test_no_index_covers_whole_file() {
+	size_t start, end;
+	range(100, 200, start, end);
+	TEST_ASSERT_EQUAL(0, start);
+	TEST_ASSERT_TRUE(end == SIZE_MAX);
+	TEST_ASSERT_TRUE(TimeIndex::createIndex(data_path, 1, 50));
+	range(100, 200, start, end);
+	TEST_ASSERT_EQUAL(0, start);
+	TEST_ASSERT_TRUE(end == SIZE_MAX);
+}
+
+void test_range_between_entries() {
+	TEST_ASSERT_TRUE(TimeIndex::createIndex(data_path, 1, 50));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 100, 4096));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 200, 8192));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 300, 12288));
+	size_t start, end;
+	range(150, 250, start, end);
+	TEST_ASSERT_EQUAL(4096, start);
+	TEST_ASSERT_EQUAL(12288, end);
+	// Before the first entry and after the last
+	range(10, 20, start, end);
+	TEST_ASSERT_EQUAL(0, start);
+	TEST_ASSERT_EQUAL(4096, end);
+	range(400, 500, start, end);
+	TEST_ASSERT_EQUAL(12288, start);
+	TEST_ASSERT_TRUE(end == SIZE_MAX);
+	range(0, UINT32_MAX, start, end);
+	TEST_ASSERT_EQUAL(0, start);
+	TEST_ASSERT_TRUE(end == SIZE_MAX);
+}
+
+void test_range_at_entry_times() {
+	TEST_ASSERT_TRUE(TimeIndex::createIndex(data_path, 1, 50));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 100, 4096));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 200, 8192));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 300, 12288));
+	size_t start, end;
+	// Rows logged in the same second just before an entry must be included
+	range(200, 200, start, end);
+	TEST_ASSERT_EQUAL(4096, start);
+	TEST_ASSERT_EQUAL(12288, end);
+	range(200, 300, start, end);
+	TEST_ASSERT_EQUAL(4096, start);
+	TEST_ASSERT_TRUE(end == SIZE_MAX);
+}
+
+void test_range_with_many_entries() {
+	TEST_ASSERT_TRUE(TimeIndex::createIndex(data_path, 1, 0));
+	for (uint32_t i = 1; i <= 100; i++) {
+		TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, i * 10, i * 1000));
+	}
+	size_t start, end;
+	for (uint32_t from = 0; from < 1020; from += 7) {
+		range(from, from + 35, start, end);
+		uint32_t before = from == 0 ? 0 : std::min((from - 1) / 10, (uint32_t)100);
+		TEST_ASSERT_EQUAL(before * 1000, start);
+		uint32_t after = (from + 35) / 10 + 1;
+		if (after > 100) {
+			TEST_ASSERT_TRUE(end == SIZE_MAX);
+		} else {
+			TEST_ASSERT_EQUAL(after * 1000, end);
+		}
+	}
+}
+
+void test_header_and_cursor() {
+	uint32_t generation = 0;
+	uint32_t started = 0;
+	TEST_ASSERT_FALSE(TimeIndex::getHeader(data_path, generation, started));
+	TEST_ASSERT_EQUAL(0, TimeIndex::getGeneration(data_path));
+	TEST_ASSERT_TRUE(TimeIndex::createIndex(data_path, 7, 1718000000));
+	TEST_ASSERT_TRUE(TimeIndex::addEntry(data_path, 1718000100, 4096));
+	TEST_ASSERT_TRUE(TimeIndex::getHeader(data_path, generation, started));
+	TEST_ASSERT_EQUAL(7, generation);
+	TEST_ASSERT_EQUAL(1718000000, started);
+	TimeIndex::entry last;
+	TEST_ASSERT_TRUE(TimeIndex::lastEntry(data_path, last));
+	TEST_ASSERT_EQUAL(1718000100, last.time);
+	TEST_ASSERT_EQUAL(4096, last.offset);
+	// A later generation always gives a larger cursor
+	TEST_ASSERT_TRUE(TimeIndex::cursor(8, 0) > TimeIndex::cursor(7, UINT32_MAX));
+	TEST_ASSERT_TRUE(TimeIndex::removeIndex(data_path));
+	TEST_ASSERT_FALSE(TimeIndex::lastEntry(data_path, last));
+}
+
+void test_index_without_header_is_rejected() {
+	// Indexes written by older versions start with entries, not a header
+	uint32_t entries[] = { 100, 4096, 200, 8192, 300, 12288 };
+	TEST_ASSERT_TRUE(Storage::writeFile(TimeIndex::indexPath(data_path), (const uint8_t*)entries, sizeof(entries)));
+	uint32_t generation, started;
+	TEST_ASSERT_FALSE(TimeIndex::getHeader(data_path, generation, started));
+}
+
+void test_time_round_trip() {
+	uint32_t seconds = 0;
+	TEST_ASSERT_TRUE(TimeIndex::parseTime("06-10-2024 13:45:09,21.5,40", seconds));
+	TEST_ASSERT_EQUAL_STRING("06-10-2024 13:45:09", TimeIndex::formatTime(seconds).c_str());
+	TEST_ASSERT_FALSE(TimeIndex::parseTime("Time,Temperature", seconds));
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_no_index_covers_whole_file);
+	RUN_TEST(test_range_between_entries);
+	RUN_TEST(test_range_at_entry_times);
+	RUN_TEST(test_range_with_many_entries);
+	RUN_TEST(test_header_and_cursor);
+	RUN_TEST(test_index_without_header_is_rejected);
+	RUN_TEST(test_time_round_trip);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,303 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <LittleFS.h>
+#include <UploadStream.h>
+#include <zlib.h>
+
+/// @brief gzip header flags
+enum : uint8_t {
+	FHCRC = 0x02,
+	FEXTRA = 0x04,
+	FNAME = 0x08,
+	FCOMMENT = 0x10
+};
+
+/// @brief Makes compressible data, larger than the inflater's window
+/// @param size The size in bytes
+/// @return The data
+static std::vector<uint8_t> makeData(size_t size) {
+	std::vector<uint8_t> data;
+	uint32_t seed = 1;
+	while (data.size() < size) {
+		seed = seed * 1103515245 + 12345;
+		String row = "06-10-2024 13:45:" + String((seed >> 16) % 60) + "," + String((seed >> 8) % 1000) + "\n";
+		data.insert(data.end(), row.begin(), row.end());
+	}
+	data.resize(size);
+	return data;
+}
+
+/// @brief Compresses data into a gzip stream
+/// @param data The data
+/// @param flags The optional header fields to include
+/// @return The gzip stream
+static std::vector<uint8_t> gzip(const std::vector<uint8_t>& data, uint8_t flags) {
+	std::vector<uint8_t> out = { 0x1F, 0x8B, 8, flags, 0, 0, 0, 0, 2, 3 };
+	if (flags & FEXTRA) {
+		const uint8_t extra[] = { 5, 0, 'A', 'B', 3, 0, 1 };
+		out.insert(out.end(), extra, extra + sizeof(extra));
+	}
+	if (flags & FNAME) {
+		const char name[] = "firmware.bin";
+		out.insert(out.end(), name, name + sizeof(name));
+	}
+	if (flags & FCOMMENT) {
+		const char comment[] = "built for testing";
+		out.insert(out.end(), comment, comment + sizeof(comment));
+	}
+	if (flags & FHCRC) {
+		uint16_t crc = crc32(0, out.data(), out.size()) & 0xFFFF;
+		out.push_back(crc & 0xFF);
+		out.push_back(crc >> 8);
+	}
+	z_stream z = {};
+	deflateInit2(&z, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+	std::vector<uint8_t> compressed(deflateBound(&z, data.size()));
+	z.next_in = (Bytef*)data.data();
+	z.avail_in = data.size();
+	z.next_out = compressed.data();
+	z.avail_out = compressed.size();
+	deflate(&z, Z_FINISH);
+	compressed.resize(z.total_out);
+	deflateEnd(&z);
+	out.insert(out.end(), compressed.begin(), compressed.end());
+	uint32_t trailer[] = { (uint32_t)crc32(0, data.data(), data.size()), (uint32_t)data.size() };
+	out.insert(out.end(), (uint8_t*)trailer, (uint8_t*)trailer + sizeof(trailer));
+	return out;
+}
+
+/// @brief Uploads data to a file through UploadStream
+/// @param request The request of the upload
+/// @param data The uploaded bytes
+/// @param chunk The size of the chunks the upload arrives in
+/// @param inflate True to inflate the upload
+/// @return True if the upload succeeded
+static bool upload(AsyncWebServerRequest& request, std::vector<uint8_t> data, size_t chunk, bool inflate) {
+	request._tempFile = LittleFS.open("/upload.bin", FILE_WRITE, true);
+	request.setContentLength(data.size());
+	bool success = UploadStream::begin(&request, UploadStream::Sink::File, "test", inflate);
+	for (size_t i = 0; success && i < data.size(); i += chunk) {
+		success = UploadStream::write(&request, data.data() + i, std::min(chunk, data.size() - i));
+	}
+	success = UploadStream::end(&request) && success;
+	request._tempFile.close();
+	return success;
+}
+
+/// @brief Reads back the uploaded file
+/// @return The contents of the file
+static std::vector<uint8_t> uploaded() {
+	File file = LittleFS.open("/upload.bin");
+	std::vector<uint8_t> data(file.size());
+	file.read(data.data(), data.size());
+	file.close();
+	return data;
+}
+
+void setUp() {
+	HostTest::resetStorage();
+	LittleFS.begin(true);
+}
+
+void tearDown() {}
+
+void test_plain_upload() {
+	std::vector<uint8_t> data = makeData(10000);
+	AsyncWebServerRequest request(HTTP_POST, "/upload");
+	TEST_ASSERT_TRUE(upload(request, data, 1460, false));
+	TEST_ASSERT_EQUAL(201, UploadStream::getStatus(&request));
+	TEST_ASSERT_TRUE(uploaded() == data);
+}
+
+void test_gzip_header_fields() {
+	std::vector<uint8_t> data = makeData(100000);
+	const uint8_t flag_sets[] = { 0, FNAME, FEXTRA | FNAME | FCOMMENT | FHCRC, FHCRC, FEXTRA | FCOMMENT };
+	for (uint8_t flags : flag_sets) {
+		std::vector<uint8_t> compressed = gzip(data, flags);
+		// Fed a byte at a time, every header field is split across chunks
+		for (size_t chunk : { (size_t)1, (size_t)3, (size_t)1460, compressed.size() }) {
+			AsyncWebServerRequest request(HTTP_POST, "/upload");
+			TEST_ASSERT_TRUE_MESSAGE(upload(request, compressed, chunk, true), UploadStream::getMessage(&request).c_str());
+			TEST_ASSERT_EQUAL(201, UploadStream::getStatus(&request));
+			TEST_ASSERT_TRUE(uploaded() == data);
+		}
+	}
+}
+
+void test_not_gzip() {
+	AsyncWebServerRequest request(HTTP_POST, "/upload");
+	TEST_ASSERT_FALSE(upload(request, makeData(1000), 100, true));
+	TEST_ASSERT_EQUAL(400, UploadStream::getStatus(&request));
+	TEST_ASSERT_EQUAL_STRING("Upload isn't gzip compressed", UploadStream::getMessage(&request).c_str());
+}
+
+void test_truncated_and_corrupt_gzip() {
+	std::vector<uint8_t> compressed = gzip(makeData(50000), FNAME);
+	std::vector<uint8_t> truncated(compressed.begin(), compressed.begin() + compressed.size() / 2);
+	AsyncWebServerRequest request(HTTP_POST, "/upload");
+	TEST_ASSERT_FALSE(upload(request, truncated, 512, true));
+	TEST_ASSERT_EQUAL_STRING("Compressed upload is incomplete", UploadStream::getMessage(&request).c_str());
+	std::vector<uint8_t> corrupt = compressed;
+	for (size_t i = 30; i < 60; i++) {
+		corrupt[i] = 0xFF;
+	}
+	AsyncWebServerRequest corrupted(HTTP_POST, "/upload");
+	TEST_ASSERT_FALSE(upload(corrupted, corrupt, 512, true));
+	TEST_ASSERT_EQUAL(400, UploadStream::getStatus(&corrupted));
+}
+
+void test_hash_check() {
+	std::vector<uint8_t> data = makeData(5000);
+	std::vector<uint8_t> compressed = gzip(data, 0);
+	// The hash is of the bytes uploaded, before they are inflated
+	uint8_t hash[32];
+	mbedtls_sha256_context sha;
+	mbedtls_sha256_init(&sha);
+	mbedtls_sha256_starts(&sha, 0);
+	mbedtls_sha256_update(&sha, compressed.data(), compressed.size());
+	mbedtls_sha256_finish(&sha, hash);
+	mbedtls_sha256_free(&sha);
+	char hex[65];
+	for (int i = 0; i < 32; i++) {
+		snprintf(hex + i * 2, 3, "%02x", hash[i]);
+	}
+	AsyncWebServerRequest request(HTTP_POST, "/upload");
+	request.receiveHeader("X-SHA256", hex);
+	request.addInterestingHeader("X-SHA256");
+	request.parseHeaders();
+	TEST_ASSERT_TRUE(upload(request, compressed, 700, true));
+	hex[0] = hex[0] == '0' ? '1' : '0';
+	AsyncWebServerRequest mismatched(HTTP_POST, "/upload");
+	mismatched.receiveHeader("X-SHA256", hex);
+	mismatched.addInterestingHeader("X-SHA256");
+	mismatched.parseHeaders();
+	TEST_ASSERT_FALSE(upload(mismatched, compressed, 700, true));
+	TEST_ASSERT_EQUAL_STRING("SHA-256 hash doesn't match", UploadStream::getMessage(&mismatched).c_str());
+}
+
+void test_compressed_delta_to_firmware() {
+	std::vector<uint8_t> running = makeData(20000);
+	HostTest::setRunningFirmware(running);
+	std::vector<uint8_t> target(running.begin() + 10000, running.end());
+	target.insert(target.end(), { 'n', 'e', 'w' });
+	// Copy the second half of the running firmware, then insert three bytes
+	uint8_t hash[32];
+	mbedtls_sha256_context sha;
+	mbedtls_sha256_init(&sha);
+	mbedtls_sha256_starts(&sha, 0);
+	mbedtls_sha256_update(&sha, running.data(), running.size());
+	mbedtls_sha256_finish(&sha, hash);
+	mbedtls_sha256_free(&sha);
+	std::vector<uint8_t> delta = { 'S', 'H', 'D', '1' };
+	uint32_t sizes[] = { (uint32_t)running.size(), (uint32_t)target.size() };
+	delta.insert(delta.end(), (uint8_t*)&sizes[0], (uint8_t*)&sizes[0] + 4);
+	delta.insert(delta.end(), hash, hash + 32);
+	delta.insert(delta.end(), (uint8_t*)&sizes[1], (uint8_t*)&sizes[1] + 4);
+	const uint8_t operations[] = { 1, 0x10, 0x27, 0, 0, 0x10, 0x27, 0, 0, 2, 3, 0, 0, 0, 'n', 'e', 'w' };
+	delta.insert(delta.end(), operations, operations + sizeof(operations));
+	std::vector<uint8_t> compressed = gzip(delta, FNAME);
+	AsyncWebServerRequest request(HTTP_POST, "/update");
+	TEST_ASSERT_TRUE(Update.begin(UPDATE_SIZE_UNKNOWN));
+	TEST_ASSERT_TRUE(UploadStream::begin(&request, UploadStream::Sink::Firmware, "firmware", true, true));
+	for (size_t i = 0; i < compressed.size(); i += 9) {
+		TEST_ASSERT_TRUE(UploadStream::write(&request, compressed.data() + i, std::min((size_t)9, compressed.size() - i)));
+	}
+	TEST_ASSERT_TRUE(UploadStream::end(&request));
+	TEST_ASSERT_TRUE(Update.end(true));
+	TEST_ASSERT_TRUE(HostTest::updateWritten() == target);
+}
+
+void test_progress() {
+	AsyncWebServerRequest request(HTTP_POST, "/upload");
+	request.receiveHeader("X-Upload-Id", "abc");
+	request.addInterestingHeader("X-Upload-Id");
+	request.parseHeaders();
+	TEST_ASSERT_TRUE(upload(request, makeData(10000), 1000, false));
+	String progress = UploadStream::getProgress("abc");
+	TEST_ASSERT_TRUE(progress.indexOf("\"received\":10000") >= 0);
+	TEST_ASSERT_TRUE(progress.indexOf("\"written\":10000") >= 0);
+	TEST_ASSERT_TRUE(progress.indexOf("\"finished\":true") >= 0);
+	TEST_ASSERT_EQUAL_STRING("{}", UploadStream::getProgress("other").c_str());
+}
+
+void test_interleaved_uploads() {
+	// Two uploads on separate requests, their chunks arriving in turn as two connections would deliver them
+	std::vector<uint8_t> plain = makeData(30000);
+	std::vector<uint8_t> data = makeData(60000);
+	std::vector<uint8_t> compressed = gzip(data, FNAME);
+	AsyncWebServerRequest first(HTTP_POST, "/upload");
+	AsyncWebServerRequest second(HTTP_POST, "/upload");
+	first._tempFile = LittleFS.open("/first.bin", FILE_WRITE, true);
+	second._tempFile = LittleFS.open("/second.bin", FILE_WRITE, true);
+	first.setContentLength(plain.size());
+	second.setContentLength(compressed.size());
+	TEST_ASSERT_TRUE(UploadStream::begin(&first, UploadStream::Sink::File, "first", false));
+	TEST_ASSERT_TRUE(UploadStream::begin(&second, UploadStream::Sink::File, "second", true));
+	size_t sent_first = 0;
+	size_t sent_second = 0;
+	while (sent_first < plain.size() || sent_second < compressed.size()) {
+		if (sent_first < plain.size()) {
+			size_t len = std::min((size_t)1000, plain.size() - sent_first);
+			TEST_ASSERT_TRUE(UploadStream::write(&first, plain.data() + sent_first, len));
+			sent_first += len;
+		}
+		if (sent_second < compressed.size()) {
+			size_t len = std::min((size_t)700, compressed.size() - sent_second);
+			TEST_ASSERT_TRUE(UploadStream::write(&second, compressed.data() + sent_second, len));
+			sent_second += len;
+		}
+	}
+	TEST_ASSERT_TRUE(UploadStream::end(&second));
+	TEST_ASSERT_TRUE(UploadStream::end(&first));
+	first._tempFile.close();
+	second._tempFile.close();
+	TEST_ASSERT_EQUAL(201, UploadStream::getStatus(&first));
+	TEST_ASSERT_EQUAL(201, UploadStream::getStatus(&second));
+	File file = LittleFS.open("/first.bin");
+	std::vector<uint8_t> written(file.size());
+	file.read(written.data(), written.size());
+	file.close();
+	TEST_ASSERT_TRUE(written == plain);
+	file = LittleFS.open("/second.bin");
+	written.resize(file.size());
+	file.read(written.data(), written.size());
+	file.close();
+	TEST_ASSERT_TRUE(written == data);
+	// Each is reported under its own ID
+	TEST_ASSERT_TRUE(UploadStream::getProgress("first").indexOf("\"written\":30000") >= 0);
+	TEST_ASSERT_TRUE(UploadStream::getProgress("second").indexOf("\"written\":60000") >= 0);
+}
+
+void test_small_chunks_are_written_in_pages() {
+	// 64 byte chunks are collected into 4096 byte pages, with the rest written at the end
+	AsyncWebServerRequest request(HTTP_POST, "/upload");
+	request.receiveHeader("X-Upload-Id", "small");
+	request.addInterestingHeader("X-Upload-Id");
+	request.parseHeaders();
+	std::vector<uint8_t> data = makeData(10 * 4096 + 100);
+	TEST_ASSERT_TRUE(upload(request, data, 64, false));
+	TEST_ASSERT_TRUE(uploaded() == data);
+	TEST_ASSERT_TRUE(UploadStream::getProgress("small").indexOf("\"writes\":11,") >= 0);
+	// Chunks of whole pages are written as they arrive
+	AsyncWebServerRequest pages(HTTP_POST, "/upload");
+	pages.receiveHeader("X-Upload-Id", "pages");
+	pages.addInterestingHeader("X-Upload-Id");
+	pages.parseHeaders();
+	TEST_ASSERT_TRUE(upload(pages, makeData(8 * 4096), 2 * 4096, false));
+	TEST_ASSERT_TRUE(UploadStream::getProgress("pages").indexOf("\"writes\":4,") >= 0);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_plain_upload);
+	RUN_TEST(test_gzip_header_fields);
+	RUN_TEST(test_not_gzip);
+	RUN_TEST(test_truncated_and_corrupt_gzip);
+	RUN_TEST(test_hash_check);
+	RUN_TEST(test_compressed_delta_to_firmware);
+	RUN_TEST(test_progress);
+	RUN_TEST(test_interleaved_uploads);
+	RUN_TEST(test_small_chunks_are_written_in_pages);
+	HostTest::finish(UNITY_END());
+}
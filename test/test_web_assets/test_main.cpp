@@ -0,0 +1,126 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <WebAssets.h>
+#include <WebBundle.h>
+#include <zlib.h>
+
+/// @brief Creates a GET request carrying an If-None-Match header that has already been parsed
+/// @param tags The value of the header
+/// @return The request
+static AsyncWebServerRequest* conditionalRequest(String tags) {
+	AsyncWebServerRequest* request = new AsyncWebServerRequest(HTTP_GET, "/app.js");
+	request->receiveHeader("If-None-Match", tags);
+	request->addInterestingHeader("If-None-Match");
+	request->parseHeaders();
+	return request;
+}
+
+void setUp() {
+	HostTest::resetStorage();
+}
+
+void tearDown() {}
+
+void test_no_header_is_modified() {
+	AsyncWebServerRequest request(HTTP_GET, "/app.js");
+	TEST_ASSERT_FALSE(WebAssets::notModified(&request, "\"abc\""));
+	TEST_ASSERT_NULL(request.response());
+}
+
+void test_matching_tag_sends_304() {
+	AsyncWebServerRequest* request = conditionalRequest("\"abc\"");
+	TEST_ASSERT_TRUE(WebAssets::notModified(request, "\"abc\"", "public, max-age=60"));
+	TEST_ASSERT_NOT_NULL(request->response());
+	TEST_ASSERT_EQUAL(304, request->response()->code);
+	TEST_ASSERT_EQUAL_STRING("\"abc\"", request->response()->header("ETag").c_str());
+	TEST_ASSERT_EQUAL_STRING("public, max-age=60", request->response()->header("Cache-Control").c_str());
+	delete request;
+}
+
+void test_different_tag_is_modified() {
+	AsyncWebServerRequest* request = conditionalRequest("\"abd\"");
+	TEST_ASSERT_FALSE(WebAssets::notModified(request, "\"abc\""));
+	TEST_ASSERT_NULL(request->response());
+	delete request;
+}
+
+void test_weak_tags_compare_weakly() {
+	AsyncWebServerRequest* request = conditionalRequest("W/\"12-34\"");
+	TEST_ASSERT_TRUE(WebAssets::notModified(request, "\"12-34\""));
+	delete request;
+	request = conditionalRequest("\"12-34\"");
+	TEST_ASSERT_TRUE(WebAssets::notModified(request, "W/\"12-34\""));
+	TEST_ASSERT_EQUAL_STRING("W/\"12-34\"", request->response()->header("ETag").c_str());
+	delete request;
+}
+
+void test_tag_list_and_wildcard() {
+	AsyncWebServerRequest* request = conditionalRequest("\"old\", W/\"older\" ,  \"abc\"");
+	TEST_ASSERT_TRUE(WebAssets::notModified(request, "\"abc\""));
+	delete request;
+	request = conditionalRequest("\"old\",\"older\"");
+	TEST_ASSERT_FALSE(WebAssets::notModified(request, "\"abc\""));
+	delete request;
+	request = conditionalRequest("*");
+	TEST_ASSERT_TRUE(WebAssets::notModified(request, "\"abc\""));
+	delete request;
+}
+
+void test_handler_keeps_if_none_match() {
+	TEST_ASSERT_TRUE(Storage::begin());
+	TEST_ASSERT_TRUE(Storage::writeFile("/www/assets.json", "{\"assets\":{\"/app.js\":{\"file\":\"app.1a2b.js.gz\",\"etag\":\"1a2b\",\"type\":\"text/javascript\",\"immutable\":true}}}"));
+	TEST_ASSERT_TRUE(Storage::writeFile("/www/app.1a2b.js.gz", "not really gzip"));
+	WebAssets assets("/www");
+	TEST_ASSERT_TRUE(assets.begin());
+	AsyncWebServer server(80);
+	server.addHandler(&assets);
+	// The header only reaches the handler if canHandle() asked for it before the headers were parsed
+	AsyncWebServerRequest request(HTTP_GET, "/app.js");
+	request.receiveHeader("If-None-Match", "\"1a2b\"");
+	TEST_ASSERT_TRUE(server.handle(&request) == &assets);
+	TEST_ASSERT_EQUAL(304, request.response()->code);
+	TEST_ASSERT_EQUAL_STRING("public, max-age=31536000, immutable", request.response()->header("Cache-Control").c_str());
+	AsyncWebServerRequest stale(HTTP_GET, "/app.js");
+	stale.receiveHeader("If-None-Match", "\"0000\"");
+	server.handle(&stale);
+	TEST_ASSERT_EQUAL(200, stale.response()->code);
+	TEST_ASSERT_EQUAL_STRING("gzip", stale.response()->header("Content-Encoding").c_str());
+	TEST_ASSERT_EQUAL_STRING("\"1a2b\"", stale.response()->header("ETag").c_str());
+}
+
+void test_bundle_is_smaller_gzipped() {
+	// The web interface as built into the firmware, each file gzipped by tools/build_www.py
+	size_t raw_total = 0;
+	size_t gzip_total = 0;
+	for (size_t i = 0; i < WebBundle::count; i++) {
+		const WebBundle::entry& e = WebBundle::entries[i];
+		std::vector<uint8_t> raw(64 * 1024);
+		z_stream z = {};
+		TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&z, 16 + MAX_WBITS));
+		z.next_in = (Bytef*)e.data;
+		z.avail_in = e.length;
+		z.next_out = raw.data();
+		z.avail_out = raw.size();
+		TEST_ASSERT_EQUAL_MESSAGE(Z_STREAM_END, inflate(&z, Z_FINISH), e.url);
+		TEST_ASSERT_EQUAL(e.length, z.total_in);
+		raw_total += z.total_out;
+		gzip_total += e.length;
+		inflateEnd(&z);
+	}
+	TEST_MESSAGE((String(WebBundle::count) + " files: " + String(raw_total) + " bytes, " + String(gzip_total) + " bytes gzipped, " + String(100 - gzip_total * 100 / raw_total) + "% saved").c_str());
+	TEST_ASSERT_GREATER_THAN(0, WebBundle::count);
+	TEST_ASSERT_LESS_THAN(raw_total / 2, gzip_total);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_no_header_is_modified);
+	RUN_TEST(test_matching_tag_sends_304);
+	RUN_TEST(test_different_tag_is_modified);
+	RUN_TEST(test_weak_tags_compare_weakly);
+	RUN_TEST(test_tag_list_and_wildcard);
+	RUN_TEST(test_handler_keeps_if_none_match);
+	RUN_TEST(test_bundle_is_smaller_gzipped);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <LocalServer.h>
+#include <ConnectionPool.h>
+#include <Webhook.h>
+
+/// @brief The server webhooks are sent to
+static LocalServer* server;
+
+void setUp() {
+	HostTest::setWiFiConnected(true);
+	server = new LocalServer();
+	TEST_ASSERT_TRUE(server->start());
+}
+
+void tearDown() {
+	// Pooled connections to the server are found closed and dropped by the next test
+	delete server;
+}
+
+void test_key_for() {
+	TEST_ASSERT_EQUAL_STRING("http://example.com:80", ConnectionPool::keyFor("http://example.com/hook?a=1").c_str());
+	TEST_ASSERT_EQUAL_STRING("https://example.com:443", ConnectionPool::keyFor("https://example.com").c_str());
+	TEST_ASSERT_EQUAL_STRING("https://example.com:8443", ConnectionPool::keyFor("https://example.com:8443/a/b").c_str());
+	TEST_ASSERT_EQUAL_STRING("http://example.com:80", ConnectionPool::keyFor("HTTP://Example.COM/Path").c_str());
+	TEST_ASSERT_EQUAL_STRING("http://example.com:80", ConnectionPool::keyFor("example.com/hook").c_str());
+	// Credentials don't make a different server, and an @ in the path isn't taken for them
+	TEST_ASSERT_EQUAL_STRING("http://example.com:8080", ConnectionPool::keyFor("http://user:p@ss@example.com:8080/hook").c_str());
+	TEST_ASSERT_EQUAL_STRING("http://example.com:80", ConnectionPool::keyFor("http://example.com/users/@me").c_str());
+	// Different schemes to the same host aren't shared
+	TEST_ASSERT_NOT_EQUAL(ConnectionPool::keyFor("http://example.com:443"), ConnectionPool::keyFor("https://example.com"));
+}
+
+void test_requests_share_a_connection() {
+	Webhook first(server->url("/first"));
+	Webhook second(server->url("/second"));
+	for (int i = 0; i < 3; i++) {
+		TEST_ASSERT_EQUAL_STRING("{\"code\":200,\"response\":\"ok\"}", first.getRequest().c_str());
+		TEST_ASSERT_EQUAL_STRING("{\"code\":200,\"response\":\"ok\"}", second.postRequest("{\"a\":1}").c_str());
+	}
+	auto requests = server->requests();
+	TEST_ASSERT_EQUAL(6, requests.size());
+	TEST_ASSERT_EQUAL(1, server->connections());
+	TEST_ASSERT_EQUAL_STRING("GET", requests[0].method.c_str());
+	TEST_ASSERT_EQUAL_STRING("/first", requests[0].path.c_str());
+	TEST_ASSERT_EQUAL_STRING("POST", requests[1].method.c_str());
+	TEST_ASSERT_EQUAL_STRING("/second", requests[1].path.c_str());
+	TEST_ASSERT_EQUAL_STRING("{\"a\":1}", requests[1].body.c_str());
+	TEST_ASSERT_EQUAL_STRING("keep-alive", requests[5].headers["connection"].c_str());
+}
+
+void test_connection_closed_by_server() {
+	server->respond(200, "ok", false);
+	Webhook hook(server->url("/hook"));
+	for (int i = 0; i < 3; i++) {
+		TEST_ASSERT_EQUAL_STRING("{\"code\":200,\"response\":\"ok\"}", hook.getRequest().c_str());
+	}
+	TEST_ASSERT_EQUAL(3, server->connections());
+	// Once the server keeps connections open again, the next connection is reused
+	server->respond(200, "ok");
+	hook.getRequest();
+	hook.getRequest();
+	TEST_ASSERT_EQUAL(4, server->connections());
+}
+
+void test_truncated_response_keeps_connection() {
+	server->respond(200, "0123456789");
+	Webhook hook(server->url("/hook"), {}, 1, "", "application/json", 4);
+	TEST_ASSERT_EQUAL_STRING("{\"code\":200,\"response\":\"0123\",\"truncated\":true}", hook.getRequest().c_str());
+	// The rest of the body was read, so the next response is read from its start
+	server->respond(500, "error");
+	TEST_ASSERT_EQUAL_STRING("{\"code\":500,\"response\":\"erro\",\"truncated\":true}", hook.getRequest().c_str());
+	TEST_ASSERT_EQUAL(1, server->connections());
+}
+
+void test_credentials_are_not_reused() {
+	String url = server->url("/hook");
+	Webhook secured(url.substring(0, 7) + "user:secret@" + url.substring(7));
+	Webhook open(url);
+	secured.getRequest();
+	open.getRequest();
+	auto requests = server->requests();
+	TEST_ASSERT_EQUAL(2, requests.size());
+	TEST_ASSERT_EQUAL(1, server->connections());
+	TEST_ASSERT_EQUAL_STRING("Basic dXNlcjpzZWNyZXQ=", requests[0].headers["authorization"].c_str());
+	TEST_ASSERT_TRUE(requests[1].headers.count("authorization") == 0);
+}
+
+void test_sockets_are_capped() {
+	// One more server than the pool has sockets for
+	std::vector<std::unique_ptr<LocalServer>> others;
+	for (int i = 0; i < 4; i++) {
+		others.emplace_back(new LocalServer());
+		TEST_ASSERT_TRUE(others.back()->start());
+	}
+	Webhook hook(server->url("/hook"));
+	hook.getRequest();
+	for (auto& other : others) {
+		Webhook(other->url("/hook")).getRequest();
+	}
+	// The connection idle the longest was closed to make room
+	hook.getRequest();
+	TEST_ASSERT_EQUAL(2, server->connections());
+	for (auto& other : others) {
+		TEST_ASSERT_EQUAL(1, other->connections());
+	}
+}
+
+void test_server_down() {
+	String url = server->url("/hook");
+	server->stop();
+	Webhook hook(url);
+	TEST_ASSERT_EQUAL_STRING("{\"code\":-1,\"response\":\"fail\"}", hook.getRequest().c_str());
+}
+
+void test_pooled_requests_are_faster() {
+	const int requests = 200;
+	// As webhooks were sent before pooling, with a new connection for each request
+	ulong start = micros();
+	for (int i = 0; i < requests; i++) {
+		WiFiClient client;
+		HTTPClient http;
+		http.setReuse(false);
+		TEST_ASSERT_TRUE(http.begin(client, server->url("/hook")));
+		TEST_ASSERT_EQUAL(200, http.GET());
+		TEST_ASSERT_EQUAL_STRING("ok", http.getString().c_str());
+		http.end();
+	}
+	ulong unpooled = micros() - start;
+	TEST_ASSERT_EQUAL(requests, server->connections());
+	Webhook hook(server->url("/hook"));
+	start = micros();
+	for (int i = 0; i < requests; i++) {
+		TEST_ASSERT_EQUAL_STRING("{\"code\":200,\"response\":\"ok\"}", hook.getRequest().c_str());
+	}
+	ulong pooled = micros() - start;
+	TEST_ASSERT_EQUAL(requests + 1, server->connections());
+	TEST_MESSAGE(("Unpooled: " + String(unpooled / requests) + "us per request, pooled: " + String(pooled / requests) + "us per request").c_str());
+	// Over loopback the handshake is the cheapest it will ever be, over WiFi and TLS the difference is far larger
+	TEST_ASSERT_LESS_THAN(unpooled, pooled);
+}
+
+int main(int argc, char **argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_key_for);
+	RUN_TEST(test_requests_share_a_connection);
+	RUN_TEST(test_connection_closed_by_server);
+	RUN_TEST(test_truncated_response_keeps_connection);
+	RUN_TEST(test_credentials_are_not_reused);
+	RUN_TEST(test_sockets_are_capped);
+	RUN_TEST(test_server_down);
+	RUN_TEST(test_pooled_requests_are_faster);
+	HostTest::finish(UNITY_END());
+}
@@ -0,0 +1,280 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <HostTest.h>
+#include <LocalServer.h>
+#include <WebhookManager.h>
+
+/// @brief A sensor with a fixed reading, for templated requests
+class FakeSensor : public Sensor {
+	public:
+		FakeSensor() {
+			Description = { .parameterQuantity = 1, .type = "Fake", .name = "Fake Sensor", .parameters = { "Temperature" }, .units = { "C" }, .id = 0 };
+			values = { 21.5 };
+		}
+
+		bool begin() override {
+			return true;
+		}
+
+		bool takeMeasurement() override {
+			return true;
+		}
+};
+
+/// @brief The sensor templates are rendered from
+static FakeSensor sensor;
+
+/// @brief The servers webhooks are sent to
+static LocalServer* servers[2];
+
+/// @brief The outcome of a queued request
+typedef struct outcome {
+	String status;
+	int attempts;
+	int code;
+	String response;
+} outcome;
+
+/// @brief Gets the outcome of a queued request
+/// @param id The ID of the request
+/// @return The outcome, with an empty status if the request isn't known
+static outcome getOutcome(int64_t id) {
+	String result = WebhookManager::getResult(id);
+	if (result.isEmpty()) {
+		return { .status = "", .attempts = 0, .code = 0, .response = "" };
+	}
+	JsonDocument doc;
+	TEST_ASSERT_FALSE(deserializeJson(doc, result));
+	return { .status = doc["status"].as<String>(), .attempts = doc["attempts"], .code = doc["code"], .response = doc["response"].as<String>() };
+}
+
+/// @brief Waits for a queued request to finish
+/// @param id The ID of the request
+/// @param timeout The time in ms to wait
+/// @return The outcome of the request
+static outcome waitForOutcome(int64_t id, ulong timeout = 3000) {
+	ulong start = millis();
+	outcome o = getOutcome(id);
+	while (o.status != "done" && o.status != "failed" && millis() - start < timeout) {
+		delay(10);
+		o = getOutcome(id);
+	}
+	return o;
+}
+
+/// @brief Points the webhooks at the servers
+/// @param extra Extra settings for each webhook, as JSON members
+static void configure(String extra = "") {
+	String hooks = "{\"hooks\":[";
+	for (int i = 0; i < 2; i++) {
+		hooks += String(i == 0 ? "" : ",") + "{\"url\":\"" + servers[i]->url("/hook" + String(i)) + "\"" + extra + "}";
+	}
+	TEST_ASSERT_TRUE(WebhookManager::updateWebhooks(hooks + "]}"));
+}
+
+void setUp() {
+	HostTest::setWiFiConnected(true);
+	for (auto& server : servers) {
+		server = new LocalServer();
+		TEST_ASSERT_TRUE(server->start());
+	}
+	configure();
+}
+
+void tearDown() {
+	for (auto& server : servers) {
+		delete server;
+	}
+}
+
+void test_queued_request_is_sent() {
+	TEST_ASSERT_EQUAL(-1, WebhookManager::queueRequest(2, Webhook::Method::GET, "", false));
+	int64_t id = WebhookManager::queueRequest(0, Webhook::Method::GET, "{\"a\":\"1 2\"}", false);
+	TEST_ASSERT_GREATER_OR_EQUAL(0, id);
+	outcome o = waitForOutcome(id);
+	TEST_ASSERT_EQUAL_STRING("done", o.status.c_str());
+	TEST_ASSERT_EQUAL(1, o.attempts);
+	TEST_ASSERT_EQUAL(200, o.code);
+	TEST_ASSERT_EQUAL_STRING("ok", o.response.c_str());
+	auto requests = servers[0]->requests();
+	TEST_ASSERT_EQUAL(1, requests.size());
+	TEST_ASSERT_EQUAL_STRING("/hook0?a=1%202", requests[0].path.c_str());
+	TEST_ASSERT_TRUE(servers[1]->requests().empty());
+	// Unknown requests have no outcome
+	TEST_ASSERT_EQUAL_STRING("", WebhookManager::getResult(id + 1000).c_str());
+}
+
+void test_server_errors_are_retried_with_backoff() {
+	servers[0]->respondNext(503, "busy");
+	servers[0]->respondNext(429, "slow down");
+	servers[0]->respondNext(500, "error");
+	int64_t id = WebhookManager::queueRequest(0, Webhook::Method::POST, "{\"a\":1}", true);
+	TEST_ASSERT_TRUE(servers[0]->waitForRequests(1, 1000));
+	// The result of the failed attempt is kept while waiting to retry
+	delay(100);
+	outcome waiting = getOutcome(id);
+	TEST_ASSERT_EQUAL_STRING("retrying", waiting.status.c_str());
+	TEST_ASSERT_EQUAL(503, waiting.code);
+	TEST_ASSERT_EQUAL_STRING("busy", waiting.response.c_str());
+	outcome o = waitForOutcome(id, 10000);
+	TEST_ASSERT_EQUAL_STRING("done", o.status.c_str());
+	TEST_ASSERT_EQUAL(4, o.attempts);
+	auto requests = servers[0]->requests();
+	TEST_ASSERT_EQUAL(4, requests.size());
+	// Each retry waits twice as long as the last, starting at a second
+	for (int i = 1; i < 4; i++) {
+		ulong gap = requests[i].time - requests[i - 1].time;
+		ulong wait = 1000 << (i - 1);
+		TEST_ASSERT_GREATER_OR_EQUAL(wait, gap);
+		TEST_ASSERT_LESS_THAN(wait + 500, gap);
+		TEST_ASSERT_EQUAL_STRING("{\"a\":1}", requests[i].body.c_str());
+	}
+}
+
+void test_retries_stop() {
+	// Errors the client made aren't retried
+	servers[0]->respondNext(404, "missing");
+	outcome o = waitForOutcome(WebhookManager::queueRequest(0, Webhook::Method::GET, "", false));
+	TEST_ASSERT_EQUAL_STRING("failed", o.status.c_str());
+	TEST_ASSERT_EQUAL(1, o.attempts);
+	TEST_ASSERT_EQUAL(404, o.code);
+	// Nor are requests that keep failing, after the last attempt
+	servers[1]->respond(502, "bad gateway");
+	o = waitForOutcome(WebhookManager::queueRequest(1, Webhook::Method::GET, "", false), 10000);
+	TEST_ASSERT_EQUAL_STRING("failed", o.status.c_str());
+	TEST_ASSERT_EQUAL(4, o.attempts);
+	TEST_ASSERT_EQUAL(502, o.code);
+	delay(500);
+	TEST_ASSERT_EQUAL(4, servers[1]->requests().size());
+}
+
+void test_connection_errors_are_retried() {
+	// The server closes the connection without responding
+	servers[0]->respondNext(0);
+	int64_t id = WebhookManager::queueRequest(0, Webhook::Method::GET, "", false);
+	TEST_ASSERT_TRUE(servers[0]->waitForRequests(1, 1000));
+	delay(100);
+	outcome waiting = getOutcome(id);
+	TEST_ASSERT_EQUAL_STRING("retrying", waiting.status.c_str());
+	TEST_ASSERT_LESS_THAN(0, waiting.code);
+	outcome o = waitForOutcome(id);
+	TEST_ASSERT_EQUAL_STRING("done", o.status.c_str());
+	TEST_ASSERT_EQUAL(2, o.attempts);
+	TEST_ASSERT_EQUAL(2, servers[0]->connections());
+}
+
+void test_concurrency_is_limited_per_webhook() {
+	TEST_ASSERT_TRUE(WebhookManager::updateWebhooks("{\"hooks\":[{\"url\":\"" + servers[0]->url("/one") + "\",\"maxConcurrent\":1},{\"url\":\"" + servers[1]->url("/two") + "\",\"maxConcurrent\":2}]}"));
+	for (auto& server : servers) {
+		server->setLatency(200);
+	}
+	std::vector<int64_t> ids;
+	for (int i = 0; i < 4; i++) {
+		ids.push_back(WebhookManager::queueRequest(0, Webhook::Method::GET, "", false));
+	}
+	ulong start = millis();
+	for (int64_t id : ids) {
+		TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(id).status.c_str());
+	}
+	// One at a time, even with another dispatcher free
+	TEST_ASSERT_GREATER_OR_EQUAL(4 * 200, millis() - start);
+	TEST_ASSERT_EQUAL(1, servers[0]->peakConcurrency());
+	ids.clear();
+	for (int i = 0; i < 4; i++) {
+		ids.push_back(WebhookManager::queueRequest(1, Webhook::Method::GET, "", false));
+	}
+	for (int64_t id : ids) {
+		TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(id).status.c_str());
+	}
+	TEST_ASSERT_EQUAL(2, servers[1]->peakConcurrency());
+}
+
+void test_full_queue_is_refused() {
+	servers[0]->setLatency(100);
+	std::vector<int64_t> ids;
+	int64_t refused = 0;
+	for (int i = 0; i < 24 && refused == 0; i++) {
+		int64_t id = WebhookManager::queueRequest(0, Webhook::Method::GET, "", false);
+		if (id < 0) {
+			refused = id;
+		} else {
+			ids.push_back(id);
+		}
+	}
+	// 16 wait to be sent, on top of any a dispatcher has already taken
+	TEST_ASSERT_EQUAL(-2, refused);
+	TEST_ASSERT_GREATER_OR_EQUAL(16, ids.size());
+	TEST_ASSERT_LESS_OR_EQUAL(18, ids.size());
+	// Everything accepted is sent, and then there's room again
+	for (int64_t id : ids) {
+		TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(id, 5000).status.c_str());
+	}
+	TEST_ASSERT_EQUAL(ids.size(), servers[0]->requests().size());
+	TEST_ASSERT_GREATER_OR_EQUAL(0, WebhookManager::queueRequest(0, Webhook::Method::GET, "", false));
+}
+
+void test_finished_results_are_evicted() {
+	// A request that's still being sent keeps its result
+	servers[1]->setLatency(3000);
+	int64_t slow = WebhookManager::queueRequest(1, Webhook::Method::GET, "", false);
+	TEST_ASSERT_TRUE(servers[1]->waitForRequests(1, 1000));
+	std::vector<int64_t> ids;
+	for (int batch = 0; batch < 4; batch++) {
+		for (int i = 0; i < 10; i++) {
+			ids.push_back(WebhookManager::queueRequest(0, Webhook::Method::GET, "", false));
+		}
+		TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(ids.back()).status.c_str());
+	}
+	TEST_ASSERT_EQUAL_STRING("sending", getOutcome(slow).status.c_str());
+	// Only the most recent 32 are kept, the oldest finished ones are forgotten first
+	size_t kept = 0;
+	for (size_t i = 0; i < ids.size(); i++) {
+		String status = getOutcome(ids[i]).status;
+		if (!status.isEmpty()) {
+			TEST_ASSERT_EQUAL_STRING("done", status.c_str());
+			kept++;
+		} else {
+			// Nothing newer than a kept result is forgotten
+			TEST_ASSERT_EQUAL(0, kept);
+		}
+	}
+	TEST_ASSERT_LESS_THAN(32, kept);
+	TEST_ASSERT_GREATER_OR_EQUAL(32 - 2, kept);
+	TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(slow, 5000).status.c_str());
+}
+
+void test_template_is_rendered_when_queued() {
+	TEST_ASSERT_TRUE(WebhookManager::updateWebhooks("{\"hooks\":[{\"url\":\"" + servers[0]->url("/t?v={{Temperature}}") + "\",\"body\":\"{\\\"t\\\":{{Temperature}}}\",\"bodyType\":\"application/json\"}]}"));
+	TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	servers[0]->setLatency(200);
+	// Keep the dispatcher busy, so the templated request waits in the queue
+	int64_t first = WebhookManager::queueRequest(0, Webhook::Method::GET, "", false);
+	int64_t id = WebhookManager::queueTemplate(0);
+	// Measurements taken after the request was queued don't change it
+	sensor.values[0] = 30;
+	TEST_ASSERT_TRUE(SensorManager::takeMeasurement());
+	TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(first).status.c_str());
+	TEST_ASSERT_EQUAL_STRING("done", waitForOutcome(id).status.c_str());
+	auto requests = servers[0]->requests();
+	TEST_ASSERT_EQUAL(2, requests.size());
+	TEST_ASSERT_EQUAL_STRING("POST", requests[1].method.c_str());
+	TEST_ASSERT_EQUAL_STRING("/t?v=21.5", requests[1].path.c_str());
+	TEST_ASSERT_EQUAL_STRING("{\"t\":21.5}", requests[1].body.c_str());
+	TEST_ASSERT_EQUAL_STRING("application/json", requests[1].headers["content-type"].c_str());
+	sensor.values[0] = 21.5;
+}
+
+int main(int argc, char **argv) {
+	SensorManager::addSensor(&sensor);
+	WebhookManager::begin("webhooks.json");
+	UNITY_BEGIN();
+	RUN_TEST(test_queued_request_is_sent);
+	RUN_TEST(test_server_errors_are_retried_with_backoff);
+	RUN_TEST(test_retries_stop);
+	RUN_TEST(test_connection_errors_are_retried);
+	RUN_TEST(test_concurrency_is_limited_per_webhook);
+	RUN_TEST(test_full_queue_is_refused);
+	RUN_TEST(test_finished_results_are_evicted);
+	RUN_TEST(test_template_is_rendered_when_queued);
+	HostTest::finish(UNITY_END());
+}
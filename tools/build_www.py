@@ -0,0 +1,153 @@
+# This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+# Contributors: Sam Groveman
+#
+# Compresses and fingerprints the web interface files in www/ for serving from storage.
+# Runs automatically before each PlatformIO build (see extra_scripts in platformio.ini),
+# or can be run by hand with: python tools/build_www.py
+#
+# Output is written to data/www/ so it can be uploaded with "pio run -t uploadfs", or
+# copied to the /www directory of the device storage using the storage manager page.
+# The same files are packed into lib/WebAssets/src/WebBundle.h and compiled into the
+# firmware, so the interface works without uploading anything (files on storage still
+# take precedence). Use "pio run -t webassets" to regenerate the files without building.
+#  - Stylesheets and scripts are renamed with a content hash (main.css -> main.1a2b3c4d.css)
+#    and served with long-lived immutable caching
+#  - HTML pages keep their names and are revalidated with a strong ETag on every load
+#  - Every file is stored gzipped, and assets.json describes how to serve each URL
+
+import gzip
+import hashlib
+import json
+import os
+import shutil
+
+# Files that are entry points and keep their names
+ENTRY_TYPES = (".html",)
+
+# Content types of known file extensions
+CONTENT_TYPES = {
+	".html": "text/html",
+	".css": "text/css",
+	".js": "application/javascript",
+	".json": "application/json",
+	".png": "image/png",
+	".ico": "image/x-icon",
+	".svg": "image/svg+xml",
+}
+
+def content_hash(data):
+	return hashlib.sha256(data).hexdigest()
+
+def compress(data):
+	# Fixed mtime keeps the output reproducible between builds
+	return gzip.compress(data, compresslevel=9, mtime=0)
+
+def write_bundle(path, bundle):
+	lines = [
+		"// Generated by tools/build_www.py from the files in www/, do not edit",
+		"#pragma once",
+		"#include <Arduino.h>",
+		"",
+		"/// @brief Web interface files compiled into the firmware",
+		"namespace WebBundle {",
+		"\t/// @brief Describes an embedded file",
+		"\tstruct entry {",
+		"\t\tconst char* url;",
+		"\t\tconst uint8_t* data;",
+		"\t\tsize_t length;",
+		"\t\tconst char* etag;",
+		"\t\tconst char* type;",
+		"\t\tbool immutable;",
+		"\t};",
+		"",
+	]
+	urls = sorted(bundle)
+	for i, url in enumerate(urls):
+		gz = bundle[url]["data"]
+		lines.append("\tconst uint8_t asset_%d[] PROGMEM = {" % i)
+		for start in range(0, len(gz), 24):
+			lines.append("\t\t" + ",".join("0x%02x" % b for b in gz[start:start + 24]) + ",")
+		lines.append("\t};")
+	lines.append("")
+	lines.append("\t/// @brief Index of embedded files, sorted by URL")
+	lines.append("\tconstexpr entry entries[] = {")
+	for i, url in enumerate(urls):
+		info = bundle[url]
+		lines.append('\t\t{ "%s", asset_%d, %d, "\\"%s\\"", "%s", %s },' % (url, i, len(info["data"]), info["etag"], info["type"], "true" if info["immutable"] else "false"))
+	lines.append("\t};")
+	lines.append("")
+	lines.append("\t/// @brief Number of embedded files")
+	lines.append("\tconstexpr size_t count = sizeof(entries) / sizeof(entry);")
+	lines.append("}")
+	content = "\n".join(lines) + "\n"
+	# Only touch the header when it changes to avoid needless recompiles
+	if os.path.isfile(path):
+		with open(path) as f:
+			if f.read() == content:
+				return
+	with open(path, "w") as f:
+		f.write(content)
+
+def build(project_dir):
+	src_dir = os.path.join(project_dir, "www")
+	out_dir = os.path.join(project_dir, "data", "www")
+	bundle_path = os.path.join(project_dir, "lib", "WebAssets", "src", "WebBundle.h")
+	if os.path.isdir(out_dir):
+		shutil.rmtree(out_dir)
+	os.makedirs(out_dir)
+
+	files = {}
+	for name in sorted(os.listdir(src_dir)):
+		path = os.path.join(src_dir, name)
+		if os.path.isfile(path):
+			with open(path, "rb") as f:
+				files[name] = f.read()
+
+	# Fingerprint sub-resources first so pages can reference the hashed names
+	renamed = {}
+	for name, data in files.items():
+		base, ext = os.path.splitext(name)
+		if ext not in ENTRY_TYPES:
+			renamed[name] = base + "." + content_hash(data)[:8] + ext
+
+	manifest = {}
+	bundle = {}
+	raw_total = 0
+	gz_total = 0
+	for name, data in files.items():
+		ext = os.path.splitext(name)[1]
+		if ext in ENTRY_TYPES:
+			for old, new in renamed.items():
+				data = data.replace(b'"/' + old.encode() + b'"', b'"/' + new.encode() + b'"')
+		url_name = renamed.get(name, name)
+		gz = compress(data)
+		with open(os.path.join(out_dir, url_name + ".gz"), "wb") as f:
+			f.write(gz)
+		manifest["/" + url_name] = {
+			"file": url_name + ".gz",
+			"etag": content_hash(data)[:16],
+			"type": CONTENT_TYPES.get(ext, "application/octet-stream"),
+			"immutable": url_name != name,
+		}
+		bundle["/" + url_name] = dict(manifest["/" + url_name], data=gz)
+		raw_total += len(data)
+		gz_total += len(gz)
+
+	with open(os.path.join(out_dir, "assets.json"), "w") as f:
+		json.dump({"assets": manifest}, f, separators=(",", ":"), sort_keys=True)
+	write_bundle(bundle_path, bundle)
+
+	print("Web assets: %d files, %d bytes -> %d bytes gzipped (%d%% saved)" % (len(files), raw_total, gz_total, 100 - (gz_total * 100 // max(raw_total, 1))))
+
+try:
+	Import("env")
+	build(env.subst("$PROJECT_DIR"))
+	env.AddCustomTarget(
+		name="webassets",
+		dependencies=None,
+		actions=[lambda *args, **kwargs: build(env.subst("$PROJECT_DIR"))],
+		title="Build web assets",
+		description="Compress and fingerprint www/ and regenerate the embedded bundle"
+	)
+except NameError:
+	build(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
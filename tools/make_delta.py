@@ -0,0 +1,94 @@
+# This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+# Contributors: Sam Groveman
+#
+# Makes a firmware delta that turns one firmware image into another (see lib/DeltaPatch for the format).
+# Devices running the old firmware can then be updated by uploading the much smaller delta to /update?delta
+# (or /update?delta&inflate when gzipped, which is the default).
+#
+# Run by hand with: python tools/make_delta.py old.bin new.bin firmware.delta.gz [--no-gzip]
+# or after a build with "pio run -t delta", which makes .pio/build/<env>/firmware.delta.gz against the image
+# named by the DELTA_BASE environment variable (e.g. the firmware.bin of the release the devices are running).
+#  - Runs of the new image found anywhere in the old image are copied from the device's running firmware
+#  - Everything else is sent as-is, and the whole delta is gzipped
+
+import gzip
+import hashlib
+import os
+import struct
+import sys
+
+# Length of the blocks used to find matches, shorter finds more matches but makes more operations.
+# Every match is at least this long, so it must stay above the 9 bytes of a copy operation to save space
+BLOCK = 32
+
+def make_delta(old, new):
+	# Index every block of the old image by its contents, at every 4 bytes since code is word aligned
+	index = {}
+	for offset in range(0, len(old) - BLOCK + 1, 4):
+		index.setdefault(old[offset:offset + BLOCK], offset)
+
+	operations = []
+	pending = bytearray()
+
+	def flush_insert():
+		if pending:
+			operations.append(struct.pack("<BI", 2, len(pending)) + bytes(pending))
+			pending.clear()
+
+	position = 0
+	while position < len(new):
+		match = index.get(new[position:position + BLOCK])
+		if match is None:
+			pending.append(new[position])
+			position += 1
+			continue
+		# Extend the match as far forward as it goes
+		length = BLOCK
+		while position + length < len(new) and match + length < len(old) and new[position + length] == old[match + length]:
+			length += 1
+		flush_insert()
+		operations.append(struct.pack("<BII", 1, match, length))
+		position += length
+	flush_insert()
+
+	header = b"SHD1" + struct.pack("<I", len(old)) + hashlib.sha256(old).digest() + struct.pack("<I", len(new))
+	return header + b"".join(operations)
+
+def build(old_path, new_path, out_path, compress=True):
+	with open(old_path, "rb") as f:
+		old = f.read()
+	with open(new_path, "rb") as f:
+		new = f.read()
+	delta = make_delta(old, new)
+	if compress:
+		# Fixed mtime keeps the output reproducible between builds
+		delta = gzip.compress(delta, compresslevel=9, mtime=0)
+	with open(out_path, "wb") as f:
+		f.write(delta)
+	print("Firmware delta: %d bytes -> %d bytes (%d%% saved)" % (len(new), len(delta), 100 - (len(delta) * 100 // max(len(new), 1))))
+
+try:
+	Import("env")
+
+	def build_target(*args, **kwargs):
+		base = os.environ.get("DELTA_BASE")
+		if not base:
+			print("Set DELTA_BASE to the firmware image the devices are running")
+			return 1
+		build_dir = env.subst("$BUILD_DIR")
+		build(base, os.path.join(build_dir, env.subst("${PROGNAME}.bin")), os.path.join(build_dir, env.subst("${PROGNAME}.delta.gz")))
+
+	env.AddCustomTarget(
+		name="delta",
+		dependencies="$BUILD_DIR/${PROGNAME}.bin",
+		actions=[build_target],
+		title="Build firmware delta",
+		description="Make a compressed delta of the firmware against the image in DELTA_BASE"
+	)
+except NameError:
+	if __name__ == "__main__":
+		args = [a for a in sys.argv[1:] if not a.startswith("--")]
+		if len(args) != 3:
+			print("Usage: python tools/make_delta.py old.bin new.bin out.delta.gz [--no-gzip]")
+			sys.exit(1)
+		build(args[0], args[1], args[2], "--no-gzip" not in sys.argv)
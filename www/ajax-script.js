@@ -139,4 +139,26 @@ let uprog = {
 		};
 		xhr.send(data);
 	}
-};
\ No newline at end of file
+};
+
+// Subscribe to measurements pushed by the device as they are taken
+// Calls the callback with an array of { parameter, value, unit } objects each time measurements change
+function liveMeasurements(callback) {
+	let measurements = [];
+	let source = new EventSource('/sensors/stream');
+	source.addEventListener('frame', (e) => {
+		let frame = JSON.parse(e.data);
+		measurements = frame.p.map((p, i) => ({ parameter: p, value: frame.v[i], unit: frame.u[i] }));
+		callback(measurements);
+	});
+	source.addEventListener('delta', (e) => {
+		let frame = JSON.parse(e.data);
+		for (let change of frame.d) {
+			if (change[0] < measurements.length) {
+				measurements[change[0]].value = change[1];
+			}
+		}
+		callback(measurements);
+	});
+	return source;
+}
@@ -21,4 +21,21 @@ document.addEventListener("DOMContentLoaded", () => {
 		POSTRequest('/setTime', "Time set", { time:  Math.floor(new Date().getTime() / 1000), offset: 0 - new Date().getTimezoneOffset() * 60 });
 	};
 
-});
\ No newline at end of file
+	// Show measurements as the device takes them
+	liveMeasurements(showMeasurements);
+
+});
+
+// Callback for receiving live measurements
+function showMeasurements(measurements) {
+	let list = document.getElementById("measurement-list");
+	list.innerHTML = "";
+	for (let i = 0; i < measurements.length; i++) {
+		list.innerHTML += `
+		<tr class="file">
+			<td>` + measurements[i].parameter + `</td>
+			<td>` + (measurements[i].value == null ? "-" : measurements[i].value) + `</td>
+			<td>` + measurements[i].unit + `</td>
+		</tr>`;
+	}
+}
\ No newline at end of file
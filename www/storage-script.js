@@ -24,9 +24,17 @@ function updateFileList() {
 	getFileList("/", 5);
 }
 
-// Get list of files
-function getFileList(filePath, traverseDepth = 0) {
-	GETRequest("/list", addFileList, { path: filePath, depth: traverseDepth });
+// Number of files to request at a time
+const filePageSize = 100;
+
+// Get list of files, a page at a time
+function getFileList(filePath, traverseDepth = 0, offset = 0) {
+	GETRequest("/list", (response) => {
+		addFileList(response);
+		if (response != null && response.total > response.offset + response.files.length) {
+			getFileList(filePath, traverseDepth, response.offset + response.files.length);
+		}
+	}, { path: filePath, depth: traverseDepth, offset: offset, limit: filePageSize });
 }
 
 // Callback for receiving file list data
@@ -37,14 +45,25 @@ function addFileList(response) {
 		{
 			list.innerHTML += `
 			<tr class="file">
-				<td>` + response.files[i] + `</td>
-				<td class="download"><a href="/download?path=` + response.files[i] + `">Download</a>
-				<td class="delete" onclick="deleteFile(this)" data-name="` + response.files[i] + `">Delete</td>
+				<td>` + response.files[i].path + `</td>
+				<td>` + formatSize(response.files[i].size) + `</td>
+				<td class="download"><a href="/download?path=` + response.files[i].path + `">Download</a>
+				<td class="delete" onclick="deleteFile(this)" data-name="` + response.files[i].path + `">Delete</td>
 			</tr>`;
 		}
 	}
 }
 
+// Format a file size for display
+function formatSize(size) {
+	if (size < 1024) {
+		return size + " B";
+	} else if (size < 1048576) {
+		return (size / 1024).toFixed(1) + " KB";
+	}
+	return (size / 1048576).toFixed(1) + " MB";
+}
+
 // Delete file
 function deleteFile(file) {
 	let name = file.dataset.name;